@@ -12,7 +12,33 @@ namespace DXRDemo
     std::unique_ptr<GameObject> AssetImporter::ImportAsset(const std::string& filename)
     {
         Assimp::Importer importer;
+        const aiScene* scene = _ReadFile(importer, filename);
 
+        // Create meshes, unless the asset has already been imported
+        auto cachedMeshes = _assetMeshes.find(filename);
+        const std::vector<std::shared_ptr<Mesh>>& meshes = cachedMeshes != _assetMeshes.end() ?
+            cachedMeshes->second :
+            _CreateMeshes(*scene, filename);
+
+        // Create GameObjects from nodes
+        return _CreateGameObjectFromNode(*scene->mRootNode, meshes, filename);
+    }
+
+    const std::vector<std::shared_ptr<Mesh>>& AssetImporter::ImportMeshes(const std::string& filename)
+    {
+        auto cachedMeshes = _assetMeshes.find(filename);
+        if (cachedMeshes != _assetMeshes.end())
+        {
+            return cachedMeshes->second;
+        }
+
+        Assimp::Importer importer;
+        const aiScene* scene = _ReadFile(importer, filename);
+        return _CreateMeshes(*scene, filename);
+    }
+
+    const aiScene* AssetImporter::_ReadFile(Assimp::Importer& importer, const std::string& filename) const
+    {
         const uint32_t flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_FlipWindingOrder;
 
         const aiScene* scene = importer.ReadFile(filename, flags);
@@ -22,36 +48,38 @@ namespace DXRDemo
             throw std::runtime_error("Could not read from file");
         }
 
-        std::unordered_map<unsigned int, std::shared_ptr<Mesh>> meshMap;
+        return scene;
+    }
+
+    const std::vector<std::shared_ptr<Mesh>>& AssetImporter::_CreateMeshes(const aiScene& scene, const std::string& filename)
+    {
         std::unordered_map<unsigned int, std::shared_ptr<MeshMaterial>> materialMap;
-        meshMap.reserve(scene->mNumMeshes);
-        materialMap.reserve(scene->mNumMaterials);
-        
+        materialMap.reserve(scene.mNumMaterials);
+
         // Create materials
-        if (scene->HasMaterials())
+        if (scene.HasMaterials())
         {
-            for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+            for (unsigned int i = 0; i < scene.mNumMaterials; ++i)
             {
-                _materials.push_back(_CreateMaterial(*scene->mMaterials[i]));
+                _materials.push_back(_CreateMaterial(*scene.mMaterials[i]));
                 const std::shared_ptr<MeshMaterial>& newMaterial = _materials.back();
                 materialMap.insert({ i, newMaterial });
             }
         }
 
         // Create meshes
-        if (scene->HasMeshes())
+        std::vector<std::shared_ptr<Mesh>>& meshes = _assetMeshes[filename];
+        if (scene.HasMeshes())
         {
-            for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+            meshes.reserve(scene.mNumMeshes);
+            for (unsigned int i = 0; i < scene.mNumMeshes; ++i)
             {
-
-                _meshes.push_back(_CreateMesh(*scene->mMeshes[i], materialMap));
-                const std::shared_ptr<Mesh>& newMesh = _meshes.back();
-                meshMap.insert({i, newMesh});
+                _meshes.push_back(_CreateMesh(*scene.mMeshes[i], materialMap));
+                meshes.push_back(_meshes.back());
             }
         }
 
-        // Create GameObjects from nodes
-        return _CreateGameObjectFromNode(*scene->mRootNode, meshMap);
+        return meshes;
     }
 
     std::unique_ptr<MeshMaterial> AssetImporter::_CreateMaterial(const aiMaterial& aiMaterial) const
@@ -138,7 +166,8 @@ namespace DXRDemo
 
     std::unique_ptr<GameObject> AssetImporter::_CreateGameObjectFromNode(
         const aiNode& aiNode,
-        const std::unordered_map<unsigned int, std::shared_ptr<Mesh>>& meshMap)
+        const std::vector<std::shared_ptr<Mesh>>& meshes,
+        const std::string& filename)
     {
         std::unique_ptr<GameObject> gameObject = std::make_unique<GameObject>();
 
@@ -155,17 +184,19 @@ namespace DXRDemo
         {
             gameObject->AddComponent(std::make_shared<MeshRenderer>());
             MeshRenderer& meshRenderer = static_cast<MeshRenderer&>(*gameObject->Components.back());
+            meshRenderer.AssetPath = filename;
 
             for (unsigned int i = 0; i < aiNode.mNumMeshes; ++i)
             {
-                meshRenderer.Meshes.push_back(meshMap.at(aiNode.mMeshes[i]));
+                meshRenderer.Meshes.push_back(meshes.at(aiNode.mMeshes[i]));
+                meshRenderer.AssetMeshIndices.push_back(aiNode.mMeshes[i]);
             }
         }
 
         // Populate children
         for (unsigned int i = 0; i < aiNode.mNumChildren; ++i)
         {
-            gameObject->AddChild(_CreateGameObjectFromNode(*aiNode.mChildren[i], meshMap));
+            gameObject->AddChild(_CreateGameObjectFromNode(*aiNode.mChildren[i], meshes, filename));
         }
 
         return gameObject;
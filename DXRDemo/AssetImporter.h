@@ -17,9 +17,17 @@ namespace DXRDemo
     public:
         std::unique_ptr<GameObject> ImportAsset(const std::string& filename);
 
+        // Meshes of an asset, in file order. Assets are only read once, later calls
+        // for the same file return the cached meshes.
+        const std::vector<std::shared_ptr<Mesh>>& ImportMeshes(const std::string& filename);
+
     private:
         std::vector<std::shared_ptr<Mesh>> _meshes;
         std::vector<std::shared_ptr<MeshMaterial>> _materials;
+        std::unordered_map<std::string, std::vector<std::shared_ptr<Mesh>>> _assetMeshes;
+
+        const aiScene* _ReadFile(Assimp::Importer& importer, const std::string& filename) const;
+        const std::vector<std::shared_ptr<Mesh>>& _CreateMeshes(const aiScene& scene, const std::string& filename);
 
         std::unique_ptr<MeshMaterial> _CreateMaterial(const aiMaterial& aiMaterial) const;
         std::unique_ptr<Mesh> _CreateMesh(
@@ -27,6 +35,7 @@ namespace DXRDemo
             const std::unordered_map<unsigned int, std::shared_ptr<MeshMaterial>>& materialMap) const;
         std::unique_ptr<GameObject> _CreateGameObjectFromNode(
             const aiNode& aiNode,
-            const std::unordered_map<unsigned int, std::shared_ptr<Mesh>>& meshMap);
+            const std::vector<std::shared_ptr<Mesh>>& meshes,
+            const std::string& filename);
     };
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace DXRDemo
+{
+    class GameObject;
+    class Component;
+
+    enum class ChangeType : uint8_t
+    {
+        Transform,
+        Material,
+        Hierarchy,
+        Settings,
+        Camera
+    };
+
+    struct Change
+    {
+        ChangeType Type;
+        GameObject* Object = nullptr;
+        Component* Component = nullptr;
+    };
+
+    // Records what changed in a scene since the renderer last looked at it. Edits
+    // are appended as they happen and consumers go through the list once per frame
+    // before it is cleared, so a frame where nothing changed costs nothing.
+    class ChangeJournal final
+    {
+    public:
+        inline void Record(ChangeType type, GameObject* object = nullptr, Component* component = nullptr)
+        {
+            _changes.push_back({ type, object, component });
+            _changedTypes |= 1u << static_cast<uint32_t>(type);
+        }
+
+        inline bool Empty() const
+        {
+            return _changes.empty();
+        }
+
+        inline bool HasChanges(ChangeType type) const
+        {
+            return (_changedTypes & (1u << static_cast<uint32_t>(type))) != 0;
+        }
+
+        inline const std::vector<Change>& GetChanges() const
+        {
+            return _changes;
+        }
+
+        // Keeps the storage, so recording does not allocate once the journal has
+        // grown to the usual number of changes per frame
+        inline void Clear()
+        {
+            _changes.clear();
+            _changedTypes = 0;
+        }
+
+    private:
+        std::vector<Change> _changes;
+        uint32_t _changedTypes = 0;
+    };
+}
@@ -1,14 +1,29 @@
 #include "CommandQueue.h"
 #include "Utilities.h"
 #include <cassert>
+#include <vector>
 
 using namespace Microsoft::WRL;
 
 namespace DXRDemo
 {
+    namespace
+    {
+        // Private data of a command list, naming the pool its allocator goes back to
+        // {5C2B3E0A-8F41-4D7C-9B8E-3A6F1D2C7E94}
+        const GUID CommandAllocatorPoolGuid = { 0x5c2b3e0a, 0x8f41, 0x4d7c, { 0x9b, 0x8e, 0x3a, 0x6f, 0x1d, 0x2c, 0x7e, 0x94 } };
+    }
+
     CommandQueue::CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type) :
         _device(device),
         _commandListType(type),
+        _commandLists(
+            CommandListPoolCapacity,
+            CommandAllocatorIdleFenceValues,
+            [this]() { return _fence->GetCompletedValue(); },
+            // Lists are released with a completed fence value, the pool never waits
+            [](uint64_t fenceValue) {},
+            []() { return ComPtr<ID3D12GraphicsCommandList4>(); }),
         _fenceValue(0)
     {
         // Create command queue
@@ -35,15 +50,12 @@ namespace DXRDemo
 
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> CommandQueue::GetCommandList(ID3D12PipelineState* pipelineState)
     {
-        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator = _GetCommandAllocator();
-        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList;
+        CommandAllocatorPool& pool = _GetThreadCommandAllocatorPool();
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator = pool.Acquire();
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList = _commandLists.Acquire();
 
-        // Reuse in object pool if possible
-        if (!_commandLists.empty())
+        if (commandList)
         {
-            commandList = _commandLists.front();
-            _commandLists.pop();
-
             ThrowIfFailed(commandList->Reset(commandAllocator.Get(), pipelineState));
         }
         else
@@ -52,42 +64,72 @@ namespace DXRDemo
         }
 
         // Associate the command allocator with the command list so that it can be
-        // retrieved when the command list is executed.
+        // retrieved when the command list is executed, along with the pool it
+        // goes back to.
         ThrowIfFailed(commandList->SetPrivateDataInterface(__uuidof(ID3D12CommandAllocator), commandAllocator.Get()));
+        CommandAllocatorPool* poolPointer = &pool;
+        ThrowIfFailed(commandList->SetPrivateData(CommandAllocatorPoolGuid, sizeof(poolPointer), &poolPointer));
 
         return commandList;
     }
 
     uint64_t CommandQueue::ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList)
     {
-        ThrowIfFailed(commandList->Close());
-
-        // Get command allocator associated with this command list
-        ID3D12CommandAllocator* commandAllocator;
-        UINT dataSize = sizeof(commandAllocator);
-        ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
+        return ExecuteCommandLists({ &commandList, 1 });
+    }
 
-        ID3D12CommandList* const commandLists[] = {
-            commandList.Get()
-        };
+    uint64_t CommandQueue::ExecuteCommandLists(std::span<const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>> commandLists)
+    {
+        std::vector<ID3D12CommandList*> d3d12CommandLists;
+        d3d12CommandLists.reserve(commandLists.size());
+        for (const ComPtr<ID3D12GraphicsCommandList4>& commandList : commandLists)
+        {
+            ThrowIfFailed(commandList->Close());
+            d3d12CommandLists.push_back(commandList.Get());
+        }
 
-        _d3d12CommandQueue->ExecuteCommandLists(1, commandLists);
-        uint64_t fenceValue = Signal();
+        uint64_t fenceValue;
+        {
+            std::lock_guard<std::mutex> lock(_submitMutex);
+            _d3d12CommandQueue->ExecuteCommandLists(static_cast<UINT>(d3d12CommandLists.size()), d3d12CommandLists.data());
+            fenceValue = _Signal();
+        }
 
-        // Command allocator must be waited on before being reused
-        _commandAllocators.emplace(CommandAllocatorEntry{ fenceValue, commandAllocator });
-        // Command list can be reused immediately after
-        _commandLists.push(commandList);
+        for (const ComPtr<ID3D12GraphicsCommandList4>& commandList : commandLists)
+        {
+            // Get command allocator associated with this command list, and its pool
+            ID3D12CommandAllocator* commandAllocator;
+            UINT dataSize = sizeof(commandAllocator);
+            ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
+
+            CommandAllocatorPool* pool;
+            dataSize = sizeof(pool);
+            ThrowIfFailed(commandList->GetPrivateData(CommandAllocatorPoolGuid, &dataSize, &pool));
+
+            // Command allocator must be waited on before being reused. GetPrivateData
+            // added a reference, which the ComPtr handed to the pool takes over.
+            ComPtr<ID3D12CommandAllocator> ownedCommandAllocator;
+            ownedCommandAllocator.Attach(commandAllocator);
+            pool->Release(std::move(ownedCommandAllocator), fenceValue);
+        }
 
-        // The ownership of the command allocator has been transferred to the ComPtr
-        // in the command allocator queue. It is safe to release the reference 
-        // in this temporary COM pointer here.
-        commandAllocator->Release();
+        // Command lists can be reused immediately after
+        uint64_t completedValue = _fence->GetCompletedValue();
+        for (const ComPtr<ID3D12GraphicsCommandList4>& commandList : commandLists)
+        {
+            _commandLists.Release(commandList, completedValue);
+        }
 
         return fenceValue;
     }
 
     uint64_t CommandQueue::Signal()
+    {
+        std::lock_guard<std::mutex> lock(_submitMutex);
+        return _Signal();
+    }
+
+    uint64_t CommandQueue::_Signal()
     {
         uint64_t fenceValue = ++_fenceValue;
         _d3d12CommandQueue->Signal(_fence.Get(), fenceValue);
@@ -100,11 +142,16 @@ namespace DXRDemo
     }
 
     void CommandQueue::WaitForFenceValue(uint64_t fenceValue) const
+    {
+        WaitForFenceValue(fenceValue, _fenceEvent);
+    }
+
+    void CommandQueue::WaitForFenceValue(uint64_t fenceValue, HANDLE event) const
     {
         if (!IsFenceComplete(fenceValue))
         {
-            _fence->SetEventOnCompletion(fenceValue, _fenceEvent);
-            ::WaitForSingleObject(_fenceEvent, DWORD_MAX);
+            _fence->SetEventOnCompletion(fenceValue, event);
+            ::WaitForSingleObject(event, DWORD_MAX);
         }
     }
 
@@ -118,24 +165,56 @@ namespace DXRDemo
         return _d3d12CommandQueue;
     }
 
-    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CommandQueue::_GetCommandAllocator()
+    Microsoft::WRL::ComPtr<ID3D12Fence> CommandQueue::GetD3D12Fence() const
     {
-        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
+        return _fence;
+    }
 
-        if (!_commandAllocators.empty() && IsFenceComplete(_commandAllocators.front().fenceValue))
+    CommandQueue::CommandAllocatorPool& CommandQueue::_GetThreadCommandAllocatorPool()
+    {
+        std::thread::id threadId = std::this_thread::get_id();
         {
-            commandAllocator = _commandAllocators.front().commandAllocator;
-            _commandAllocators.pop();
-
-            ThrowIfFailed(commandAllocator->Reset());
-            return commandAllocator;
+            std::shared_lock<std::shared_mutex> lock(_commandAllocatorPoolsMutex);
+            auto pool = _commandAllocatorPools.find(threadId);
+            if (pool != _commandAllocatorPools.end())
+            {
+                return *pool->second;
+            }
         }
-        else
+
+        // First command list of the thread
+        std::unique_lock<std::shared_mutex> lock(_commandAllocatorPoolsMutex);
+        std::unique_ptr<CommandAllocatorPool>& pool = _commandAllocatorPools[threadId];
+        if (!pool)
         {
-            commandAllocator = _CreateCommandAllocator();
+            pool = std::make_unique<CommandAllocatorPool>(
+                CommandAllocatorPoolCapacity,
+                CommandAllocatorIdleFenceValues,
+                [this]() { return _fence->GetCompletedValue(); },
+                // A null event blocks until the fence reaches the value, without
+                // sharing the queue's event between threads
+                [this](uint64_t fenceValue) { ThrowIfFailed(_fence->SetEventOnCompletion(fenceValue, nullptr)); },
+                [this]() { return _CreateCommandAllocator(); },
+                [](ComPtr<ID3D12CommandAllocator>& commandAllocator) { ThrowIfFailed(commandAllocator->Reset()); });
         }
+        return *pool;
+    }
 
-        return commandAllocator;
+    FencedPoolStatistics CommandQueue::GetCommandAllocatorStatistics()
+    {
+        FencedPoolStatistics total;
+        std::shared_lock<std::shared_mutex> lock(_commandAllocatorPoolsMutex);
+        for (const auto& [threadId, pool] : _commandAllocatorPools)
+        {
+            FencedPoolStatistics statistics = pool->GetStatistics();
+            total.Creations += statistics.Creations;
+            total.Reuses += statistics.Reuses;
+            total.Trims += statistics.Trims;
+            total.Waits += statistics.Waits;
+            total.Size += statistics.Size;
+            total.PeakSize += statistics.PeakSize;
+        }
+        return total;
     }
 
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CommandQueue::_CreateCommandAllocator()
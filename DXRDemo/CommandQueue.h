@@ -3,10 +3,19 @@
 #include <d3d12.h> 
 #include <wrl.h>
 #include <cstdint>
-#include <queue>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include "FencedPool.h"
 
 namespace DXRDemo
 {
+    // Command lists can be recorded on several threads at once, each drawing
+    // command allocators from a pool of its own, and executed from any thread.
+    // The lists themselves are shared by every thread through one lock free pool.
     class CommandQueue final
     {
     public:
@@ -19,30 +28,55 @@ namespace DXRDemo
 
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> GetCommandList(ID3D12PipelineState* pipelineState = nullptr);
         uint64_t ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList);
+        // Submits the command lists in one batch, in the order given, and returns
+        // the fence value marking the completion of all of them
+        uint64_t ExecuteCommandLists(std::span<const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>> commandLists);
         uint64_t Signal();
         bool IsFenceComplete(uint64_t fenceValue) const;
         void WaitForFenceValue(uint64_t fenceValue) const;
+        // Waits on the given event instead of the queue's own, so other threads
+        // can wait without racing the owner of the queue
+        void WaitForFenceValue(uint64_t fenceValue, HANDLE event) const;
         void Flush();
         Microsoft::WRL::ComPtr<ID3D12CommandQueue> GetD3D12CommandQueue() const;
+        Microsoft::WRL::ComPtr<ID3D12Fence> GetD3D12Fence() const;
+
+        // Summed over the allocator pools of every recording thread
+        FencedPoolStatistics GetCommandAllocatorStatistics();
+
+        // Command allocators each recording thread keeps, and fence values after
+        // which an allocator left unused is released
+        static constexpr uint32_t CommandAllocatorPoolCapacity = 32;
+        static constexpr uint64_t CommandAllocatorIdleFenceValues = 512;
+        // Closed command lists kept for any thread to record again
+        static constexpr uint32_t CommandListPoolCapacity = 64;
 
     private:
-        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> _GetCommandAllocator();
+        // Allocators of the command lists one thread recorded. They go back to it
+        // from the thread executing the lists.
+        using CommandAllocatorPool = FencedPool<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>>;
+        // A list can be reset as soon as it is submitted, so lists go back with
+        // the fence value completed at that point. The pool hands out null for a
+        // list to be created, which takes the allocator it will record with.
+        using CommandListPool = FencedPool<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>>;
+
+        CommandAllocatorPool& _GetThreadCommandAllocatorPool();
         Microsoft::WRL::ComPtr<ID3D12CommandAllocator> _CreateCommandAllocator();
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> _CreateCommandList(Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator, ID3D12PipelineState* pipelineState = nullptr);
-    
-        struct CommandAllocatorEntry
-        {
-            uint64_t fenceValue;
-            Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
-        };
+        // With _submitMutex held
+        uint64_t _Signal();
 
         Microsoft::WRL::ComPtr<ID3D12Device2>       _device;
         D3D12_COMMAND_LIST_TYPE                     _commandListType;
         Microsoft::WRL::ComPtr<ID3D12CommandQueue>  _d3d12CommandQueue;
-        std::queue<CommandAllocatorEntry>           _commandAllocators;
-        std::queue<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>> _commandLists;
 
-        // Signaling
+        std::shared_mutex                           _commandAllocatorPoolsMutex;
+        std::unordered_map<std::thread::id, std::unique_ptr<CommandAllocatorPool>> _commandAllocatorPools;
+        CommandListPool                             _commandLists;
+
+        // Signaling. Submissions and signals are serialized, so fence values
+        // follow the order work reaches the GPU.
+        std::mutex                                  _submitMutex;
         Microsoft::WRL::ComPtr<ID3D12Fence>         _fence;
         HANDLE                                      _fenceEvent;
         uint64_t                                    _fenceValue;
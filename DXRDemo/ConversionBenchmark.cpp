@@ -0,0 +1,97 @@
+#include "ConversionBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "PixelConversion.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // Best of several runs, in milliseconds
+        double Time(const std::function<void()>& function)
+        {
+            const int runs = 10;
+            double best = std::numeric_limits<double>::max();
+            for (int i = 0; i < runs; ++i)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                function();
+                auto end = std::chrono::high_resolution_clock::now();
+                best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+            }
+            return best;
+        }
+    }
+
+    void RunConversionBenchmark(const std::string& filename, ThreadPool& threadPool)
+    {
+        std::ofstream file(filename);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open benchmark file for writing");
+        }
+
+        struct Resolution
+        {
+            size_t Width;
+            size_t Height;
+        };
+        const Resolution resolutions[] = { { 800, 600 }, { 1920, 1080 }, { 3840, 2160 } };
+
+        std::mt19937 generator(0);
+        std::uniform_int_distribution<uint32_t> byteDistribution(0, 255);
+
+        file << "width,height,conversion,scalar_ms,simd_ms,simd_threaded_ms\n";
+        for (const Resolution& resolution : resolutions)
+        {
+            size_t width = resolution.Width;
+            size_t height = resolution.Height;
+            size_t pixelCount = width * height;
+
+            std::vector<uint8_t> rgba8(pixelCount * 4);
+            for (uint8_t& value : rgba8)
+            {
+                value = static_cast<uint8_t>(byteDistribution(generator));
+            }
+            std::vector<uint16_t> rgba16f(pixelCount * 4);
+            std::vector<float> rgb32f(pixelCount * 3);
+
+            PixelConversion::Scalar::Rgba8ToRgb32f(rgba8.data(), rgb32f.data(), pixelCount);
+            PixelConversion::Scalar::Rgb32fToRgba16f(rgb32f.data(), rgba16f.data(), pixelCount);
+
+            auto write = [&](const char* conversion, double scalar, double simd, double threaded)
+            {
+                file << width << "," << height << "," << conversion << ","
+                    << scalar << "," << simd << "," << threaded << "\n";
+            };
+
+            write("rgba8_to_rgb32f",
+                Time([&]() { PixelConversion::Scalar::Rgba8ToRgb32f(rgba8.data(), rgb32f.data(), pixelCount); }),
+                Time([&]() { PixelConversion::Rgba8ToRgb32f(rgba8.data(), rgb32f.data(), pixelCount); }),
+                Time([&]() { PixelConversion::Rgba8ToRgb32f(rgba8.data(), width * 4, rgb32f.data(), width * 12, width, height, threadPool); }));
+
+            write("rgb32f_to_rgba8",
+                Time([&]() { PixelConversion::Scalar::Rgb32fToRgba8(rgb32f.data(), rgba8.data(), pixelCount); }),
+                Time([&]() { PixelConversion::Rgb32fToRgba8(rgb32f.data(), rgba8.data(), pixelCount); }),
+                Time([&]() { PixelConversion::Rgb32fToRgba8(rgb32f.data(), width * 12, rgba8.data(), width * 4, width, height, threadPool); }));
+
+            write("rgba16f_to_rgb32f",
+                Time([&]() { PixelConversion::Scalar::Rgba16fToRgb32f(rgba16f.data(), rgb32f.data(), pixelCount); }),
+                Time([&]() { PixelConversion::Rgba16fToRgb32f(rgba16f.data(), rgb32f.data(), pixelCount); }),
+                Time([&]() { PixelConversion::Rgba16fToRgb32f(rgba16f.data(), width * 8, rgb32f.data(), width * 12, width, height, threadPool); }));
+
+            write("rgb32f_to_rgba16f",
+                Time([&]() { PixelConversion::Scalar::Rgb32fToRgba16f(rgb32f.data(), rgba16f.data(), pixelCount); }),
+                Time([&]() { PixelConversion::Rgb32fToRgba16f(rgb32f.data(), rgba16f.data(), pixelCount); }),
+                Time([&]() { PixelConversion::Rgb32fToRgba16f(rgb32f.data(), width * 12, rgba16f.data(), width * 8, width, height, threadPool); }));
+        }
+    }
+}
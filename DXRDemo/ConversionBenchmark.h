@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    class ThreadPool;
+
+    // Times the denoiser pixel conversions, scalar, vectorized and vectorized
+    // over the thread pool, at common resolutions and writes the results as CSV
+    void RunConversionBenchmark(const std::string& filename, ThreadPool& threadPool);
+}
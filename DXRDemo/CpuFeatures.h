@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace DXRDemo
+{
+    // Instruction set extensions the vectorized CPU kernels can use
+    struct CpuFeatures
+    {
+        bool Sse41 = false;
+        bool Avx2 = false;
+        bool F16c = false;
+    };
+
+    // Registers of a cpuid leaf, all zero when the leaf or the instruction is
+    // not available
+    inline void ReadCpuid(uint32_t leaf, uint32_t subleaf, uint32_t info[4])
+    {
+        info[0] = info[1] = info[2] = info[3] = 0;
+#if defined(_MSC_VER)
+        int registers[4];
+        __cpuidex(registers, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; ++i)
+        {
+            info[i] = static_cast<uint32_t>(registers[i]);
+        }
+#elif defined(__x86_64__) || defined(__i386__)
+        __get_cpuid_count(leaf, subleaf, &info[0], &info[1], &info[2], &info[3]);
+#endif
+    }
+
+    // State components the OS saves on context switches, only to be read when
+    // cpuid reports OSXSAVE
+    inline uint64_t ReadXcr0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#elif defined(__x86_64__) || defined(__i386__)
+        // The intrinsic needs -mxsave on GCC and Clang, the instruction does not
+        uint32_t low = 0;
+        uint32_t high = 0;
+        __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        return (static_cast<uint64_t>(high) << 32) | low;
+#else
+        return 0;
+#endif
+    }
+
+    inline CpuFeatures DetectCpuFeatures()
+    {
+        CpuFeatures features;
+
+        uint32_t info[4];
+        ReadCpuid(0, 0, info);
+        uint32_t maxLeaf = info[0];
+
+        ReadCpuid(1, 0, info);
+        features.Sse41 = (info[2] & (1u << 19)) != 0;
+        bool osxsave = (info[2] & (1u << 27)) != 0;
+        bool avx = (info[2] & (1u << 28)) != 0;
+        bool f16c = (info[2] & (1u << 29)) != 0;
+
+        // The OS has to save the YMM registers for AVX code to be usable
+        bool ymmEnabled = osxsave && avx && (ReadXcr0() & 6) == 6;
+        features.F16c = f16c && ymmEnabled;
+
+        if (maxLeaf >= 7)
+        {
+            ReadCpuid(7, 0, info);
+            features.Avx2 = (info[1] & (1u << 5)) != 0 && ymmEnabled;
+        }
+
+        return features;
+    }
+
+    // Detected once, on first use
+    inline const CpuFeatures& GetCpuFeatures()
+    {
+        static const CpuFeatures features = DetectCpuFeatures();
+        return features;
+    }
+}
@@ -0,0 +1,474 @@
+#include "D3D12Backend.h"
+
+#include <d3dx12.h>
+#include <cassert>
+#include <stdexcept>
+#include "Utilities.h"
+
+using namespace Microsoft::WRL;
+
+namespace DXRDemo
+{
+    D3D12_RESOURCE_DESC ToD3D12ResourceDesc(const ResourceDesc& desc)
+    {
+        D3D12_RESOURCE_FLAGS flags = static_cast<D3D12_RESOURCE_FLAGS>(desc.Flags);
+        if (desc.Dimension == ResourceDimension::Buffer)
+        {
+            return CD3DX12_RESOURCE_DESC::Buffer(desc.Width, flags);
+        }
+        return CD3DX12_RESOURCE_DESC::Tex2D(static_cast<DXGI_FORMAT>(desc.Format), desc.Width, desc.Height, 1, 1, 1, 0, flags);
+    }
+
+    D3D12RenderResource::D3D12RenderResource(ComPtr<ID3D12Resource> resource, const ResourceDesc& desc) :
+        _resource(resource),
+        _desc(desc)
+    {
+    }
+
+    const ResourceDesc& D3D12RenderResource::GetDesc() const
+    {
+        return _desc;
+    }
+
+    void* D3D12RenderResource::Map()
+    {
+        // The CPU does not read upload heaps
+        CD3DX12_RANGE readRange(0, 0);
+        void* data;
+        ThrowIfFailed(_resource->Map(0, _desc.Heap == HeapType::Upload ? &readRange : nullptr, &data));
+        return data;
+    }
+
+    void D3D12RenderResource::Unmap()
+    {
+        // Nor writes readback heaps
+        CD3DX12_RANGE writtenRange(0, 0);
+        _resource->Unmap(0, _desc.Heap == HeapType::Readback ? &writtenRange : nullptr);
+    }
+
+    uint64_t D3D12RenderResource::GetGpuAddress() const
+    {
+        return _desc.Dimension == ResourceDimension::Buffer ? _resource->GetGPUVirtualAddress() : 0;
+    }
+
+    D3D12RenderHeap::D3D12RenderHeap(ID3D12Device* device, uint64_t size) :
+        _device(device),
+        _size(size)
+    {
+        D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+        ThrowIfFailed(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+        _tier = options.ResourceHeapTier;
+
+        // Buffers and textures share the heap, which resource heap tier 2 allows
+        if (_tier != D3D12_RESOURCE_HEAP_TIER_1)
+        {
+            _CreateHeap(AllResources, D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES);
+        }
+    }
+
+    uint64_t D3D12RenderHeap::GetSize() const
+    {
+        return _size;
+    }
+
+    ID3D12Heap* D3D12RenderHeap::GetNative(const D3D12_RESOURCE_DESC& desc)
+    {
+        if (_tier != D3D12_RESOURCE_HEAP_TIER_1)
+        {
+            return _heaps[AllResources].Get();
+        }
+
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        {
+            if (_heaps[Buffers] == nullptr)
+            {
+                _CreateHeap(Buffers, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS);
+            }
+            return _heaps[Buffers].Get();
+        }
+
+        if ((desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0)
+        {
+            if (_heaps[RenderTargetTextures] == nullptr)
+            {
+                _CreateHeap(RenderTargetTextures, D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+            }
+            return _heaps[RenderTargetTextures].Get();
+        }
+
+        if (_heaps[NonRenderTargetTextures] == nullptr)
+        {
+            _CreateHeap(NonRenderTargetTextures, D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES);
+        }
+        return _heaps[NonRenderTargetTextures].Get();
+    }
+
+    void D3D12RenderHeap::_CreateHeap(HeapKind kind, D3D12_HEAP_FLAGS flags)
+    {
+        CD3DX12_HEAP_DESC desc(_size, D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, flags);
+        ThrowIfFailed(_device->CreateHeap(&desc, IID_PPV_ARGS(&_heaps[kind])));
+    }
+
+    D3D12RenderFence::D3D12RenderFence(ComPtr<ID3D12Fence> fence) :
+        _fence(fence)
+    {
+        _event = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+        assert(_event && "Failed to create fence event.");
+    }
+
+    D3D12RenderFence::~D3D12RenderFence()
+    {
+        ::CloseHandle(_event);
+    }
+
+    uint64_t D3D12RenderFence::GetCompletedValue() const
+    {
+        return _fence->GetCompletedValue();
+    }
+
+    void D3D12RenderFence::Wait(uint64_t value)
+    {
+        if (_fence->GetCompletedValue() < value)
+        {
+            ThrowIfFailed(_fence->SetEventOnCompletion(value, _event));
+            ::WaitForSingleObject(_event, INFINITE);
+        }
+    }
+
+    D3D12RenderDescriptorHeap::D3D12RenderDescriptorHeap(ID3D12Device* device, DescriptorHeapType type, uint32_t count, bool shaderVisible) :
+        _type(type),
+        _count(count),
+        _shaderVisible(shaderVisible)
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+        desc.NumDescriptors = count;
+        desc.Type = static_cast<D3D12_DESCRIPTOR_HEAP_TYPE>(type);
+        desc.Flags = shaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+        ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&_heap)));
+
+        _incrementSize = device->GetDescriptorHandleIncrementSize(desc.Type);
+        _start.Cpu = _heap->GetCPUDescriptorHandleForHeapStart().ptr;
+        if (shaderVisible)
+        {
+            _start.Gpu = _heap->GetGPUDescriptorHandleForHeapStart().ptr;
+        }
+    }
+
+    DescriptorHeapType D3D12RenderDescriptorHeap::GetType() const
+    {
+        return _type;
+    }
+
+    uint32_t D3D12RenderDescriptorHeap::GetCount() const
+    {
+        return _count;
+    }
+
+    bool D3D12RenderDescriptorHeap::IsShaderVisible() const
+    {
+        return _shaderVisible;
+    }
+
+    DescriptorHandle D3D12RenderDescriptorHeap::GetHandle(uint32_t index) const
+    {
+        uint64_t offset = static_cast<uint64_t>(index) * _incrementSize;
+        return { _start.Cpu + offset, _shaderVisible ? _start.Gpu + offset : 0 };
+    }
+
+    D3D12RenderCommandList::D3D12RenderCommandList(ID3D12Device* device, ComPtr<ID3D12GraphicsCommandList4> commandList, CommandListType type) :
+        _device(device),
+        _commandList(commandList),
+        _type(type)
+    {
+    }
+
+    CommandListType D3D12RenderCommandList::GetType() const
+    {
+        return _type;
+    }
+
+    void D3D12RenderCommandList::Barriers(std::span<const ResourceBarrier> barriers)
+    {
+        _barriers.clear();
+        for (const ResourceBarrier& barrier : barriers)
+        {
+            switch (barrier.Kind)
+            {
+                case ResourceBarrier::Type::Transition:
+                    _barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(GetD3D12Resource(barrier.Resource),
+                        static_cast<D3D12_RESOURCE_STATES>(barrier.StateBefore),
+                        static_cast<D3D12_RESOURCE_STATES>(barrier.StateAfter),
+                        D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                        static_cast<D3D12_RESOURCE_BARRIER_FLAGS>(barrier.SplitFlags)));
+                    break;
+                case ResourceBarrier::Type::UnorderedAccess:
+                    _barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(GetD3D12Resource(barrier.Resource)));
+                    break;
+                case ResourceBarrier::Type::Aliasing:
+                    _barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(GetD3D12Resource(barrier.ResourceBefore), GetD3D12Resource(barrier.Resource)));
+                    break;
+            }
+        }
+
+        if (!_barriers.empty())
+        {
+            _commandList->ResourceBarrier(static_cast<UINT>(_barriers.size()), _barriers.data());
+        }
+    }
+
+    void D3D12RenderCommandList::CopyBufferRegion(RenderResource& destination, uint64_t destinationOffset,
+        RenderResource& source, uint64_t sourceOffset, uint64_t size)
+    {
+        _commandList->CopyBufferRegion(GetD3D12Resource(&destination), destinationOffset, GetD3D12Resource(&source), sourceOffset, size);
+    }
+
+    void D3D12RenderCommandList::CopyResource(RenderResource& destination, RenderResource& source)
+    {
+        _commandList->CopyResource(GetD3D12Resource(&destination), GetD3D12Resource(&source));
+    }
+
+    void D3D12RenderCommandList::CopyTextureToBuffer(RenderResource& destination, uint64_t bufferOffset, RenderResource& source)
+    {
+        ID3D12Resource* texture = GetD3D12Resource(&source);
+        CD3DX12_TEXTURE_COPY_LOCATION textureLocation(texture, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION bufferLocation(GetD3D12Resource(&destination), _GetFootprint(texture, bufferOffset));
+        _commandList->CopyTextureRegion(&bufferLocation, 0, 0, 0, &textureLocation, nullptr);
+    }
+
+    void D3D12RenderCommandList::CopyBufferToTexture(RenderResource& destination, RenderResource& source, uint64_t bufferOffset)
+    {
+        ID3D12Resource* texture = GetD3D12Resource(&destination);
+        CD3DX12_TEXTURE_COPY_LOCATION textureLocation(texture, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION bufferLocation(GetD3D12Resource(&source), _GetFootprint(texture, bufferOffset));
+        _commandList->CopyTextureRegion(&textureLocation, 0, 0, 0, &bufferLocation, nullptr);
+    }
+
+    void D3D12RenderCommandList::DiscardResource(RenderResource& resource)
+    {
+        _commandList->DiscardResource(GetD3D12Resource(&resource), nullptr);
+    }
+
+    void D3D12RenderCommandList::SetDescriptorHeaps(std::span<RenderDescriptorHeap* const> heaps)
+    {
+        ID3D12DescriptorHeap* nativeHeaps[2] = {};
+        assert(heaps.size() <= _countof(nativeHeaps) && "At most one CBV/SRV/UAV and one sampler heap can be set.");
+        for (std::size_t i = 0; i < heaps.size(); ++i)
+        {
+            nativeHeaps[i] = static_cast<D3D12RenderDescriptorHeap*>(heaps[i])->GetNative();
+        }
+        _commandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), nativeHeaps);
+    }
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT D3D12RenderCommandList::_GetFootprint(ID3D12Resource* texture, uint64_t bufferOffset) const
+    {
+        D3D12_RESOURCE_DESC desc = texture->GetDesc();
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+        _device->GetCopyableFootprints(&desc, 0, 1, bufferOffset, &footprint, nullptr, nullptr, nullptr);
+        return footprint;
+    }
+
+    D3D12RenderQueue::D3D12RenderQueue(ID3D12Device* device, CommandQueue& commandQueue, CommandListType type) :
+        _device(device),
+        _commandQueue(&commandQueue),
+        _type(type),
+        _fence(commandQueue.GetD3D12Fence())
+    {
+    }
+
+    CommandListType D3D12RenderQueue::GetType() const
+    {
+        return _type;
+    }
+
+    RenderFence& D3D12RenderQueue::GetFence()
+    {
+        return _fence;
+    }
+
+    std::unique_ptr<RenderCommandList> D3D12RenderQueue::GetCommandList()
+    {
+        return std::make_unique<D3D12RenderCommandList>(_device, _commandQueue->GetCommandList(), _type);
+    }
+
+    uint64_t D3D12RenderQueue::ExecuteCommandList(std::unique_ptr<RenderCommandList> commandList)
+    {
+        return _commandQueue->ExecuteCommandList(static_cast<D3D12RenderCommandList&>(*commandList).GetNative());
+    }
+
+    uint64_t D3D12RenderQueue::Signal()
+    {
+        return _commandQueue->Signal();
+    }
+
+    void D3D12RenderQueue::Wait(RenderQueue& queue, uint64_t fenceValue)
+    {
+        ID3D12Fence* fence = static_cast<D3D12RenderQueue&>(queue)._fence.GetNative();
+        ThrowIfFailed(_commandQueue->GetD3D12CommandQueue()->Wait(fence, fenceValue));
+    }
+
+    D3D12RenderDevice::D3D12RenderDevice(ComPtr<ID3D12Device5> device, CommandQueue& directCommandQueue, CommandQueue& copyCommandQueue) :
+        _device(device),
+        _directQueue(device.Get(), directCommandQueue, CommandListType::Direct),
+        _copyQueue(device.Get(), copyCommandQueue, CommandListType::Copy)
+    {
+    }
+
+    RenderQueue& D3D12RenderDevice::GetQueue(CommandListType type)
+    {
+        switch (type)
+        {
+            case CommandListType::Direct:
+                return _directQueue;
+            case CommandListType::Copy:
+                return _copyQueue;
+            default:
+                throw std::invalid_argument("The device has no queue of this type");
+        }
+    }
+
+    std::shared_ptr<RenderResource> D3D12RenderDevice::CreateResource(const ResourceDesc& desc)
+    {
+        CD3DX12_HEAP_PROPERTIES heapProperties(static_cast<D3D12_HEAP_TYPE>(desc.Heap));
+        D3D12_RESOURCE_DESC nativeDesc = ToD3D12ResourceDesc(desc);
+        ComPtr<ID3D12Resource> resource;
+        ThrowIfFailed(_device->CreateCommittedResource(
+            &heapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &nativeDesc,
+            static_cast<D3D12_RESOURCE_STATES>(desc.InitialState),
+            nullptr,
+            IID_PPV_ARGS(&resource)));
+        return std::make_shared<D3D12RenderResource>(resource, desc);
+    }
+
+    std::shared_ptr<RenderHeap> D3D12RenderDevice::CreateHeap(uint64_t size)
+    {
+        return std::make_shared<D3D12RenderHeap>(_device.Get(), size);
+    }
+
+    std::shared_ptr<RenderResource> D3D12RenderDevice::CreatePlacedResource(std::shared_ptr<RenderHeap> heap, uint64_t offset, const ResourceDesc& desc)
+    {
+        if (desc.Heap != HeapType::Default)
+        {
+            throw std::invalid_argument("Placed resources must be on the default heap");
+        }
+
+        // The resource holds a reference to its heap
+        D3D12_RESOURCE_DESC nativeDesc = ToD3D12ResourceDesc(desc);
+        ComPtr<ID3D12Resource> resource;
+        ThrowIfFailed(_device->CreatePlacedResource(
+            static_cast<D3D12RenderHeap&>(*heap).GetNative(nativeDesc),
+            offset,
+            &nativeDesc,
+            static_cast<D3D12_RESOURCE_STATES>(desc.InitialState),
+            nullptr,
+            IID_PPV_ARGS(&resource)));
+        return std::make_shared<D3D12RenderResource>(resource, desc);
+    }
+
+    uint64_t D3D12RenderDevice::GetAllocationSize(const ResourceDesc& desc, uint64_t* alignment) const
+    {
+        D3D12_RESOURCE_DESC nativeDesc = ToD3D12ResourceDesc(desc);
+        D3D12_RESOURCE_ALLOCATION_INFO info = _device->GetResourceAllocationInfo(0, 1, &nativeDesc);
+        if (alignment != nullptr)
+        {
+            *alignment = info.Alignment;
+        }
+        return info.SizeInBytes;
+    }
+
+    std::shared_ptr<RenderDescriptorHeap> D3D12RenderDevice::CreateDescriptorHeap(DescriptorHeapType type, uint32_t count, bool shaderVisible)
+    {
+        return std::make_shared<D3D12RenderDescriptorHeap>(_device.Get(), type, count, shaderVisible);
+    }
+
+    uint64_t D3D12RenderDevice::GetCopyableFootprint(const ResourceDesc& desc, uint64_t* rowPitch) const
+    {
+        D3D12_RESOURCE_DESC nativeDesc = ToD3D12ResourceDesc(desc);
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+        uint64_t size;
+        _device->GetCopyableFootprints(&nativeDesc, 0, 1, 0, &footprint, nullptr, nullptr, &size);
+        if (rowPitch != nullptr)
+        {
+            *rowPitch = footprint.Footprint.RowPitch;
+        }
+        return size;
+    }
+
+    void D3D12RenderDevice::CreateShaderResourceView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride)
+    {
+        const ResourceDesc& desc = resource.GetDesc();
+        D3D12_CPU_DESCRIPTOR_HANDLE handle = { static_cast<SIZE_T>(destination.Cpu) };
+        if (desc.Dimension != ResourceDimension::Buffer)
+        {
+            _device->CreateShaderResourceView(GetD3D12Resource(&resource), nullptr, handle);
+            return;
+        }
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+        viewDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+        viewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        if (structureStride != 0)
+        {
+            viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+            viewDesc.Buffer.NumElements = static_cast<UINT>(desc.Width / structureStride);
+            viewDesc.Buffer.StructureByteStride = structureStride;
+        }
+        else
+        {
+            viewDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+            viewDesc.Buffer.NumElements = static_cast<UINT>(desc.Width / 4);
+            viewDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+        }
+        _device->CreateShaderResourceView(GetD3D12Resource(&resource), &viewDesc, handle);
+    }
+
+    void D3D12RenderDevice::CreateUnorderedAccessView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride)
+    {
+        const ResourceDesc& desc = resource.GetDesc();
+        D3D12_CPU_DESCRIPTOR_HANDLE handle = { static_cast<SIZE_T>(destination.Cpu) };
+        if (desc.Dimension != ResourceDimension::Buffer)
+        {
+            _device->CreateUnorderedAccessView(GetD3D12Resource(&resource), nullptr, nullptr, handle);
+            return;
+        }
+
+        D3D12_UNORDERED_ACCESS_VIEW_DESC viewDesc = {};
+        viewDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+        if (structureStride != 0)
+        {
+            viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+            viewDesc.Buffer.NumElements = static_cast<UINT>(desc.Width / structureStride);
+            viewDesc.Buffer.StructureByteStride = structureStride;
+        }
+        else
+        {
+            viewDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+            viewDesc.Buffer.NumElements = static_cast<UINT>(desc.Width / 4);
+            viewDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+        }
+        _device->CreateUnorderedAccessView(GetD3D12Resource(&resource), nullptr, &viewDesc, handle);
+    }
+
+    void D3D12RenderDevice::CopyDescriptors(DescriptorHandle destination, DescriptorHandle source, uint32_t count, DescriptorHeapType type)
+    {
+        _device->CopyDescriptorsSimple(count,
+            { static_cast<SIZE_T>(destination.Cpu) },
+            { static_cast<SIZE_T>(source.Cpu) },
+            static_cast<D3D12_DESCRIPTOR_HEAP_TYPE>(type));
+    }
+
+    std::shared_ptr<RenderResource> D3D12RenderDevice::WrapResource(ComPtr<ID3D12Resource> resource, HeapType heap, ResourceState state)
+    {
+        D3D12_RESOURCE_DESC nativeDesc = resource->GetDesc();
+        ResourceDesc desc;
+        desc.Dimension = nativeDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? ResourceDimension::Buffer : ResourceDimension::Texture2D;
+        desc.Width = nativeDesc.Width;
+        desc.Height = nativeDesc.Height;
+        desc.Format = static_cast<ResourceFormat>(nativeDesc.Format);
+        desc.Flags = static_cast<ResourceFlags>(nativeDesc.Flags);
+        desc.Heap = heap;
+        desc.InitialState = state;
+        return std::make_shared<D3D12RenderResource>(resource, desc);
+    }
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <memory>
+#include <vector>
+#include "CommandQueue.h"
+#include "RenderBackend.h"
+
+namespace DXRDemo
+{
+    // RenderBackend over D3D12. The objects wrap native ones, which GetNative
+    // returns for the work the interfaces leave to D3D12, such as pipelines and
+    // ray dispatches.
+
+    class D3D12RenderResource final : public RenderResource
+    {
+    public:
+        D3D12RenderResource(Microsoft::WRL::ComPtr<ID3D12Resource> resource, const ResourceDesc& desc);
+
+        const ResourceDesc& GetDesc() const override;
+        void* Map() override;
+        void Unmap() override;
+        uint64_t GetGpuAddress() const override;
+
+        inline ID3D12Resource* GetNative() const
+        {
+            return _resource.Get();
+        }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12Resource> _resource;
+        ResourceDesc _desc;
+    };
+
+    // On resource heap tier 1, buffers, render target and depth stencil textures,
+    // and other textures cannot share a heap. Each kind then gets a heap of the
+    // full size, created once a resource of that kind is placed, so offsets mean
+    // the same in all of them.
+    class D3D12RenderHeap final : public RenderHeap
+    {
+    public:
+        D3D12RenderHeap(ID3D12Device* device, uint64_t size);
+
+        uint64_t GetSize() const override;
+
+        // Heap a resource of desc is placed in
+        ID3D12Heap* GetNative(const D3D12_RESOURCE_DESC& desc);
+
+    private:
+        enum HeapKind
+        {
+            AllResources = 0,
+            Buffers = 0,
+            NonRenderTargetTextures,
+            RenderTargetTextures,
+            HeapKindCount
+        };
+
+        ID3D12Device* _device;
+        uint64_t _size;
+        D3D12_RESOURCE_HEAP_TIER _tier;
+        // A single heap for every kind on tier 2, one per kind on tier 1
+        Microsoft::WRL::ComPtr<ID3D12Heap> _heaps[HeapKindCount];
+
+        void _CreateHeap(HeapKind kind, D3D12_HEAP_FLAGS flags);
+    };
+
+    class D3D12RenderFence final : public RenderFence
+    {
+    public:
+        explicit D3D12RenderFence(Microsoft::WRL::ComPtr<ID3D12Fence> fence);
+        D3D12RenderFence(const D3D12RenderFence&) = delete;
+        D3D12RenderFence& operator=(const D3D12RenderFence&) = delete;
+        ~D3D12RenderFence();
+
+        uint64_t GetCompletedValue() const override;
+        void Wait(uint64_t value) override;
+
+        inline ID3D12Fence* GetNative() const
+        {
+            return _fence.Get();
+        }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12Fence> _fence;
+        HANDLE _event;
+    };
+
+    class D3D12RenderDescriptorHeap final : public RenderDescriptorHeap
+    {
+    public:
+        D3D12RenderDescriptorHeap(ID3D12Device* device, DescriptorHeapType type, uint32_t count, bool shaderVisible);
+
+        DescriptorHeapType GetType() const override;
+        uint32_t GetCount() const override;
+        bool IsShaderVisible() const override;
+        DescriptorHandle GetHandle(uint32_t index) const override;
+
+        inline ID3D12DescriptorHeap* GetNative() const
+        {
+            return _heap.Get();
+        }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _heap;
+        DescriptorHeapType _type;
+        uint32_t _count;
+        bool _shaderVisible;
+        uint32_t _incrementSize;
+        DescriptorHandle _start;
+    };
+
+    class D3D12RenderCommandList final : public RenderCommandList
+    {
+    public:
+        D3D12RenderCommandList(ID3D12Device* device, Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList, CommandListType type);
+
+        CommandListType GetType() const override;
+        void Barriers(std::span<const ResourceBarrier> barriers) override;
+        void CopyBufferRegion(RenderResource& destination, uint64_t destinationOffset,
+            RenderResource& source, uint64_t sourceOffset, uint64_t size) override;
+        void CopyResource(RenderResource& destination, RenderResource& source) override;
+        void CopyTextureToBuffer(RenderResource& destination, uint64_t bufferOffset, RenderResource& source) override;
+        void CopyBufferToTexture(RenderResource& destination, RenderResource& source, uint64_t bufferOffset) override;
+        void DiscardResource(RenderResource& resource) override;
+        void SetDescriptorHeaps(std::span<RenderDescriptorHeap* const> heaps) override;
+
+        inline const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>& GetNative() const
+        {
+            return _commandList;
+        }
+
+    private:
+        ID3D12Device* _device;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> _commandList;
+        CommandListType _type;
+        // Kept between calls to spare the allocations
+        std::vector<D3D12_RESOURCE_BARRIER> _barriers;
+
+        // Location of a texture in a buffer starting at bufferOffset
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT _GetFootprint(ID3D12Resource* texture, uint64_t bufferOffset) const;
+    };
+
+    // Wraps a CommandQueue, so native and backend submissions share its fence
+    class D3D12RenderQueue final : public RenderQueue
+    {
+    public:
+        D3D12RenderQueue(ID3D12Device* device, CommandQueue& commandQueue, CommandListType type);
+
+        CommandListType GetType() const override;
+        RenderFence& GetFence() override;
+        std::unique_ptr<RenderCommandList> GetCommandList() override;
+        uint64_t ExecuteCommandList(std::unique_ptr<RenderCommandList> commandList) override;
+        uint64_t Signal() override;
+        void Wait(RenderQueue& queue, uint64_t fenceValue) override;
+
+        inline CommandQueue& GetNative() const
+        {
+            return *_commandQueue;
+        }
+
+    private:
+        ID3D12Device* _device;
+        CommandQueue* _commandQueue;
+        CommandListType _type;
+        D3D12RenderFence _fence;
+    };
+
+    class D3D12RenderDevice final : public RenderDevice
+    {
+    public:
+        D3D12RenderDevice(Microsoft::WRL::ComPtr<ID3D12Device5> device, CommandQueue& directCommandQueue, CommandQueue& copyCommandQueue);
+
+        RenderQueue& GetQueue(CommandListType type) override;
+        std::shared_ptr<RenderResource> CreateResource(const ResourceDesc& desc) override;
+        std::shared_ptr<RenderHeap> CreateHeap(uint64_t size) override;
+        std::shared_ptr<RenderResource> CreatePlacedResource(std::shared_ptr<RenderHeap> heap, uint64_t offset, const ResourceDesc& desc) override;
+        uint64_t GetAllocationSize(const ResourceDesc& desc, uint64_t* alignment = nullptr) const override;
+        std::shared_ptr<RenderDescriptorHeap> CreateDescriptorHeap(DescriptorHeapType type, uint32_t count, bool shaderVisible) override;
+        uint64_t GetCopyableFootprint(const ResourceDesc& desc, uint64_t* rowPitch = nullptr) const override;
+        void CreateShaderResourceView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride = 0) override;
+        void CreateUnorderedAccessView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride = 0) override;
+        void CopyDescriptors(DescriptorHandle destination, DescriptorHandle source, uint32_t count, DescriptorHeapType type) override;
+
+        // Wraps a resource created natively, currently in the given state
+        std::shared_ptr<RenderResource> WrapResource(Microsoft::WRL::ComPtr<ID3D12Resource> resource, HeapType heap, ResourceState state);
+
+        inline ID3D12Device5* GetNative() const
+        {
+            return _device.Get();
+        }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12Device5> _device;
+        D3D12RenderQueue _directQueue;
+        D3D12RenderQueue _copyQueue;
+    };
+
+    D3D12_RESOURCE_DESC ToD3D12ResourceDesc(const ResourceDesc& desc);
+
+    inline ID3D12Resource* GetD3D12Resource(RenderResource* resource)
+    {
+        return resource != nullptr ? static_cast<D3D12RenderResource*>(resource)->GetNative() : nullptr;
+    }
+
+    inline const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>& GetD3D12CommandList(RenderCommandList& commandList)
+    {
+        return static_cast<D3D12RenderCommandList&>(commandList).GetNative();
+    }
+}
@@ -13,6 +13,7 @@ namespace DXRDemo
         //_EnableDebugLayer();
 
         _backBuffers.resize(numBuffers);
+        _backBufferResources.resize(numBuffers);
 
         // Initialize
         _tearingSupported = _CheckTearingSupport();
@@ -24,6 +25,10 @@ namespace DXRDemo
         // Create command queues
         DirectCommandQueue = std::make_unique<CommandQueue>(Device, D3D12_COMMAND_LIST_TYPE_DIRECT);
         CopyCommandQueue = std::make_unique<CommandQueue>(Device, D3D12_COMMAND_LIST_TYPE_COPY);
+        RenderDevice = std::make_unique<D3D12RenderDevice>(Device, *DirectCommandQueue, *CopyCommandQueue);
+        CopyUploadRing = std::make_unique<UploadRingBuffer>(Device.Get(), *CopyCommandQueue, CopyUploadRingSize);
+        BufferHeaps = std::make_unique<PlacedResourceAllocator>(Device.Get());
+        ResourceStates = std::make_unique<ResourceStateRegistry>();
 
         // Create swap chain
         _swapChain = _CreateSwapChain(window.GetHWND(),
@@ -89,6 +94,11 @@ namespace DXRDemo
         return _backBuffers[_currentBackBufferIndex];
     }
 
+    RenderResource& DXContext::GetCurrentBackBufferResource() const
+    {
+        return *_backBufferResources[_currentBackBufferIndex];
+    }
+
     D3D12_CPU_DESCRIPTOR_HANDLE DXContext::GetCurrentRenderTargetView() const
     {
         return CD3DX12_CPU_DESCRIPTOR_HANDLE(
@@ -136,43 +146,18 @@ namespace DXRDemo
         return options5.RaytracingTier >= D3D12_RAYTRACING_TIER_1_0;
     }
 
-    void DXContext::UpdateBufferResource(ID3D12GraphicsCommandList4* commandList, ID3D12Resource** pDestinationResource, ID3D12Resource** pIntermediateResource, size_t numElements, size_t elementSize, const void* bufferData, D3D12_RESOURCE_FLAGS flags)
+    void DXContext::UpdateBufferResource(ID3D12Resource** pDestinationResource, size_t numElements, size_t elementSize, const void* bufferData, D3D12_RESOURCE_FLAGS flags)
     {
         {
             size_t bufferSize = numElements * elementSize;
 
-            // Create a committed resource for the GPU resource in a default heap
-            CD3DX12_HEAP_PROPERTIES defaultProperties(D3D12_HEAP_TYPE_DEFAULT);
-            CD3DX12_RESOURCE_DESC defaultResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, flags);
-            ThrowIfFailed(Device->CreateCommittedResource(
-                &defaultProperties,
-                D3D12_HEAP_FLAG_NONE,
-                &defaultResourceDesc,
-                D3D12_RESOURCE_STATE_COPY_DEST,
-                nullptr,
-                IID_PPV_ARGS(pDestinationResource)));
-
-            // Create an committed resource for the upload
+            // Placed in one of the shared default heaps
+            *pDestinationResource = BufferHeaps->CreateBuffer(bufferSize, flags, D3D12_RESOURCE_STATE_COPY_DEST).Detach();
+
+            // Staged in the upload ring, whose space comes back once the copy completes
             if (bufferData)
             {
-                CD3DX12_HEAP_PROPERTIES uploadProperties(D3D12_HEAP_TYPE_UPLOAD);
-                CD3DX12_RESOURCE_DESC uploadResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-                ThrowIfFailed(Device->CreateCommittedResource(
-                    &uploadProperties,
-                    D3D12_HEAP_FLAG_NONE,
-                    &uploadResourceDesc,
-                    D3D12_RESOURCE_STATE_GENERIC_READ,
-                    nullptr,
-                    IID_PPV_ARGS(pIntermediateResource)));
-
-                D3D12_SUBRESOURCE_DATA subresourceData = {};
-                subresourceData.pData = bufferData;
-                subresourceData.RowPitch = bufferSize;
-                subresourceData.SlicePitch = subresourceData.RowPitch;
-
-                UpdateSubresources(commandList,
-                    *pDestinationResource, *pIntermediateResource,
-                    0, 0, 1, &subresourceData);
+                CopyUploadRing->CopyBuffer(*pDestinationResource, 0, bufferData, bufferSize);
             }
         }
     }
@@ -398,6 +383,11 @@ namespace DXRDemo
             Device->CreateRenderTargetView(backBuffer.Get(), nullptr, rtvHandle);
 
             _backBuffers[i] = backBuffer;
+            if (_backBufferResources[i])
+            {
+                ResourceStates->Forget(*_backBufferResources[i]);
+            }
+            _backBufferResources[i] = RenderDevice->WrapResource(backBuffer, HeapType::Default, ResourceState::Present);
 
             rtvHandle.Offset(_rtvDescriptorSize);
         }
@@ -13,6 +13,10 @@
 
 #include "Window.h"
 #include "CommandQueue.h"
+#include "D3D12Backend.h"
+#include "PlacedResourceAllocator.h"
+#include "ResourceStateTracker.h"
+#include "UploadRingBuffer.h"
 
 namespace DXRDemo
 {
@@ -30,6 +34,16 @@ namespace DXRDemo
         Microsoft::WRL::ComPtr<ID3D12Device5> Device;
         std::unique_ptr<CommandQueue> DirectCommandQueue;
         std::unique_ptr<CommandQueue> CopyCommandQueue;
+        // The device and queues above behind the RenderBackend interfaces
+        std::unique_ptr<D3D12RenderDevice> RenderDevice;
+        // Staging memory of the uploads on the copy queue
+        std::unique_ptr<UploadRingBuffer> CopyUploadRing;
+        // Default heap buffers of the scene, geometry and acceleration structures
+        std::unique_ptr<PlacedResourceAllocator> BufferHeaps;
+        // States the submitted direct lists left the tracked resources in
+        std::unique_ptr<ResourceStateRegistry> ResourceStates;
+
+        static constexpr uint64_t CopyUploadRingSize = 32 * 1024 * 1024;
 
         void SetVSync(bool enabled);
         bool IsVSyncEnabled() const;
@@ -41,6 +55,9 @@ namespace DXRDemo
         UINT GetNumberBuffers() const;
         UINT GetCurrentBackBufferIndex() const;
         Microsoft::WRL::ComPtr<ID3D12Resource> GetCurrentBackBuffer() const;
+        // The current back buffer behind the RenderBackend interfaces, for the
+        // state trackers, presentable between frames
+        RenderResource& GetCurrentBackBufferResource() const;
         D3D12_CPU_DESCRIPTOR_HANDLE GetCurrentRenderTargetView() const;
         UINT Present();
         Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(
@@ -51,10 +68,10 @@ namespace DXRDemo
 
         bool IsRaytracingSupported();
 
+        // Creates a default heap buffer and records the copy of bufferData into it
+        // through CopyUploadRing, to be submitted by its Flush
         void UpdateBufferResource(
-            ID3D12GraphicsCommandList4* commandList,
             ID3D12Resource** pDestinationResource,
-            ID3D12Resource** pIntermediateResource,
             size_t numElements, size_t elementSize, const void* bufferData,
             D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
 
@@ -65,6 +82,7 @@ namespace DXRDemo
         Microsoft::WRL::ComPtr<IDXGISwapChain4> _swapChain;
         UINT _currentBackBufferIndex;
         std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> _backBuffers;
+        std::vector<std::shared_ptr<RenderResource>> _backBufferResources;
         Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _rtvDescriptorHeap;
         UINT _rtvDescriptorSize;
 
@@ -46,6 +46,7 @@ buffer needs to be kept until the command list execution is finished.
 */
 
 #include "TopLevelASGenerator.h"
+#include <algorithm>
 #include <stdexcept>
 
 // Helper to compute aligned buffer sizes
@@ -76,6 +77,62 @@ void TopLevelASGenerator::AddInstance(
 )
 {
   m_instances.emplace_back(Instance(bottomLevelAS, transform, instanceID, hitGroupIndex));
+  m_updates.Add();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Update the transform of an instance previously added with AddInstance. The
+// instance is flagged as dirty, so that the next call to Generate only rewrites
+// the descriptors of the instances which actually moved
+void TopLevelASGenerator::SetInstanceTransform(UINT instanceIndex,
+                                               const DirectX::XMMATRIX& transform)
+{
+  if (instanceIndex >= m_instances.size())
+  {
+    throw std::out_of_range("Invalid top-level AS instance index");
+  }
+
+  m_instances[instanceIndex].transform = transform;
+  m_updates.MarkDirty(instanceIndex);
+
+  // Every descriptor buffer holding the instance needs it rewritten when it is
+  // next passed to Generate
+  for (DescriptorBuffer& buffer : m_descriptorBuffers)
+  {
+    if (instanceIndex < buffer.writtenInstanceCount && !buffer.instanceStale[instanceIndex])
+    {
+      buffer.instanceStale[instanceIndex] = true;
+      buffer.staleInstances.push_back(instanceIndex);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Remove an instance previously added with AddInstance. The instances after it
+// move down an index, so their descriptors have to be rewritten in every buffer
+void TopLevelASGenerator::RemoveInstance(UINT instanceIndex)
+{
+  if (instanceIndex >= m_instances.size())
+  {
+    throw std::out_of_range("Invalid top-level AS instance index");
+  }
+
+  m_instances.erase(m_instances.begin() + instanceIndex);
+  m_updates.Remove(instanceIndex);
+
+  // The descriptors from the removed instance on are written again as if they
+  // had never been
+  for (DescriptorBuffer& buffer : m_descriptorBuffers)
+  {
+    buffer.writtenInstanceCount = (std::min)(buffer.writtenInstanceCount, instanceIndex);
+    buffer.staleInstances.erase(std::remove_if(buffer.staleInstances.begin(),
+                                               buffer.staleInstances.end(),
+                                               [instanceIndex](UINT i) { return i >= instanceIndex; }),
+                                buffer.staleInstances.end());
+    buffer.instanceStale.resize(buffer.writtenInstanceCount);
+  }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -135,6 +192,10 @@ void TopLevelASGenerator::ComputeASBufferSizes(
       ROUND_UP(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * static_cast<UINT64>(m_instances.size()),
                D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
 
+  // New sizes mean new buffers will be allocated by the application, so the
+  // next Generate calls have to map and fill the descriptor buffers from scratch
+  m_descriptorBuffers.clear();
+
   *scratchSizeInBytes = m_scratchSizeInBytes;
   *resultSizeInBytes = m_resultSizeInBytes;
   *descriptorsSizeInBytes = m_instanceDescsSizeInBytes;
@@ -160,45 +221,67 @@ void TopLevelASGenerator::Generate(
                                                  // is requested
 )
 {
-  // Copy the descriptors in the target descriptor buffer
-  D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs;
-  descriptorsBuffer->Map(0, nullptr, reinterpret_cast<void**>(&instanceDescs));
-  if (!instanceDescs)
+  // The descriptor buffers live in the upload heap, so they can stay mapped for
+  // their whole lifetime instead of being mapped again on every build
+  auto buffer = std::find_if(m_descriptorBuffers.begin(), m_descriptorBuffers.end(),
+                             [descriptorsBuffer](const DescriptorBuffer& mapped)
+                             { return mapped.resource == descriptorsBuffer; });
+  if (buffer == m_descriptorBuffers.end())
   {
-    throw std::logic_error("Cannot map the instance descriptor buffer - is it "
-                           "in the upload heap?");
+    D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs = nullptr;
+    descriptorsBuffer->Map(0, nullptr, reinterpret_cast<void**>(&instanceDescs));
+    if (!instanceDescs)
+    {
+      throw std::logic_error("Cannot map the instance descriptor buffer - is it "
+                             "in the upload heap?");
+    }
+
+    buffer = m_descriptorBuffers.insert(m_descriptorBuffers.end(), DescriptorBuffer());
+    buffer->resource = descriptorsBuffer;
+    buffer->instanceDescs = instanceDescs;
   }
 
   auto instanceCount = static_cast<UINT>(m_instances.size());
 
-  // Initialize the memory to zero on the first time only
-  if (!updateOnly)
+  // Instances added or removed since the buffers were sized change the layout
+  // of the hierarchy, which a refit cannot account for
+  if (updateOnly && m_updates.HasCountChanged())
+  {
+    throw std::logic_error("Cannot update a top-level AS whose instances were added or removed");
+  }
+  if (sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * static_cast<UINT64>(instanceCount) > m_instanceDescsSizeInBytes)
+  {
+    throw std::logic_error("Instances were added since the top-level AS buffer sizes were computed");
+  }
+
+  // Every descriptor is fully written below, so only the alignment padding at
+  // the end of the buffer needs clearing, and only the first time it is filled
+  if (buffer->writtenInstanceCount == 0)
   {
-    ZeroMemory(instanceDescs, m_instanceDescsSizeInBytes);
+    UINT64 usedSize = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * static_cast<UINT64>(instanceCount);
+    if (m_instanceDescsSizeInBytes > usedSize)
+    {
+      ZeroMemory(reinterpret_cast<uint8_t*>(buffer->instanceDescs) + usedSize,
+                 m_instanceDescsSizeInBytes - usedSize);
+    }
   }
 
-  // Create the description for each instance
-  for (uint32_t i = 0; i < instanceCount; i++)
+  // Instances which have never been written to this buffer get their descriptor
+  // regardless, after which only the instances that changed are rewritten
+  for (UINT i = buffer->writtenInstanceCount; i < instanceCount; i++)
+  {
+    WriteInstanceDesc(*buffer, i);
+  }
+  for (UINT i : buffer->staleInstances)
   {
-    // Instance ID visible in the shader in InstanceID()
-    instanceDescs[i].InstanceID = m_instances[i].instanceID;
-    // Index of the hit group invoked upon intersection
-    instanceDescs[i].InstanceContributionToHitGroupIndex = m_instances[i].hitGroupIndex;
-    // Instance flags, including backface culling, winding, etc - TODO: should
-    // be accessible from outside
-    instanceDescs[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-    // Instance transform matrix
-    DirectX::XMMATRIX m = XMMatrixTranspose(
-        m_instances[i].transform); // GLM is column major, the INSTANCE_DESC is row major
-    memcpy(instanceDescs[i].Transform, &m, sizeof(instanceDescs[i].Transform));
-    // Get access to the bottom level
-    instanceDescs[i].AccelerationStructure = m_instances[i].bottomLevelAS->GetGPUVirtualAddress();
-    // Visibility mask, always visible here - TODO: should be accessible from
-    // outside
-    instanceDescs[i].InstanceMask = 0xFF;
+    WriteInstanceDesc(*buffer, i);
+    buffer->instanceStale[i] = false;
   }
+  buffer->staleInstances.clear();
+  buffer->writtenInstanceCount = instanceCount;
+  buffer->instanceStale.resize(instanceCount, false);
 
-  descriptorsBuffer->Unmap(0, nullptr);
+  m_updates.MarkBuilt();
 
   // If this in an update operation we need to provide the source buffer
   D3D12_GPU_VIRTUAL_ADDRESS pSourceAS = updateOnly ? previousResult->GetGPUVirtualAddress() : 0;
@@ -249,6 +332,32 @@ void TopLevelASGenerator::Generate(
   commandList->ResourceBarrier(1, &uavBarrier);
 }
 
+//--------------------------------------------------------------------------------------------------
+//
+// Write the descriptor of a single instance in a mapped descriptor buffer
+void TopLevelASGenerator::WriteInstanceDesc(DescriptorBuffer& buffer, UINT instanceIndex)
+{
+  const Instance& instance = m_instances[instanceIndex];
+  D3D12_RAYTRACING_INSTANCE_DESC& instanceDesc = buffer.instanceDescs[instanceIndex];
+
+  // Instance ID visible in the shader in InstanceID()
+  instanceDesc.InstanceID = instance.instanceID;
+  // Index of the hit group invoked upon intersection
+  instanceDesc.InstanceContributionToHitGroupIndex = instance.hitGroupIndex;
+  // Instance flags, including backface culling, winding, etc - TODO: should
+  // be accessible from outside
+  instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+  // Instance transform matrix
+  DirectX::XMMATRIX m = XMMatrixTranspose(
+      instance.transform); // GLM is column major, the INSTANCE_DESC is row major
+  memcpy(instanceDesc.Transform, &m, sizeof(instanceDesc.Transform));
+  // Get access to the bottom level
+  instanceDesc.AccelerationStructure = instance.bottomLevelAS->GetGPUVirtualAddress();
+  // Visibility mask, always visible here - TODO: should be accessible from
+  // outside
+  instanceDesc.InstanceMask = 0xFF;
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 //
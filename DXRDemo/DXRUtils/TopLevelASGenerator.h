@@ -74,6 +74,8 @@ return buffers;
 
 #include <vector>
 
+#include "../InstanceUpdateTracker.h"
+
 namespace nv_helpers_dx12
 {
 
@@ -98,6 +100,30 @@ public:
                                  /// invocated upon hitting the geometry
   );
 
+  /// Update the transform of an instance previously added with AddInstance.
+  /// The instance is flagged as dirty, and only dirty instances have their
+  /// descriptor rewritten by the next call to Generate
+  void SetInstanceTransform(UINT instanceIndex, /// Index of the instance, in AddInstance order
+                            const DirectX::XMMATRIX& transform /// New transform of the instance
+  );
+
+  /// Remove an instance previously added with AddInstance. The instances after
+  /// it move down an index, and the next call to Generate has to rebuild the
+  /// structure from buffers sized by ComputeASBufferSizes
+  void RemoveInstance(UINT instanceIndex /// Index of the instance, in AddInstance order
+  );
+
+  /// Number of instances whose transform changed since the last Generate call
+  size_t GetDirtyInstanceCount() const { return m_updates.GetDirtyInstances().size(); }
+
+  /// Fraction of the instances whose transform changed since the last Generate
+  /// call, used to choose between refitting and rebuilding the hierarchy
+  float GetDirtyInstanceFraction() const { return m_updates.GetDirtyFraction(); }
+
+  /// Instances added, moved or removed since the last Generate call, and
+  /// whether they call for a refit or a rebuild
+  const DXRDemo::InstanceUpdateTracker& GetInstanceUpdates() const { return m_updates; }
+
   /// Compute the size of the scratch space required to build the acceleration
   /// structure, as well as the size of the resulting structure. The allocation
   /// of the buffers is then left to the application
@@ -118,7 +144,11 @@ public:
   /// using application-provided buffers and possibly a pointer to the previous
   /// acceleration structure in case of iterative updates. Note that the update
   /// can be done in place: the result and previousResult pointers can be the
-  /// same.
+  /// same. The descriptor buffer stays mapped between calls, and once it has been
+  /// filled only the descriptors of the instances that changed since it was last
+  /// written are rewritten, both for refits and for rebuilds. Several descriptor
+  /// buffers, such as one per frame in flight, can be passed in turn. They must
+  /// live until the next call to ComputeASBufferSizes.
   void Generate(
       ID3D12GraphicsCommandList4* commandList, /// Command list on which the build will be enqueued
       ID3D12Resource* scratchBuffer,     /// Scratch buffer used by the builder to
@@ -132,6 +162,23 @@ public:
   );
 
 private:
+  /// A descriptor buffer mapped by Generate
+  struct DescriptorBuffer
+  {
+    ID3D12Resource* resource = nullptr;
+    D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs = nullptr;
+    /// Number of descriptors already written. Any instance beyond that count is
+    /// written regardless of whether it changed
+    UINT writtenInstanceCount = 0;
+    /// Written instances whose transform changed since, and per-instance flags
+    /// avoiding duplicates
+    std::vector<UINT> staleInstances;
+    std::vector<bool> instanceStale;
+  };
+
+  /// Write the descriptor of an instance in a mapped descriptor buffer
+  void WriteInstanceDesc(DescriptorBuffer& buffer, UINT instanceIndex);
+
   /// Helper struct storing the instance data
   struct Instance
   {
@@ -139,7 +186,7 @@ private:
     /// Bottom-level AS
     ID3D12Resource* bottomLevelAS;
     /// Transform matrix
-    const DirectX::XMMATRIX& transform;
+    DirectX::XMMATRIX transform;
     /// Instance ID visible in the shader
     UINT instanceID;
     /// Hit group index used to fetch the shaders from the SBT
@@ -150,6 +197,11 @@ private:
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS m_flags;
   /// Instances contained in the top-level AS
   std::vector<Instance> m_instances;
+  /// Instances changed since the last Generate call
+  DXRDemo::InstanceUpdateTracker m_updates;
+
+  /// Descriptor buffers mapped since the last call to ComputeASBufferSizes
+  std::vector<DescriptorBuffer> m_descriptorBuffers;
 
   /// Size of the temporary memory used by the TLAS builder
   UINT64 m_scratchSizeInBytes;
@@ -0,0 +1,212 @@
+#include "DenoisePipeline.h"
+
+#include <algorithm>
+#include <cassert>
+#include <d3dx12.h>
+#include "DXRUtils/DXRHelper.h"
+#include "Utilities.h"
+
+namespace DXRDemo
+{
+    DenoisePipeline::DenoisePipeline(ID3D12Device* device, CommandQueue& commandQueue, DenoiserService& denoiser,
+        ThreadPool& threadPool, const D3D12_RESOURCE_DESC& imageDesc, uint32_t depth, uint32_t latency) :
+        _commandQueue(&commandQueue),
+        _denoiser(&denoiser),
+        _width(static_cast<std::size_t>(imageDesc.Width)),
+        _height(static_cast<std::size_t>(imageDesc.Height)),
+        _format(imageDesc.Format),
+        _latency(latency),
+        _slots(depth),
+        _accumulator(threadPool),
+        _worker(1)
+    {
+        if (depth <= latency)
+        {
+            throw std::invalid_argument("Denoise queue depth must be larger than its latency");
+        }
+
+        // Rows of buffer copies are padded to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+        uint64_t imageSize;
+        device->GetCopyableFootprints(&imageDesc, 0, 1, 0, &_imageFootprint, nullptr, nullptr, &imageSize);
+
+        uint64_t featureOffset = ROUND_UP(imageSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        _albedoFootprint = _imageFootprint;
+        _albedoFootprint.Offset = featureOffset;
+        _normalFootprint = _imageFootprint;
+        _normalFootprint.Offset = 2 * featureOffset;
+
+        // The instance and distance images share a layout, both 4 bytes per pixel
+        D3D12_RESOURCE_DESC surfaceDesc = imageDesc;
+        surfaceDesc.Format = TemporalAccumulator::InstanceFormat;
+        uint64_t surfaceSize;
+        device->GetCopyableFootprints(&surfaceDesc, 0, 1, 0, &_instanceFootprint, nullptr, nullptr, &surfaceSize);
+        _instanceFootprint.Offset = 3 * featureOffset;
+        _distanceFootprint = _instanceFootprint;
+        _distanceFootprint.Footprint.Format = TemporalAccumulator::DistanceFormat;
+        _distanceFootprint.Offset = _instanceFootprint.Offset + ROUND_UP(surfaceSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+        CD3DX12_HEAP_PROPERTIES readbackHeapProps(D3D12_HEAP_TYPE_READBACK);
+
+        // Both buffers stay mapped, the GPU and the worker take turns using them
+        for (Slot& slot : _slots)
+        {
+            slot.ReadbackBuffer = nv_helpers_dx12::CreateBuffer(device,
+                _distanceFootprint.Offset + surfaceSize,
+                D3D12_RESOURCE_FLAG_NONE,
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                readbackHeapProps);
+            ThrowIfFailed(slot.ReadbackBuffer->Map(0, nullptr, reinterpret_cast<void**>(&slot.ReadbackData)));
+
+            slot.UploadBuffer = nv_helpers_dx12::CreateBuffer(device,
+                imageSize,
+                D3D12_RESOURCE_FLAG_NONE,
+                D3D12_RESOURCE_STATE_GENERIC_READ,
+                nv_helpers_dx12::kUploadHeapProps);
+            CD3DX12_RANGE readRange(0, 0);
+            ThrowIfFailed(slot.UploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&slot.UploadData)));
+        }
+
+        _fenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+        assert(_fenceEvent && "Failed to create fence event.");
+    }
+
+    DenoisePipeline::~DenoisePipeline()
+    {
+        Flush();
+
+        for (Slot& slot : _slots)
+        {
+            slot.UploadBuffer->Unmap(0, nullptr);
+            CD3DX12_RANGE writtenRange(0, 0);
+            slot.ReadbackBuffer->Unmap(0, &writtenRange);
+        }
+
+        ::CloseHandle(_fenceEvent);
+    }
+
+    void DenoisePipeline::RecordReadback(ID3D12GraphicsCommandList* commandList,
+        ID3D12Resource* image, ID3D12Resource* albedo, ID3D12Resource* normal,
+        ID3D12Resource* instance, ID3D12Resource* distance)
+    {
+        Slot& slot = _GetSubmitSlot();
+
+        // The worker may still read the slot if its result was never copied back
+        if (slot.Job.valid())
+        {
+            slot.Job.get();
+        }
+
+        CD3DX12_TEXTURE_COPY_LOCATION imageLocation(image, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION imageReadbackLocation(slot.ReadbackBuffer.Get(), _imageFootprint);
+        commandList->CopyTextureRegion(&imageReadbackLocation, 0, 0, 0, &imageLocation, nullptr);
+
+        CD3DX12_TEXTURE_COPY_LOCATION albedoLocation(albedo, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION albedoReadbackLocation(slot.ReadbackBuffer.Get(), _albedoFootprint);
+        commandList->CopyTextureRegion(&albedoReadbackLocation, 0, 0, 0, &albedoLocation, nullptr);
+
+        CD3DX12_TEXTURE_COPY_LOCATION normalLocation(normal, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION normalReadbackLocation(slot.ReadbackBuffer.Get(), _normalFootprint);
+        commandList->CopyTextureRegion(&normalReadbackLocation, 0, 0, 0, &normalLocation, nullptr);
+
+        CD3DX12_TEXTURE_COPY_LOCATION instanceLocation(instance, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION instanceReadbackLocation(slot.ReadbackBuffer.Get(), _instanceFootprint);
+        commandList->CopyTextureRegion(&instanceReadbackLocation, 0, 0, 0, &instanceLocation, nullptr);
+
+        CD3DX12_TEXTURE_COPY_LOCATION distanceLocation(distance, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION distanceReadbackLocation(slot.ReadbackBuffer.Get(), _distanceFootprint);
+        commandList->CopyTextureRegion(&distanceReadbackLocation, 0, 0, 0, &distanceLocation, nullptr);
+    }
+
+    void DenoisePipeline::Submit(uint64_t fenceValue, DenoiserBackend backend, DenoiseQuality quality,
+        std::optional<TemporalAccumulator::Frame> temporalFrame)
+    {
+        Slot& slot = _GetSubmitSlot();
+        ++_submittedFrames;
+
+        // The upload buffer must also be done with the copy of its previous result
+        uint64_t waitFenceValue = std::max(fenceValue, slot.UploadFenceValue);
+        slot.Job = _worker.Submit([this, &slot, waitFenceValue, backend, quality, temporalFrame = std::move(temporalFrame)]()
+        {
+            _commandQueue->WaitForFenceValue(waitFenceValue, _fenceEvent);
+
+            uint32_t rowPitch = _imageFootprint.Footprint.RowPitch;
+            if (temporalFrame)
+            {
+                // The readback buffer is written in place, it is only read again
+                // by the denoiser below
+                _accumulator.Accumulate(_width, _height, _format,
+                    slot.ReadbackData + _imageFootprint.Offset,
+                    slot.ReadbackData + _normalFootprint.Offset,
+                    rowPitch,
+                    slot.ReadbackData + _instanceFootprint.Offset,
+                    slot.ReadbackData + _distanceFootprint.Offset,
+                    _instanceFootprint.Footprint.RowPitch,
+                    *temporalFrame);
+                slot.ReprojectedFraction = _accumulator.GetReprojectedFraction();
+            }
+            else
+            {
+                _accumulator.Reset();
+                slot.ReprojectedFraction = 0;
+            }
+
+            slot.Timing = _denoiser->Denoise(_width, _height, _format, backend, quality,
+                slot.ReadbackData + _imageFootprint.Offset,
+                slot.ReadbackData + _albedoFootprint.Offset,
+                slot.ReadbackData + _normalFootprint.Offset,
+                rowPitch,
+                slot.UploadData + _imageFootprint.Offset,
+                rowPitch);
+        });
+    }
+
+    bool DenoisePipeline::HasResult(uint32_t pendingFrames) const
+    {
+        return _submittedFrames + pendingFrames > _latency;
+    }
+
+    void DenoisePipeline::RecordResult(ID3D12GraphicsCommandList* commandList, ID3D12Resource* image)
+    {
+        assert(HasResult() && "No denoised frame is due yet.");
+
+        Slot& slot = _slots[(_submittedFrames - 1 - _latency) % _slots.size()];
+        // Rethrows whatever the denoiser threw
+        slot.Job.get();
+        _lastTiming = slot.Timing;
+        _lastReprojectedFraction = slot.ReprojectedFraction;
+
+        CD3DX12_TEXTURE_COPY_LOCATION imageLocation(image, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION uploadLocation(slot.UploadBuffer.Get(), _imageFootprint);
+        commandList->CopyTextureRegion(&imageLocation, 0, 0, 0, &uploadLocation, nullptr);
+
+        _resultSlot = &slot;
+    }
+
+    void DenoisePipeline::EndFrame(uint64_t fenceValue)
+    {
+        if (_resultSlot != nullptr)
+        {
+            _resultSlot->UploadFenceValue = fenceValue;
+            _resultSlot = nullptr;
+        }
+    }
+
+    void DenoisePipeline::Flush()
+    {
+        for (Slot& slot : _slots)
+        {
+            if (slot.Job.valid())
+            {
+                slot.Job.wait();
+                slot.Job = {};
+            }
+        }
+        _submittedFrames = 0;
+        _accumulator.Reset();
+    }
+
+    DenoisePipeline::Slot& DenoisePipeline::_GetSubmitSlot()
+    {
+        return _slots[_submittedFrames % _slots.size()];
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <cstdint>
+#include <future>
+#include <optional>
+#include <vector>
+#include "CommandQueue.h"
+#include "DenoiserService.h"
+#include "TemporalAccumulator.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    // Denoises ray traced frames on a worker thread while the next ones are traced.
+    //
+    // Every frame copies its radiance and features into one of a ring of readback
+    // slots and hands the slot to the worker once the GPU is done with the copy. The
+    // result of the frame submitted `latency` frames earlier is then copied back from
+    // that slot's upload buffer. With a latency of 1 or more, tracing a frame overlaps
+    // denoising the previous one, so a frame costs the slower of the two instead of
+    // their sum.
+    //
+    // Before denoising, the worker can accumulate the radiance with the history of
+    // the previous frames, reprojected with the camera and instance motion.
+    class DenoisePipeline final
+    {
+    public:
+        // imageDesc describes the radiance texture, which the features share. The
+        // instance and distance images have its size in the formats of
+        // TemporalAccumulator. depth is the number of slots and must be larger than
+        // latency.
+        DenoisePipeline(ID3D12Device* device, CommandQueue& commandQueue, DenoiserService& denoiser,
+            ThreadPool& threadPool, const D3D12_RESOURCE_DESC& imageDesc, uint32_t depth, uint32_t latency);
+        DenoisePipeline(const DenoisePipeline&) = delete;
+        DenoisePipeline& operator=(const DenoisePipeline&) = delete;
+        ~DenoisePipeline();
+
+        // Records the copy of this frame's images into the next slot. They must be
+        // in the D3D12_RESOURCE_STATE_COPY_SOURCE state.
+        void RecordReadback(ID3D12GraphicsCommandList* commandList,
+            ID3D12Resource* image, ID3D12Resource* albedo, ID3D12Resource* normal,
+            ID3D12Resource* instance, ID3D12Resource* distance);
+
+        // Hands the slot of the last RecordReadback to the worker, which starts once
+        // the command queue reaches fenceValue. The radiance is accumulated over
+        // frames first when a temporal frame is given, otherwise the history is dropped.
+        void Submit(uint64_t fenceValue, DenoiserBackend backend, DenoiseQuality quality,
+            std::optional<TemporalAccumulator::Frame> temporalFrame = std::nullopt);
+
+        // Whether a denoised frame is due, that is whether more than latency frames
+        // were submitted since the pipeline was started or flushed, counting
+        // pendingFrames about to be
+        bool HasResult(uint32_t pendingFrames = 0) const;
+
+        // Waits for the due frame to be denoised and records its copy into image,
+        // which must be in the D3D12_RESOURCE_STATE_COPY_DEST state
+        void RecordResult(ID3D12GraphicsCommandList* commandList, ID3D12Resource* image);
+
+        // Marks the upload buffer copied by RecordResult as in use until the command
+        // queue reaches fenceValue
+        void EndFrame(uint64_t fenceValue);
+
+        // Waits for all submitted frames and drops their results, along with the
+        // temporal history
+        void Flush();
+
+        inline uint32_t GetDepth() const
+        {
+            return static_cast<uint32_t>(_slots.size());
+        }
+
+        inline uint32_t GetLatency() const
+        {
+            return _latency;
+        }
+
+        // Time the denoiser took for the frame of the last RecordResult
+        inline const DenoiserService::Timing& GetLastTiming() const
+        {
+            return _lastTiming;
+        }
+
+        // Fraction of the pixels of the frame of the last RecordResult that reused
+        // temporal history
+        inline float GetLastReprojectedFraction() const
+        {
+            return _lastReprojectedFraction;
+        }
+
+    private:
+        struct Slot
+        {
+            Microsoft::WRL::ComPtr<ID3D12Resource> ReadbackBuffer;
+            Microsoft::WRL::ComPtr<ID3D12Resource> UploadBuffer;
+            uint8_t* ReadbackData = nullptr;
+            uint8_t* UploadData = nullptr;
+            // Fence of the frame that last copied from the upload buffer
+            uint64_t UploadFenceValue = 0;
+            std::future<void> Job;
+            DenoiserService::Timing Timing;
+            float ReprojectedFraction = 0;
+        };
+
+        CommandQueue* _commandQueue;
+        DenoiserService* _denoiser;
+        std::size_t _width;
+        std::size_t _height;
+        DXGI_FORMAT _format;
+        uint32_t _latency;
+        std::vector<Slot> _slots;
+        // Layout of the images in the slot buffers. The readback buffers hold the
+        // radiance followed by the albedo, normal, instance and distance, the upload
+        // buffers only the denoised radiance.
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT _imageFootprint;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT _albedoFootprint;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT _normalFootprint;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT _instanceFootprint;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT _distanceFootprint;
+        // Frames submitted since the last flush
+        uint64_t _submittedFrames = 0;
+        Slot* _resultSlot = nullptr;
+        DenoiserService::Timing _lastTiming;
+        float _lastReprojectedFraction = 0;
+        // Only used by the worker, or while it is idle
+        TemporalAccumulator _accumulator;
+        // Event the worker waits for the GPU with
+        HANDLE _fenceEvent;
+        // Single worker, so frames are denoised one at a time and in order
+        ThreadPool _worker;
+
+        Slot& _GetSubmitSlot();
+    };
+}
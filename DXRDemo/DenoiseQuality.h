@@ -0,0 +1,30 @@
+#pragma once
+
+#include <OpenImageDenoise/oidn.hpp>
+
+namespace DXRDemo
+{
+    // Trade-off between denoising speed and quality
+    enum class DenoiseQuality
+    {
+        // Interactive previews
+        Fast,
+        Balanced,
+        // Final frames
+        High
+    };
+
+    inline oidn::Quality ToOidnQuality(DenoiseQuality quality)
+    {
+        switch (quality)
+        {
+            // OIDN 2.0 has no fast mode yet, balanced is its fastest
+            case DenoiseQuality::Fast:
+            case DenoiseQuality::Balanced:
+                return oidn::Quality::Balanced;
+            case DenoiseQuality::High:
+            default:
+                return oidn::Quality::High;
+        }
+    }
+}
@@ -1,25 +1,58 @@
 #pragma once
 
 #include <OpenImageDenoise/oidn.hpp>
+#include <cstring>
 #include <d3d12.h>
+#include <memory>
 #include "Utilities.h"
+#include "PixelConversion.h"
+#include "ThreadPool.h"
+#include "DenoiseQuality.h"
+#include "ImageDenoiser.h"
+#include "TiledDenoiser.h"
 
 namespace DXRDemo
 {
-    class Denoiser
+    // Open Image Denoise filter
+    class Denoiser final : public ImageDenoiser
     {
     public:
-        Denoiser(std::size_t width, std::size_t height) :
+        // Images are linear HDR radiance, either DXGI_FORMAT_R16G16B16A16_FLOAT or
+        // DXGI_FORMAT_R32G32B32A32_FLOAT. The albedo and normal feature images given
+        // with them share the format. Images larger than the tile size of tiling are
+        // denoised in tiles. Whole images are denoised on device, or on a device of
+        // their own if it is null.
+        Denoiser(std::size_t width, std::size_t height, DXGI_FORMAT format, ThreadPool& threadPool,
+            const DenoiseTiling& tiling = {}, DenoiseQuality quality = DenoiseQuality::High, oidn::DeviceRef device = {}) :
             _width(width),
-            _height(height)
+            _height(height),
+            _format(format),
+            _threadPool(&threadPool)
         {
+            if (_format != DXGI_FORMAT_R16G16B16A16_FLOAT && _format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+            {
+                throw std::invalid_argument("Unsupported denoiser image format");
+            }
+
+            if (tiling.TileSize != 0 && (_width > tiling.TileSize || _height > tiling.TileSize))
+            {
+                _tiledDenoiser = std::make_unique<TiledDenoiser>(_width, _height, _format, tiling, quality, threadPool);
+                return;
+            }
 
             //_inputImageHandler = nullptr;
             //ThrowIfFailed(device->CreateSharedHandle(resource, NULL, GENERIC_ALL, NULL, &_inputImageHandler));
 
             // Create an Open Image Denoise device
-            _device = oidn::newDevice(oidn::DeviceType::Default); // CPU or GPU if available
-            _device.commit();
+            if (device)
+            {
+                _device = device;
+            }
+            else
+            {
+                _device = oidn::newDevice(oidn::DeviceType::Default); // CPU or GPU if available
+                _device.commit();
+            }
 
             const char* errorMessage;
             if (_device.getError(errorMessage) != oidn::Error::None)
@@ -28,20 +61,26 @@ namespace DXRDemo
                 throw std::runtime_error(errorMessage);
             }
 
-            colorBuf = _device.newBuffer(_width * _height * 3 * sizeof(float));
+            // Half images are widened to packed RGB floats. Float images are used as
+            // they are, skipping over alpha.
+            std::size_t pixelStride = _format == DXGI_FORMAT_R32G32B32A32_FLOAT ? 4 * sizeof(float) : 3 * sizeof(float);
+            colorBuf = _device.newBuffer(_width * _height * pixelStride);
+            albedoBuf = _device.newBuffer(_width * _height * pixelStride);
+            normalBuf = _device.newBuffer(_width * _height * pixelStride);
 
             // Create a filter for denoising a beauty (color) image using optional auxiliary images too
             // This can be an expensive operation, so try no to create a new filter for every image!
             _filter = _device.newFilter("RT"); // generic ray tracing filter
-            _filter.setImage("color", colorBuf, oidn::Format::Float3, _width, _height); // beauty
-            //filter.setImage("albedo", albedoBuf, oidn::Format::Float3, width, height); // auxiliary
-            //filter.setImage("normal", normalBuf, oidn::Format::Float3, width, height); // auxiliary
-            _filter.setImage("output", colorBuf, oidn::Format::Float3, _width, _height); // denoised beauty
+            _filter.setImage("color", colorBuf, oidn::Format::Float3, _width, _height, 0, pixelStride, _width * pixelStride); // beauty
+            _filter.setImage("albedo", albedoBuf, oidn::Format::Float3, _width, _height, 0, pixelStride, _width * pixelStride); // auxiliary
+            _filter.setImage("normal", normalBuf, oidn::Format::Float3, _width, _height, 0, pixelStride, _width * pixelStride); // auxiliary
+            _filter.setImage("output", colorBuf, oidn::Format::Float3, _width, _height, 0, pixelStride, _width * pixelStride); // denoised beauty
             _filter.set("hdr", true); // beauty image is HDR
+            // The features come from the first hit of rays through pixel centers and
+            // carry no noise, so the filter does not need to denoise them first
+            _filter.set("cleanAux", true);
+            _filter.set("quality", ToOidnQuality(quality));
             _filter.commit();
-
-            // Fill the input image buffers
-            //float* colorPtr = (float*)colorBuf.getData();
         }
 
         ~Denoiser()
@@ -52,32 +91,21 @@ namespace DXRDemo
             //}
         }
 
-        void Denoise(void* image, void* output)
+        void Denoise(const void* image, const void* albedo, const void* normal, std::size_t inputRowPitch,
+            void* output, std::size_t outputRowPitch) override
         {
-            std::byte* rgba8Image = reinterpret_cast<std::byte*>(image);
-            std::byte* rgba8Output = reinterpret_cast<std::byte*>(output);
-            float* colorPtr = reinterpret_cast<float*>(colorBuf.getData());
-
-            for (int x = 0; x < _width; ++x)
+            if (_tiledDenoiser)
             {
-                for (int y = 0; y < _height; ++y)
-                {
-                    *colorPtr = static_cast<float>(*(rgba8Image));
-                    ++colorPtr;
-                    ++rgba8Image;
-
-                    *colorPtr = static_cast<float>(*(rgba8Image));
-                    ++colorPtr;
-                    ++rgba8Image;
-
-                    *colorPtr = static_cast<float>(*(rgba8Image));
-                    ++colorPtr;
-                    ++rgba8Image;
-
-                    ++rgba8Image;
-                }
+                _tiledDenoiser->Denoise(image, albedo, normal, inputRowPitch, output, outputRowPitch);
+                return;
             }
 
+            uint8_t* colorPtr = reinterpret_cast<uint8_t*>(colorBuf.getData());
+
+            _ToFilterImage(image, inputRowPitch, colorPtr);
+            _ToFilterImage(albedo, inputRowPitch, reinterpret_cast<uint8_t*>(albedoBuf.getData()));
+            _ToFilterImage(normal, inputRowPitch, reinterpret_cast<uint8_t*>(normalBuf.getData()));
+
             _filter.execute();
 
             const char* errorMessage;
@@ -87,36 +115,58 @@ namespace DXRDemo
                 throw std::runtime_error(errorMessage);
             }
 
-            colorPtr = reinterpret_cast<float*>(colorBuf.getData());
-            for (int x = 0; x < _width; ++x)
+            if (_format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+            {
+                PixelConversion::Rgb32fToRgba16f(colorPtr, _width * 3 * sizeof(float), output, outputRowPitch,
+                    _width, _height, *_threadPool);
+            }
+            else
             {
-                for (int y = 0; y < _height; ++y)
-                {
-                    *rgba8Output = static_cast<std::byte>(std::min(*(colorPtr), 255.0f));
-                    ++colorPtr;
-                    ++rgba8Output;
-
-                    *rgba8Output = static_cast<std::byte>(std::min(*(colorPtr), 255.0f));
-                    ++colorPtr;
-                    ++rgba8Output;
-
-                    *rgba8Output = static_cast<std::byte>(std::min(*(colorPtr), 255.0f));
-                    ++colorPtr;
-                    ++rgba8Output;
-
-                    *rgba8Output = static_cast<std::byte>(255);
-                    ++rgba8Output;
-                }
+                _CopyRows(colorPtr, _width * 4 * sizeof(float), output, outputRowPitch);
             }
         }
 
+        // Tiles denoised at once, 1 when whole images are denoised
+        std::size_t GetConcurrentTiles() const
+        {
+            return _tiledDenoiser ? _tiledDenoiser->GetConcurrentTiles() : 1;
+        }
+
     private:
         std::size_t _width;
         std::size_t _height;
+        DXGI_FORMAT _format;
+        ThreadPool* _threadPool;
         oidn::BufferRef colorBuf;
-        //oidn::BufferRef outputBuf;
+        oidn::BufferRef albedoBuf;
+        oidn::BufferRef normalBuf;
         oidn::DeviceRef _device;
         oidn::FilterRef _filter;
+        std::unique_ptr<TiledDenoiser> _tiledDenoiser;
         //HANDLE _inputImageHandler;
+
+        void _ToFilterImage(const void* image, std::size_t imageRowPitch, uint8_t* filterImage)
+        {
+            if (_format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+            {
+                PixelConversion::Rgba16fToRgb32f(image, imageRowPitch, filterImage, _width * 3 * sizeof(float),
+                    _width, _height, *_threadPool);
+            }
+            else
+            {
+                _CopyRows(image, imageRowPitch, filterImage, _width * 4 * sizeof(float));
+            }
+        }
+
+        void _CopyRows(const void* source, std::size_t sourceRowPitch, void* destination, std::size_t destinationRowPitch)
+        {
+            std::size_t rowSize = _width * 4 * sizeof(float);
+            for (std::size_t y = 0; y < _height; ++y)
+            {
+                memcpy(reinterpret_cast<uint8_t*>(destination) + y * destinationRowPitch,
+                    reinterpret_cast<const uint8_t*>(source) + y * sourceRowPitch,
+                    rowSize);
+            }
+        }
     };
 }
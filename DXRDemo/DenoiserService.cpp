@@ -0,0 +1,87 @@
+#include "DenoiserService.h"
+
+#include <chrono>
+#include <stdexcept>
+#include "Utilities.h"
+#include "WaveletDenoiser.h"
+
+namespace DXRDemo
+{
+    DenoiserService::DenoiserService(ThreadPool& threadPool, const DenoiseTiling& tiling, std::size_t maxCachedFilters) :
+        _threadPool(&threadPool),
+        _tiling(tiling),
+        _maxCachedFilters(maxCachedFilters)
+    {
+        if (_maxCachedFilters == 0)
+        {
+            throw std::invalid_argument("The denoiser service must cache at least one filter");
+        }
+
+        _device = oidn::newDevice(oidn::DeviceType::Default); // CPU or GPU if available
+        _device.commit();
+
+        // Everything is denoised with the wavelet filter then
+        const char* errorMessage;
+        if (_device.getError(errorMessage) != oidn::Error::None)
+        {
+            OutputDebugStringA(errorMessage);
+            _device = {};
+        }
+    }
+
+    DenoiserService::Timing DenoiserService::Denoise(std::size_t width, std::size_t height, DXGI_FORMAT format,
+        DenoiserBackend backend, DenoiseQuality quality, const void* image, const void* albedo, const void* normal, std::size_t inputRowPitch,
+        void* output, std::size_t outputRowPitch)
+    {
+        Timing timing;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        ImageDenoiser& denoiser = _GetDenoiser(width, height, format, backend, quality);
+        auto setupEnd = std::chrono::high_resolution_clock::now();
+
+        denoiser.Denoise(image, albedo, normal, inputRowPitch, output, outputRowPitch);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        timing.SetupMilliseconds = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+        timing.DenoiseMilliseconds = std::chrono::duration<double, std::milli>(end - setupEnd).count();
+        return timing;
+    }
+
+    ImageDenoiser& DenoiserService::_GetDenoiser(std::size_t width, std::size_t height, DXGI_FORMAT format,
+        DenoiserBackend backend, DenoiseQuality quality)
+    {
+        if (!_device)
+        {
+            backend = DenoiserBackend::Wavelet;
+        }
+
+        for (auto it = _filters.begin(); it != _filters.end(); ++it)
+        {
+            if (it->Width == width && it->Height == height && it->Format == format &&
+                it->Backend == backend && it->Quality == quality)
+            {
+                _filters.splice(_filters.begin(), _filters, it);
+                return *_filters.front().Instance;
+            }
+        }
+
+        // Release the least recently used filter before allocating the new one
+        if (_filters.size() == _maxCachedFilters)
+        {
+            _filters.pop_back();
+        }
+
+        std::unique_ptr<ImageDenoiser> denoiser;
+        if (backend == DenoiserBackend::Wavelet)
+        {
+            denoiser = std::make_unique<WaveletDenoiser>(width, height, format, *_threadPool, quality);
+        }
+        else
+        {
+            denoiser = std::make_unique<Denoiser>(width, height, format, *_threadPool, _tiling, quality, _device);
+        }
+
+        _filters.push_front({ width, height, format, backend, quality, std::move(denoiser) });
+        return *_filters.front().Instance;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <OpenImageDenoise/oidn.hpp>
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include "DenoiseQuality.h"
+#include "Denoiser.h"
+#include "ImageDenoiser.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    // Denoises images of any size and quality, keeping the filters it creates so
+    // switching back and forth between resolutions or qualities, such as previews
+    // at DenoiseQuality::Fast and final frames at DenoiseQuality::High, only pays
+    // for filter creation and buffer allocation once per combination.
+    //
+    // Filters are created on first use and the Open Image Denoise ones share one
+    // device. The least recently used one is released when more than the given
+    // number are cached. When no Open Image Denoise device can be created, the
+    // wavelet filter is used instead. Calls must come from one thread at a time.
+    class DenoiserService final
+    {
+    public:
+        // Time spent in a Denoise call, in milliseconds
+        struct Timing
+        {
+            // Creating the filter and allocating its buffers, 0 when it was cached
+            double SetupMilliseconds = 0;
+            double DenoiseMilliseconds = 0;
+        };
+
+        explicit DenoiserService(ThreadPool& threadPool, const DenoiseTiling& tiling = {}, std::size_t maxCachedFilters = 4);
+        DenoiserService(const DenoiserService&) = delete;
+        DenoiserService& operator=(const DenoiserService&) = delete;
+
+        // Same contract as Denoiser::Denoise, with the image description given per call
+        Timing Denoise(std::size_t width, std::size_t height, DXGI_FORMAT format, DenoiserBackend backend, DenoiseQuality quality,
+            const void* image, const void* albedo, const void* normal, std::size_t inputRowPitch,
+            void* output, std::size_t outputRowPitch);
+
+        inline std::size_t GetCachedFilterCount() const
+        {
+            return _filters.size();
+        }
+
+        inline bool IsOpenImageDenoiseAvailable() const
+        {
+            return static_cast<bool>(_device);
+        }
+
+    private:
+        struct CachedFilter
+        {
+            std::size_t Width;
+            std::size_t Height;
+            DXGI_FORMAT Format;
+            DenoiserBackend Backend;
+            DenoiseQuality Quality;
+            std::unique_ptr<ImageDenoiser> Instance;
+        };
+
+        ThreadPool* _threadPool;
+        DenoiseTiling _tiling;
+        std::size_t _maxCachedFilters;
+        oidn::DeviceRef _device;
+        // Most recently used first
+        std::list<CachedFilter> _filters;
+
+        ImageDenoiser& _GetDenoiser(std::size_t width, std::size_t height, DXGI_FORMAT format,
+            DenoiserBackend backend, DenoiseQuality quality);
+    };
+}
@@ -0,0 +1,88 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    DescriptorAllocator::DescriptorAllocator(uint32_t persistentCount, uint32_t transientCountPerFrame, uint32_t frameCount) :
+        _persistentCount(persistentCount),
+        _transientCountPerFrame(transientCountPerFrame),
+        _persistent(persistentCount)
+    {
+        if (frameCount == 0)
+        {
+            throw std::invalid_argument("A descriptor allocator needs at least one frame");
+        }
+
+        // The frame regions follow the persistent descriptors
+        _frames.reserve(frameCount);
+        for (uint32_t i = 0; i < frameCount; ++i)
+        {
+            _frames.emplace_back(persistentCount + uint64_t(transientCountPerFrame) * i, transientCountPerFrame);
+        }
+    }
+
+    uint32_t DescriptorAllocator::Allocate(uint32_t count)
+    {
+        uint64_t index = _persistent.Allocate(count, 1);
+        if (index == TlsfAllocator::InvalidOffset)
+        {
+            throw std::runtime_error("Out of persistent descriptors");
+        }
+        return static_cast<uint32_t>(index);
+    }
+
+    void DescriptorAllocator::Free(uint32_t index, uint64_t fenceValue)
+    {
+        if (!IsPersistent(index))
+        {
+            throw std::invalid_argument("Only persistent descriptors are freed one by one");
+        }
+        if (fenceValue < _lastFreeFenceValue)
+        {
+            throw std::invalid_argument("Descriptors freed with a fence value lower than the last");
+        }
+        _pendingFrees.push_back({ fenceValue, index });
+        _lastFreeFenceValue = fenceValue;
+    }
+
+    void DescriptorAllocator::Reclaim(uint64_t completedFenceValue)
+    {
+        while (!_pendingFrees.empty() && _pendingFrees.front().FenceValue <= completedFenceValue)
+        {
+            _persistent.Free(_pendingFrees.front().Index);
+            _pendingFrees.pop_front();
+        }
+    }
+
+    void DescriptorAllocator::BeginFrame(uint32_t frameIndex)
+    {
+        _frameIndex = frameIndex % static_cast<uint32_t>(_frames.size());
+        _frames[_frameIndex].Reset();
+    }
+
+    uint32_t DescriptorAllocator::AllocateTransient(uint32_t count)
+    {
+        uint64_t index = _frames[_frameIndex].Allocate(count, 1);
+        if (index == LinearAllocator::InvalidOffset)
+        {
+            throw std::runtime_error("Descriptor frame region is full");
+        }
+
+        _peakTransientUsed = std::max(_peakTransientUsed, static_cast<uint32_t>(_frames[_frameIndex].GetUsedSize()));
+        return static_cast<uint32_t>(index);
+    }
+
+    DescriptorAllocatorStatistics DescriptorAllocator::GetStatistics() const
+    {
+        TlsfStatistics persistent = _persistent.GetStatistics();
+        DescriptorAllocatorStatistics statistics;
+        statistics.PersistentUsed = static_cast<uint32_t>(persistent.UsedSize);
+        statistics.PendingFrees = static_cast<uint32_t>(_pendingFrees.size());
+        statistics.LargestFreeRange = static_cast<uint32_t>(persistent.LargestFreeBlock);
+        statistics.TransientUsed = static_cast<uint32_t>(_frames[_frameIndex].GetUsedSize());
+        statistics.PeakTransientUsed = _peakTransientUsed;
+        return statistics;
+    }
+}
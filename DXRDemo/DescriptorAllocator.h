@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <vector>
+#include "LinearAllocator.h"
+#include "TlsfAllocator.h"
+
+namespace DXRDemo
+{
+    struct DescriptorAllocatorStatistics
+    {
+        // Persistent descriptors allocated, and freed ones waiting for the GPU
+        uint32_t PersistentUsed = 0;
+        uint32_t PendingFrees = 0;
+        uint32_t LargestFreeRange = 0;
+        // Transient descriptors of the current frame, and the most any frame took
+        uint32_t TransientUsed = 0;
+        uint32_t PeakTransientUsed = 0;
+    };
+
+    // Hands out the descriptors of the one shader visible CBV/SRV/UAV heap the
+    // frames bind, by index. The first persistentCount descriptors are for views
+    // living across frames, allocated and freed in any order through a
+    // TlsfAllocator. A freed range is only handed out again once the fence value
+    // of the last submission that could use it completed, Reclaim passing the
+    // completed value on. The rest of the heap is split in one region per frame
+    // in flight for views a single frame needs, allocated by bumping an index
+    // and dropped whole by BeginFrame, as LinearUploadBuffer does with constants.
+    //
+    // Indices never move, so shaders can reach any descriptor by its index from
+    // a descriptor table starting at the beginning of the heap, without a heap
+    // or root signature per set of views. Only does the bookkeeping, the heap
+    // belongs to the caller.
+    class DescriptorAllocator final
+    {
+    public:
+        static constexpr uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+
+        DescriptorAllocator(uint32_t persistentCount, uint32_t transientCountPerFrame, uint32_t frameCount);
+
+        // Index of the first of count consecutive descriptors. Throws
+        // std::runtime_error when no free range is large enough.
+        uint32_t Allocate(uint32_t count = 1);
+
+        // Frees the range Allocate returned index for once fenceValue completes.
+        // Fence values must not decrease from one call to the next.
+        void Free(uint32_t index, uint64_t fenceValue);
+
+        void Reclaim(uint64_t completedFenceValue);
+
+        // Starts allocating from the region of a frame, dropping what it held
+        // before. The GPU must be done with the frame that used it last.
+        void BeginFrame(uint32_t frameIndex);
+
+        // Same as Allocate, for the current frame. Throws std::runtime_error when
+        // the region is full.
+        uint32_t AllocateTransient(uint32_t count = 1);
+
+        // Descriptors the heap must hold
+        inline uint32_t GetCount() const
+        {
+            return _persistentCount + _transientCountPerFrame * static_cast<uint32_t>(_frames.size());
+        }
+
+        inline bool IsPersistent(uint32_t index) const
+        {
+            return index < _persistentCount;
+        }
+
+        DescriptorAllocatorStatistics GetStatistics() const;
+
+    private:
+        struct PendingFree
+        {
+            uint64_t FenceValue;
+            uint32_t Index;
+        };
+
+        uint32_t _persistentCount;
+        uint32_t _transientCountPerFrame;
+        TlsfAllocator _persistent;
+        // Waiting for their fence values, which only grow
+        std::deque<PendingFree> _pendingFrees;
+        uint64_t _lastFreeFenceValue = 0;
+        std::vector<LinearAllocator> _frames;
+        uint32_t _frameIndex = 0;
+        uint32_t _peakTransientUsed = 0;
+    };
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace DXRDemo
+{
+    struct FencedPoolStatistics
+    {
+        uint64_t Creations = 0;
+        uint64_t Reuses = 0;
+        // Objects released after staying unused for too long
+        uint64_t Trims = 0;
+        // Releases that found every slot held by work still in flight
+        uint64_t Waits = 0;
+        // Objects held, and the most held at once
+        uint32_t Size = 0;
+        uint32_t PeakSize = 0;
+    };
+
+    // Recycles objects the GPU uses until a fence value is reached, such as
+    // command allocators. Released objects wait in a fixed number of slots, and
+    // Acquire takes the one whose fence value completed last among all of them,
+    // so surplus objects sit unused and are released once their fence value is
+    // idleFenceValues behind the completed one. When every slot holds work still
+    // in flight, Release waits for the oldest instead of growing the pool.
+    //
+    // Lock free: slots are claimed with a compare and swap of their state, so
+    // threads only contend on the slot they claim. The fence callbacks must be
+    // thread safe. Objects still held on destruction are released whatever their
+    // fence value.
+    template <typename T>
+    class FencedPool final
+    {
+    public:
+        FencedPool(uint32_t capacity, uint64_t idleFenceValues,
+            std::function<uint64_t()> completedFenceValue,
+            std::function<void(uint64_t)> waitForFenceValue,
+            std::function<T()> create,
+            std::function<void(T&)> reset = {}) :
+            _slots(std::make_unique<Slot[]>(capacity)),
+            _capacity(capacity),
+            _idleFenceValues(idleFenceValues),
+            _completedFenceValue(std::move(completedFenceValue)),
+            _waitForFenceValue(std::move(waitForFenceValue)),
+            _create(std::move(create)),
+            _reset(std::move(reset))
+        {
+            if (capacity == 0)
+            {
+                throw std::invalid_argument("A fenced pool needs at least one slot");
+            }
+        }
+
+        FencedPool(const FencedPool&) = delete;
+        FencedPool& operator=(const FencedPool&) = delete;
+
+        // An object whose work is complete, reset, or a new one
+        T Acquire()
+        {
+            uint64_t completedValue = _completedFenceValue();
+            while (true)
+            {
+                Slot* newest = nullptr;
+                uint64_t newestFenceValue = 0;
+                for (uint32_t i = 0; i < _capacity; ++i)
+                {
+                    Slot& slot = _slots[i];
+                    if (slot.State.load(std::memory_order_acquire) != SlotState::Pending)
+                    {
+                        continue;
+                    }
+
+                    uint64_t fenceValue = slot.FenceValue.load(std::memory_order_relaxed);
+                    if (fenceValue > completedValue)
+                    {
+                        continue;
+                    }
+
+                    if (completedValue - fenceValue > _idleFenceValues)
+                    {
+                        _TryTrim(slot, completedValue);
+                    }
+                    else if (newest == nullptr || fenceValue > newestFenceValue)
+                    {
+                        newest = &slot;
+                        newestFenceValue = fenceValue;
+                    }
+                }
+
+                if (newest == nullptr)
+                {
+                    break;
+                }
+
+                T object;
+                if (!_TryTake(*newest, completedValue, object))
+                {
+                    // Taken by another thread in the meantime
+                    continue;
+                }
+
+                _reuses.fetch_add(1, std::memory_order_relaxed);
+                if (_reset)
+                {
+                    _reset(object);
+                }
+                return object;
+            }
+
+            _creations.fetch_add(1, std::memory_order_relaxed);
+            return _create();
+        }
+
+        // Hands the object back, to be reused once fenceValue completes
+        void Release(T object, uint64_t fenceValue)
+        {
+            while (true)
+            {
+                for (uint32_t i = 0; i < _capacity; ++i)
+                {
+                    Slot& slot = _slots[i];
+                    SlotState expected = SlotState::Empty;
+                    if (slot.State.load(std::memory_order_relaxed) == SlotState::Empty &&
+                        slot.State.compare_exchange_strong(expected, SlotState::Busy, std::memory_order_acquire))
+                    {
+                        slot.Object = std::move(object);
+                        slot.FenceValue.store(fenceValue, std::memory_order_relaxed);
+                        slot.State.store(SlotState::Pending, std::memory_order_release);
+                        _AddSize();
+                        return;
+                    }
+                }
+
+                // Full, make room by dropping a completed object or waiting for the oldest
+                uint64_t completedValue = _completedFenceValue();
+                Slot* oldest = nullptr;
+                uint64_t oldestFenceValue = 0;
+                for (uint32_t i = 0; i < _capacity; ++i)
+                {
+                    Slot& slot = _slots[i];
+                    if (slot.State.load(std::memory_order_acquire) != SlotState::Pending)
+                    {
+                        continue;
+                    }
+
+                    uint64_t slotFenceValue = slot.FenceValue.load(std::memory_order_relaxed);
+                    if (oldest == nullptr || slotFenceValue < oldestFenceValue)
+                    {
+                        oldest = &slot;
+                        oldestFenceValue = slotFenceValue;
+                    }
+                }
+
+                if (oldest == nullptr)
+                {
+                    // Every slot is being claimed by another thread
+                    std::this_thread::yield();
+                }
+                else if (oldestFenceValue <= completedValue)
+                {
+                    _TryTrim(*oldest, completedValue);
+                }
+                else
+                {
+                    _waits.fetch_add(1, std::memory_order_relaxed);
+                    _waitForFenceValue(oldestFenceValue);
+                }
+            }
+        }
+
+        // Releases the objects unused for too long without waiting for an Acquire
+        void Trim()
+        {
+            uint64_t completedValue = _completedFenceValue();
+            for (uint32_t i = 0; i < _capacity; ++i)
+            {
+                Slot& slot = _slots[i];
+                if (slot.State.load(std::memory_order_acquire) != SlotState::Pending)
+                {
+                    continue;
+                }
+
+                uint64_t fenceValue = slot.FenceValue.load(std::memory_order_relaxed);
+                if (fenceValue <= completedValue && completedValue - fenceValue > _idleFenceValues)
+                {
+                    _TryTrim(slot, completedValue);
+                }
+            }
+        }
+
+        FencedPoolStatistics GetStatistics() const
+        {
+            FencedPoolStatistics statistics;
+            statistics.Creations = _creations.load(std::memory_order_relaxed);
+            statistics.Reuses = _reuses.load(std::memory_order_relaxed);
+            statistics.Trims = _trims.load(std::memory_order_relaxed);
+            statistics.Waits = _waits.load(std::memory_order_relaxed);
+            statistics.Size = _size.load(std::memory_order_relaxed);
+            statistics.PeakSize = _peakSize.load(std::memory_order_relaxed);
+            return statistics;
+        }
+
+        inline uint32_t GetCapacity() const
+        {
+            return _capacity;
+        }
+
+    private:
+        enum class SlotState : uint32_t
+        {
+            Empty,
+            // Claimed by a thread moving an object in or out
+            Busy,
+            // Holds an object waiting for its fence value
+            Pending
+        };
+
+        // A cache line each, so threads claiming neighbouring slots do not contend
+        struct alignas(64) Slot
+        {
+            std::atomic<SlotState> State = SlotState::Empty;
+            std::atomic<uint64_t> FenceValue = 0;
+            T Object{};
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        uint32_t _capacity;
+        uint64_t _idleFenceValues;
+        std::function<uint64_t()> _completedFenceValue;
+        std::function<void(uint64_t)> _waitForFenceValue;
+        std::function<T()> _create;
+        std::function<void(T&)> _reset;
+
+        std::atomic<uint64_t> _creations = 0;
+        std::atomic<uint64_t> _reuses = 0;
+        std::atomic<uint64_t> _trims = 0;
+        std::atomic<uint64_t> _waits = 0;
+        std::atomic<uint32_t> _size = 0;
+        std::atomic<uint32_t> _peakSize = 0;
+
+        // Moves the object out of a pending slot if its fence value is still at
+        // most completedValue, the slot having possibly been reused since it was read
+        bool _TryTake(Slot& slot, uint64_t completedValue, T& object)
+        {
+            SlotState expected = SlotState::Pending;
+            if (!slot.State.compare_exchange_strong(expected, SlotState::Busy, std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            if (slot.FenceValue.load(std::memory_order_relaxed) > completedValue)
+            {
+                slot.State.store(SlotState::Pending, std::memory_order_release);
+                return false;
+            }
+
+            object = std::move(slot.Object);
+            slot.Object = T{};
+            slot.State.store(SlotState::Empty, std::memory_order_release);
+            _size.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        void _TryTrim(Slot& slot, uint64_t completedValue)
+        {
+            T object;
+            if (_TryTake(slot, completedValue, object))
+            {
+                _trims.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void _AddSize()
+        {
+            uint32_t size = _size.fetch_add(1, std::memory_order_relaxed) + 1;
+            uint32_t peakSize = _peakSize.load(std::memory_order_relaxed);
+            while (size > peakSize && !_peakSize.compare_exchange_weak(peakSize, size, std::memory_order_relaxed))
+            {
+            }
+        }
+    };
+}
@@ -0,0 +1,72 @@
+#include "FrameCapture.h"
+
+#include <d3dx12.h>
+#include "DXRUtils/DXRHelper.h"
+#include "Utilities.h"
+
+namespace DXRDemo
+{
+    FrameCapture::FrameCapture(ID3D12Device* device, const D3D12_RESOURCE_DESC& imageDesc, const std::string& filenamePattern) :
+        _width(static_cast<std::size_t>(imageDesc.Width)),
+        _height(static_cast<std::size_t>(imageDesc.Height)),
+        _format(imageDesc.Format),
+        _fileFormat(ImageEncoding::GetFileFormat(filenamePattern, imageDesc.Format == DXGI_FORMAT_R32G32B32A32_FLOAT)),
+        _filenamePattern(filenamePattern)
+    {
+        // Rows of buffer copies are padded to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+        uint64_t imageSize;
+        device->GetCopyableFootprints(&imageDesc, 0, 1, 0, &_footprint, nullptr, nullptr, &imageSize);
+
+        CD3DX12_HEAP_PROPERTIES readbackHeapProps(D3D12_HEAP_TYPE_READBACK);
+        _readbackBuffer = nv_helpers_dx12::CreateBuffer(device,
+            imageSize,
+            D3D12_RESOURCE_FLAG_NONE,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            readbackHeapProps);
+        ThrowIfFailed(_readbackBuffer->Map(0, nullptr, reinterpret_cast<void**>(&_readbackData)));
+    }
+
+    FrameCapture::~FrameCapture()
+    {
+        CD3DX12_RANGE writtenRange(0, 0);
+        _readbackBuffer->Unmap(0, &writtenRange);
+    }
+
+    void FrameCapture::RecordReadback(ID3D12GraphicsCommandList* commandList, ID3D12Resource* image)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION imageLocation(image, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION readbackLocation(_readbackBuffer.Get(), _footprint);
+        commandList->CopyTextureRegion(&readbackLocation, 0, 0, 0, &imageLocation, nullptr);
+    }
+
+    void FrameCapture::Write(const TonemapSettings& tonemap)
+    {
+        _writer.Write(_GetFilename(_frameCount), _fileFormat, _width, _height, _format,
+            _readbackData, _footprint.Footprint.RowPitch, tonemap);
+        ++_frameCount;
+    }
+
+    std::string FrameCapture::_GetFilename(uint64_t frame) const
+    {
+        std::size_t runEnd = _filenamePattern.find_last_of('#');
+        std::size_t width = 5;
+        std::size_t runStart = _filenamePattern.find_last_of('.');
+        if (runEnd != std::string::npos)
+        {
+            runStart = _filenamePattern.find_last_not_of('#', runEnd);
+            runStart = runStart == std::string::npos ? 0 : runStart + 1;
+            width = runEnd + 1 - runStart;
+        }
+        else
+        {
+            runEnd = runStart - 1;
+        }
+
+        std::string number = std::to_string(frame);
+        if (number.size() < width)
+        {
+            number.insert(0, width - number.size(), '0');
+        }
+        return _filenamePattern.substr(0, runStart) + number + _filenamePattern.substr(runEnd + 1);
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <cstdint>
+#include <string>
+#include "ImageWriter.h"
+
+namespace DXRDemo
+{
+    // Saves the radiance of every frame to numbered image files.
+    //
+    // The image is copied to a readback buffer along with the frame's other
+    // commands, then handed to an ImageWriter once they have completed. The file
+    // name pattern numbers frames in place of its last run of # characters,
+    // zero padded to its length, or before the extension when it has none. The
+    // extension selects the format as ImageEncoding::GetFileFormat does, EXRs
+    // keep the precision of the radiance.
+    class FrameCapture final
+    {
+    public:
+        // The image is a 2D texture of DXGI_FORMAT_R16G16B16A16_FLOAT or DXGI_FORMAT_R32G32B32A32_FLOAT
+        FrameCapture(ID3D12Device* device, const D3D12_RESOURCE_DESC& imageDesc, const std::string& filenamePattern);
+        FrameCapture(const FrameCapture&) = delete;
+        FrameCapture& operator=(const FrameCapture&) = delete;
+        ~FrameCapture();
+
+        // The image must be in D3D12_RESOURCE_STATE_COPY_SOURCE
+        void RecordReadback(ID3D12GraphicsCommandList* commandList, ID3D12Resource* image);
+
+        // Queues the image read back to be written. The commands recorded by
+        // RecordReadback must have completed.
+        void Write(const TonemapSettings& tonemap);
+
+        // Frames queued so far
+        inline uint64_t GetFrameCount() const
+        {
+            return _frameCount;
+        }
+
+    private:
+        std::size_t _width;
+        std::size_t _height;
+        DXGI_FORMAT _format;
+        ImageFileFormat _fileFormat;
+        std::string _filenamePattern;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT _footprint;
+        Microsoft::WRL::ComPtr<ID3D12Resource> _readbackBuffer;
+        uint8_t* _readbackData = nullptr;
+        uint64_t _frameCount = 0;
+        ImageWriter _writer;
+
+        std::string _GetFilename(uint64_t frame) const;
+    };
+}
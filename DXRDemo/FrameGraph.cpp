@@ -0,0 +1,127 @@
+#include "FrameGraph.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace DXRDemo
+{
+    FrameLayout GetFrameLayout(const FrameImages& images, const FramePasses& passes)
+    {
+        FrameLayout layout;
+        layout.Raster = static_cast<bool>(passes.Raster);
+        layout.DispatchRays = static_cast<bool>(passes.DispatchRays);
+        layout.Readback = static_cast<bool>(passes.Readback);
+        layout.Result = static_cast<bool>(passes.Result);
+        layout.Tonemap = static_cast<bool>(passes.Tonemap);
+        layout.Capture = static_cast<bool>(passes.Capture);
+        layout.Interface = static_cast<bool>(passes.Interface);
+        layout.Radiance = images.Radiance;
+        layout.Features = images.Features;
+        return layout;
+    }
+
+    RenderGraphResource DeclareFrame(RenderGraph& graph, ResourceStateTracker& tracker, const FrameImages& images, const FramePasses& passes)
+    {
+        if (images.BackBuffer == nullptr || (!passes.Raster && (images.Radiance == nullptr || !passes.DispatchRays || !passes.Tonemap)))
+        {
+            throw std::invalid_argument("Frame neither rasterized nor traced and tonemapped");
+        }
+
+        RenderGraphResource backBuffer = graph.Import("BackBuffer", *images.BackBuffer);
+        // Called through passes, the callbacks of the frame being executed
+        auto record = [&passes](FramePasses::RecordCallback FramePasses::* callback) -> RenderGraph::ExecuteCallback
+        {
+            return [&passes, callback](RenderGraphContext& context) { (passes.*callback)(context.GetCommandList()); };
+        };
+
+        if (passes.Raster)
+        {
+            graph.AddPass("Raster", [&](RenderGraphBuilder& builder)
+            {
+                backBuffer = builder.Write(backBuffer, ResourceState::RenderTarget);
+                builder.EndsCommandList();
+            }, record(&FramePasses::Raster));
+        }
+        else
+        {
+            RenderGraphResource radiance = graph.Import("Radiance", *images.Radiance);
+            std::vector<RenderGraphResource> features;
+            for (size_t i = 0; i < images.Features.size(); ++i)
+            {
+                features.push_back(graph.Import("Feature" + std::to_string(i), *images.Features[i]));
+            }
+
+            graph.AddPass("DispatchRays", [&](RenderGraphBuilder& builder)
+            {
+                radiance = builder.Write(radiance, ResourceState::UnorderedAccess);
+                for (RenderGraphResource& feature : features)
+                {
+                    feature = builder.Write(feature, ResourceState::UnorderedAccess);
+                }
+            }, record(&FramePasses::DispatchRays));
+
+            if (passes.Readback)
+            {
+                graph.AddPass("Readback", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(radiance, ResourceState::CopySource);
+                    for (RenderGraphResource feature : features)
+                    {
+                        builder.Read(feature, ResourceState::CopySource);
+                    }
+                    builder.HasSideEffects();
+                    builder.EndsCommandList();
+                }, record(&FramePasses::Readback));
+            }
+            if (passes.Result)
+            {
+                graph.AddPass("Result", [&](RenderGraphBuilder& builder)
+                {
+                    radiance = builder.Write(radiance, ResourceState::CopyDest);
+                }, record(&FramePasses::Result));
+            }
+
+            // The next frame traces into the radiance first, its transition
+            // carried out while the passes after its last use run
+            RenderResource* radianceResource = images.Radiance;
+            auto recordLastUse = [&passes, &tracker, radianceResource](FramePasses::RecordCallback FramePasses::* callback) -> RenderGraph::ExecuteCallback
+            {
+                return [&passes, &tracker, radianceResource, callback](RenderGraphContext& context)
+                {
+                    (passes.*callback)(context.GetCommandList());
+                    tracker.BeginTransition(*radianceResource, ResourceState::UnorderedAccess);
+                };
+            };
+
+            graph.AddPass("Tonemap", [&](RenderGraphBuilder& builder)
+            {
+                builder.Read(radiance, ResourceState::PixelShaderResource);
+                backBuffer = builder.Write(backBuffer, ResourceState::RenderTarget);
+            }, passes.Capture ? record(&FramePasses::Tonemap) : recordLastUse(&FramePasses::Tonemap));
+            if (passes.Capture)
+            {
+                graph.AddPass("Capture", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(radiance, ResourceState::CopySource);
+                    builder.HasSideEffects();
+                }, recordLastUse(&FramePasses::Capture));
+            }
+        }
+
+        if (passes.Interface)
+        {
+            graph.AddPass("Interface", [&](RenderGraphBuilder& builder)
+            {
+                backBuffer = builder.Write(backBuffer, ResourceState::RenderTarget);
+            }, record(&FramePasses::Interface));
+        }
+        graph.AddPass("Present", [&](RenderGraphBuilder& builder)
+        {
+            builder.Read(backBuffer, ResourceState::Present);
+            builder.HasSideEffects();
+        }, [](RenderGraphContext&) {});
+
+        graph.Compile();
+        return { backBuffer.Index, 0 };
+    }
+}
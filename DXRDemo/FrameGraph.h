@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "RenderBackend.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+
+namespace DXRDemo
+{
+    // Images the passes of a frame use, kept across frames
+    struct FrameImages
+    {
+        RenderResource* BackBuffer = nullptr;
+        // Traced radiance, replaced by the denoised one when there is one
+        RenderResource* Radiance = nullptr;
+        // Denoiser features of the first surface hit, traced along with the radiance
+        std::vector<RenderResource*> Features;
+    };
+
+    // What the passes of a frame record once their barriers are in place, left
+    // empty for the passes the frame goes without
+    struct FramePasses
+    {
+        using RecordCallback = std::function<void(RenderCommandList&)>;
+
+        // Draws the scene into the back buffer, possibly on lists of its own,
+        // instead of tracing it. Ends the command list.
+        RecordCallback Raster;
+        RecordCallback DispatchRays;
+        // Copies the radiance and the features out for the denoiser. Ends the
+        // command list, for the denoiser to start as soon as it is done.
+        RecordCallback Readback;
+        // Writes the denoised radiance of an earlier frame over the traced one
+        RecordCallback Result;
+        // Draws the radiance into the back buffer
+        RecordCallback Tonemap;
+        // Saves the radiance as shown
+        RecordCallback Capture;
+        // Draws over the back buffer, whether rasterized or traced
+        RecordCallback Interface;
+    };
+
+    // Which passes a frame has and the images they trace into, the back buffer
+    // aside. A graph declared for a frame can be executed again for the next
+    // while it stays the same.
+    struct FrameLayout
+    {
+        bool Raster = false;
+        bool DispatchRays = false;
+        bool Readback = false;
+        bool Result = false;
+        bool Tonemap = false;
+        bool Capture = false;
+        bool Interface = false;
+        RenderResource* Radiance = nullptr;
+        std::vector<RenderResource*> Features;
+
+        bool operator==(const FrameLayout&) const = default;
+    };
+
+    FrameLayout GetFrameLayout(const FrameImages& images, const FramePasses& passes);
+
+    // Declares the passes of a frame, the way Game renders it, to a graph just
+    // reset, and compiles it. The back buffer is left ready to present. The
+    // radiance starts its transition to the next frame's trace after its last
+    // use, through tracker, the one the graph is executed with.
+    //
+    // The passes are called through passes, which must outlive the graph's
+    // executions and may be given new callbacks between them, as long as the
+    // layout stays the same. Returns the back buffer, for the graph to be
+    // pointed at the next one with RenderGraph::Reimport.
+    RenderGraphResource DeclareFrame(RenderGraph& graph, ResourceStateTracker& tracker, const FrameImages& images, const FramePasses& passes);
+}
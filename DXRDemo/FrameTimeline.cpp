@@ -0,0 +1,87 @@
+#include "FrameTimeline.h"
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include "framework.h"
+
+namespace DXRDemo
+{
+    FrameTimeline::~FrameTimeline()
+    {
+        try
+        {
+            _SaveRecording();
+        }
+        catch (const std::exception& exception)
+        {
+            OutputDebugStringA(exception.what());
+        }
+    }
+
+    void FrameTimeline::StartRecording(const std::string& filename)
+    {
+        _recordingFilename = filename;
+        _frameDeltas.clear();
+    }
+
+    void FrameTimeline::LoadReplay(const std::string& filename)
+    {
+        std::ifstream file(filename);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open frame time file");
+        }
+
+        _frameDeltas.clear();
+        double frameDelta;
+        while (file >> frameDelta)
+        {
+            _frameDeltas.push_back(frameDelta);
+        }
+
+        _replayIndex = 0;
+        _replaying = true;
+    }
+
+    double FrameTimeline::NextFrameDelta()
+    {
+        auto now = std::chrono::high_resolution_clock::now();
+        double measuredDelta = std::chrono::duration<double>(now - _lastFrameTime).count();
+        _lastFrameTime = now;
+
+        if (_replaying)
+        {
+            return _replayIndex < _frameDeltas.size() ? _frameDeltas[_replayIndex++] : 0.0;
+        }
+
+        if (!_recordingFilename.empty())
+        {
+            _frameDeltas.push_back(measuredDelta);
+        }
+
+        return measuredDelta;
+    }
+
+    void FrameTimeline::_SaveRecording() const
+    {
+        if (_recordingFilename.empty() || _replaying)
+        {
+            return;
+        }
+
+        std::ofstream file(_recordingFilename);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open frame time file for writing");
+        }
+
+        // Enough digits for every value to read back to the exact same double
+        file << std::setprecision(std::numeric_limits<double>::max_digits10);
+        for (double frameDelta : _frameDeltas)
+        {
+            file << frameDelta << "\n";
+        }
+    }
+}
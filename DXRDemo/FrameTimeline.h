@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace DXRDemo
+{
+    // Source of the frame times driving the simulation. Frame times are either
+    // measured, or replayed from a file recorded during an earlier run, so that a
+    // benchmark or a distributed render goes through exactly the same states.
+    class FrameTimeline final
+    {
+    public:
+        FrameTimeline() = default;
+        FrameTimeline(const FrameTimeline&) = delete;
+        FrameTimeline& operator=(const FrameTimeline&) = delete;
+        ~FrameTimeline();
+
+        // Measured frame times are written to the file when the timeline is destroyed
+        void StartRecording(const std::string& filename);
+        void LoadReplay(const std::string& filename);
+
+        // Time elapsed since the previous frame, in seconds
+        double NextFrameDelta();
+
+        inline bool IsReplaying() const
+        {
+            return _replaying;
+        }
+
+        inline bool IsReplayFinished() const
+        {
+            return _replaying && _replayIndex >= _frameDeltas.size();
+        }
+
+    private:
+        std::chrono::high_resolution_clock::time_point _lastFrameTime = std::chrono::high_resolution_clock::now();
+        std::vector<double> _frameDeltas;
+        size_t _replayIndex = 0;
+        bool _replaying = false;
+        std::string _recordingFilename;
+
+        void _SaveRecording() const;
+    };
+}
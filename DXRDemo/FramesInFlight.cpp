@@ -0,0 +1,65 @@
+#include "FramesInFlight.h"
+
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    FramesInFlight::FramesInFlight(RenderQueue& queue, uint32_t frameCount) :
+        _queue(&queue),
+        _fenceValues(frameCount, 0)
+    {
+        if (frameCount == 0)
+        {
+            throw std::invalid_argument("At least one frame must be in flight");
+        }
+    }
+
+    FramesInFlight::~FramesInFlight()
+    {
+        WaitForIdle();
+    }
+
+    uint32_t FramesInFlight::BeginFrame()
+    {
+        _frameIndex = static_cast<uint32_t>(_frameNumber % _fenceValues.size());
+        ++_frameNumber;
+
+        uint64_t fenceValue = _fenceValues[_frameIndex];
+        if (!_queue->IsFenceComplete(fenceValue))
+        {
+            ++_waitCount;
+            _queue->WaitForFenceValue(fenceValue);
+        }
+
+        _ReleaseCompleted();
+        return _frameIndex;
+    }
+
+    void FramesInFlight::EndFrame(uint64_t fenceValue)
+    {
+        _fenceValues[_frameIndex] = fenceValue;
+        _lastFenceValue = fenceValue;
+
+        for (auto pending = _pendingReleases.rbegin(); pending != _pendingReleases.rend() && pending->FenceValue == 0; ++pending)
+        {
+            pending->FenceValue = fenceValue;
+        }
+    }
+
+    void FramesInFlight::WaitForIdle()
+    {
+        // Objects deferred after the last frame ended were never used by the GPU
+        _queue->WaitForFenceValue(_lastFenceValue);
+        _pendingReleases.clear();
+    }
+
+    void FramesInFlight::_ReleaseCompleted()
+    {
+        // Deferred in order, so their fence values only grow
+        while (!_pendingReleases.empty() && _pendingReleases.front().FenceValue != 0 &&
+            _queue->IsFenceComplete(_pendingReleases.front().FenceValue))
+        {
+            _pendingReleases.pop_front();
+        }
+    }
+}
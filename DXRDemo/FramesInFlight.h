@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "RenderBackend.h"
+
+namespace DXRDemo
+{
+    // Lets the CPU record frames while the GPU still executes earlier ones.
+    //
+    // Each of the frameCount slots stands for a frame that may be in flight.
+    // BeginFrame waits until the GPU is done with the frame that last used the
+    // next slot, after which memory kept per slot, such as upload regions indexed
+    // by GetFrameIndex, can be rewritten. EndFrame records the fence value that
+    // marks the frame's completion. Objects the frames in flight may still use are
+    // handed to DeferRelease instead of being dropped, and released once every
+    // frame submitted before then has completed.
+    class FramesInFlight final
+    {
+    public:
+        FramesInFlight(RenderQueue& queue, uint32_t frameCount);
+        FramesInFlight(const FramesInFlight&) = delete;
+        FramesInFlight& operator=(const FramesInFlight&) = delete;
+        // Waits for the frames in flight
+        ~FramesInFlight();
+
+        // Returns the slot of the new frame
+        uint32_t BeginFrame();
+
+        // The fence value the frame's last submission signaled
+        void EndFrame(uint64_t fenceValue);
+
+        // Keeps a copy of object, typically a ComPtr or shared_ptr, alive until the
+        // frame being recorded and those before it have completed
+        template <typename T>
+        inline void DeferRelease(T object)
+        {
+            _pendingReleases.push_back({ 0, std::make_shared<T>(std::move(object)) });
+        }
+
+        // Waits for every frame submitted and releases everything deferred
+        void WaitForIdle();
+
+        inline uint32_t GetFrameIndex() const
+        {
+            return _frameIndex;
+        }
+
+        inline uint32_t GetFrameCount() const
+        {
+            return static_cast<uint32_t>(_fenceValues.size());
+        }
+
+        // Frames BeginFrame had to wait for the GPU on
+        inline uint64_t GetWaitCount() const
+        {
+            return _waitCount;
+        }
+
+        inline std::size_t GetPendingReleaseCount() const
+        {
+            return _pendingReleases.size();
+        }
+
+    private:
+        struct PendingRelease
+        {
+            // 0 until the frame it was deferred in ends
+            uint64_t FenceValue;
+            std::shared_ptr<void> Object;
+        };
+
+        RenderQueue* _queue;
+        // Fence value of the frame that last used each slot
+        std::vector<uint64_t> _fenceValues;
+        uint32_t _frameIndex = 0;
+        uint64_t _frameNumber = 0;
+        uint64_t _lastFenceValue = 0;
+        uint64_t _waitCount = 0;
+        std::deque<PendingRelease> _pendingReleases;
+
+        void _ReleaseCompleted();
+    };
+}
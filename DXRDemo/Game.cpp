@@ -1,9 +1,11 @@
 #include "Game.h"
 
 #include <wrl.h>
+#include <algorithm>
 #include <chrono>
 #include <d3dcompiler.h>
 #include <memory>
+#include <stdexcept>
 
 #include "DXRUtils/DXRHelper.h"
 #include "DXRUtils/BottomLevelASGenerator.h"
@@ -12,7 +14,9 @@
 #include "GameObject.h"
 #include "MeshRenderer.h"
 #include "OscillatorComponent.h"
+#include "PixelConversion.h"
 #include "AssetImporter.h"
+#include "SceneSerializer.h"
 
 using namespace std;
 using namespace DirectX;
@@ -21,22 +25,31 @@ using namespace nv_helpers_dx12;
 
 namespace DXRDemo
 {
-    Game::Game(Window& window, uint32_t width, uint32_t height) :
+    Game::Game(Window& window, uint32_t width, uint32_t height, const LaunchOptions& options) :
         _window(&window),
+        _options(options),
+        _simulationClock(1.0 / options.SimulationRate),
         _dxContext(window, 3),
-        _viewport(CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)))
+        _framesInFlight(_dxContext.RenderDevice->GetQueue(CommandListType::Direct), options.FramesInFlight),
+        _stateTracker(*_dxContext.ResourceStates),
+        _frameGraph(*_dxContext.RenderDevice, *_dxContext.ResourceStates, [this](std::shared_ptr<void> object) { _framesInFlight.DeferRelease(std::move(object)); }),
+        _recordingThreadPool(options.RecordingThreads != 0 ? options.RecordingThreads : std::max(std::thread::hardware_concurrency() / 2, 1u)),
+        _viewport(CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height))),
+        _radianceFormat(options.FullPrecisionRadiance ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R16G16B16A16_FLOAT)
     {
         if (!_dxContext.IsRaytracingSupported())
         {
             assert("Raytracing not supported on device");
         }
 
-        //_fenceValues.resize(_dxContext.GetNumberBuffers());
         _OnInit();
     }
 
     Game::~Game()
     {
+        // Resources are released below, the GPU must be done with every frame
+        _framesInFlight.WaitForIdle();
+
         ImGui_ImplDX12_Shutdown();
         ImGui_ImplWin32_Shutdown();
         ImGui::DestroyContext();
@@ -65,7 +78,17 @@ namespace DXRDemo
         //rotation[0] += static_cast<float>(2 * XM_PI / secondsPerRotation * secondsSinceLastTick);
         //rotation[1] += static_cast<float>(2 * XM_PI / secondsPerRotation * secondsSinceLastTick);
 
-        Scene.Update(secondsSinceLastTick);
+        // Advance the simulation in fixed steps, from measured or replayed frame times
+        uint32_t steps = _simulationClock.Advance(_frameTimeline.NextFrameDelta());
+        for (uint32_t step = 0; step < steps; ++step)
+        {
+            _StepSimulation();
+        }
+
+        if (_frameTimeline.IsReplayFinished())
+        {
+            _window->Quit();
+        }
 
         if (elapsedSeconds > 1.0)
         {
@@ -94,14 +117,6 @@ namespace DXRDemo
             rayTracingEnabled = _dxContext.IsRaytracingEnabled();
         }
 
-        // Update the model matrix
-        Scene.RootSceneObject->Transform.UpdateModelMatrix();
-        Scene.RootSceneObject->ForEachChild([](GameObject& child, std::size_t i)
-        {
-            child.Transform.UpdateModelMatrix();
-            return false;
-        });
-
         // Update the view matrix
         const XMVECTOR eyePosition = XMVectorSet(0, 0, -250, 1);
         const XMVECTOR focusPoint = XMVectorSet(0, 0, 0, 1);
@@ -115,6 +130,15 @@ namespace DXRDemo
 
     void Game::Render()
     {
+        // The sweep takes the place of the first frame, then the application exits
+        if (!_options.QualitySweepPath.empty())
+        {
+            _RunQualitySweep();
+            _options.QualitySweepPath.clear();
+            _window->Quit();
+            return;
+        }
+
         ImGui_ImplDX12_NewFrame();
         ImGui_ImplWin32_NewFrame();
         ImGui::NewFrame();
@@ -128,6 +152,24 @@ namespace DXRDemo
             
             ImGui::Text("Ray Tracing Enabled: %s", _dxContext.IsRaytracingEnabled() ? "True" : "False");
             ImGui::Text("VSync Enabled: %s", _dxContext.IsVSyncEnabled() ? "True" : "False");
+            FencedPoolStatistics allocatorStatistics = _dxContext.DirectCommandQueue->GetCommandAllocatorStatistics();
+            ImGui::Text("Command Allocators: %u (peak %u, %llu created, %llu reused)",
+                allocatorStatistics.Size, allocatorStatistics.PeakSize,
+                allocatorStatistics.Creations, allocatorStatistics.Reuses);
+            const UploadRingStatistics& uploadStatistics = _dxContext.CopyUploadRing->GetStatistics();
+            ImGui::Text("Upload Resources: %llu (ring peak %.1f MB, %llu waits)",
+                uploadStatistics.ResourceCreations + _materialUploadRing->GetStatistics().ResourceCreations,
+                uploadStatistics.PeakUsedSize / (1024.0 * 1024.0), uploadStatistics.Waits);
+            PlacedResourceStatistics heapStatistics = _dxContext.BufferHeaps->GetStatistics();
+            ImGui::Text("Buffer Heaps: %u (%u buffers, %.1f of %.1f MB)",
+                heapStatistics.HeapCount, heapStatistics.ResourceCount,
+                heapStatistics.UsedBytes / (1024.0 * 1024.0), heapStatistics.HeapBytes / (1024.0 * 1024.0));
+            ImGui::Text("Geometry Pool: %u meshes (%.1f MB)",
+                _geometryPool->GetGeometryCount(), _geometryPool->GetSize() / (1024.0 * 1024.0));
+            const ResourceStateTrackerStatistics& barrierStatistics = _stateTracker.GetStatistics();
+            ImGui::Text("Barriers: %llu in %llu batches (%llu merged, %llu redundant, %llu split)",
+                barrierStatistics.Barriers + barrierStatistics.ResolvedBarriers, barrierStatistics.BarrierBatches,
+                barrierStatistics.MergedTransitions, barrierStatistics.RedundantTransitions, barrierStatistics.SplitBarriers);
             
             ImGui::SeparatorText("Ray Tracing");
             ////////////////////////////////////
@@ -137,6 +179,34 @@ namespace DXRDemo
             ImGui::Checkbox("Importance Sampling", &UserSettings.ImportanceSamplingEnabled);
             ImGui::SliderFloat("% Towards Light", &UserSettings.ImportanceSamplingPercentage, 0, 1);
             ImGui::Checkbox("Denoising", &DenoisingEnabled);
+            ImGui::Checkbox("Temporal Accumulation", &TemporalAccumulationEnabled);
+
+            const char* denoiserBackends[] = { "Open Image Denoise", "Wavelet" };
+            int denoiserBackend = static_cast<int>(DenoisingBackend);
+            if (ImGui::Combo("Denoiser", &denoiserBackend, denoiserBackends, IM_ARRAYSIZE(denoiserBackends)))
+            {
+                DenoisingBackend = static_cast<DenoiserBackend>(denoiserBackend);
+            }
+
+            const char* denoiseQualities[] = { "Fast", "Balanced", "High" };
+            int denoiseQuality = static_cast<int>(DenoisingQuality);
+            if (ImGui::Combo("Denoise Quality", &denoiseQuality, denoiseQualities, IM_ARRAYSIZE(denoiseQualities)))
+            {
+                DenoisingQuality = static_cast<DenoiseQuality>(denoiseQuality);
+            }
+            const DenoiserService::Timing& denoiseTiming = _denoisePipeline->GetLastTiming();
+            ImGui::Text("Denoise: %.2f ms (setup %.2f ms)", denoiseTiming.DenoiseMilliseconds, denoiseTiming.SetupMilliseconds);
+            ImGui::Text("Reprojected: %.0f%%", _denoisePipeline->GetLastReprojectedFraction() * 100.0f);
+
+            ImGui::SeparatorText("Tonemapping");
+
+            const char* tonemapOperators[] = { "Clamp", "Reinhard", "ACES" };
+            int tonemapOperator = static_cast<int>(Tonemap.Operator);
+            if (ImGui::Combo("Operator", &tonemapOperator, tonemapOperators, IM_ARRAYSIZE(tonemapOperators)))
+            {
+                Tonemap.Operator = static_cast<TonemapOperator>(tonemapOperator);
+            }
+            ImGui::SliderFloat("Exposure", &Tonemap.Exposure, 0.01f, 16.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
 
             ImGui::SeparatorText("FPS");
             ///////////////////////////////
@@ -157,209 +227,203 @@ namespace DXRDemo
 
         CommandQueue& directCommandQueue = *_dxContext.DirectCommandQueue;
         auto directCommandList = directCommandQueue.GetCommandList(_pipelineState.Get());
+        // The list the frame graph records to, replaced each time a pass ends it
+        auto renderCommandList = std::make_unique<D3D12RenderCommandList>(_dxContext.Device.Get(), directCommandList, CommandListType::Direct);
         
-        UINT currentBackBufferIndex = _dxContext.GetCurrentBackBufferIndex();
-        auto backBuffer = _dxContext.GetCurrentBackBuffer();
+        RenderResource& backBuffer = _dxContext.GetCurrentBackBufferResource();
         auto rtv = _dxContext.GetCurrentRenderTargetView();
         auto dsv = _dsvHeap->GetCPUDescriptorHandleForHeapStart();
-
-        directCommandList->RSSetViewports(1, &_viewport);
-        directCommandList->RSSetScissorRects(1, &_scissorRect);
-        directCommandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+        bool frameCaptured = false;
+        bool readbackRecorded = false;
+        // Lists recorded before the one being recorded, submitted along with it
+        std::vector<ComPtr<ID3D12GraphicsCommandList4>> commandListBatch;
+        // Draws recorded on the recording threads, run after the list of their pass
+        std::vector<ComPtr<ID3D12GraphicsCommandList4>> drawCommandLists;
+
+        // Waits for the GPU only when it is a full set of frames behind, the
+        // memory kept per frame is then free to be written
+        uint32_t frameIndex = _framesInFlight.BeginFrame();
+        _descriptorAllocator->BeginFrame(frameIndex);
+
+        // Bring the model matrices, instances and constants up to date with
+        // whatever changed since the last frame
+        _ProcessChanges(directCommandList.Get());
+        _UploadFrameConstants();
+        _frameUploadBuffer->BeginFrame(frameIndex);
+
+        // The passes of the frame, their barriers left to the frame graph
+        FrameImages images;
+        images.BackBuffer = &backBuffer;
+        // Refilled every frame, the callbacks referencing what this one records
+        FramePasses& passes = _framePasses;
+        passes = {};
 
         // Raster
         if (!_dxContext.IsRaytracingEnabled())
         {
-            directCommandList->SetGraphicsRootSignature(_rootSignature.Get());
-
-            // Indicate that the back buffer will be used as a render target
-            _TransitionResource(directCommandList, backBuffer,
-                D3D12_RESOURCE_STATE_PRESENT,
-                D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-            // Clear the render targets
-            _ClearRTV(directCommandList, rtv, _clearColor);
-            _ClearDepth(directCommandList, dsv);
-
-            directCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-            
-            // Render all geometry
-            Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this, &directCommandList](MeshRenderer& meshRenderer, size_t index)
+            passes.Raster = [&](RenderCommandList& commandList)
             {
-
-                XMMATRIX mvpMatrix = XMMatrixMultiply(meshRenderer.Parent->Transform.ModelMatrix, _viewMatrix);
-                mvpMatrix = XMMatrixMultiply(mvpMatrix, _projectionMatrix);
-
-                CopyDataToBuffer(meshRenderer.Parent->Transform.MvpBuffer, &mvpMatrix, sizeof(mvpMatrix));
-                directCommandList->SetGraphicsRootConstantBufferView(0, meshRenderer.Parent->Transform.MvpBuffer->GetGPUVirtualAddress());
-
-                for (uint32_t i = 0; i < meshRenderer.Meshes.size(); ++i)
-                {
-                    directCommandList->IASetVertexBuffers(0, 1, &meshRenderer.VertexBufferViews[i]);
-                    directCommandList->IASetIndexBuffer(&meshRenderer.IndexBufferViews[i]);
-                    // Draw command
-                    directCommandList->DrawIndexedInstanced(static_cast<UINT>(meshRenderer.Meshes[i]->Indices.size()), 1, 0, 0, 0);
-                }
-
-                return false;
-            });
-
-            _TransitionResource(directCommandList, backBuffer,
-                D3D12_RESOURCE_STATE_RENDER_TARGET,
-                D3D12_RESOURCE_STATE_PRESENT);
+                const ComPtr<ID3D12GraphicsCommandList4>& nativeCommandList = GetD3D12CommandList(commandList);
+                nativeCommandList->SetGraphicsRootSignature(_rootSignature.Get());
+                nativeCommandList->RSSetViewports(1, &_viewport);
+                nativeCommandList->RSSetScissorRects(1, &_scissorRect);
+                nativeCommandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+
+                // Clear the render targets
+                _ClearRTV(nativeCommandList, rtv, _clearColor);
+                _ClearDepth(nativeCommandList, dsv);
+
+                // Render all geometry, the draws going between the clears and the
+                // interface, which continues on a new list
+                drawCommandLists = _RecordRasterDraws(rtv, dsv);
+            };
         }
         // Ray tracing
         else
         {
+            images.Radiance = _outputImage.get();
+            // Features are left as the last readback needed them, and brought
+            // back along with the radiance
+            images.Features = { _albedoImage.get(), _normalImage.get(), _instanceImage.get(), _distanceImage.get() };
+
             // Set descriptor heap
-            std::vector<ID3D12DescriptorHeap*> heaps = { m_srvUavHeap.Get() };
+            std::vector<ID3D12DescriptorHeap*> heaps = { _GetDescriptorHeap() };
             directCommandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
 
-            // Update acceleration structures
-            int instanceNumber = 0;
-            Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this, &instanceNumber](MeshRenderer& meshRenderer, size_t index)
-            {
-                for (auto& bottomLevelBuffer : meshRenderer.BottomLevelASBuffers)
-                {
-                    ASInstances[instanceNumber].second = meshRenderer.Parent->Transform.ModelMatrix;
-                    ++instanceNumber;
-                }
-                return false;
-            });
-            CreateTopLevelAS(directCommandList.Get(), ASInstances, true);
-
-            // Update inverse view and projection matrices
-            XMMATRIX inverseProjectionMatrix = XMMatrixInverse(nullptr, _projectionMatrix);
-            CopyDataToBuffer(_inverseProjectBuffer, &inverseProjectionMatrix, sizeof(inverseProjectionMatrix));
-
-            XMMATRIX inverseViewMatrix = XMMatrixInverse(nullptr, _viewMatrix);
-            CopyDataToBuffer(_inverseViewBuffer, &inverseViewMatrix, sizeof(inverseViewMatrix));
-
-            // Copy settings
-            CopyDataToBuffer(_settingsViewBuffer, &UserSettings, sizeof(Settings));
+            // Update acceleration structures with the instances that moved
+            CreateTopLevelAS(directCommandList.Get(), true);
 
-            // Transition output buffer from copy to unordered access (
-            CD3DX12_RESOURCE_BARRIER transition = CD3DX12_RESOURCE_BARRIER::Transition(m_outputResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-            directCommandList->ResourceBarrier(1, &transition);
-
-            // Setup raytracing task
-            D3D12_DISPATCH_RAYS_DESC desc = {};
-            desc.RayGenerationShaderRecord.StartAddress = m_sbtStorage->GetGPUVirtualAddress();
-            desc.RayGenerationShaderRecord.SizeInBytes = m_sbtHelper.GetRayGenSectionSize();
-            
-            // Required to be 64 bit aligned
-            desc.MissShaderTable.StartAddress = ROUND_UP(m_sbtStorage->GetGPUVirtualAddress(), D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT) +
-                ROUND_UP(m_sbtHelper.GetRayGenSectionSize(), D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
-            desc.MissShaderTable.SizeInBytes = m_sbtHelper.GetMissSectionSize();
-            desc.MissShaderTable.StrideInBytes = m_sbtHelper.GetMissEntrySize();
-
-            // Required to be 64 bit aligned
-            desc.HitGroupTable.StartAddress = m_sbtStorage->GetGPUVirtualAddress() +
-                ROUND_UP(m_sbtHelper.GetRayGenSectionSize(), D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT) +
-                ROUND_UP(m_sbtHelper.GetMissSectionSize(), D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
-            desc.HitGroupTable.SizeInBytes = m_sbtHelper.GetHitGroupSectionSize();
-            desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
-           
-            desc.Width = static_cast<UINT>(_viewport.Width);
-            desc.Height = static_cast<UINT>(_viewport.Height);
-            desc.Depth = 1;
-            directCommandList->SetPipelineState1(m_rtStateObject.Get());
-            directCommandList->DispatchRays(&desc);
-
-            // Copy RT output image to render target
-
-            // Transition output from unordered access to copy source
-            transition = CD3DX12_RESOURCE_BARRIER::Transition(m_outputResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
-            directCommandList->ResourceBarrier(1, &transition);
-
-            // Transition render target from render target to copy dest
-            transition = CD3DX12_RESOURCE_BARRIER::Transition(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST);
-            directCommandList->ResourceBarrier(1, &transition);
+            passes.DispatchRays = [this](RenderCommandList& commandList)
+            {
+                _RecordDispatchRays(GetD3D12CommandList(commandList).Get());
+            };
 
             if (DenoisingEnabled)
             {
-                D3D12_TEXTURE_COPY_LOCATION srcLocation = {};
-                srcLocation.pResource = m_outputResource.Get();
-                srcLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-                srcLocation.SubresourceIndex = 0; // Assuming you want to copy from the first subresource
-
-                D3D12_TEXTURE_COPY_LOCATION dstLocation = {};
-                dstLocation.pResource = m_outputReadbackResource.Get();
-                dstLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-                dstLocation.PlacedFootprint.Offset = 0;
-                dstLocation.PlacedFootprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // Adjust this as necessary
-                dstLocation.PlacedFootprint.Footprint.Width = static_cast<uint32_t>(_viewport.Width);
-                dstLocation.PlacedFootprint.Footprint.Height = static_cast<uint32_t>(_viewport.Height);
-                dstLocation.PlacedFootprint.Footprint.Depth = 1;
-                dstLocation.PlacedFootprint.Footprint.RowPitch = static_cast<uint32_t>(_viewport.Width * 4); // Adjust this as necessary
-
-                directCommandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, nullptr);
-                //directCommandList->CopyResource(m_outputReadbackResource.Get(), m_outputResource.Get());
-
-                _fenceValue = directCommandQueue.ExecuteCommandList(directCommandList);
-                directCommandQueue.WaitForFenceValue(_fenceValue);
-                directCommandList = directCommandQueue.GetCommandList();
-
-                void* readBack;
-                void* upload;
-                m_outputReadbackResource->Map(0, nullptr, &readBack);
-                m_outputUploadResource->Map(0, nullptr, &upload);
-
-                _denoiser->Denoise(readBack, upload);
-                //memcpy(upload, readBack,
-                //    static_cast<std::size_t>(_viewport.Width)* static_cast<std::size_t>(_viewport.Height) * 4);
-
-                m_outputUploadResource->Unmap(0, nullptr);
-                m_outputReadbackResource->Unmap(0, nullptr);
-
-
-                D3D12_TEXTURE_COPY_LOCATION dstLocation2 = {};
-                dstLocation2.pResource = backBuffer.Get();
-                dstLocation2.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-                dstLocation2.SubresourceIndex = 0; // Assuming you want to copy to the first subresource
-
-                D3D12_TEXTURE_COPY_LOCATION srcLocation2 = {};
-                srcLocation2.pResource = m_outputUploadResource.Get();
-                srcLocation2.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-                srcLocation2.PlacedFootprint.Offset = 0;
-                srcLocation2.PlacedFootprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // Adjust this as necessary
-                srcLocation2.PlacedFootprint.Footprint.Width = static_cast<uint32_t>(_viewport.Width);
-                srcLocation2.PlacedFootprint.Footprint.Height = static_cast<uint32_t>(_viewport.Height);
-                srcLocation2.PlacedFootprint.Footprint.Depth = 1;
-                srcLocation2.PlacedFootprint.Footprint.RowPitch = static_cast<uint32_t>(_viewport.Width * 4); // Adjust this as necessary
-
-                directCommandList->CopyTextureRegion(&dstLocation2, 0, 0, 0, &srcLocation2, nullptr);
+                // The radiance is read back and denoised in its own float format,
+                // along with the features guiding the denoiser. The denoiser works
+                // on it while the following frames are traced.
+                passes.Readback = [&](RenderCommandList& commandList)
+                {
+                    _denoisePipeline->RecordReadback(GetD3D12CommandList(commandList).Get(), m_outputResource.Get(), _albedoResource.Get(), _normalResource.Get(),
+                        _instanceResource.Get(), _distanceResource.Get());
+                    readbackRecorded = true;
+                };
+
+                // Write the denoised radiance of an earlier frame over the ray traced
+                // one, until the first one is ready the noisy radiance is shown
+                if (_denoisePipeline->HasResult(1))
+                {
+                    passes.Result = [this](RenderCommandList& commandList)
+                    {
+                        _denoisePipeline->RecordResult(GetD3D12CommandList(commandList).Get(), m_outputResource.Get());
+                    };
+                }
             }
             else
             {
-                // Copy raytrace output to render target
-                directCommandList->CopyResource(backBuffer.Get(), m_outputResource.Get());
+                // Results still in flight belong to frames that are no longer shown
+                _denoisePipeline->Flush();
             }
-            
 
-            transition = CD3DX12_RESOURCE_BARRIER::Transition(backBuffer.Get(),
-                D3D12_RESOURCE_STATE_COPY_DEST,
-                D3D12_RESOURCE_STATE_PRESENT);
-            directCommandList->ResourceBarrier(1, &transition);
+            // Tonemap the radiance into the back buffer
+            passes.Tonemap = [&, heaps](RenderCommandList& commandList)
+            {
+                ID3D12GraphicsCommandList4* nativeCommandList = GetD3D12CommandList(commandList).Get();
+                nativeCommandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
+                nativeCommandList->SetPipelineState(_tonemapPipelineState.Get());
+                nativeCommandList->SetGraphicsRootSignature(_tonemapRootSignature.Get());
+                nativeCommandList->SetGraphicsRoot32BitConstants(0, sizeof(TonemapSettings) / 4, &Tonemap, 0);
+                nativeCommandList->SetGraphicsRootDescriptorTable(1, D3D12_GPU_DESCRIPTOR_HANDLE{ _descriptorHeap->GetHandle(_outputSrvIndex).Gpu });
+                nativeCommandList->RSSetViewports(1, &_viewport);
+                nativeCommandList->RSSetScissorRects(1, &_scissorRect);
+                nativeCommandList->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+                nativeCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+                nativeCommandList->DrawInstanced(3, 1, 0, 0);
+            };
+
+            // Save the radiance as shown, denoised or not
+            if (_frameCapture)
+            {
+                passes.Capture = [&](RenderCommandList& commandList)
+                {
+                    _frameCapture->RecordReadback(GetD3D12CommandList(commandList).Get(), m_outputResource.Get());
+                    frameCaptured = true;
+                };
+            }
         }
 
-        directCommandList->RSSetViewports(1, &_viewport);
-        directCommandList->RSSetScissorRects(1, &_scissorRect);
-        directCommandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+        passes.Interface = [&](RenderCommandList& commandList)
+        {
+            ID3D12GraphicsCommandList4* nativeCommandList = GetD3D12CommandList(commandList).Get();
+            nativeCommandList->RSSetViewports(1, &_viewport);
+            nativeCommandList->RSSetScissorRects(1, &_scissorRect);
+            nativeCommandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+
+            std::vector<ID3D12DescriptorHeap*> uiHeaps = { _GetDescriptorHeap() };
+            nativeCommandList->SetDescriptorHeaps(static_cast<UINT>(uiHeaps.size()), uiHeaps.data());
+            ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), nativeCommandList);
+        };
 
-        std::vector<ID3D12DescriptorHeap*> uiHeaps = { m_guiHeap.Get() };
-        directCommandList->SetDescriptorHeaps(static_cast<UINT>(uiHeaps.size()), uiHeaps.data());
-        ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), directCommandList.Get());
+        // Lists ended by the raster pass are submitted with the rest of the frame,
+        // the one ended by the readback right away for the denoiser to start
+        auto submit = [&](RenderCommandList& commandList) -> RenderCommandList&
+        {
+            commandListBatch.push_back(GetD3D12CommandList(commandList));
+            commandListBatch.insert(commandListBatch.end(), drawCommandLists.begin(), drawCommandLists.end());
+            drawCommandLists.clear();
+            if (readbackRecorded)
+            {
+                _fenceValue = _ExecuteCommandLists(std::move(commandListBatch));
+                commandListBatch.clear();
+                std::optional<TemporalAccumulator::Frame> temporalFrame;
+                if (TemporalAccumulationEnabled)
+                {
+                    temporalFrame = _CreateTemporalFrame();
+                }
+                _denoisePipeline->Submit(_fenceValue, DenoisingBackend, DenoisingQuality, std::move(temporalFrame));
+                readbackRecorded = false;
+            }
 
-        // Present
-        _fenceValue = directCommandQueue.ExecuteCommandList(directCommandList);
-        directCommandQueue.WaitForFenceValue(_fenceValue);
+            renderCommandList = std::make_unique<D3D12RenderCommandList>(_dxContext.Device.Get(), directCommandQueue.GetCommandList(), CommandListType::Direct);
+            return *renderCommandList;
+        };
+
+        // The graph is compiled again only when passes are turned on or off or the
+        // images are recreated, the back buffer swapped in otherwise. All the
+        // images are imported, the graph places no transient resources for Game.
+        FrameLayout frameLayout = GetFrameLayout(images, passes);
+        if (frameLayout != _frameLayout)
+        {
+            _frameGraph.Reset();
+            _frameBackBuffer = DeclareFrame(_frameGraph, _stateTracker, images, passes);
+            _frameLayout = std::move(frameLayout);
+        }
+        else
+        {
+            _frameGraph.Reimport(_frameBackBuffer, backBuffer);
+        }
+        _frameGraph.Execute(*renderCommandList, _stateTracker, submit);
 
+        // Present, the graph having left the back buffer ready for it
+        commandListBatch.push_back(renderCommandList->GetNative());
+        _fenceValue = _ExecuteCommandLists(std::move(commandListBatch));
+        _denoisePipeline->EndFrame(_fenceValue);
+        _framesInFlight.EndFrame(_fenceValue);
+        _materialUploadRing->Retire(_fenceValue);
+
+        if (frameCaptured)
+        {
+            // The capture has a single readback buffer, saving frames runs in lockstep
+            directCommandQueue.WaitForFenceValue(_fenceValue);
+            _frameCapture->Write(Tonemap);
+            if (_options.FrameOutputCount != 0 && _frameCapture->GetFrameCount() >= _options.FrameOutputCount)
+            {
+                _window->Quit();
+            }
+        }
 
         _dxContext.Present();
-        //directCommandQueue.WaitForFenceValue(_fenceValues[_dxContext.GetCurrentBackBufferIndex()]);
-    
-        //while (true) {}
     }
 
     void Game::OnKeyUp(uint8_t key)
@@ -388,24 +452,42 @@ namespace DXRDemo
     {
         // Import Scene
         AssetImporter assetImporter;
-        Scene.RootSceneObject = make_shared<GameObject>();
-        
-        Scene.RootSceneObject->AddChild(assetImporter.ImportAsset(R"(Content\cornell_box_multimaterial\cornell_box_multimaterial.obj)"));
-        Scene.RootSceneObject->AddChild(assetImporter.ImportAsset(R"(Content\sphere\sphere.obj)"));
+        SceneSerializer sceneSerializer;
+        if (!_options.ScenePath.empty())
+        {
+            sceneSerializer.Load(Scene, _options.ScenePath, assetImporter);
+        }
+        else
+        {
+            _CreateDefaultScene(assetImporter);
+        }
 
-        auto& sphere = Scene.RootSceneObject->Children.back()->Children.back();
-        sphere->Transform.Scale *= 10;
-        sphere->Transform.Position.y = 20;
-        auto oscillator = std::make_shared<OscillatorComponent>();
-        oscillator->Radius = 30;
-        oscillator->Speed = XM_PI / 2;
-        sphere->AddComponent(oscillator);
+        if (!_options.SaveScenePath.empty())
+        {
+            const std::string& path = _options.SaveScenePath;
+            bool text = path.size() >= 4 && path.compare(path.size() - 4, 4, ".txt") == 0;
+            sceneSerializer.Save(Scene, path, text);
+        }
+
+        if (!_options.RecordFrameTimesPath.empty())
+        {
+            _frameTimeline.StartRecording(_options.RecordFrameTimesPath);
+        }
+        if (!_options.ReplayFrameTimesPath.empty())
+        {
+            _frameTimeline.LoadReplay(_options.ReplayFrameTimesPath);
+        }
+
+        // Model matrices are needed before the acceleration structures are built
+        _InitializeTransforms(*Scene.RootSceneObject);
 
         _CreateDescriptorHeaps();
         _CreateBuffers();
         _CreateBufferViews();
         _CreateRasterizationRootSignature();
         _CreateRasterizationPipeline();
+        _CreateTonemapRootSignature();
+        _CreateTonemapPipeline();
 
         CreateAccelerationStructures();
         CreateRaytracingPipeline();
@@ -413,26 +495,544 @@ namespace DXRDemo
         CreateShaderResourceHeap();
         CreateShaderBindingTable();
 
-        _denoiser = std::make_shared<Denoiser>(
-            static_cast<std::size_t>(_viewport.Width),
-            static_cast<std::size_t>(_viewport.Height)
+        _denoiser = std::make_shared<DenoiserService>(
+            _threadPool,
+            DenoiseTiling{ _options.DenoiseTileSize, _options.DenoiseTileOverlap, _options.DenoiseMemoryLimitMB }
             );
 
+        uint32_t denoiseLatency = _options.DenoiseLatency;
+        uint32_t denoiseQueueDepth = _options.DenoiseQueueDepth != 0 ? _options.DenoiseQueueDepth : denoiseLatency + 1;
+        _denoisePipeline = std::make_unique<DenoisePipeline>(
+            _dxContext.Device.Get(),
+            *_dxContext.DirectCommandQueue,
+            *_denoiser,
+            _threadPool,
+            m_outputResource->GetDesc(),
+            denoiseQueueDepth,
+            denoiseLatency);
+
+        if (!_options.FrameOutputPath.empty())
+        {
+            _frameCapture = std::make_unique<FrameCapture>(_dxContext.Device.Get(), m_outputResource->GetDesc(), _options.FrameOutputPath);
+        }
 
         _InitializeGUI();
+
+        // Everything built so far reflects the scene, only the constants are still
+        // to be uploaded
+        Scene.Journal.Clear();
+        Scene.Journal.Record(ChangeType::Settings);
+        Scene.Journal.Record(ChangeType::Camera);
+    }
+
+    void Game::_CreateDefaultScene(AssetImporter& assetImporter)
+    {
+        Scene.SetRootSceneObject(make_shared<GameObject>());
+        
+        Scene.RootSceneObject->AddChild(assetImporter.ImportAsset(R"(Content\cornell_box_multimaterial\cornell_box_multimaterial.obj)"));
+        Scene.RootSceneObject->AddChild(assetImporter.ImportAsset(R"(Content\sphere\sphere.obj)"));
+
+        auto& sphere = Scene.RootSceneObject->Children.back()->Children.back();
+        sphere->Transform.Scale *= 10;
+        sphere->Transform.Position.y = 20;
+        auto oscillator = std::make_shared<OscillatorComponent>();
+        oscillator->Radius = 30;
+        oscillator->Speed = XM_PI / 2;
+        sphere->AddComponent(oscillator);
+    }
+
+    void Game::_InitializeTransforms(GameObject& gameObject)
+    {
+        auto initializeTransform = [](GameObject& gameObject)
+        {
+            // The loaded state is where the simulation starts from
+            gameObject.Transform.SavePreviousState();
+            gameObject.Transform.UpdateModelMatrix();
+            gameObject.Transform.Dirty = false;
+            gameObject.Transform.Moved = false;
+        };
+
+        initializeTransform(gameObject);
+        gameObject.ForEachChild([&initializeTransform](GameObject& child, std::size_t i)
+        {
+            initializeTransform(child);
+            return false;
+        });
+    }
+
+    void Game::_StepSimulation()
+    {
+        // Objects that moved during the previous step start this one from the
+        // state that step left them in. Objects that did not move already have
+        // matching previous and current states.
+        for (GameObject* gameObject : _movingObjects)
+        {
+            gameObject->Transform.SavePreviousState();
+            gameObject->RequestTransformUpdate();
+        }
+        _movingObjects.clear();
+
+        Scene.Update(_simulationClock.GetFixedDeltaTime());
+
+        // Every object that moved has an entry in the journal
+        for (const Change& change : Scene.Journal.GetChanges())
+        {
+            if (change.Type == ChangeType::Transform && change.Object->Transform.Moved)
+            {
+                change.Object->Transform.Moved = false;
+                change.Object->Transform.Interpolating = true;
+                _movingObjects.push_back(change.Object);
+            }
+        }
+    }
+
+    void Game::_ProcessChanges(ID3D12GraphicsCommandList4* commandList)
+    {
+        ChangeJournal& journal = Scene.Journal;
+
+        // Interpolated transforms change every frame, even without a simulation step
+        for (GameObject* gameObject : _movingObjects)
+        {
+            gameObject->RequestTransformUpdate();
+        }
+
+        if (UserSettings != _uploadedSettings)
+        {
+            journal.Record(ChangeType::Settings);
+        }
+
+        if (memcmp(&_viewMatrix, &_uploadedViewMatrix, sizeof(XMMATRIX)) != 0 ||
+            memcmp(&_projectionMatrix, &_uploadedProjectionMatrix, sizeof(XMMATRIX)) != 0)
+        {
+            journal.Record(ChangeType::Camera);
+        }
+
+        if (journal.Empty())
+        {
+            return;
+        }
+
+        float interpolationFactor = _simulationClock.GetInterpolationFactor();
+        bool cameraChanged = journal.HasChanges(ChangeType::Camera);
+        bool hierarchyChanged = journal.HasChanges(ChangeType::Hierarchy);
+
+        for (const Change& change : journal.GetChanges())
+        {
+            switch (change.Type)
+            {
+            case ChangeType::Transform:
+            {
+                Transform& transform = change.Object->Transform;
+                if (!transform.Dirty)
+                {
+                    break;
+                }
+
+                // Changed outside of a simulation step, the object jumps to its
+                // new state instead of being blended towards it
+                if (transform.Moved)
+                {
+                    transform.Moved = false;
+                    transform.SavePreviousState();
+                }
+
+                transform.UpdateModelMatrix(interpolationFactor);
+                transform.Dirty = false;
+                _UpdateInstances(*change.Object);
+                break;
+            }
+            case ChangeType::Material:
+            {
+                D3D12RenderCommandList renderCommandList(_dxContext.Device.Get(), commandList, CommandListType::Direct);
+                static_cast<MeshRenderer*>(change.Component)->UpdateMaterials(renderCommandList, _stateTracker, *_materialUploadRing, *_geometryPool);
+                _resetTemporalHistory = true;
+                break;
+            }
+            case ChangeType::Hierarchy:
+                // Objects added after the acceleration structures were built have no
+                // instances yet, only their own transforms are brought up to date.
+                // Their bottom-level structures are not built either, instances are
+                // only added and removed by --check-instance-updates so far.
+                _InitializeTransforms(*change.Object);
+                break;
+            case ChangeType::Settings:
+                _uploadedSettings = UserSettings;
+                _resetTemporalHistory = true;
+                break;
+            case ChangeType::Camera:
+                break;
+            }
+        }
+
+        if (cameraChanged)
+        {
+            _uploadedViewMatrix = _viewMatrix;
+            _uploadedProjectionMatrix = _projectionMatrix;
+
+            _inverseProjectionMatrix = XMMatrixInverse(nullptr, _projectionMatrix);
+            _inverseViewMatrix = XMMatrixInverse(nullptr, _viewMatrix);
+        }
+
+        // Added mesh renderers take more constants and draws than the regions hold
+        if (hierarchyChanged)
+        {
+            _GrowFrameUploadBuffer();
+        }
+
+        journal.Clear();
+    }
+
+    void Game::_UploadFrameConstants()
+    {
+        // Written every frame, the copy may be several changes behind since the
+        // frame that last used it
+        FrameResources& frame = _frames[_framesInFlight.GetFrameIndex()];
+        memcpy(frame.InverseProjectionConstants.CpuAddress, &_inverseProjectionMatrix, sizeof(XMMATRIX));
+        memcpy(frame.InverseViewConstants.CpuAddress, &_inverseViewMatrix, sizeof(XMMATRIX));
+        memcpy(frame.SettingsConstants.CpuAddress, &_uploadedSettings, sizeof(Settings));
+    }
+
+    uint64_t Game::_GetFrameUploadSize()
+    {
+        // One MVP matrix per mesh renderer and one indirect draw per mesh
+        size_t meshRendererCount = 0;
+        size_t drawCount = 0;
+        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([&](MeshRenderer& meshRenderer, size_t index)
+        {
+            ++meshRendererCount;
+            drawCount += meshRenderer.Meshes.size();
+            return false;
+        });
+
+        const uint64_t alignment = LinearUploadBuffer::ConstantBufferAlignment;
+        return meshRendererCount * ROUND_UP(sizeof(XMMATRIX), alignment) +
+            ROUND_UP(std::max<size_t>(drawCount, 1) * sizeof(IndirectDraw), alignment);
+    }
+
+    void Game::_GrowFrameUploadBuffer()
+    {
+        uint64_t frameSize = _GetFrameUploadSize();
+        if (frameSize <= _frameUploadBuffer->GetFrameSize())
+        {
+            return;
+        }
+
+        // Doubled so that objects added one by one do not replace it every frame.
+        // The frames in flight still read their draws from the old one.
+        frameSize = std::max(frameSize, 2 * _frameUploadBuffer->GetFrameSize());
+        _framesInFlight.DeferRelease(std::shared_ptr<LinearUploadBuffer>(std::move(_frameUploadBuffer)));
+        _frameUploadBuffer = std::make_unique<LinearUploadBuffer>(*_dxContext.RenderDevice,
+            frameSize, _framesInFlight.GetFrameCount());
+    }
+
+    void Game::_UpdateInstances(GameObject& gameObject)
+    {
+        // Flag the acceleration structure instances of the object so that only
+        // their descriptors are rewritten on the next top-level AS update
+        for (const std::shared_ptr<Component>& component : gameObject.Components)
+        {
+            const MeshRenderer* meshRenderer = dynamic_cast<const MeshRenderer*>(component.get());
+            if (meshRenderer == nullptr)
+            {
+                continue;
+            }
+
+            for (size_t i = 0; i < meshRenderer->BottomLevelASBuffers.size(); ++i)
+            {
+                uint32_t instance = meshRenderer->FirstInstanceIndex + static_cast<uint32_t>(i);
+                TopLevelASGenerator.SetInstanceTransform(instance, gameObject.Transform.ModelMatrix);
+                _instanceMatrices[instance] = gameObject.Transform.ModelMatrix;
+                if (!_instanceMoved[instance])
+                {
+                    _instanceMoved[instance] = true;
+                    _movedInstances.push_back(instance);
+                }
+            }
+        }
+    }
+
+    TemporalAccumulator::Frame Game::_CreateTemporalFrame()
+    {
+        TemporalAccumulator::Frame frame;
+        XMStoreFloat4x4(&frame.InverseView, XMMatrixInverse(nullptr, _uploadedViewMatrix));
+        XMStoreFloat4x4(&frame.InverseProjection, XMMatrixInverse(nullptr, _uploadedProjectionMatrix));
+        XMStoreFloat4x4(&frame.ViewProjection, XMMatrixMultiply(_uploadedViewMatrix, _uploadedProjectionMatrix));
+
+        // Undo this frame's transform, then apply the one of the last frame
+        // accumulated, which the history holds, for the instances moved since
+        for (uint32_t instance : _movedInstances)
+        {
+            const XMMATRIX& current = _instanceMatrices[instance];
+            XMMATRIX& previous = _previousInstanceMatrices[instance];
+            if (memcmp(&current, &previous, sizeof(XMMATRIX)) != 0)
+            {
+                TemporalAccumulator::InstanceMotion& motion = frame.MovedInstances.emplace_back();
+                motion.Instance = instance;
+                XMStoreFloat4x4(&motion.Motion, XMMatrixMultiply(XMMatrixInverse(nullptr, current), previous));
+                previous = current;
+            }
+            _instanceMoved[instance] = false;
+        }
+        _movedInstances.clear();
+
+        frame.ResetHistory = _resetTemporalHistory;
+        _resetTemporalHistory = false;
+        return frame;
+    }
+
+    std::vector<ComPtr<ID3D12GraphicsCommandList4>> Game::_RecordRasterDraws(
+        D3D12_CPU_DESCRIPTOR_HANDLE rtv,
+        D3D12_CPU_DESCRIPTOR_HANDLE dsv)
+    {
+        _meshRenderers.clear();
+        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this](MeshRenderer& meshRenderer, size_t index)
+        {
+            _meshRenderers.push_back(&meshRenderer);
+            return false;
+        });
+
+        // Constants of every draw are packed in this frame's upload region up
+        // front, the upload buffer being written by one thread only
+        XMMATRIX viewProjectionMatrix = XMMatrixMultiply(_viewMatrix, _projectionMatrix);
+        _drawConstants.resize(_meshRenderers.size());
+        _firstDraws.resize(_meshRenderers.size() + 1);
+        size_t drawCount = 0;
+        for (size_t i = 0; i < _meshRenderers.size(); ++i)
+        {
+            XMMATRIX mvpMatrix = XMMatrixMultiply(_meshRenderers[i]->Parent->Transform.ModelMatrix, viewProjectionMatrix);
+            _drawConstants[i] = _frameUploadBuffer->Upload(mvpMatrix);
+            _firstDraws[i] = drawCount;
+            drawCount += _meshRenderers[i]->Meshes.size();
+        }
+        _firstDraws[_meshRenderers.size()] = drawCount;
+
+        // One indirect draw per mesh, the arguments written by the thread
+        // recording them into its own part of the allocation
+        LinearUploadBuffer::Allocation drawArguments = _frameUploadBuffer->Allocate(std::max<size_t>(drawCount, 1) * sizeof(IndirectDraw));
+        IndirectDraw* draws = static_cast<IndirectDraw*>(drawArguments.CpuAddress);
+        ID3D12Resource* argumentBuffer = GetD3D12Resource(&_frameUploadBuffer->GetResource());
+        uint64_t argumentOffset = drawArguments.GpuAddress - argumentBuffer->GetGPUVirtualAddress();
+
+        // Each command list is recorded by one thread, from its own allocators, and
+        // sets up all the state its draws need. The meshes all live in the geometry
+        // pool, so the buffers are bound once and a single indirect call draws them.
+        CommandQueue& directCommandQueue = *_dxContext.DirectCommandQueue;
+        size_t commandListCount = (_meshRenderers.size() + MeshRenderersPerCommandList - 1) / MeshRenderersPerCommandList;
+        std::vector<ComPtr<ID3D12GraphicsCommandList4>> commandLists(commandListCount);
+        _recordingThreadPool.ParallelFor(commandListCount, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t listIndex = begin; listIndex < end; ++listIndex)
+            {
+                size_t first = listIndex * MeshRenderersPerCommandList;
+                size_t last = std::min((listIndex + 1) * MeshRenderersPerCommandList, _meshRenderers.size());
+                for (size_t rendererIndex = first; rendererIndex < last; ++rendererIndex)
+                {
+                    const MeshRenderer& meshRenderer = *_meshRenderers[rendererIndex];
+                    for (uint32_t i = 0; i < meshRenderer.Meshes.size(); ++i)
+                    {
+                        const GeometryRange& geometry = _geometryPool->GetGeometry(meshRenderer.FirstGeometryIndex + i);
+                        IndirectDraw draw;
+                        draw.Constants = _drawConstants[rendererIndex];
+                        draw.Arguments.IndexCountPerInstance = geometry.IndexCount;
+                        draw.Arguments.InstanceCount = 1;
+                        draw.Arguments.StartIndexLocation = geometry.FirstIndex;
+                        draw.Arguments.BaseVertexLocation = static_cast<INT>(geometry.FirstVertex);
+                        draw.Arguments.StartInstanceLocation = 0;
+                        draws[_firstDraws[rendererIndex] + i] = draw;
+                    }
+                }
+
+                ComPtr<ID3D12GraphicsCommandList4> commandList = directCommandQueue.GetCommandList(_pipelineState.Get());
+                commandList->SetGraphicsRootSignature(_rootSignature.Get());
+                commandList->RSSetViewports(1, &_viewport);
+                commandList->RSSetScissorRects(1, &_scissorRect);
+                commandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+                commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+                commandList->IASetVertexBuffers(0, 1, &_geometryPool->GetVertexBufferView());
+                commandList->IASetIndexBuffer(&_geometryPool->GetIndexBufferView());
+
+                UINT listDrawCount = static_cast<UINT>(_firstDraws[last] - _firstDraws[first]);
+                if (listDrawCount != 0)
+                {
+                    commandList->ExecuteIndirect(_drawCommandSignature.Get(), listDrawCount,
+                        argumentBuffer, argumentOffset + _firstDraws[first] * sizeof(IndirectDraw), nullptr, 0);
+                }
+
+                commandLists[listIndex] = std::move(commandList);
+            }
+        });
+
+        return commandLists;
+    }
+
+    void Game::_RecordDispatchRays(ID3D12GraphicsCommandList4* commandList)
+    {
+        // Setup raytracing task
+        ID3D12Resource* sbtStorage = _frames[_framesInFlight.GetFrameIndex()].ShaderBindingTable.Get();
+        D3D12_DISPATCH_RAYS_DESC desc = {};
+        desc.RayGenerationShaderRecord.StartAddress = sbtStorage->GetGPUVirtualAddress();
+        desc.RayGenerationShaderRecord.SizeInBytes = m_sbtHelper.GetRayGenSectionSize();
+        
+        // Required to be 64 bit aligned
+        desc.MissShaderTable.StartAddress = ROUND_UP(sbtStorage->GetGPUVirtualAddress(), D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT) +
+            ROUND_UP(m_sbtHelper.GetRayGenSectionSize(), D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+        desc.MissShaderTable.SizeInBytes = m_sbtHelper.GetMissSectionSize();
+        desc.MissShaderTable.StrideInBytes = m_sbtHelper.GetMissEntrySize();
+
+        // Required to be 64 bit aligned
+        desc.HitGroupTable.StartAddress = sbtStorage->GetGPUVirtualAddress() +
+            ROUND_UP(m_sbtHelper.GetRayGenSectionSize(), D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT) +
+            ROUND_UP(m_sbtHelper.GetMissSectionSize(), D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+        desc.HitGroupTable.SizeInBytes = m_sbtHelper.GetHitGroupSectionSize();
+        desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
+       
+        desc.Width = static_cast<UINT>(_viewport.Width);
+        desc.Height = static_cast<UINT>(_viewport.Height);
+        desc.Depth = 1;
+        commandList->SetPipelineState1(m_rtStateObject.Get());
+        commandList->DispatchRays(&desc);
+    }
+
+    double Game::_TraceImage()
+    {
+        CommandQueue& directCommandQueue = *_dxContext.DirectCommandQueue;
+        auto commandList = directCommandQueue.GetCommandList(_pipelineState.Get());
+        _descriptorAllocator->BeginFrame(_framesInFlight.BeginFrame());
+        _ProcessChanges(commandList.Get());
+        _UploadFrameConstants();
+
+        std::vector<ID3D12DescriptorHeap*> heaps = { _GetDescriptorHeap() };
+        commandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()), heaps.data());
+        CreateTopLevelAS(commandList.Get(), true);
+
+        _stateTracker.Transition(*_outputImage, ResourceState::UnorderedAccess);
+        _stateTracker.Transition(*_albedoImage, ResourceState::UnorderedAccess);
+        _stateTracker.Transition(*_normalImage, ResourceState::UnorderedAccess);
+        _stateTracker.Transition(*_instanceImage, ResourceState::UnorderedAccess);
+        _stateTracker.Transition(*_distanceImage, ResourceState::UnorderedAccess);
+        _FlushBarriers(commandList);
+        _RecordDispatchRays(commandList.Get());
+
+        auto start = std::chrono::high_resolution_clock::now();
+        _fenceValue = _ExecuteCommandLists({ commandList });
+        _framesInFlight.EndFrame(_fenceValue);
+        _materialUploadRing->Retire(_fenceValue);
+        directCommandQueue.WaitForFenceValue(_fenceValue);
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    void Game::_RunQualitySweep()
+    {
+        if (!_dxContext.IsRaytracingEnabled())
+        {
+            throw std::runtime_error("The quality sweep needs ray tracing");
+        }
+
+        // Nothing may be denoising while the sweep uses the denoiser
+        _denoisePipeline->Flush();
+
+        CommandQueue& directCommandQueue = *_dxContext.DirectCommandQueue;
+        size_t width = static_cast<size_t>(_viewport.Width);
+        size_t height = static_cast<size_t>(_viewport.Height);
+
+        // The radiance and its features are read back one after the other into
+        // one buffer, with rows padded to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+        ID3D12Resource* images[3] = { m_outputResource.Get(), _albedoResource.Get(), _normalResource.Get() };
+        D3D12_RESOURCE_DESC imageDesc = m_outputResource->GetDesc();
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[3];
+        uint64_t imageSize;
+        _dxContext.Device->GetCopyableFootprints(&imageDesc, 0, 1, 0, &footprints[0], nullptr, nullptr, &imageSize);
+        for (int i = 1; i < 3; ++i)
+        {
+            footprints[i] = footprints[0];
+            footprints[i].Offset = i * ROUND_UP(imageSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        }
+
+        CD3DX12_HEAP_PROPERTIES readbackHeapProps(D3D12_HEAP_TYPE_READBACK);
+        ComPtr<ID3D12Resource> readbackBuffer = CreateBuffer(_dxContext.Device.Get(),
+            footprints[2].Offset + imageSize,
+            D3D12_RESOURCE_FLAG_NONE,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            readbackHeapProps);
+
+        Settings userSettings = UserSettings;
+        QualitySweepTraceFunction trace = [&](int32_t samples, int32_t seed)
+        {
+            UserSettings.Samples = samples;
+            UserSettings.Seed = seed;
+
+            QualitySweepImage image;
+            image.TraceMilliseconds = _TraceImage();
+
+            auto commandList = directCommandQueue.GetCommandList();
+            for (RenderResource* image : { _outputImage.get(), _albedoImage.get(), _normalImage.get() })
+            {
+                _stateTracker.Transition(*image, ResourceState::CopySource);
+            }
+            _FlushBarriers(commandList);
+            for (int i = 0; i < 3; ++i)
+            {
+                CD3DX12_TEXTURE_COPY_LOCATION location(images[i], 0);
+                CD3DX12_TEXTURE_COPY_LOCATION readbackLocation(readbackBuffer.Get(), footprints[i]);
+                commandList->CopyTextureRegion(&readbackLocation, 0, 0, 0, &location, nullptr);
+            }
+            _fenceValue = _ExecuteCommandLists({ commandList });
+            directCommandQueue.WaitForFenceValue(_fenceValue);
+
+            // Converted to RGBA floats, whatever the radiance format
+            uint8_t* data;
+            ThrowIfFailed(readbackBuffer->Map(0, nullptr, reinterpret_cast<void**>(&data)));
+            std::vector<float>* planes[3] = { &image.Radiance, &image.Albedo, &image.Normal };
+            for (int i = 0; i < 3; ++i)
+            {
+                planes[i]->resize(width * height * 4);
+                for (size_t y = 0; y < height; ++y)
+                {
+                    const uint8_t* row = data + footprints[i].Offset + y * footprints[i].Footprint.RowPitch;
+                    float* destination = planes[i]->data() + y * width * 4;
+                    if (_radianceFormat == DXGI_FORMAT_R32G32B32A32_FLOAT)
+                    {
+                        memcpy(destination, row, width * 4 * sizeof(float));
+                    }
+                    else
+                    {
+                        PixelConversion::Rgba16fToRgba32f(reinterpret_cast<const uint16_t*>(row), destination, width);
+                    }
+                }
+            }
+            CD3DX12_RANGE writtenRange(0, 0);
+            readbackBuffer->Unmap(0, &writtenRange);
+            return image;
+        };
+
+        QualitySweepSettings settings;
+        settings.ReferenceSamples = static_cast<int32_t>(_options.QualitySweepReferenceSamples);
+        settings.MaxSamples = static_cast<int32_t>(_options.QualitySweepMaxSamples);
+        settings.Tonemap = Tonemap;
+        settings.Parameters = {
+            { "bounces", static_cast<double>(userSettings.Bounces) },
+            { "light_intensity", userSettings.LightIntensity },
+            { "importance_sampling", userSettings.ImportanceSamplingEnabled ? 1.0 : 0.0 },
+            { "importance_sampling_percentage", userSettings.ImportanceSamplingPercentage } };
+
+        RunQualitySweep(_options.QualitySweepPath, width, height, settings, trace, *_denoiser, _threadPool);
+        UserSettings = userSettings;
     }
 
     void Game::_CreateBuffers()
     {
         auto device = _dxContext.Device;
         CommandQueue& copyCommandQueue = *_dxContext.CopyCommandQueue;
-        auto commandList = copyCommandQueue.GetCommandList();
 
-        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this, &commandList](MeshRenderer& meshRenderer, size_t index)
+        // Every mesh is packed in the geometry pool, uploaded in one copy per buffer
+        _geometryPool = std::make_unique<GeometryPool>(static_cast<uint32_t>(sizeof(MeshRenderer::VertexPosColor)));
+        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this](MeshRenderer& meshRenderer, size_t index)
             {
-                meshRenderer.CreateBuffers(_dxContext, commandList.Get());
+                meshRenderer.AddGeometries(*_geometryPool);
                 return false;
             });
+        _geometryPool->Create(_dxContext);
 
         // Depth dencil buffer
         {
@@ -456,33 +1056,44 @@ namespace DXRDemo
             ));
         }
 
-        // Clear color in upload heap
+        // Constants referenced by the shader binding tables, one copy per frame in
+        // flight packed in one buffer. The regions are allocated once and never reset.
         {
-            Game::CreateBuffer(sizeof(_clearColor), &_clearColorBuffer);
-            CopyDataToBuffer(_clearColorBuffer, _clearColor, sizeof(_clearColor));
+            const uint64_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+            uint32_t frameCount = _framesInFlight.GetFrameCount();
+            _constantUploadBuffer = std::make_unique<LinearUploadBuffer>(*_dxContext.RenderDevice,
+                ROUND_UP(sizeof(_clearColor), alignment) +
+                2 * ROUND_UP(sizeof(XMMATRIX), alignment) +
+                ROUND_UP(sizeof(Settings), alignment),
+                frameCount);
+
+            _frames.resize(frameCount);
+            for (uint32_t i = 0; i < frameCount; ++i)
+            {
+                FrameResources& frame = _frames[i];
+                _constantUploadBuffer->BeginFrame(i);
+                frame.ClearColorConstants = _constantUploadBuffer->Allocate(sizeof(_clearColor));
+                frame.InverseProjectionConstants = _constantUploadBuffer->Allocate(sizeof(XMMATRIX));
+                frame.InverseViewConstants = _constantUploadBuffer->Allocate(sizeof(XMMATRIX));
+                frame.SettingsConstants = _constantUploadBuffer->Allocate(sizeof(Settings));
+
+                memcpy(frame.ClearColorConstants.CpuAddress, _clearColor, sizeof(_clearColor));
+            }
         }
-        
-        Scene.RootSceneObject->ForEachChild([this](GameObject& gameObject, std::size_t i)
-        {
-            CreateBuffer(sizeof(DirectX::XMMATRIX), &gameObject.Transform.MvpBuffer);
-            return false;
-        });
-        Game::CreateBuffer(sizeof(DirectX::XMMATRIX), &_inverseProjectBuffer);
-        Game::CreateBuffer(sizeof(DirectX::XMMATRIX), &_inverseViewBuffer);
-        Game::CreateBuffer(sizeof(Settings), &_settingsViewBuffer);
-        
-        auto fenceValue = copyCommandQueue.ExecuteCommandList(commandList);
-        copyCommandQueue.WaitForFenceValue(fenceValue);
+
+        // Per-frame constants and indirect draws of the rasterizer
+        _frameUploadBuffer = std::make_unique<LinearUploadBuffer>(*_dxContext.RenderDevice,
+            _GetFrameUploadSize(), _framesInFlight.GetFrameCount());
+
+        // Material edits, copied on the direct queue along with the frame
+        _materialUploadRing = std::make_unique<UploadRingBuffer>(device.Get(),
+            *_dxContext.DirectCommandQueue, MaterialUploadRingSize);
+
+        copyCommandQueue.WaitForFenceValue(_dxContext.CopyUploadRing->Flush());
     }
 
     void Game::_CreateBufferViews()
     {
-        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this](MeshRenderer& meshRenderer, size_t index)
-            {
-                meshRenderer.CreateBufferViews(_dxContext);
-                return false;
-            });
-
         // Depth stencil view
         {
             D3D12_DEPTH_STENCIL_VIEW_DESC dsv = {};
@@ -500,8 +1111,21 @@ namespace DXRDemo
 
     void Game::_CreateDescriptorHeaps()
     {
-        m_srvUavHeap = _dxContext.CreateDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 2, true);
-        m_guiHeap = _dxContext.CreateDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1, true);
+        // One shader visible heap for every view the frames and the GUI bind, their
+        // slots handed out instead of fixed
+        _descriptorAllocator = std::make_unique<DescriptorAllocator>(PersistentDescriptorCount,
+            TransientDescriptorsPerFrame, _framesInFlight.GetFrameCount());
+        _descriptorHeap = _dxContext.RenderDevice->CreateDescriptorHeap(DescriptorHeapType::CbvSrvUav,
+            _descriptorAllocator->GetCount(), true);
+
+        // Read by the root signatures, which take the slots as offsets from the heap start
+        _outputUavIndex = _descriptorAllocator->Allocate();
+        _topLevelASIndex = _descriptorAllocator->Allocate();
+        _outputSrvIndex = _descriptorAllocator->Allocate();
+        // Albedo, normal, instance then distance, bound as one range
+        _featureUavIndex = _descriptorAllocator->Allocate(4);
+        _guiFontIndex = _descriptorAllocator->Allocate();
+
         _dsvHeap = _dxContext.CreateDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1, false);
     }
 
@@ -538,6 +1162,20 @@ namespace DXRDemo
         // Create the root signature.
         ThrowIfFailed(_dxContext.Device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
             rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&_rootSignature)));
+
+        // Indirect draws set the constants of their renderer, then draw a range of
+        // the geometry pool
+        D3D12_INDIRECT_ARGUMENT_DESC drawArguments[2] = {};
+        drawArguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
+        drawArguments[0].ConstantBufferView.RootParameterIndex = 0;
+        drawArguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+        D3D12_COMMAND_SIGNATURE_DESC commandSignatureDescription = {};
+        commandSignatureDescription.ByteStride = sizeof(IndirectDraw);
+        commandSignatureDescription.NumArgumentDescs = _countof(drawArguments);
+        commandSignatureDescription.pArgumentDescs = drawArguments;
+        ThrowIfFailed(_dxContext.Device->CreateCommandSignature(&commandSignatureDescription,
+            _rootSignature.Get(), IID_PPV_ARGS(&_drawCommandSignature)));
     }
 
     void Game::_CreateRasterizationPipeline()
@@ -579,6 +1217,69 @@ namespace DXRDemo
         ThrowIfFailed(_dxContext.Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&_pipelineState)));
     }
 
+    void Game::_CreateTonemapRootSignature()
+    {
+        D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+        if (FAILED(_dxContext.Device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+        {
+            featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+        }
+
+        // Only the pixel shader reads anything, the vertices come from SV_VertexID
+        D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
+            D3D12_ROOT_SIGNATURE_FLAG_DENY_VERTEX_SHADER_ROOT_ACCESS |
+            D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+            D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+            D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+
+        // Tonemap settings and the radiance texture
+        CD3DX12_DESCRIPTOR_RANGE1 radianceRange;
+        radianceRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE);
+
+        CD3DX12_ROOT_PARAMETER1 rootParameters[2];
+        rootParameters[0].InitAsConstants(sizeof(TonemapSettings) / 4, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[1].InitAsDescriptorTable(1, &radianceRange, D3D12_SHADER_VISIBILITY_PIXEL);
+
+        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+        rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, rootSignatureFlags);
+
+        ComPtr<ID3DBlob> rootSignatureBlob;
+        ComPtr<ID3DBlob> errorBlob;
+        ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDescription,
+            featureData.HighestVersion, &rootSignatureBlob, &errorBlob));
+        ThrowIfFailed(_dxContext.Device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
+            rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&_tonemapRootSignature)));
+    }
+
+    void Game::_CreateTonemapPipeline()
+    {
+        ComPtr<ID3DBlob> vertexShaderBlob;
+        ThrowIfFailed(D3DReadFileToBlob(L"..//x64//Debug//TonemapVertexShader.cso", &vertexShaderBlob));
+
+        ComPtr<ID3DBlob> pixelShaderBlob;
+        ThrowIfFailed(D3DReadFileToBlob(L"..//x64//Debug//TonemapPixelShader.cso", &pixelShaderBlob));
+
+        // Full screen triangle without input layout or depth
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.pRootSignature = _tonemapRootSignature.Get();
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShaderBlob.Get());
+        psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShaderBlob.Get());
+        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+        psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+        psoDesc.DepthStencilState.DepthEnable = FALSE;
+        psoDesc.DepthStencilState.StencilEnable = FALSE;
+        psoDesc.SampleMask = UINT_MAX;
+        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        psoDesc.NumRenderTargets = 1;
+        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        psoDesc.SampleDesc.Count = 1;
+        psoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
+
+        ThrowIfFailed(_dxContext.Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&_tonemapPipelineState)));
+    }
+
     void Game::_InitializeGUI()
     {
         // Setup Dear ImGui context
@@ -590,24 +1291,36 @@ namespace DXRDemo
 
         // Setup Platform/Renderer backends
         ImGui_ImplWin32_Init(_window->GetHWND());
-        ImGui_ImplDX12_Init(_dxContext.Device.Get(), _dxContext.GetNumberBuffers(), DXGI_FORMAT_R8G8B8A8_UNORM,
-            m_guiHeap.Get(),
+        // Its vertex and index buffers are reused that many frames later
+        UINT guiFrameCount = std::max(_dxContext.GetNumberBuffers(), _framesInFlight.GetFrameCount());
+        ImGui_ImplDX12_Init(_dxContext.Device.Get(), guiFrameCount, DXGI_FORMAT_R8G8B8A8_UNORM,
+            _GetDescriptorHeap(),
             // You'll need to designate a descriptor from your descriptor heap for Dear ImGui to use internally for its font texture's SRV
-            m_guiHeap->GetCPUDescriptorHandleForHeapStart(),
-            m_guiHeap->GetGPUDescriptorHandleForHeapStart());
+            D3D12_CPU_DESCRIPTOR_HANDLE{ static_cast<SIZE_T>(_descriptorHeap->GetHandle(_guiFontIndex).Cpu) },
+            D3D12_GPU_DESCRIPTOR_HANDLE{ _descriptorHeap->GetHandle(_guiFontIndex).Gpu });
     }
 
-    // Transition a resource
-    void Game::_TransitionResource(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList,
-        Microsoft::WRL::ComPtr<ID3D12Resource> resource,
-        D3D12_RESOURCE_STATES beforeState,
-        D3D12_RESOURCE_STATES afterState)
+    void Game::_FlushBarriers(const ComPtr<ID3D12GraphicsCommandList4>& commandList)
     {
-        CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-            resource.Get(),
-            beforeState, afterState);
+        D3D12RenderCommandList renderCommandList(_dxContext.Device.Get(), commandList, CommandListType::Direct);
+        _stateTracker.FlushBarriers(renderCommandList);
+    }
 
-        commandList->ResourceBarrier(1, &barrier);
+    uint64_t Game::_ExecuteCommandLists(std::vector<ComPtr<ID3D12GraphicsCommandList4>> commandLists)
+    {
+        CommandQueue& directCommandQueue = *_dxContext.DirectCommandQueue;
+        D3D12RenderCommandList lastCommandList(_dxContext.Device.Get(), commandLists.back(), CommandListType::Direct);
+        _stateTracker.Close(lastCommandList);
+
+        std::vector<ResourceBarrier> barriers;
+        _stateTracker.ResolveBarriers(barriers);
+        if (!barriers.empty())
+        {
+            ComPtr<ID3D12GraphicsCommandList4> barrierCommandList = directCommandQueue.GetCommandList();
+            D3D12RenderCommandList(_dxContext.Device.Get(), barrierCommandList, CommandListType::Direct).Barriers(barriers);
+            commandLists.insert(commandLists.begin(), barrierCommandList);
+        }
+        return directCommandQueue.ExecuteCommandLists(commandLists);
     }
 
     void Game::_ClearRTV(
@@ -628,16 +1341,30 @@ namespace DXRDemo
 
     void Game::CreateTopLevelAS(
         ID3D12GraphicsCommandList4* commandList,
-        const std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>& instances,
         bool updateOnly)
     {
-        if (!updateOnly)
+        bool refit = false;
+        if (updateOnly)
         {
-            // Gather all the instances into the builder helper
-            for (size_t i = 0; i < instances.size(); i++)
+            const InstanceUpdateTracker& updates = TopLevelASGenerator.GetInstanceUpdates();
+            TopLevelASUpdate update = updates.GetUpdate(TopLevelASRefitMaxDirtyFraction);
+
+            // Nothing moved, the acceleration structure built last time is still valid
+            if (update == TopLevelASUpdate::None)
             {
-                TopLevelASGenerator.AddInstance(instances[i].first.Get(), instances[i].second, static_cast<uint32_t>(i), static_cast<uint32_t>(i));
+                return;
             }
+
+            // Refitting keeps the hierarchy of the previous build and only grows its
+            // bounding boxes, which degrades traversal once many instances moved. In
+            // that case rebuild in place instead, the buffers are large enough either
+            // way, unless instances were added or removed.
+            refit = update == TopLevelASUpdate::Refit;
+            updateOnly = !updates.HasCountChanged();
+        }
+
+        if (!updateOnly)
+        {
             // As for the bottom-level AS, the building the AS requires some scratch space
             // to store temporary data in addition to the actual AS. In the case of the
             // top-level AS, the instance descriptors also need to be stored in GPU
@@ -647,15 +1374,35 @@ namespace DXRDemo
             UINT64 scratchSize, resultSize, instanceDescsSize;
             TopLevelASGenerator.ComputeASBufferSizes(_dxContext.Device.Get(), true, &scratchSize, &resultSize, &instanceDescsSize);
 
+            if (TopLevelASBuffers.pResult)
+            {
+                // The view of the structure is rewritten in place below, its slot
+                // baked into the root signatures, which frames in flight must be
+                // done reading first. Instances are only added or removed on rare
+                // occasions, waiting for them then is cheaper than versioning it.
+                _framesInFlight.WaitForIdle();
+                _framesInFlight.DeferRelease(std::move(TopLevelASBuffers));
+                for (FrameResources& frame : _frames)
+                {
+                    _framesInFlight.DeferRelease(std::move(frame.InstanceDescs));
+                }
+            }
+
             // Create the scratch and result buffers. Since the build is all done on GPU,
             // those can be allocated on the default heap
-            TopLevelASBuffers.pScratch = nv_helpers_dx12::CreateBuffer(_dxContext.Device.Get(), scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nv_helpers_dx12::kDefaultHeapProps);
-            TopLevelASBuffers.pResult = nv_helpers_dx12::CreateBuffer(_dxContext.Device.Get(), resultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE, nv_helpers_dx12::kDefaultHeapProps);
+            TopLevelASBuffers.pScratch = _dxContext.BufferHeaps->CreateBuffer(scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+            TopLevelASBuffers.pResult = _dxContext.BufferHeaps->CreateBuffer(resultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
 
-            // The buffer describing the instances: ID, shader binding information,
+            // The buffers describing the instances: ID, shader binding information,
             // matrices ... Those will be copied into the buffer by the helper through
-            // mapping, so the buffer has to be allocated on the upload heap.
-            TopLevelASBuffers.pInstanceDesc = nv_helpers_dx12::CreateBuffer(_dxContext.Device.Get(), instanceDescsSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+            // mapping, so the buffers have to be allocated on the upload heap. Each
+            // frame in flight builds from its own copy.
+            for (FrameResources& frame : _frames)
+            {
+                frame.InstanceDescs = nv_helpers_dx12::CreateBuffer(_dxContext.Device.Get(), instanceDescsSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+            }
+
+            _CreateTopLevelASView();
         }
 
         // After all the buffers are allocated, or if only an update is required, we
@@ -666,8 +1413,8 @@ namespace DXRDemo
             commandList,
             TopLevelASBuffers.pScratch.Get(),
             TopLevelASBuffers.pResult.Get(),
-            TopLevelASBuffers.pInstanceDesc.Get(),
-            updateOnly,
+            _frames[_framesInFlight.GetFrameIndex()].InstanceDescs.Get(),
+            refit,
             TopLevelASBuffers.pResult.Get());
     }
 
@@ -675,31 +1422,60 @@ namespace DXRDemo
     void Game::CreateAccelerationStructures()
     {
         CommandQueue& directCommandQueue = *_dxContext.DirectCommandQueue;
-        auto directCommandList = directCommandQueue.GetCommandList(_pipelineState.Get());
-
 
-        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this, &directCommandList](MeshRenderer& meshRenderer, size_t index)
+        std::vector<MeshRenderer*> meshRenderers;
+        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([&meshRenderers](MeshRenderer& meshRenderer, size_t index)
         {
-            meshRenderer.CreateBottomLevelAS(_dxContext, directCommandList.Get());
+            meshRenderers.push_back(&meshRenderer);
             return false;
         });
 
+        // The bottom-level structures are independent, the recording threads build
+        // them into command lists of their own. Each build ends with a barrier on
+        // its result, so the top-level build submitted after them sees them all.
+        size_t commandListCount = (meshRenderers.size() + BottomLevelASPerCommandList - 1) / BottomLevelASPerCommandList;
+        std::vector<ComPtr<ID3D12GraphicsCommandList4>> commandLists(commandListCount);
+        // Released once the builds complete, their ranges of the heaps then reused
+        std::vector<std::vector<ComPtr<ID3D12Resource>>> scratchBuffers(commandListCount);
+        _recordingThreadPool.ParallelFor(commandListCount, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t listIndex = begin; listIndex < end; ++listIndex)
+            {
+                ComPtr<ID3D12GraphicsCommandList4> commandList = directCommandQueue.GetCommandList(_pipelineState.Get());
+                size_t last = std::min((listIndex + 1) * BottomLevelASPerCommandList, meshRenderers.size());
+                for (size_t i = listIndex * BottomLevelASPerCommandList; i < last; ++i)
+                {
+                    meshRenderers[i]->CreateBottomLevelAS(_dxContext, *_geometryPool, commandList.Get(), scratchBuffers[listIndex]);
+                }
+                commandLists[listIndex] = std::move(commandList);
+            }
+        });
 
-        // Buid instances
-        ASInstances.clear();
-        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this](MeshRenderer& meshRenderer, size_t index)
+        auto directCommandList = directCommandQueue.GetCommandList(_pipelineState.Get());
+
+        // Buid instances. Their ID is the geometry index of their mesh, which the
+        // hit shader looks up in the pool; all share the one hit group record.
+        uint32_t instanceCount = 0;
+        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this, &instanceCount](MeshRenderer& meshRenderer, size_t index)
         {
-            for (auto& bottomLevelBuffer : meshRenderer.BottomLevelASBuffers)
+            meshRenderer.FirstInstanceIndex = instanceCount;
+            for (uint32_t i = 0; i < meshRenderer.BottomLevelASBuffers.size(); ++i)
             {
-                ASInstances.push_back({ bottomLevelBuffer, meshRenderer.Parent->Transform.ModelMatrix }); // TODO: fix model matrices
+                TopLevelASGenerator.AddInstance(meshRenderer.BottomLevelASBuffers[i].Get(), meshRenderer.Parent->Transform.ModelMatrix,
+                    meshRenderer.FirstGeometryIndex + i, 0);
+                _instanceMatrices.push_back(meshRenderer.Parent->Transform.ModelMatrix);
+                ++instanceCount;
             }
             return false;
         });
 
 
-        CreateTopLevelAS(directCommandList.Get(), ASInstances);
+        CreateTopLevelAS(directCommandList.Get());
+        _previousInstanceMatrices = _instanceMatrices;
+        _instanceMoved.assign(_instanceMatrices.size(), false);
         
-        auto fenceValue = directCommandQueue.ExecuteCommandList(directCommandList);
+        commandLists.push_back(directCommandList);
+        auto fenceValue = directCommandQueue.ExecuteCommandLists(commandLists);
         directCommandQueue.WaitForFenceValue(fenceValue);
     }
 
@@ -716,7 +1492,7 @@ namespace DXRDemo
                 1, // Num descriptors
                 0, // Register space
                 D3D12_DESCRIPTOR_RANGE_TYPE_UAV, // Type
-                0  // Heap slot
+                _outputUavIndex  // Heap slot
             },
             // Top-level acceleration structure
             {
@@ -724,7 +1500,15 @@ namespace DXRDemo
                 1, // Num descriptors
                 0, // Register space
                 D3D12_DESCRIPTOR_RANGE_TYPE_SRV, // Type
-                1  // Heap slot
+                _topLevelASIndex  // Heap slot
+            },
+            // Albedo, normal, instance and distance of the first hit
+            {
+                1, // Register number (u1)
+                4, // Num descriptors
+                0, // Register space
+                D3D12_DESCRIPTOR_RANGE_TYPE_UAV, // Type
+                _featureUavIndex  // Heap slot
             }
         });
         return rsc.Generate(_dxContext.Device.Get(), true);
@@ -733,8 +1517,9 @@ namespace DXRDemo
     ComPtr<ID3D12RootSignature> Game::CreateHitSignature()
     {
         nv_helpers_dx12::RootSignatureGenerator rsc;
-        rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0); // Vertices
-        rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 1); // Indices
+        rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0); // Vertices of the geometry pool
+        rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 1); // Indices of the geometry pool
+        rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 3); // Geometry ranges
         rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0); // Settings
         rsc.AddHeapRangesParameter({
             // Top-level acceleration structure
@@ -743,7 +1528,7 @@ namespace DXRDemo
                 1, // Num descriptors
                 0, // Register space
                 D3D12_DESCRIPTOR_RANGE_TYPE_SRV, // Type
-                1  // Heap slot
+                _topLevelASIndex  // Heap slot
             }
         }); 
         return rsc.Generate(_dxContext.Device.Get(), true);
@@ -781,7 +1566,7 @@ namespace DXRDemo
         pipeline.AddRootSignatureAssociation(m_missSignature.Get(), {L"Miss"});
         pipeline.AddRootSignatureAssociation(m_hitSignature.Get(), {L"HitGroup"});
 
-        pipeline.SetMaxPayloadSize(16 * sizeof(float)); // RGB + distance
+        pipeline.SetMaxPayloadSize(16 * sizeof(float)); // RGB + distance + depth + sample + albedo + normal + instance
 
         pipeline.SetMaxAttributeSize(2 * sizeof(float)); // barycentric coordinates
 
@@ -796,7 +1581,7 @@ namespace DXRDemo
         D3D12_RESOURCE_DESC resDesc = {};
         resDesc.DepthOrArraySize = 1;
         resDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-        resDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        resDesc.Format = _radianceFormat;
         resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
         resDesc.Width = static_cast<uint64_t>(_viewport.Width);
         resDesc.Height = static_cast<uint64_t>(_viewport.Height);
@@ -804,9 +1589,7 @@ namespace DXRDemo
         resDesc.MipLevels = 1;
         resDesc.SampleDesc.Count = 1;
 
-        CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
         CD3DX12_HEAP_PROPERTIES defaultHeapProps(D3D12_HEAP_TYPE_DEFAULT);
-        CD3DX12_HEAP_PROPERTIES readbackHeapProps(D3D12_HEAP_TYPE_READBACK);
 
         ThrowIfFailed(_dxContext.Device->CreateCommittedResource(
             &defaultHeapProps,
@@ -816,34 +1599,82 @@ namespace DXRDemo
             nullptr,
             IID_PPV_ARGS(&m_outputResource)));
 
-        D3D12_RESOURCE_DESC resourceDesc = m_outputResource->GetDesc();
-
-        m_outputUploadResource = nv_helpers_dx12::CreateBuffer(_dxContext.Device.Get(),
-            static_cast<uint64_t>(_viewport.Width) * static_cast<uint64_t>(_viewport.Height) * 4,
-            D3D12_RESOURCE_FLAG_NONE,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            uploadHeapProps);
+        // The features are only copied out when denoising, they stay writable otherwise
+        for (ComPtr<ID3D12Resource>* feature : { &_albedoResource, &_normalResource })
+        {
+            ThrowIfFailed(_dxContext.Device->CreateCommittedResource(
+                &defaultHeapProps,
+                D3D12_HEAP_FLAG_NONE,
+                &resDesc,
+                D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                nullptr,
+                IID_PPV_ARGS(feature->ReleaseAndGetAddressOf())));
+        }
 
-        m_outputReadbackResource = nv_helpers_dx12::CreateBuffer(_dxContext.Device.Get(),
-            static_cast<uint64_t>(_viewport.Width) * static_cast<uint64_t>(_viewport.Height) * 4,
-            D3D12_RESOURCE_FLAG_NONE,
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            readbackHeapProps);
+        // Their own 32-bit formats keep instance indices and distances exact
+        auto createSurface = [&](ComPtr<ID3D12Resource>& surface, DXGI_FORMAT format)
+        {
+            D3D12_RESOURCE_DESC surfaceDesc = resDesc;
+            surfaceDesc.Format = format;
+            ThrowIfFailed(_dxContext.Device->CreateCommittedResource(
+                &defaultHeapProps,
+                D3D12_HEAP_FLAG_NONE,
+                &surfaceDesc,
+                D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                nullptr,
+                IID_PPV_ARGS(surface.ReleaseAndGetAddressOf())));
+        };
+        createSurface(_instanceResource, TemporalAccumulator::InstanceFormat);
+        createSurface(_distanceResource, TemporalAccumulator::DistanceFormat);
 
+        D3D12RenderDevice& renderDevice = *_dxContext.RenderDevice;
+        _outputImage = renderDevice.WrapResource(m_outputResource, HeapType::Default, ResourceState::CopySource);
+        _albedoImage = renderDevice.WrapResource(_albedoResource, HeapType::Default, ResourceState::UnorderedAccess);
+        _normalImage = renderDevice.WrapResource(_normalResource, HeapType::Default, ResourceState::UnorderedAccess);
+        _instanceImage = renderDevice.WrapResource(_instanceResource, HeapType::Default, ResourceState::UnorderedAccess);
+        _distanceImage = renderDevice.WrapResource(_distanceResource, HeapType::Default, ResourceState::UnorderedAccess);
 
     }
 
     void Game::CreateShaderResourceHeap()
     {
-        D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = m_srvUavHeap->GetCPUDescriptorHandleForHeapStart();
+        auto cpuHandle = [this](uint32_t index)
+        {
+            return D3D12_CPU_DESCRIPTOR_HANDLE{ static_cast<SIZE_T>(_descriptorHeap->GetHandle(index).Cpu) };
+        };
 
         // Unordered access view (Output image)
         D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
         uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-        _dxContext.Device->CreateUnorderedAccessView(m_outputResource.Get(), nullptr, &uavDesc, srvHandle);
-
-        srvHandle.ptr += _dxContext.Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        _dxContext.Device->CreateUnorderedAccessView(m_outputResource.Get(), nullptr, &uavDesc, cpuHandle(_outputUavIndex));
+
+        // The view of the acceleration structure is written along with it, by
+        // CreateTopLevelAS
+
+        // Shader resource view (Output image, read by the tonemap pass)
+        D3D12_SHADER_RESOURCE_VIEW_DESC outputSrvDesc = {};
+        outputSrvDesc.Format = _radianceFormat;
+        outputSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        outputSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        outputSrvDesc.Texture2D.MipLevels = 1;
+        _dxContext.Device->CreateShaderResourceView(m_outputResource.Get(), &outputSrvDesc, cpuHandle(_outputSrvIndex));
+
+        // Unordered access views (Albedo and normal features)
+        D3D12_UNORDERED_ACCESS_VIEW_DESC featureUavDesc = {};
+        featureUavDesc.Format = _radianceFormat;
+        featureUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+        _dxContext.Device->CreateUnorderedAccessView(_albedoResource.Get(), nullptr, &featureUavDesc, cpuHandle(_featureUavIndex));
+        _dxContext.Device->CreateUnorderedAccessView(_normalResource.Get(), nullptr, &featureUavDesc, cpuHandle(_featureUavIndex + 1));
+
+        // Unordered access views (Instance and distance of the first hit)
+        featureUavDesc.Format = TemporalAccumulator::InstanceFormat;
+        _dxContext.Device->CreateUnorderedAccessView(_instanceResource.Get(), nullptr, &featureUavDesc, cpuHandle(_featureUavIndex + 2));
+        featureUavDesc.Format = TemporalAccumulator::DistanceFormat;
+        _dxContext.Device->CreateUnorderedAccessView(_distanceResource.Get(), nullptr, &featureUavDesc, cpuHandle(_featureUavIndex + 3));
+    }
 
+    void Game::_CreateTopLevelASView()
+    {
         // Shared resource view (Acceleration structure)
         D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
         srvDesc.Format = DXGI_FORMAT_UNKNOWN;
@@ -851,63 +1682,47 @@ namespace DXRDemo
         srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
         srvDesc.RaytracingAccelerationStructure.Location = TopLevelASBuffers.pResult->GetGPUVirtualAddress();
 
-        _dxContext.Device->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
+        D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle{ static_cast<SIZE_T>(_descriptorHeap->GetHandle(_topLevelASIndex).Cpu) };
+        _dxContext.Device->CreateShaderResourceView(nullptr, &srvDesc, cpuHandle);
     }
 
     void Game::CreateShaderBindingTable()
     {
-        m_sbtHelper.Reset();
+        // The tables start at the beginning of the heap, the root signatures giving
+        // each range its slot
+        auto heapPointer = reinterpret_cast<void*>(_descriptorHeap->GetHandle(0).Gpu);
 
-        D3D12_GPU_DESCRIPTOR_HANDLE srvUavHeapHandle = m_srvUavHeap->GetGPUDescriptorHandleForHeapStart();
-        auto heapPointer = reinterpret_cast<void*>(srvUavHeapHandle.ptr);
-        m_sbtHelper.AddRayGenerationProgram(L"RayGen", {
-            reinterpret_cast<void*>(_inverseProjectBuffer->GetGPUVirtualAddress()),
-            reinterpret_cast<void*>(_inverseViewBuffer->GetGPUVirtualAddress()),
-            reinterpret_cast<void*>(_settingsViewBuffer->GetGPUVirtualAddress()),
-            heapPointer
-        });
-        m_sbtHelper.AddMissProgram(L"Miss", { reinterpret_cast<void*>(_clearColorBuffer->GetGPUVirtualAddress()) });
-        
-        Scene.RootSceneObject->ForEachComponent<MeshRenderer>([this, heapPointer](const MeshRenderer& meshRenderer, size_t index)
-            {
-                for (size_t i = 0; i < meshRenderer.Meshes.size(); ++i)
-                {
-                    m_sbtHelper.AddHitGroup(L"HitGroup", {
-                        reinterpret_cast<void*>(meshRenderer.VertexBuffers[i]->GetGPUVirtualAddress()),
-                        reinterpret_cast<void*>(meshRenderer.IndexBuffers[i]->GetGPUVirtualAddress()),
-                        reinterpret_cast<void*>(_settingsViewBuffer->GetGPUVirtualAddress()),
-                        heapPointer
-                    });
-                }
-                return false;
-            });
-
-        const uint32_t sbtSize = m_sbtHelper.ComputeSBTSize();
-        m_sbtStorage = nv_helpers_dx12::CreateBuffer(_dxContext.Device.Get(), sbtSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
-        if (!m_sbtStorage)
+        // One table per frame in flight, each referencing that frame's constants
+        for (FrameResources& frame : _frames)
         {
-            throw std::logic_error("Could not allocate the shader binding table");
-        }
+            m_sbtHelper.Reset();
 
-        m_sbtHelper.Generate(m_sbtStorage.Get(), m_rtStateObjectProps.Get());
-    }
+            m_sbtHelper.AddRayGenerationProgram(L"RayGen", {
+                reinterpret_cast<void*>(frame.InverseProjectionConstants.GpuAddress),
+                reinterpret_cast<void*>(frame.InverseViewConstants.GpuAddress),
+                reinterpret_cast<void*>(frame.SettingsConstants.GpuAddress),
+                heapPointer
+            });
+            m_sbtHelper.AddMissProgram(L"Miss", { reinterpret_cast<void*>(frame.ClearColorConstants.GpuAddress) });
+
+            // A single record for every instance, the hit shader finding their
+            // geometry in the pool from the instance ID
+            m_sbtHelper.AddHitGroup(L"HitGroup", {
+                reinterpret_cast<void*>(_geometryPool->GetVertexBuffer()->GetGPUVirtualAddress()),
+                reinterpret_cast<void*>(_geometryPool->GetIndexBuffer()->GetGPUVirtualAddress()),
+                reinterpret_cast<void*>(_geometryPool->GetGeometryBuffer()->GetGPUVirtualAddress()),
+                reinterpret_cast<void*>(frame.SettingsConstants.GpuAddress),
+                heapPointer
+            });
 
-    void Game::CreateBuffer(size_t bufferSize, ID3D12Resource** buffer)
-    {        
-        *buffer = nv_helpers_dx12::CreateBuffer(
-            _dxContext.Device.Get(),
-            bufferSize,
-            D3D12_RESOURCE_FLAG_NONE,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nv_helpers_dx12::kUploadHeapProps);
-    }
+            const uint32_t sbtSize = m_sbtHelper.ComputeSBTSize();
+            frame.ShaderBindingTable = nv_helpers_dx12::CreateBuffer(_dxContext.Device.Get(), sbtSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, nv_helpers_dx12::kUploadHeapProps);
+            if (!frame.ShaderBindingTable)
+            {
+                throw std::logic_error("Could not allocate the shader binding table");
+            }
 
-    void Game::CopyDataToBuffer(Microsoft::WRL::ComPtr<ID3D12Resource> buffer, void* data, size_t bufferSize)
-    {
-        // Copy CPU memory to GPU
-        uint8_t* pData;
-        ThrowIfFailed(buffer->Map(0, nullptr, (void**)&pData));
-        memcpy(pData, data, bufferSize);
-        buffer->Unmap(0, nullptr);
+            m_sbtHelper.Generate(frame.ShaderBindingTable.Get(), m_rtStateObjectProps.Get());
+        }
     }
 }
\ No newline at end of file
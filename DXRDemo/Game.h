@@ -3,6 +3,7 @@
 #include <directxmath.h>
 #include <combaseapi.h>
 #include <dxcapi.h>
+#include <optional>
 #include "DXContext.h"
 #include "DXRUtils/TopLevelASGenerator.h"
 #include "DXRUtils/ShaderBindingTableGenerator.h"
@@ -11,13 +12,30 @@
 #include <imgui.h>
 #include <imgui_impl_dx12.h>
 #include "Denoiser.h"
+#include "DenoisePipeline.h"
+#include "FrameCapture.h"
+#include "LaunchOptions.h"
+#include "SimulationClock.h"
+#include "FrameTimeline.h"
+#include "LinearUploadBuffer.h"
+#include "UploadRingBuffer.h"
+#include "FramesInFlight.h"
+#include "DescriptorAllocator.h"
+#include "ResourceStateTracker.h"
+#include "RenderGraph.h"
+#include "FrameGraph.h"
+#include "GeometryPool.h"
+#include "Tonemap.h"
+#include "QualitySweep.h"
 
 namespace DXRDemo
 {
+    class AssetImporter;
+
     class Game final
     {
     public:
-        Game(Window& window, uint32_t width, uint32_t height);
+        Game(Window& window, uint32_t width, uint32_t height, const LaunchOptions& options = {});
         ~Game();
 
         struct Settings
@@ -27,6 +45,11 @@ namespace DXRDemo
             float LightIntensity = 100;
             bool ImportanceSamplingEnabled = true;
             float ImportanceSamplingPercentage = 0.7;
+            // Offsets the random numbers, so traces with the same sample count can
+            // be averaged
+            int32_t Seed = 0;
+
+            bool operator==(const Settings&) const = default;
         };
 
         void Update();
@@ -39,22 +62,80 @@ namespace DXRDemo
         double FPS = 0;
         Settings UserSettings;
         bool DenoisingEnabled = true;
+        // Accumulates radiance over frames before denoising
+        bool TemporalAccumulationEnabled = true;
+        DenoiserBackend DenoisingBackend = DenoiserBackend::OpenImageDenoise;
+        DenoiseQuality DenoisingQuality = DenoiseQuality::Fast;
+        TonemapSettings Tonemap;
 
     private:
 
         Window* _window;
+        LaunchOptions _options;
+        SimulationClock _simulationClock;
+        FrameTimeline _frameTimeline;
+        // Objects that moved during the last simulation step
+        std::vector<GameObject*> _movingObjects;
         DXContext _dxContext;
-        //std::vector<uint64_t> _fenceValues;
+        // Fence value of the last submission on the direct queue
         uint64_t _fenceValue = 0;
-        std::shared_ptr<Denoiser> _denoiser;
+        FramesInFlight _framesInFlight;
+        // States of the ray traced images and the back buffer over the direct
+        // lists, with the barriers recorded in batches right before the commands
+        ResourceStateTracker _stateTracker;
+        // Passes of the frame being rendered, declared again only when its layout
+        // changes, the passes calling the callbacks given to the frame in _framePasses
+        RenderGraph _frameGraph;
+        FramePasses _framePasses;
+        std::optional<FrameLayout> _frameLayout;
+        RenderGraphResource _frameBackBuffer;
+        ThreadPool _threadPool;
+        // Records command lists. Kept apart from the denoiser's pool, whose long
+        // tasks the render thread would otherwise run while waiting for a recording.
+        ThreadPool _recordingThreadPool;
+        std::shared_ptr<DenoiserService> _denoiser;
+        std::unique_ptr<DenoisePipeline> _denoisePipeline;
+        // Saves frames when the command line asks for it
+        std::unique_ptr<FrameCapture> _frameCapture;
 
         void _OnInit();
+        void _CreateDefaultScene(AssetImporter& assetImporter);
+        void _InitializeTransforms(GameObject& gameObject);
+        void _StepSimulation();
+        // Drains the scene change journal, updating whatever depends on what changed
+        void _ProcessChanges(ID3D12GraphicsCommandList4* commandList);
+        // Writes the constants the shader binding table references to the current
+        // frame's copy
+        void _UploadFrameConstants();
+        // Bytes a region of _frameUploadBuffer needs for the scene's mesh renderers
+        uint64_t _GetFrameUploadSize();
+        // Replaces _frameUploadBuffer with a larger one if the scene outgrew it
+        void _GrowFrameUploadBuffer();
+        void _UpdateInstances(GameObject& gameObject);
+        // Camera and instance motion of the frame being traced, for the temporal accumulation
+        TemporalAccumulator::Frame _CreateTemporalFrame();
         void _CreateBuffers();
         void _CreateDescriptorHeaps();
         void _CreateBufferViews();
         // Rasterization init
         void _CreateRasterizationRootSignature();
         void _CreateRasterizationPipeline();
+        // Tonemap init, resolving the HDR ray tracing output to the back buffer
+        void _CreateTonemapRootSignature();
+        void _CreateTonemapPipeline();
+
+        // Records the draws of the rasterizer on the recording threads, returning
+        // the command lists in submission order
+        std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>> _RecordRasterDraws(
+            D3D12_CPU_DESCRIPTOR_HANDLE rtv,
+            D3D12_CPU_DESCRIPTOR_HANDLE dsv);
+        // Records the dispatch of the ray tracing pipeline over the whole output
+        void _RecordDispatchRays(ID3D12GraphicsCommandList4* commandList);
+        // Traces the scene with the current settings and waits for the GPU,
+        // returning the wall clock time in milliseconds
+        double _TraceImage();
+        // Measures error against time and samples, see RunQualitySweep
+        void _RunQualitySweep();
 
         void _InitializeGUI();
 
@@ -62,11 +143,11 @@ namespace DXRDemo
         //void _ResizeDepthBuffer(int width, int height);
 
         // Helper functions
-        // Transition a resource
-        void _TransitionResource(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList,
-            Microsoft::WRL::ComPtr<ID3D12Resource> resource,
-            D3D12_RESOURCE_STATES beforeState,
-            D3D12_RESOURCE_STATES afterState);
+        // Records the barriers _stateTracker queued into a direct command list
+        void _FlushBarriers(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>& commandList);
+        // Closes _stateTracker on the last of the lists and submits them, after a
+        // list bringing the resources to the states they start with if needed
+        uint64_t _ExecuteCommandLists(std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4>> commandLists);
 
         // Clear a render target view
         void _ClearRTV(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList,
@@ -81,13 +162,29 @@ namespace DXRDemo
         // Descriptor heap for depth buffer
         Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _dsvHeap;
 
-        // Vertex buffer
-        Microsoft::WRL::ComPtr<ID3D12Resource> _vertexBuffer;
-        D3D12_VERTEX_BUFFER_VIEW _vertexBufferView;
+        // Mesh renderers in draw order, and the constants of their draws this frame
+        std::vector<MeshRenderer*> _meshRenderers;
+        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> _drawConstants;
+        // Index of the first draw of each mesh renderer, and the draw count last
+        std::vector<size_t> _firstDraws;
+
+        // Work each command list recorded in parallel gets, few enough lists for
+        // the submission to stay cheap
+        static constexpr size_t MeshRenderersPerCommandList = 256;
+        static constexpr size_t BottomLevelASPerCommandList = 16;
 
-        // Index buffer
-        Microsoft::WRL::ComPtr<ID3D12Resource> _indexBuffer;
-        D3D12_INDEX_BUFFER_VIEW _indexBufferView;
+        // Vertices and indices of every mesh, indexed by the geometry index of
+        // the mesh in draws and hit shaders alike
+        std::unique_ptr<GeometryPool> _geometryPool;
+
+        // Arguments of one indirect draw, a mesh's range of the geometry pool
+        // drawn with the constants of its renderer
+        struct IndirectDraw
+        {
+            D3D12_GPU_VIRTUAL_ADDRESS Constants;
+            D3D12_DRAW_INDEXED_ARGUMENTS Arguments;
+        };
+        Microsoft::WRL::ComPtr<ID3D12CommandSignature> _drawCommandSignature;
 
         // Depth buffer
         Microsoft::WRL::ComPtr<ID3D12Resource> _depthBuffer;
@@ -98,6 +195,9 @@ namespace DXRDemo
         // Root signature
         Microsoft::WRL::ComPtr<ID3D12RootSignature> _rootSignature;
 
+        Microsoft::WRL::ComPtr<ID3D12PipelineState> _tonemapPipelineState;
+        Microsoft::WRL::ComPtr<ID3D12RootSignature> _tonemapRootSignature;
+
         D3D12_VIEWPORT _viewport;
         D3D12_RECT _scissorRect = CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX);
 
@@ -108,9 +208,31 @@ namespace DXRDemo
         DirectX::XMMATRIX _viewMatrix;
         DirectX::XMMATRIX _projectionMatrix;
 
+        // Last values written to the constant buffers
+        Settings _uploadedSettings;
+        DirectX::XMMATRIX _uploadedViewMatrix = DirectX::XMMatrixIdentity();
+        DirectX::XMMATRIX _uploadedProjectionMatrix = DirectX::XMMatrixIdentity();
+        DirectX::XMMATRIX _inverseViewMatrix = DirectX::XMMatrixIdentity();
+        DirectX::XMMATRIX _inverseProjectionMatrix = DirectX::XMMatrixIdentity();
+
+        // Transforms of the acceleration structure instances, as traced this frame
+        // and by the last frame accumulated, whose entries are only brought up to
+        // date for the instances moved since
+        std::vector<DirectX::XMMATRIX> _instanceMatrices;
+        std::vector<DirectX::XMMATRIX> _previousInstanceMatrices;
+        std::vector<uint32_t> _movedInstances;
+        std::vector<bool> _instanceMoved;
+        // Set by changes the temporal history cannot be reprojected across
+        bool _resetTemporalHistory = false;
+
         nv_helpers_dx12::TopLevelASGenerator TopLevelASGenerator;
+        // Scratch and result of the top-level AS. The instance descriptors are kept
+        // per frame instead.
         AccelerationStructureBuffers TopLevelASBuffers;
-        std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> ASInstances;
+
+        // Above this fraction of moved instances the top-level AS is rebuilt
+        // instead of refitted
+        static constexpr float TopLevelASRefitMaxDirtyFraction = 0.25f;
 
         /// Create the acceleration structure of an instance
         ///
@@ -123,10 +245,10 @@ namespace DXRDemo
         
         /// Create the main acceleration structure that holds
         /// all instances of the scene
-        /// \param instances : pair of BLAS and transform
+        /// \param updateOnly : only update the instances whose transform changed,
+        /// refitting or rebuilding the existing structure
         void CreateTopLevelAS(
             ID3D12GraphicsCommandList4* commandList,
-            const std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>& instances,
             bool updateOnly = false);
         
         /// Create all acceleration structures, bottom and top
@@ -156,22 +278,70 @@ namespace DXRDemo
         // as the target image
         void CreateRaytracingOutputBuffer();
         void CreateShaderResourceHeap();
-        Microsoft::WRL::ComPtr<ID3D12Resource> m_outputUploadResource;
+        // Points the view the shaders trace through at the current top-level
+        // acceleration structure, each time it is reallocated
+        void _CreateTopLevelASView();
+        // Linear HDR radiance, R16G16B16A16_FLOAT or R32G32B32A32_FLOAT
+        DXGI_FORMAT _radianceFormat;
         Microsoft::WRL::ComPtr<ID3D12Resource> m_outputResource;
-        Microsoft::WRL::ComPtr<ID3D12Resource> m_outputReadbackResource;
-        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_srvUavHeap;
-        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_guiHeap;
+        // Denoiser features of the first surface hit, in the radiance format
+        Microsoft::WRL::ComPtr<ID3D12Resource> _albedoResource;
+        Microsoft::WRL::ComPtr<ID3D12Resource> _normalResource;
+        // Instance and hit distance of the first surface hit, in the formats of
+        // TemporalAccumulator
+        Microsoft::WRL::ComPtr<ID3D12Resource> _instanceResource;
+        Microsoft::WRL::ComPtr<ID3D12Resource> _distanceResource;
+        // The five above behind the RenderBackend interfaces, for _stateTracker
+        std::shared_ptr<RenderResource> _outputImage;
+        std::shared_ptr<RenderResource> _albedoImage;
+        std::shared_ptr<RenderResource> _normalImage;
+        std::shared_ptr<RenderResource> _instanceImage;
+        std::shared_ptr<RenderResource> _distanceImage;
+        // Shader visible heap of the views the passes and the GUI bind, and the
+        // slots of those allocated at startup
+        static constexpr uint32_t PersistentDescriptorCount = 1024;
+        static constexpr uint32_t TransientDescriptorsPerFrame = 256;
+        std::shared_ptr<RenderDescriptorHeap> _descriptorHeap;
+        std::unique_ptr<DescriptorAllocator> _descriptorAllocator;
+        uint32_t _outputUavIndex = DescriptorAllocator::InvalidIndex;
+        uint32_t _topLevelASIndex = DescriptorAllocator::InvalidIndex;
+        uint32_t _outputSrvIndex = DescriptorAllocator::InvalidIndex;
+        // Albedo, normal, instance, then distance
+        uint32_t _featureUavIndex = DescriptorAllocator::InvalidIndex;
+        uint32_t _guiFontIndex = DescriptorAllocator::InvalidIndex;
+
+        inline ID3D12DescriptorHeap* _GetDescriptorHeap() const
+        {
+            return static_cast<D3D12RenderDescriptorHeap&>(*_descriptorHeap).GetNative();
+        }
 
         void CreateShaderBindingTable();
         nv_helpers_dx12::ShaderBindingTableGenerator m_sbtHelper;
-        Microsoft::WRL::ComPtr<ID3D12Resource> m_sbtStorage;
 
-        void CreateBuffer(size_t bufferSize, ID3D12Resource** buffer);
-        void CopyDataToBuffer(Microsoft::WRL::ComPtr<ID3D12Resource> buffer, void* data, size_t bufferSize);
-        
-        Microsoft::WRL::ComPtr<ID3D12Resource> _clearColorBuffer;
-        Microsoft::WRL::ComPtr<ID3D12Resource> _inverseProjectBuffer;
-        Microsoft::WRL::ComPtr<ID3D12Resource> _inverseViewBuffer;
-        Microsoft::WRL::ComPtr<ID3D12Resource> _settingsViewBuffer;
+        // What the CPU writes for a frame while earlier ones may still be read by
+        // the GPU, one copy per frame in flight
+        struct FrameResources
+        {
+            // Constants referenced by the frame's shader binding table
+            LinearUploadBuffer::Allocation ClearColorConstants;
+            LinearUploadBuffer::Allocation InverseProjectionConstants;
+            LinearUploadBuffer::Allocation InverseViewConstants;
+            LinearUploadBuffer::Allocation SettingsConstants;
+            Microsoft::WRL::ComPtr<ID3D12Resource> ShaderBindingTable;
+            // Top-level AS instance descriptors, rewritten whole when the frame's
+            // copy differs from the one written last
+            Microsoft::WRL::ComPtr<ID3D12Resource> InstanceDescs;
+        };
+        std::vector<FrameResources> _frames;
+        // One region per frame in flight, each holding a FrameResources' constants
+        std::unique_ptr<LinearUploadBuffer> _constantUploadBuffer;
+
+        // Constants written every frame, such as the MVP matrices of the rasterizer
+        std::unique_ptr<LinearUploadBuffer> _frameUploadBuffer;
+
+        // Staging of the vertex data rewritten when materials change, retired with
+        // each frame's fence value
+        std::unique_ptr<UploadRingBuffer> _materialUploadRing;
+        static constexpr uint64_t MaterialUploadRingSize = 8 * 1024 * 1024;
     };
 }
\ No newline at end of file
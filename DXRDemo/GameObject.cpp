@@ -19,6 +19,8 @@ namespace DXRDemo
     {
         Children.push_back(child);
         child->Parent = this;
+        child->SetJournal(Journal);
+        child->RecordChange(ChangeType::Hierarchy);
     }
 
     void GameObject::AddComponent(const std::shared_ptr<Component>& component)
@@ -26,4 +28,13 @@ namespace DXRDemo
         Components.push_back(component);
         component->Parent = this;
     }
+
+    void GameObject::SetJournal(ChangeJournal* journal)
+    {
+        Journal = journal;
+        for (const std::shared_ptr<GameObject>& child : Children)
+        {
+            child->SetJournal(journal);
+        }
+    }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <memory>
 #include "Transform.h"
 #include "Component.h"
+#include "ChangeJournal.h"
 
 namespace DXRDemo
 {
@@ -17,11 +18,43 @@ namespace DXRDemo
         std::vector<std::shared_ptr<GameObject>> Children;
         std::vector<std::shared_ptr<Component>> Components;
 
+        // Journal of the scene the object belongs to, null while it is not in one
+        ChangeJournal* Journal = nullptr;
+
         virtual void Update(double deltaTime);
 
         void AddChild(const std::shared_ptr<GameObject>& child);
         void AddComponent(const std::shared_ptr<Component>& component);
 
+        // To be called after changing the position, scale or rotation
+        inline void MarkTransformDirty()
+        {
+            Transform.Moved = true;
+            RequestTransformUpdate();
+        }
+
+        // Asks for the rendered transform to be recomputed, recording the object in
+        // the journal at most once until the journal is processed
+        inline void RequestTransformUpdate()
+        {
+            if (!Transform.Dirty)
+            {
+                Transform.Dirty = true;
+                RecordChange(ChangeType::Transform);
+            }
+        }
+
+        inline void RecordChange(ChangeType type, Component* component = nullptr)
+        {
+            if (Journal != nullptr)
+            {
+                Journal->Record(type, this, component);
+            }
+        }
+
+        // Sets the journal of the object and of all its descendants
+        void SetJournal(ChangeJournal* journal);
+
         inline bool ForEachChild(const std::function<bool(GameObject&, std::size_t)>& callback)
         {
             std::size_t index = 0;
@@ -0,0 +1,103 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "DXContext.h"
+#include "UploadRingBuffer.h"
+
+using namespace Microsoft::WRL;
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // Buffers of an empty scene still get an element, D3D12 having no empty ones
+        ComPtr<ID3D12Resource> CreatePoolBuffer(DXContext& dxContext, const void* data, uint64_t size)
+        {
+            ComPtr<ID3D12Resource> buffer = dxContext.BufferHeaps->CreateBuffer(
+                std::max<uint64_t>(size, sizeof(GeometryRange)), D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+            if (size != 0)
+            {
+                dxContext.CopyUploadRing->CopyBuffer(buffer.Get(), 0, data, size);
+            }
+            return buffer;
+        }
+    }
+
+    GeometryPool::GeometryPool(uint32_t vertexStride) :
+        _vertexStride(vertexStride)
+    {
+    }
+
+    uint32_t GeometryPool::AddGeometry(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+    {
+        if (_vertexBuffer)
+        {
+            throw std::logic_error("Geometry added to a pool already created");
+        }
+
+        GeometryRange geometry;
+        geometry.FirstVertex = _vertexCount;
+        geometry.VertexCount = vertexCount;
+        geometry.FirstIndex = _indexCount;
+        geometry.IndexCount = indexCount;
+        _geometries.push_back(geometry);
+
+        const uint8_t* vertexData = static_cast<const uint8_t*>(vertices);
+        _vertices.insert(_vertices.end(), vertexData, vertexData + static_cast<size_t>(vertexCount) * _vertexStride);
+        _indices.insert(_indices.end(), indices, indices + indexCount);
+        _vertexCount += vertexCount;
+        _indexCount += indexCount;
+
+        return static_cast<uint32_t>(_geometries.size() - 1);
+    }
+
+    void GeometryPool::Create(DXContext& dxContext)
+    {
+        _vertexBuffer = CreatePoolBuffer(dxContext, _vertices.data(), _vertices.size());
+        _indexBuffer = CreatePoolBuffer(dxContext, _indices.data(), _indices.size() * sizeof(uint32_t));
+        _geometryBuffer = CreatePoolBuffer(dxContext, _geometries.data(), _geometries.size() * sizeof(GeometryRange));
+
+        // Left in the common state by the copy queue, read from there by the
+        // draws and the ray tracing shaders
+        _vertexResource = dxContext.RenderDevice->WrapResource(_vertexBuffer, HeapType::Default, ResourceState::Common);
+
+        _vertexBufferView.BufferLocation = _vertexBuffer->GetGPUVirtualAddress();
+        _vertexBufferView.SizeInBytes = static_cast<UINT>(_vertices.size());
+        _vertexBufferView.StrideInBytes = _vertexStride;
+
+        _indexBufferView.BufferLocation = _indexBuffer->GetGPUVirtualAddress();
+        _indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+        _indexBufferView.SizeInBytes = static_cast<UINT>(_indices.size() * sizeof(uint32_t));
+
+        // Staged in the ring already
+        _vertices = {};
+        _indices = {};
+    }
+
+    void GeometryPool::CopyVertices(
+        ID3D12GraphicsCommandList4* commandList,
+        UploadRingBuffer& uploadRing,
+        uint32_t geometryIndex,
+        const void* vertices)
+    {
+        const GeometryRange& geometry = _geometries[geometryIndex];
+        uint64_t size = static_cast<uint64_t>(geometry.VertexCount) * _vertexStride;
+        if (size == 0)
+        {
+            return;
+        }
+
+        UploadRingBuffer::Allocation staging = uploadRing.Allocate(size);
+        memcpy(staging.CpuAddress, vertices, size);
+        commandList->CopyBufferRegion(
+            _vertexBuffer.Get(), static_cast<uint64_t>(geometry.FirstVertex) * _vertexStride,
+            staging.Resource, staging.Offset, size);
+    }
+
+    uint64_t GeometryPool::GetSize() const
+    {
+        return static_cast<uint64_t>(_vertexCount) * _vertexStride + static_cast<uint64_t>(_indexCount) * sizeof(uint32_t);
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace DXRDemo
+{
+    class DXContext;
+    class RenderResource;
+    class UploadRingBuffer;
+
+    // Where a geometry lies in the pool's buffers, as the hit shader reads it
+    // (GeometryData in Common.hlsli). Indices are relative to the first vertex.
+    struct GeometryRange
+    {
+        uint32_t FirstVertex = 0;
+        uint32_t VertexCount = 0;
+        uint32_t FirstIndex = 0;
+        uint32_t IndexCount = 0;
+    };
+
+    // The vertices and indices of every mesh of the scene, packed in one vertex
+    // and one index buffer instead of a pair of buffers per mesh. Geometries are
+    // added first, then Create uploads each buffer in a single copy, along with
+    // a table of the geometry ranges through which the hit shader finds the
+    // triangles of an instance. Raster draws bind the buffers once and offset
+    // into them with their first index and base vertex.
+    class GeometryPool final
+    {
+    public:
+        explicit GeometryPool(uint32_t vertexStride);
+        GeometryPool(const GeometryPool&) = delete;
+        GeometryPool& operator=(const GeometryPool&) = delete;
+
+        // Returns the index of the geometry, its position in the range table
+        uint32_t AddGeometry(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+        // Creates the buffers in dxContext's heaps and records their uploads into
+        // its copy upload ring, to be submitted by its Flush. The geometries
+        // can no longer be added to afterwards.
+        void Create(DXContext& dxContext);
+
+        // Stages new vertices of a geometry in uploadRing and records their copy.
+        // The vertex buffer must be in the copy destination state.
+        void CopyVertices(
+            ID3D12GraphicsCommandList4* commandList,
+            UploadRingBuffer& uploadRing,
+            uint32_t geometryIndex,
+            const void* vertices);
+
+        inline const GeometryRange& GetGeometry(uint32_t geometryIndex) const
+        {
+            return _geometries[geometryIndex];
+        }
+
+        inline uint32_t GetGeometryCount() const
+        {
+            return static_cast<uint32_t>(_geometries.size());
+        }
+
+        inline uint32_t GetVertexStride() const
+        {
+            return _vertexStride;
+        }
+
+        inline ID3D12Resource* GetVertexBuffer() const
+        {
+            return _vertexBuffer.Get();
+        }
+
+        // The vertex buffer behind the RenderBackend interfaces, for the state
+        // trackers of the lists copying into it
+        inline RenderResource& GetVertexResource() const
+        {
+            return *_vertexResource;
+        }
+
+        inline ID3D12Resource* GetIndexBuffer() const
+        {
+            return _indexBuffer.Get();
+        }
+
+        inline ID3D12Resource* GetGeometryBuffer() const
+        {
+            return _geometryBuffer.Get();
+        }
+
+        inline const D3D12_VERTEX_BUFFER_VIEW& GetVertexBufferView() const
+        {
+            return _vertexBufferView;
+        }
+
+        inline const D3D12_INDEX_BUFFER_VIEW& GetIndexBufferView() const
+        {
+            return _indexBufferView;
+        }
+
+        // Size of the vertex and index buffers
+        uint64_t GetSize() const;
+
+    private:
+        uint32_t _vertexStride;
+        std::vector<GeometryRange> _geometries;
+
+        // Gathered until Create, then released
+        std::vector<uint8_t> _vertices;
+        std::vector<uint32_t> _indices;
+        uint32_t _vertexCount = 0;
+        uint32_t _indexCount = 0;
+
+        Microsoft::WRL::ComPtr<ID3D12Resource> _vertexBuffer;
+        Microsoft::WRL::ComPtr<ID3D12Resource> _indexBuffer;
+        Microsoft::WRL::ComPtr<ID3D12Resource> _geometryBuffer;
+        std::shared_ptr<RenderResource> _vertexResource;
+        D3D12_VERTEX_BUFFER_VIEW _vertexBufferView = {};
+        D3D12_INDEX_BUFFER_VIEW _indexBufferView = {};
+    };
+}
@@ -0,0 +1,332 @@
+#include "HeapAllocatorCheck.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "TlsfAllocator.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // D3D12 places resources on 64 KB boundaries, acceleration structures
+        // need 256 B within a buffer
+        const uint64_t PlacementAlignment = 64 * 1024;
+        const uint64_t AccelerationStructureAlignment = 256;
+        const uint64_t HeapSize = 64 * 1024 * 1024;
+        const uint32_t MeshCount = 4000;
+        const int ChurnOperations = 200000;
+
+        struct Result
+        {
+            std::string Workload;
+            uint64_t Allocations = 0;
+            uint64_t Heaps = 0;
+            uint64_t UsedBytes = 0;
+            uint64_t ReservedBytes = 0;
+            uint64_t FreeBlocks = 0;
+            uint64_t LargestFreeBlock = 0;
+            double Fragmentation = 0.0;
+            double NanosecondsPerOperation = 0.0;
+        };
+
+        struct Range
+        {
+            uint64_t Size;
+            uint64_t Alignment;
+        };
+
+        // The ranges held in one allocator, checked against each other as they
+        // come and go
+        class RangeTracker
+        {
+        public:
+            RangeTracker(const std::string& workload, bool& passed) :
+                _workload(workload),
+                _passed(&passed)
+            {
+            }
+
+            void Add(const TlsfAllocator& allocator, uint64_t offset, uint64_t size, uint64_t alignment)
+            {
+                if (offset % alignment != 0 || offset + size > allocator.GetCapacity())
+                {
+                    _Fail("misaligned range or one out of the block");
+                }
+
+                auto next = _ranges.lower_bound(offset);
+                if ((next != _ranges.end() && next->first < offset + size) ||
+                    (next != _ranges.begin() && std::prev(next)->first + std::prev(next)->second.Size > offset))
+                {
+                    _Fail("overlapping ranges");
+                }
+
+                _ranges[offset] = { size, alignment };
+                _usedSize += size;
+            }
+
+            void Remove(uint64_t offset)
+            {
+                _usedSize -= _ranges.at(offset).Size;
+                _ranges.erase(offset);
+            }
+
+            void CheckStatistics(const TlsfAllocator& allocator)
+            {
+                TlsfStatistics statistics = allocator.GetStatistics();
+                if (statistics.AllocationCount != _ranges.size() ||
+                    statistics.UsedSize != _usedSize ||
+                    statistics.FreeSize != allocator.GetCapacity() - _usedSize ||
+                    statistics.LargestFreeBlock > statistics.FreeSize ||
+                    (statistics.FreeSize != 0 && statistics.FreeBlockCount == 0))
+                {
+                    _Fail("statistics differ from the ranges held");
+                }
+            }
+
+            inline const std::map<uint64_t, Range>& GetRanges() const
+            {
+                return _ranges;
+            }
+
+        private:
+            std::string _workload;
+            bool* _passed;
+            std::map<uint64_t, Range> _ranges;
+            uint64_t _usedSize = 0;
+
+            void _Fail(const char* message)
+            {
+                std::cerr << _workload << ": " << message << std::endl;
+                *_passed = false;
+            }
+        };
+
+        double GetFragmentation(const TlsfStatistics& statistics)
+        {
+            return statistics.FreeSize == 0 ? 0.0 : 1.0 - static_cast<double>(statistics.LargestFreeBlock) / statistics.FreeSize;
+        }
+
+        Result Summarize(const std::string& workload, const std::vector<TlsfAllocator>& heaps, uint64_t operations, double seconds)
+        {
+            Result result;
+            result.Workload = workload;
+            result.Heaps = heaps.size();
+            TlsfStatistics total;
+            for (const TlsfAllocator& heap : heaps)
+            {
+                TlsfStatistics statistics = heap.GetStatistics();
+                result.Allocations += statistics.AllocationCount;
+                result.UsedBytes += statistics.UsedSize;
+                result.ReservedBytes += heap.GetCapacity();
+                result.FreeBlocks += statistics.FreeBlockCount;
+                result.LargestFreeBlock = std::max(result.LargestFreeBlock, statistics.LargestFreeBlock);
+                total.FreeSize += statistics.FreeSize;
+            }
+            total.LargestFreeBlock = result.LargestFreeBlock;
+            result.Fragmentation = GetFragmentation(total);
+            result.NanosecondsPerOperation = operations == 0 ? 0.0 : seconds * 1e9 / operations;
+            return result;
+        }
+
+        // What one committed resource per range would take, each in a heap of its own
+        Result SummarizeCommitted(const std::string& workload, const std::vector<uint64_t>& sizes)
+        {
+            Result result;
+            result.Workload = workload;
+            result.Allocations = sizes.size();
+            result.Heaps = sizes.size();
+            for (uint64_t size : sizes)
+            {
+                result.UsedBytes += size;
+                result.ReservedBytes += (size + PlacementAlignment - 1) & ~(PlacementAlignment - 1);
+            }
+            return result;
+        }
+
+        // Sizes spread evenly in log scale, as mesh and structure sizes are
+        std::vector<uint64_t> CreateSizes(std::mt19937_64& random, size_t count, uint64_t minimum, uint64_t maximum)
+        {
+            std::uniform_real_distribution<double> distribution(std::log(static_cast<double>(minimum)), std::log(static_cast<double>(maximum)));
+            std::vector<uint64_t> sizes(count);
+            for (uint64_t& size : sizes)
+            {
+                size = static_cast<uint64_t>(std::exp(distribution(random)));
+            }
+            return sizes;
+        }
+
+        // Packs the ranges into as many heaps as needed, as PlacedResourceAllocator does
+        Result PackInHeaps(const std::string& workload, const std::vector<uint64_t>& sizes, uint64_t allocationGranularity, uint64_t alignment, bool& passed)
+        {
+            std::vector<TlsfAllocator> heaps;
+            std::vector<RangeTracker> trackers;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint64_t size : sizes)
+            {
+                uint64_t allocationSize = (size + allocationGranularity - 1) & ~(allocationGranularity - 1);
+                bool placed = false;
+                for (size_t heap = 0; heap < heaps.size() && !placed; ++heap)
+                {
+                    uint64_t offset = heaps[heap].Allocate(allocationSize, alignment);
+                    if (offset != TlsfAllocator::InvalidOffset)
+                    {
+                        trackers[heap].Add(heaps[heap], offset, allocationSize, alignment);
+                        placed = true;
+                    }
+                }
+
+                if (!placed)
+                {
+                    heaps.emplace_back(std::max(HeapSize, allocationSize));
+                    trackers.emplace_back(workload, passed);
+                    trackers.back().Add(heaps.back(), heaps.back().Allocate(allocationSize, alignment), allocationSize, alignment);
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+            for (size_t heap = 0; heap < heaps.size(); ++heap)
+            {
+                trackers[heap].CheckStatistics(heaps[heap]);
+            }
+            return Summarize(workload, heaps, sizes.size(), seconds);
+        }
+
+        // Random allocations and frees of mixed sizes and alignments in one heap,
+        // then the ranges moved down from the top, as a defragmentation pass would
+        void Churn(std::vector<Result>& results, bool& passed)
+        {
+            std::mt19937_64 random(7);
+            std::vector<TlsfAllocator> heap;
+            heap.emplace_back(HeapSize);
+            TlsfAllocator& allocator = heap.back();
+            RangeTracker tracker("Churn", passed);
+
+            const uint64_t alignments[] = { 256, 4096, PlacementAlignment };
+            std::uniform_int_distribution<int> alignmentDistribution(0, 2);
+            std::uniform_real_distribution<double> sizeDistribution(std::log(256.0), std::log(1024.0 * 1024.0));
+            std::vector<uint64_t> live;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int operation = 0; operation < ChurnOperations; ++operation)
+            {
+                // Grows until about half full, then hovers there
+                bool allocate = live.empty() || (random() % 100) < (allocator.GetStatistics().UsedSize < HeapSize / 2 ? 70u : 45u);
+                if (allocate)
+                {
+                    uint64_t size = static_cast<uint64_t>(std::exp(sizeDistribution(random)));
+                    uint64_t alignment = alignments[alignmentDistribution(random)];
+                    uint64_t offset = allocator.Allocate(size, alignment);
+                    if (offset != TlsfAllocator::InvalidOffset)
+                    {
+                        tracker.Add(allocator, offset, size, alignment);
+                        live.push_back(offset);
+                    }
+                }
+                else
+                {
+                    size_t index = random() % live.size();
+                    allocator.Free(live[index]);
+                    tracker.Remove(live[index]);
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+
+                if (operation % 1000 == 0)
+                {
+                    tracker.CheckStatistics(allocator);
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            tracker.CheckStatistics(allocator);
+            results.push_back(Summarize("churn", heap, ChurnOperations, seconds));
+
+            // Highest ranges first, each placed as low as it fits, then the original freed
+            TlsfStatistics before = allocator.GetStatistics();
+            std::vector<std::pair<uint64_t, Range>> ranges(tracker.GetRanges().rbegin(), tracker.GetRanges().rend());
+            start = std::chrono::high_resolution_clock::now();
+            for (const auto& [offset, range] : ranges)
+            {
+                uint64_t relocated = allocator.AllocateBelow(range.Size, range.Alignment, offset);
+                if (relocated != TlsfAllocator::InvalidOffset)
+                {
+                    tracker.Add(allocator, relocated, range.Size, range.Alignment);
+                    allocator.Free(offset);
+                    tracker.Remove(offset);
+                }
+            }
+            seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            tracker.CheckStatistics(allocator);
+            results.push_back(Summarize("churn defragmented", heap, ranges.size(), seconds));
+
+            TlsfStatistics after = allocator.GetStatistics();
+            if (after.LargestFreeBlock <= before.LargestFreeBlock || GetFragmentation(after) >= GetFragmentation(before))
+            {
+                std::cerr << "Churn: defragmentation did not grow the largest free block" << std::endl;
+                passed = false;
+            }
+
+            for (const auto& [offset, range] : std::map<uint64_t, Range>(tracker.GetRanges()))
+            {
+                allocator.Free(offset);
+                tracker.Remove(offset);
+            }
+            TlsfStatistics empty = allocator.GetStatistics();
+            if (!allocator.IsEmpty() || empty.FreeBlockCount != 1 || empty.LargestFreeBlock != HeapSize)
+            {
+                std::cerr << "Churn: freeing every range did not merge them back into one block" << std::endl;
+                passed = false;
+            }
+        }
+    }
+
+    bool RunHeapAllocatorCheck(const std::string& filename)
+    {
+        std::ofstream output(filename);
+        if (!output)
+        {
+            throw std::runtime_error("Could not open " + filename);
+        }
+
+        bool passed = true;
+        std::vector<Result> results;
+        std::mt19937_64 random(1);
+
+        // A vertex and an index buffer per mesh, placed resources taking 64 KB pages
+        std::vector<uint64_t> bufferSizes = CreateSizes(random, 2 * MeshCount, 1024, 4 * 1024 * 1024);
+        results.push_back(SummarizeCommitted("mesh buffers committed", bufferSizes));
+        results.push_back(PackInHeaps("mesh buffers placed", bufferSizes, PlacementAlignment, PlacementAlignment, passed));
+
+        // One bottom-level structure per mesh, packed in a few large buffers
+        std::vector<uint64_t> structureSizes = CreateSizes(random, MeshCount, 512, 256 * 1024);
+        results.push_back(SummarizeCommitted("acceleration structures committed", structureSizes));
+        results.push_back(PackInHeaps("acceleration structures suballocated", structureSizes,
+            AccelerationStructureAlignment, AccelerationStructureAlignment, passed));
+
+        Churn(results, passed);
+
+        output << "workload,allocations,heaps,used_bytes,reserved_bytes,free_blocks,largest_free_block,fragmentation,ns_per_operation\n";
+        for (const Result& result : results)
+        {
+            output << result.Workload << ","
+                << result.Allocations << ","
+                << result.Heaps << ","
+                << result.UsedBytes << ","
+                << result.ReservedBytes << ","
+                << result.FreeBlocks << ","
+                << result.LargestFreeBlock << ","
+                << result.Fragmentation << ","
+                << result.NanosecondsPerOperation << "\n";
+        }
+
+        return passed;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    // Runs synthetic workloads through TlsfAllocator: the buffers of a scene of
+    // many small meshes placed in 64 KB aligned heap ranges, its acceleration
+    // structures packed at 256 B alignment, and random churn followed by
+    // defragmentation. Writes the space used, free blocks and fragmentation of
+    // each as CSV, next to what committed resources would have taken. Returns
+    // whether no two ranges ever overlapped or broke their alignment, the
+    // statistics matched the ranges held, defragmentation grew the largest free
+    // block and freeing everything left a single block.
+    bool RunHeapAllocatorCheck(const std::string& filename);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+namespace DXRDemo
+{
+    // Implementations a DenoiserService can denoise with
+    enum class DenoiserBackend
+    {
+        // Open Image Denoise, the best results
+        OpenImageDenoise,
+        // Built-in edge-avoiding wavelet filter, for previews or where OIDN is
+        // not available
+        Wavelet
+    };
+
+    // Denoises images of the size and format it was created for
+    class ImageDenoiser
+    {
+    public:
+        virtual ~ImageDenoiser() = default;
+
+        // Denoises image into output, guided by the albedo and normal of the first
+        // surface seen through each pixel. All images are in the format given on
+        // construction, the inputs sharing one row pitch. Row pitches are in bytes.
+        virtual void Denoise(const void* image, const void* albedo, const void* normal, std::size_t inputRowPitch,
+            void* output, std::size_t outputRowPitch) = 0;
+    };
+}
@@ -0,0 +1,378 @@
+#include "ImageEncoding.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include "PixelConversion.h"
+#include "Zlib.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // Scanlines per compressed OpenEXR block, as ZIP compression defines it
+        constexpr std::size_t ExrZipLines = 16;
+        constexpr uint8_t ExrZipCompression = 3;
+        constexpr int32_t ExrHalfPixels = 1;
+        constexpr int32_t ExrFloatPixels = 2;
+
+        void Append(std::vector<uint8_t>& output, const void* data, std::size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            output.insert(output.end(), bytes, bytes + size);
+        }
+
+        // Little endian, as the CPUs this runs on
+        template<typename T>
+        void AppendValue(std::vector<uint8_t>& output, T value)
+        {
+            Append(output, &value, sizeof(T));
+        }
+
+        void AppendBigEndian(std::vector<uint8_t>& output, uint32_t value)
+        {
+            for (int shift = 24; shift >= 0; shift -= 8)
+            {
+                output.push_back(static_cast<uint8_t>(value >> shift));
+            }
+        }
+
+        void AppendString(std::vector<uint8_t>& output, const char* value)
+        {
+            Append(output, value, std::strlen(value) + 1);
+        }
+
+        // RGBA rows of the image in the precision an encoder asks for, converted
+        // only when the image has the other one
+        class RowReader final
+        {
+        public:
+            RowReader(std::size_t width, DXGI_FORMAT format, const void* pixels, std::size_t rowPitch) :
+                _width(width),
+                _format(format),
+                _pixels(static_cast<const uint8_t*>(pixels)),
+                _rowPitch(rowPitch)
+            {
+                if (format != DXGI_FORMAT_R16G16B16A16_FLOAT && format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+                {
+                    throw std::invalid_argument("Unsupported image format for encoding");
+                }
+            }
+
+            const float* GetFloats(std::size_t y)
+            {
+                const uint8_t* row = _pixels + y * _rowPitch;
+                if (_format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+                {
+                    return reinterpret_cast<const float*>(row);
+                }
+                _floats.resize(_width * 4);
+                PixelConversion::Rgba16fToRgba32f(reinterpret_cast<const uint16_t*>(row), _floats.data(), _width);
+                return _floats.data();
+            }
+
+            const uint16_t* GetHalves(std::size_t y)
+            {
+                const uint8_t* row = _pixels + y * _rowPitch;
+                if (_format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+                {
+                    return reinterpret_cast<const uint16_t*>(row);
+                }
+                _halves.resize(_width * 4);
+                PixelConversion::Rgba32fToRgba16f(reinterpret_cast<const float*>(row), _halves.data(), _width);
+                return _halves.data();
+            }
+
+        private:
+            std::size_t _width;
+            DXGI_FORMAT _format;
+            const uint8_t* _pixels;
+            std::size_t _rowPitch;
+            std::vector<float> _floats;
+            std::vector<uint16_t> _halves;
+        };
+
+        void AppendExrAttribute(std::vector<uint8_t>& output, const char* name, const char* type,
+            const std::vector<uint8_t>& value)
+        {
+            AppendString(output, name);
+            AppendString(output, type);
+            AppendValue(output, static_cast<int32_t>(value.size()));
+            Append(output, value.data(), value.size());
+        }
+
+        // OpenEXR ZIP blocks: the bytes are split into the even and the odd ones,
+        // delta coded, then deflated. Blocks that do not shrink are kept as is.
+        std::vector<uint8_t> CompressExrBlock(const std::vector<uint8_t>& data)
+        {
+            std::vector<uint8_t> predicted(data.size());
+            std::size_t half = (data.size() + 1) / 2;
+            for (std::size_t i = 0; i < data.size(); ++i)
+            {
+                predicted[(i & 1) ? half + i / 2 : i / 2] = data[i];
+            }
+            int previous = predicted.empty() ? 0 : predicted[0];
+            for (std::size_t i = 1; i < predicted.size(); ++i)
+            {
+                int value = predicted[i];
+                predicted[i] = static_cast<uint8_t>(value - previous + (128 + 256));
+                previous = value;
+            }
+
+            std::vector<uint8_t> compressed = Zlib::Compress(predicted.data(), predicted.size());
+            return compressed.size() < data.size() ? compressed : data;
+        }
+
+        std::vector<uint8_t> EncodeExr(bool halfPrecision, std::size_t width, std::size_t height, RowReader& rows)
+        {
+            std::vector<uint8_t> output = { 0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0 };
+
+            // Channels are stored in alphabetical order
+            std::vector<uint8_t> channels;
+            for (const char* name : { "B", "G", "R" })
+            {
+                AppendString(channels, name);
+                AppendValue(channels, halfPrecision ? ExrHalfPixels : ExrFloatPixels);
+                // Perceptually linear flag and reserved bytes
+                AppendValue(channels, static_cast<uint32_t>(0));
+                AppendValue(channels, static_cast<int32_t>(1));
+                AppendValue(channels, static_cast<int32_t>(1));
+            }
+            channels.push_back(0);
+
+            std::vector<uint8_t> window;
+            for (int32_t value : { 0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1 })
+            {
+                AppendValue(window, value);
+            }
+            std::vector<uint8_t> one;
+            AppendValue(one, 1.0f);
+            std::vector<uint8_t> origin;
+            AppendValue(origin, 0.0f);
+            AppendValue(origin, 0.0f);
+
+            AppendExrAttribute(output, "channels", "chlist", channels);
+            AppendExrAttribute(output, "compression", "compression", { ExrZipCompression });
+            AppendExrAttribute(output, "dataWindow", "box2i", window);
+            AppendExrAttribute(output, "displayWindow", "box2i", window);
+            AppendExrAttribute(output, "lineOrder", "lineOrder", { 0 });
+            AppendExrAttribute(output, "pixelAspectRatio", "float", one);
+            AppendExrAttribute(output, "screenWindowCenter", "v2f", origin);
+            AppendExrAttribute(output, "screenWindowWidth", "float", one);
+            output.push_back(0);
+
+            // Offsets of the blocks, filled in as they are written
+            std::size_t blockCount = (height + ExrZipLines - 1) / ExrZipLines;
+            std::size_t offsetTable = output.size();
+            output.resize(output.size() + blockCount * sizeof(uint64_t));
+
+            std::size_t valueSize = halfPrecision ? sizeof(uint16_t) : sizeof(float);
+            std::vector<uint8_t> block;
+            for (std::size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+            {
+                std::size_t firstLine = blockIndex * ExrZipLines;
+                std::size_t lastLine = std::min(firstLine + ExrZipLines, height);
+
+                // Each line holds all of its blue values, then green, then red
+                block.resize((lastLine - firstLine) * width * 3 * valueSize);
+                uint8_t* destination = block.data();
+                for (std::size_t y = firstLine; y < lastLine; ++y)
+                {
+                    const uint16_t* halves = halfPrecision ? rows.GetHalves(y) : nullptr;
+                    const float* floats = halfPrecision ? nullptr : rows.GetFloats(y);
+                    for (int channel = 2; channel >= 0; --channel)
+                    {
+                        for (std::size_t x = 0; x < width; ++x, destination += valueSize)
+                        {
+                            if (halfPrecision)
+                            {
+                                std::memcpy(destination, &halves[x * 4 + channel], sizeof(uint16_t));
+                            }
+                            else
+                            {
+                                std::memcpy(destination, &floats[x * 4 + channel], sizeof(float));
+                            }
+                        }
+                    }
+                }
+
+                uint64_t offset = output.size();
+                std::memcpy(&output[offsetTable + blockIndex * sizeof(uint64_t)], &offset, sizeof(uint64_t));
+
+                std::vector<uint8_t> compressed = CompressExrBlock(block);
+                AppendValue(output, static_cast<int32_t>(firstLine));
+                AppendValue(output, static_cast<int32_t>(compressed.size()));
+                Append(output, compressed.data(), compressed.size());
+            }
+            return output;
+        }
+
+        std::vector<uint8_t> EncodePfm(std::size_t width, std::size_t height, RowReader& rows)
+        {
+            // A negative scale marks little endian floats. Rows go from bottom to top.
+            std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+            std::vector<uint8_t> output(header.begin(), header.end());
+            output.reserve(output.size() + width * height * 3 * sizeof(float));
+            for (std::size_t y = height; y-- > 0;)
+            {
+                const float* row = rows.GetFloats(y);
+                for (std::size_t x = 0; x < width; ++x)
+                {
+                    Append(output, &row[x * 4], 3 * sizeof(float));
+                }
+            }
+            return output;
+        }
+
+        void AppendPngChunk(std::vector<uint8_t>& output, const char* type, const std::vector<uint8_t>& data)
+        {
+            AppendBigEndian(output, static_cast<uint32_t>(data.size()));
+            std::size_t typeOffset = output.size();
+            Append(output, type, 4);
+            Append(output, data.data(), data.size());
+            AppendBigEndian(output, Zlib::Crc32(&output[typeOffset], 4 + data.size()));
+        }
+
+        uint8_t Paeth(int left, int up, int upLeft)
+        {
+            int estimate = left + up - upLeft;
+            int distanceLeft = std::abs(estimate - left);
+            int distanceUp = std::abs(estimate - up);
+            int distanceUpLeft = std::abs(estimate - upLeft);
+            if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft)
+            {
+                return static_cast<uint8_t>(left);
+            }
+            return static_cast<uint8_t>(distanceUp <= distanceUpLeft ? up : upLeft);
+        }
+
+        std::vector<uint8_t> EncodePng(std::size_t width, std::size_t height, RowReader& rows, const TonemapSettings& tonemap)
+        {
+            const std::size_t pixelSize = 3;
+            std::size_t rowSize = width * pixelSize;
+
+            // Each row is filtered with the filter giving the smallest sum of
+            // absolute differences, the heuristic the PNG specification suggests
+            std::vector<uint8_t> filtered;
+            filtered.reserve((rowSize + 1) * height);
+            std::vector<uint8_t> previousRow(rowSize, 0);
+            std::vector<uint8_t> currentRow(rowSize);
+            std::vector<uint8_t> candidates[5];
+            for (std::vector<uint8_t>& candidate : candidates)
+            {
+                candidate.resize(rowSize);
+            }
+
+            for (std::size_t y = 0; y < height; ++y)
+            {
+                const float* row = rows.GetFloats(y);
+                for (std::size_t x = 0; x < width; ++x)
+                {
+                    float color[3];
+                    ApplyTonemap(tonemap, &row[x * 4], color);
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        currentRow[x * pixelSize + c] = static_cast<uint8_t>(color[c] * 255.0f + 0.5f);
+                    }
+                }
+
+                for (std::size_t i = 0; i < rowSize; ++i)
+                {
+                    int value = currentRow[i];
+                    int left = i >= pixelSize ? currentRow[i - pixelSize] : 0;
+                    int up = previousRow[i];
+                    int upLeft = i >= pixelSize ? previousRow[i - pixelSize] : 0;
+                    candidates[0][i] = static_cast<uint8_t>(value);
+                    candidates[1][i] = static_cast<uint8_t>(value - left);
+                    candidates[2][i] = static_cast<uint8_t>(value - up);
+                    candidates[3][i] = static_cast<uint8_t>(value - (left + up) / 2);
+                    candidates[4][i] = static_cast<uint8_t>(value - Paeth(left, up, upLeft));
+                }
+
+                int bestFilter = 0;
+                uint64_t bestScore = UINT64_MAX;
+                for (int filter = 0; filter < 5; ++filter)
+                {
+                    uint64_t score = 0;
+                    for (uint8_t value : candidates[filter])
+                    {
+                        score += std::abs(static_cast<int8_t>(value));
+                    }
+                    if (score < bestScore)
+                    {
+                        bestScore = score;
+                        bestFilter = filter;
+                    }
+                }
+
+                filtered.push_back(static_cast<uint8_t>(bestFilter));
+                filtered.insert(filtered.end(), candidates[bestFilter].begin(), candidates[bestFilter].end());
+                std::swap(previousRow, currentRow);
+            }
+
+            std::vector<uint8_t> output = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+            // 8 bit RGB, deflate, adaptive filtering, not interlaced
+            std::vector<uint8_t> header;
+            AppendBigEndian(header, static_cast<uint32_t>(width));
+            AppendBigEndian(header, static_cast<uint32_t>(height));
+            header.insert(header.end(), { 8, 2, 0, 0, 0 });
+
+            AppendPngChunk(output, "IHDR", header);
+            AppendPngChunk(output, "IDAT", Zlib::Compress(filtered.data(), filtered.size()));
+            AppendPngChunk(output, "IEND", {});
+            return output;
+        }
+    }
+
+    namespace ImageEncoding
+    {
+        std::vector<uint8_t> Encode(ImageFileFormat fileFormat, std::size_t width, std::size_t height,
+            DXGI_FORMAT format, const void* pixels, std::size_t rowPitch, const TonemapSettings& tonemap)
+        {
+            if (width == 0 || height == 0)
+            {
+                throw std::invalid_argument("Cannot encode an empty image");
+            }
+
+            RowReader rows(width, format, pixels, rowPitch);
+            switch (fileFormat)
+            {
+            case ImageFileFormat::ExrHalf:
+                return EncodeExr(true, width, height, rows);
+            case ImageFileFormat::ExrFloat:
+                return EncodeExr(false, width, height, rows);
+            case ImageFileFormat::Pfm:
+                return EncodePfm(width, height, rows);
+            case ImageFileFormat::Png:
+                return EncodePng(width, height, rows, tonemap);
+            default:
+                throw std::invalid_argument("Unknown image file format");
+            }
+        }
+
+        ImageFileFormat GetFileFormat(const std::string& filename, bool fullPrecision)
+        {
+            std::size_t dot = filename.find_last_of('.');
+            std::string extension = dot == std::string::npos ? std::string() : filename.substr(dot + 1);
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                [](unsigned char character) { return static_cast<char>(std::tolower(character)); });
+
+            if (extension == "exr")
+            {
+                return fullPrecision ? ImageFileFormat::ExrFloat : ImageFileFormat::ExrHalf;
+            }
+            if (extension == "pfm")
+            {
+                return ImageFileFormat::Pfm;
+            }
+            if (extension == "png")
+            {
+                return ImageFileFormat::Png;
+            }
+            throw std::invalid_argument("Image files must have an .exr, .pfm or .png extension");
+        }
+    }
+}
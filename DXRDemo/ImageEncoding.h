@@ -0,0 +1,37 @@
+#pragma once
+
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Tonemap.h"
+
+namespace DXRDemo
+{
+    enum class ImageFileFormat
+    {
+        // OpenEXR scanline images of half or single precision RGB, ZIP compressed
+        ExrHalf,
+        ExrFloat,
+        // Portable float map of single precision RGB, uncompressed
+        Pfm,
+        // 8 bit RGB PNG of the tonemapped image
+        Png
+    };
+
+    // File contents of RGBA radiance images. Alpha is dropped, and only PNGs are
+    // tonemapped, with the tonemap pass on the CPU. Its 8 bit values are rounded
+    // from the same values the back buffer receives, so the same image and
+    // settings always give the same file.
+    namespace ImageEncoding
+    {
+        // Pixels are DXGI_FORMAT_R16G16B16A16_FLOAT or DXGI_FORMAT_R32G32B32A32_FLOAT
+        std::vector<uint8_t> Encode(ImageFileFormat fileFormat, std::size_t width, std::size_t height,
+            DXGI_FORMAT format, const void* pixels, std::size_t rowPitch, const TonemapSettings& tonemap = {});
+
+        // Picks the format from the extension, .exr, .pfm or .png. EXRs are single
+        // precision if fullPrecision is set, half precision otherwise.
+        ImageFileFormat GetFileFormat(const std::string& filename, bool fullPrecision);
+    }
+}
@@ -0,0 +1,480 @@
+#include "ImageMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        using Plane = std::vector<float>;
+
+        constexpr float Pi = 3.14159265358979f;
+
+        // Viewing conditions and parameters of FLIP, as in its reference implementation
+        constexpr float PixelsPerDegree = 67.0f;
+        constexpr float ColorExponent = 0.7f;
+        constexpr float FeatureExponent = 0.5f;
+        constexpr float ColorCutoff = 0.4f;
+        constexpr float ColorCutoffError = 0.95f;
+        constexpr float FeatureWidth = 0.082f;
+
+        // Linear sRGB to CIE XYZ under D65 and back
+        constexpr float RgbToXyz[3][3] = {
+            { 0.4124564f, 0.3575761f, 0.1804375f },
+            { 0.2126729f, 0.7151522f, 0.0721750f },
+            { 0.0193339f, 0.1191920f, 0.9503041f } };
+        constexpr float XyzToRgb[3][3] = {
+            { 3.2404542f, -1.5371385f, -0.4985314f },
+            { -0.9692660f, 1.8760108f, 0.0415560f },
+            { 0.0556434f, -0.2040259f, 1.0572252f } };
+
+        void Transform(const float matrix[3][3], const float input[3], float output[3])
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                output[i] = matrix[i][0] * input[0] + matrix[i][1] * input[1] + matrix[i][2] * input[2];
+            }
+        }
+
+        // XYZ of linear RGB white, the reference white of the opponent spaces
+        void GetWhite(float white[3])
+        {
+            const float one[3] = { 1.0f, 1.0f, 1.0f };
+            Transform(RgbToXyz, one, white);
+        }
+
+        float SrgbToLinear(float value)
+        {
+            return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        void LinearRgbToYcxcz(const float rgb[3], float ycxcz[3])
+        {
+            float white[3];
+            GetWhite(white);
+            float xyz[3];
+            Transform(RgbToXyz, rgb, xyz);
+            float x = xyz[0] / white[0];
+            float y = xyz[1] / white[1];
+            float z = xyz[2] / white[2];
+            ycxcz[0] = 116.0f * y - 16.0f;
+            ycxcz[1] = 500.0f * (x - y);
+            ycxcz[2] = 200.0f * (y - z);
+        }
+
+        void YcxczToLinearRgb(const float ycxcz[3], float rgb[3])
+        {
+            float white[3];
+            GetWhite(white);
+            float y = (ycxcz[0] + 16.0f) / 116.0f;
+            float xyz[3] = {
+                (ycxcz[1] / 500.0f + y) * white[0],
+                y * white[1],
+                (y - ycxcz[2] / 200.0f) * white[2] };
+            Transform(XyzToRgb, xyz, rgb);
+        }
+
+        // CIELAB with the chroma scaled by the lightness, as the Hunt effect
+        // makes colors look less saturated in the dark
+        void LinearRgbToHuntLab(const float rgb[3], float lab[3])
+        {
+            float white[3];
+            GetWhite(white);
+            float xyz[3];
+            Transform(RgbToXyz, rgb, xyz);
+
+            const float delta = 6.0f / 29.0f;
+            float f[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                float t = xyz[c] / white[c];
+                f[c] = t > delta * delta * delta ? std::cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f;
+            }
+
+            float lightness = 116.0f * f[1] - 16.0f;
+            lab[0] = lightness;
+            lab[1] = 0.01f * lightness * 500.0f * (f[0] - f[1]);
+            lab[2] = 0.01f * lightness * 200.0f * (f[1] - f[2]);
+        }
+
+        float HyAb(const float first[3], const float second[3])
+        {
+            float a = first[1] - second[1];
+            float b = first[2] - second[2];
+            return std::abs(first[0] - second[0]) + std::sqrt(a * a + b * b);
+        }
+
+        // Odd length kernel of exp(-x^2 / (2 sigma^2)), normalized to a sum of 1
+        std::vector<float> GaussianKernel(float sigma, int radius)
+        {
+            std::vector<float> kernel(2 * radius + 1);
+            float sum = 0;
+            for (int x = -radius; x <= radius; ++x)
+            {
+                kernel[x + radius] = std::exp(-static_cast<float>(x * x) / (2.0f * sigma * sigma));
+                sum += kernel[x + radius];
+            }
+            for (float& weight : kernel)
+            {
+                weight /= sum;
+            }
+            return kernel;
+        }
+
+        // Convolves a plane with kernelX along rows and kernelY along columns,
+        // clamping at the borders
+        void Convolve(const Plane& input, Plane& output, std::size_t width, std::size_t height,
+            const std::vector<float>& kernelX, const std::vector<float>& kernelY, ThreadPool& threadPool)
+        {
+            Plane horizontal(width * height);
+            int radiusX = static_cast<int>(kernelX.size() / 2);
+            int radiusY = static_cast<int>(kernelY.size() / 2);
+            int lastX = static_cast<int>(width) - 1;
+            int lastY = static_cast<int>(height) - 1;
+
+            threadPool.ParallelFor(height, 16, [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t y = begin; y < end; ++y)
+                {
+                    const float* row = &input[y * width];
+                    for (int x = 0; x <= lastX; ++x)
+                    {
+                        float sum = 0;
+                        for (int k = -radiusX; k <= radiusX; ++k)
+                        {
+                            sum += kernelX[k + radiusX] * row[std::clamp(x + k, 0, lastX)];
+                        }
+                        horizontal[y * width + x] = sum;
+                    }
+                }
+            });
+
+            output.resize(width * height);
+            threadPool.ParallelFor(height, 16, [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t y = begin; y < end; ++y)
+                {
+                    float* row = &output[y * width];
+                    std::fill(row, row + width, 0.0f);
+                    for (int k = -radiusY; k <= radiusY; ++k)
+                    {
+                        const float* source = &horizontal[std::clamp(static_cast<int>(y) + k, 0, lastY) * width];
+                        float weight = kernelY[k + radiusY];
+                        for (std::size_t x = 0; x < width; ++x)
+                        {
+                            row[x] += weight * source[x];
+                        }
+                    }
+                }
+            });
+        }
+
+        // Sum over the pixels, split across the thread pool
+        double Sum(std::size_t width, std::size_t height, ThreadPool& threadPool,
+            const std::function<double(std::size_t)>& pixelValue)
+        {
+            std::mutex mutex;
+            double sum = 0;
+            threadPool.ParallelFor(height, 16, [&](std::size_t begin, std::size_t end)
+            {
+                double rangeSum = 0;
+                for (std::size_t i = begin * width; i < end * width; ++i)
+                {
+                    rangeSum += pixelValue(i);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                sum += rangeSum;
+            });
+            return sum;
+        }
+
+        // Tonemapped RGB planes of an RGBA image
+        void Display(const float* image, std::size_t pixelCount, const TonemapSettings& tonemap, Plane display[3])
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                display[c].resize(pixelCount);
+            }
+            for (std::size_t i = 0; i < pixelCount; ++i)
+            {
+                float color[3];
+                ApplyTonemap(tonemap, &image[i * 4], color);
+                for (int c = 0; c < 3; ++c)
+                {
+                    display[c][i] = color[c];
+                }
+            }
+        }
+
+        double Ssim(const Plane imageDisplay[3], const Plane referenceDisplay[3], std::size_t width, std::size_t height,
+            ThreadPool& threadPool)
+        {
+            std::size_t pixelCount = width * height;
+            Plane moments[5];
+            for (Plane& moment : moments)
+            {
+                moment.resize(pixelCount);
+            }
+            for (std::size_t i = 0; i < pixelCount; ++i)
+            {
+                float x = 0.2126f * imageDisplay[0][i] + 0.7152f * imageDisplay[1][i] + 0.0722f * imageDisplay[2][i];
+                float y = 0.2126f * referenceDisplay[0][i] + 0.7152f * referenceDisplay[1][i] + 0.0722f * referenceDisplay[2][i];
+                moments[0][i] = x;
+                moments[1][i] = y;
+                moments[2][i] = x * x;
+                moments[3][i] = y * y;
+                moments[4][i] = x * y;
+            }
+
+            std::vector<float> window = GaussianKernel(1.5f, 5);
+            for (Plane& moment : moments)
+            {
+                Convolve(moment, moment, width, height, window, window, threadPool);
+            }
+
+            const double c1 = 0.01 * 0.01;
+            const double c2 = 0.03 * 0.03;
+            double sum = Sum(width, height, threadPool, [&](std::size_t i)
+            {
+                double meanX = moments[0][i];
+                double meanY = moments[1][i];
+                double varianceX = moments[2][i] - meanX * meanX;
+                double varianceY = moments[3][i] - meanY * meanY;
+                double covariance = moments[4][i] - meanX * meanY;
+                return ((2 * meanX * meanY + c1) * (2 * covariance + c2)) /
+                    ((meanX * meanX + meanY * meanY + c1) * (varianceX + varianceY + c2));
+            });
+            return sum / pixelCount;
+        }
+
+        // Opponent color planes of an image filtered with the contrast sensitivity
+        // functions of the achromatic, red-green and blue-yellow channels, each the
+        // sum of one or two Gaussians. Also returns the unfiltered achromatic plane,
+        // normalized to [0, 1], for the feature detection.
+        void FilterOpponentColors(const Plane display[3], std::size_t width, std::size_t height, ThreadPool& threadPool,
+            Plane filtered[3], Plane& achromatic)
+        {
+            std::size_t pixelCount = width * height;
+            Plane ycxcz[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                ycxcz[c].resize(pixelCount);
+            }
+            achromatic.resize(pixelCount);
+            for (std::size_t i = 0; i < pixelCount; ++i)
+            {
+                float rgb[3] = { SrgbToLinear(display[0][i]), SrgbToLinear(display[1][i]), SrgbToLinear(display[2][i]) };
+                float opponent[3];
+                LinearRgbToYcxcz(rgb, opponent);
+                for (int c = 0; c < 3; ++c)
+                {
+                    ycxcz[c][i] = opponent[c];
+                }
+                achromatic[i] = (opponent[0] + 16.0f) / 116.0f;
+            }
+
+            // Amplitude and scale of the Gaussians of each channel, in degrees
+            const float csf[3][2][2] = {
+                { { 1.0f, 0.0047f }, { 0.0f, 1e-5f } },
+                { { 1.0f, 0.0053f }, { 0.0f, 1e-5f } },
+                { { 34.1f, 0.04f }, { 13.5f, 0.025f } } };
+            const float maxScale = 0.04f;
+            int radius = static_cast<int>(std::ceil(3.0f * std::sqrt(maxScale / (2.0f * Pi * Pi)) * PixelsPerDegree));
+
+            for (int c = 0; c < 3; ++c)
+            {
+                // Each Gaussian is separable, the kernel is normalized over both
+                std::vector<float> kernels[2];
+                float weights[2];
+                float total = 0;
+                for (int g = 0; g < 2; ++g)
+                {
+                    float amplitude = csf[c][g][0];
+                    float scale = csf[c][g][1];
+                    kernels[g].resize(2 * radius + 1);
+                    float sum = 0;
+                    for (int x = -radius; x <= radius; ++x)
+                    {
+                        float degrees = x / PixelsPerDegree;
+                        kernels[g][x + radius] = std::exp(-Pi * Pi * degrees * degrees / scale);
+                        sum += kernels[g][x + radius];
+                    }
+                    weights[g] = amplitude * std::sqrt(Pi / scale);
+                    total += weights[g] * sum * sum;
+                }
+
+                filtered[c].assign(pixelCount, 0.0f);
+                Plane part;
+                for (int g = 0; g < 2; ++g)
+                {
+                    if (weights[g] == 0)
+                    {
+                        continue;
+                    }
+                    Convolve(ycxcz[c], part, width, height, kernels[g], kernels[g], threadPool);
+                    float weight = weights[g] / total;
+                    for (std::size_t i = 0; i < pixelCount; ++i)
+                    {
+                        filtered[c][i] += weight * part[i];
+                    }
+                }
+            }
+        }
+
+        // Magnitudes of the edge and point responses of the achromatic plane, from
+        // first and second Gaussian derivatives with their positive and negative
+        // weights each normalized to 1
+        void DetectFeatures(const Plane& achromatic, std::size_t width, std::size_t height, ThreadPool& threadPool,
+            Plane& edges, Plane& points)
+        {
+            float sigma = 0.5f * FeatureWidth * PixelsPerDegree;
+            int radius = static_cast<int>(std::ceil(3.0f * sigma));
+
+            std::vector<float> gaussian(2 * radius + 1);
+            std::vector<float> firstDerivative(2 * radius + 1);
+            std::vector<float> secondDerivative(2 * radius + 1);
+            float gaussianSum = 0;
+            for (int x = -radius; x <= radius; ++x)
+            {
+                float value = std::exp(-static_cast<float>(x * x) / (2.0f * sigma * sigma));
+                gaussian[x + radius] = value;
+                firstDerivative[x + radius] = -x * value;
+                secondDerivative[x + radius] = (x * x / (sigma * sigma) - 1.0f) * value;
+                gaussianSum += value;
+            }
+
+            for (std::vector<float>* kernel : { &firstDerivative, &secondDerivative })
+            {
+                float positive = 0;
+                float negative = 0;
+                for (float weight : *kernel)
+                {
+                    (weight > 0 ? positive : negative) += weight;
+                }
+                for (float& weight : *kernel)
+                {
+                    weight /= (weight > 0 ? positive : -negative) * gaussianSum;
+                }
+            }
+
+            Plane alongX;
+            Plane alongY;
+            Plane* magnitudes[2] = { &edges, &points };
+            const std::vector<float>* derivatives[2] = { &firstDerivative, &secondDerivative };
+            for (int feature = 0; feature < 2; ++feature)
+            {
+                Convolve(achromatic, alongX, width, height, *derivatives[feature], gaussian, threadPool);
+                Convolve(achromatic, alongY, width, height, gaussian, *derivatives[feature], threadPool);
+                Plane& magnitude = *magnitudes[feature];
+                magnitude.resize(width * height);
+                for (std::size_t i = 0; i < magnitude.size(); ++i)
+                {
+                    magnitude[i] = std::sqrt(alongX[i] * alongX[i] + alongY[i] * alongY[i]);
+                }
+            }
+        }
+
+        double Flip(const Plane imageDisplay[3], const Plane referenceDisplay[3], std::size_t width, std::size_t height,
+            ThreadPool& threadPool)
+        {
+            Plane imageFiltered[3], referenceFiltered[3];
+            Plane imageAchromatic, referenceAchromatic;
+            FilterOpponentColors(imageDisplay, width, height, threadPool, imageFiltered, imageAchromatic);
+            FilterOpponentColors(referenceDisplay, width, height, threadPool, referenceFiltered, referenceAchromatic);
+
+            Plane imageEdges, imagePoints, referenceEdges, referencePoints;
+            DetectFeatures(imageAchromatic, width, height, threadPool, imageEdges, imagePoints);
+            DetectFeatures(referenceAchromatic, width, height, threadPool, referenceEdges, referencePoints);
+
+            // Largest color difference, between green and blue, remapped to 1
+            const float green[3] = { 0.0f, 1.0f, 0.0f };
+            const float blue[3] = { 0.0f, 0.0f, 1.0f };
+            float greenLab[3], blueLab[3];
+            LinearRgbToHuntLab(green, greenLab);
+            LinearRgbToHuntLab(blue, blueLab);
+            float maxColorError = std::pow(HyAb(greenLab, blueLab), ColorExponent);
+            float cutoff = ColorCutoff * maxColorError;
+
+            double sum = Sum(width, height, threadPool, [&](std::size_t i)
+            {
+                float labs[2][3];
+                const Plane* filtered[2] = { imageFiltered, referenceFiltered };
+                for (int image = 0; image < 2; ++image)
+                {
+                    float ycxcz[3] = { filtered[image][0][i], filtered[image][1][i], filtered[image][2][i] };
+                    float rgb[3];
+                    YcxczToLinearRgb(ycxcz, rgb);
+                    for (float& value : rgb)
+                    {
+                        value = std::clamp(value, 0.0f, 1.0f);
+                    }
+                    LinearRgbToHuntLab(rgb, labs[image]);
+                }
+
+                // Small color differences are compressed into [0, ColorCutoffError),
+                // larger ones into the rest
+                float colorError = std::pow(HyAb(labs[0], labs[1]), ColorExponent);
+                colorError = colorError < cutoff ?
+                    ColorCutoffError * colorError / cutoff :
+                    ColorCutoffError + (colorError - cutoff) / (maxColorError - cutoff) * (1.0f - ColorCutoffError);
+
+                float featureDifference = std::max(
+                    std::abs(imageEdges[i] - referenceEdges[i]),
+                    std::abs(imagePoints[i] - referencePoints[i]));
+                float featureError = std::pow(featureDifference / std::sqrt(2.0f), FeatureExponent);
+
+                return static_cast<double>(std::pow(colorError, 1.0f - featureError));
+            });
+            return sum / (width * height);
+        }
+    }
+
+    namespace ImageMetrics
+    {
+        Comparison Compare(const float* image, const float* reference, std::size_t width, std::size_t height,
+            const TonemapSettings& tonemap, ThreadPool& threadPool)
+        {
+            Comparison comparison;
+            std::size_t pixelCount = width * height;
+            if (pixelCount == 0)
+            {
+                return comparison;
+            }
+
+            double squaredError = 0;
+            double squaredReference = 0;
+            double peak = 0;
+            for (std::size_t i = 0; i < pixelCount; ++i)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    double difference = static_cast<double>(image[i * 4 + c]) - reference[i * 4 + c];
+                    squaredError += difference * difference;
+                    squaredReference += static_cast<double>(reference[i * 4 + c]) * reference[i * 4 + c];
+                    peak = std::max(peak, static_cast<double>(reference[i * 4 + c]));
+                }
+            }
+
+            double meanSquaredError = squaredError / (pixelCount * 3);
+            comparison.Rmse = std::sqrt(meanSquaredError);
+            comparison.RelativeRmse = squaredReference > 0 ? std::sqrt(squaredError / squaredReference) : 0;
+            comparison.Psnr = meanSquaredError > 0 ?
+                10.0 * std::log10(peak * peak / meanSquaredError) :
+                std::numeric_limits<double>::infinity();
+
+            Plane imageDisplay[3], referenceDisplay[3];
+            Display(image, pixelCount, tonemap, imageDisplay);
+            Display(reference, pixelCount, tonemap, referenceDisplay);
+
+            comparison.Ssim = Ssim(imageDisplay, referenceDisplay, width, height, threadPool);
+            comparison.Flip = Flip(imageDisplay, referenceDisplay, width, height, threadPool);
+            return comparison;
+        }
+    }
+}
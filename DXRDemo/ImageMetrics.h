@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include "Tonemap.h"
+
+namespace DXRDemo
+{
+    class ThreadPool;
+
+    // Error of a rendered image against a reference rendering of the same view.
+    //
+    // The RMSE and PSNR measure the linear radiance. SSIM and FLIP measure what is
+    // displayed, both images are tonemapped first. SSIM is computed on the
+    // luminance with the usual 11x11 Gaussian window of standard deviation 1.5.
+    // FLIP is the LDR variant of Andersson et al. 2020 with its default viewing
+    // conditions of 67 pixels per degree: color differences of images filtered
+    // with the contrast sensitivity of the eye, raised where edges and points
+    // differ, averaged over the pixels.
+    namespace ImageMetrics
+    {
+        struct Comparison
+        {
+            double Rmse = 0;
+            // RMSE relative to the RMS of the reference
+            double RelativeRmse = 0;
+            // Peak signal to noise ratio against the brightest reference value, in dB
+            double Psnr = 0;
+            // 1 for identical images
+            double Ssim = 0;
+            // 0 for identical images, up to 1
+            double Flip = 0;
+        };
+
+        // Images are width * height RGBA floats, alpha is ignored
+        Comparison Compare(const float* image, const float* reference, std::size_t width, std::size_t height,
+            const TonemapSettings& tonemap, ThreadPool& threadPool);
+    }
+}
@@ -0,0 +1,135 @@
+#include "ImageOutputBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "ImageEncoding.h"
+#include "ImageWriter.h"
+#include "PixelConversion.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        const size_t Width = 1920;
+        const size_t Height = 1080;
+        const int FrameCount = 64;
+
+        // RGBA float radiance of a smooth gradient with Monte Carlo like noise,
+        // different for every seed
+        std::vector<float> CreateFrame(uint32_t seed)
+        {
+            std::vector<float> frame(Width * Height * 4);
+            std::mt19937 generator(seed);
+            std::exponential_distribution<float> noise(1.0f);
+            for (size_t y = 0; y < Height; ++y)
+            {
+                for (size_t x = 0; x < Width; ++x)
+                {
+                    float* pixel = &frame[(y * Width + x) * 4];
+                    float light = 0.1f + 1.5f * static_cast<float>(x) / Width * static_cast<float>(y) / Height;
+                    float sample = noise(generator);
+                    pixel[0] = 0.9f * light * sample;
+                    pixel[1] = 0.6f * light * sample;
+                    pixel[2] = 0.3f * light * sample;
+                    pixel[3] = 1.0f;
+                }
+            }
+            return frame;
+        }
+
+        double Milliseconds(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end)
+        {
+            return std::chrono::duration<double, std::milli>(end - start).count();
+        }
+    }
+
+    void RunImageOutputBenchmark(const std::string& filename)
+    {
+        std::ofstream file(filename);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open benchmark file for writing");
+        }
+
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "DXRDemoImageOutputBenchmark";
+        std::filesystem::create_directories(directory);
+
+        // A few distinct frames, cycled through, in both radiance formats
+        const uint32_t distinctFrames = 4;
+        std::vector<std::vector<float>> floatFrames;
+        std::vector<std::vector<uint16_t>> halfFrames;
+        for (uint32_t i = 0; i < distinctFrames; ++i)
+        {
+            floatFrames.push_back(CreateFrame(i));
+            halfFrames.emplace_back(Width * Height * 4);
+            PixelConversion::Rgba32fToRgba16f(floatFrames.back().data(), halfFrames.back().data(), Width * Height);
+        }
+
+        struct Format
+        {
+            ImageFileFormat FileFormat;
+            const char* Name;
+            const char* Extension;
+            // Radiance format the frames come in, as the renderer would give them
+            bool FullPrecision;
+        };
+        const Format formats[] = {
+            { ImageFileFormat::ExrHalf, "exr_half", ".exr", false },
+            { ImageFileFormat::ExrFloat, "exr_float", ".exr", true },
+            { ImageFileFormat::Pfm, "pfm", ".pfm", false },
+            { ImageFileFormat::Png, "png", ".png", false } };
+
+        ImageWriter writer;
+        file << "format,width,height,frames,encode_ms,write_call_ms_mean,write_call_ms_max,total_ms,frames_per_second,bytes_per_frame\n";
+        for (const Format& format : formats)
+        {
+            DXGI_FORMAT pixelFormat = format.FullPrecision ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R16G16B16A16_FLOAT;
+            size_t rowPitch = Width * 4 * (format.FullPrecision ? sizeof(float) : sizeof(uint16_t));
+            auto pixels = [&](int frame) -> const void*
+            {
+                return format.FullPrecision ?
+                    static_cast<const void*>(floatFrames[frame % distinctFrames].data()) :
+                    static_cast<const void*>(halfFrames[frame % distinctFrames].data());
+            };
+
+            // One frame on the calling thread
+            double encodeMilliseconds = std::numeric_limits<double>::max();
+            size_t encodedSize = 0;
+            for (int run = 0; run < 3; ++run)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                std::vector<uint8_t> encoded = ImageEncoding::Encode(format.FileFormat, Width, Height, pixelFormat, pixels(run), rowPitch);
+                encodeMilliseconds = std::min(encodeMilliseconds, Milliseconds(start, std::chrono::high_resolution_clock::now()));
+                encodedSize = encoded.size();
+            }
+
+            // A sequence, as the renderer would hand it over
+            double writeCallTotal = 0;
+            double writeCallMax = 0;
+            auto sequenceStart = std::chrono::high_resolution_clock::now();
+            for (int frame = 0; frame < FrameCount; ++frame)
+            {
+                std::filesystem::path path = directory / (std::string(format.Name) + "_" + std::to_string(frame) + format.Extension);
+                auto start = std::chrono::high_resolution_clock::now();
+                writer.Write(path.string(), format.FileFormat, Width, Height, pixelFormat, pixels(frame), rowPitch);
+                double writeCall = Milliseconds(start, std::chrono::high_resolution_clock::now());
+                writeCallTotal += writeCall;
+                writeCallMax = std::max(writeCallMax, writeCall);
+            }
+            writer.Flush();
+            double total = Milliseconds(sequenceStart, std::chrono::high_resolution_clock::now());
+
+            file << format.Name << "," << Width << "," << Height << "," << FrameCount << ","
+                << encodeMilliseconds << "," << writeCallTotal / FrameCount << "," << writeCallMax << ","
+                << total << "," << FrameCount * 1000.0 / total << "," << encodedSize << "\n";
+        }
+
+        std::filesystem::remove_all(directory);
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    // Encodes and writes sequences of synthetic frames in each image file format
+    // through an ImageWriter, and writes as CSV how long encoding one frame takes,
+    // how long the caller is held up per frame and how many frames per second
+    // reach the disk. The frames go to a temporary directory and are deleted.
+    void RunImageOutputBenchmark(const std::string& filename);
+}
@@ -0,0 +1,134 @@
+#include "ImageWriter.h"
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace DXRDemo
+{
+    ImageWriter::ImageWriter(uint32_t encoderThreadCount, std::size_t maxPendingBytes) :
+        _maxPendingBytes(maxPendingBytes),
+        _encoders(encoderThreadCount),
+        _diskWriter(1)
+    {
+    }
+
+    ImageWriter::~ImageWriter()
+    {
+        _WaitForPendingImages();
+    }
+
+    void ImageWriter::Write(const std::string& filename, ImageFileFormat fileFormat, std::size_t width, std::size_t height,
+        DXGI_FORMAT format, const void* pixels, std::size_t rowPitch, const TonemapSettings& tonemap)
+    {
+        if (format != DXGI_FORMAT_R16G16B16A16_FLOAT && format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+        {
+            throw std::invalid_argument("Unsupported image format for writing");
+        }
+
+        std::size_t packedRowPitch = width * (format == DXGI_FORMAT_R32G32B32A32_FLOAT ? 4 * sizeof(float) : 4 * sizeof(uint16_t));
+        std::size_t bytes = packedRowPitch * height;
+
+        // Wait for room, unless nothing is queued so that an image larger than the
+        // limit still goes through
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this, bytes]()
+            {
+                return _pendingImages == 0 || _pendingBytes + bytes <= _maxPendingBytes;
+            });
+            _pendingBytes += bytes;
+            ++_pendingImages;
+        }
+
+        // Shared so the tasks carrying it stay copyable
+        auto copy = std::make_shared<std::vector<uint8_t>>(bytes);
+        for (std::size_t y = 0; y < height; ++y)
+        {
+            std::memcpy(copy->data() + y * packedRowPitch, static_cast<const uint8_t*>(pixels) + y * rowPitch, packedRowPitch);
+        }
+
+        _encoders.Submit([this, filename, fileFormat, width, height, format, tonemap, packedRowPitch, bytes, copy]() mutable
+        {
+            std::shared_ptr<std::vector<uint8_t>> encoded;
+            try
+            {
+                encoded = std::make_shared<std::vector<uint8_t>>(
+                    ImageEncoding::Encode(fileFormat, width, height, format, copy->data(), packedRowPitch, tonemap));
+            }
+            catch (...)
+            {
+                _Finish(bytes, std::current_exception());
+                return;
+            }
+            copy.reset();
+
+            _diskWriter.Submit([this, filename, bytes, encoded]()
+            {
+                std::exception_ptr error;
+                try
+                {
+                    std::ofstream file(filename, std::ios::binary);
+                    file.write(reinterpret_cast<const char*>(encoded->data()), static_cast<std::streamsize>(encoded->size()));
+                    if (!file)
+                    {
+                        throw std::runtime_error("Could not write image file " + filename);
+                    }
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                _Finish(bytes, error);
+            });
+        });
+    }
+
+    void ImageWriter::Flush()
+    {
+        _WaitForPendingImages();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_error)
+        {
+            std::exception_ptr error = _error;
+            _error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    uint64_t ImageWriter::GetWrittenCount()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _writtenCount;
+    }
+
+    void ImageWriter::_Finish(std::size_t bytes, std::exception_ptr error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pendingBytes -= bytes;
+            --_pendingImages;
+            if (error)
+            {
+                if (!_error)
+                {
+                    _error = error;
+                }
+            }
+            else
+            {
+                ++_writtenCount;
+            }
+        }
+        _condition.notify_all();
+    }
+
+    void ImageWriter::_WaitForPendingImages()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return _pendingImages == 0; });
+    }
+}
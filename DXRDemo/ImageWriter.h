@@ -0,0 +1,62 @@
+#pragma once
+
+#include <dxgiformat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ImageEncoding.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    // Writes images to disk in the background, so long frame sequences can be
+    // saved without stalling the frames that follow.
+    //
+    // Write copies the pixels and returns. Images are encoded in parallel on the
+    // writer's own threads, away from the pool the denoiser uses, then handed to
+    // one more thread that streams them to disk. Write only waits when
+    // the images queued hold more than the given number of bytes, so a disk that
+    // cannot keep up slows the caller down instead of exhausting memory.
+    class ImageWriter final
+    {
+    public:
+        explicit ImageWriter(uint32_t encoderThreadCount = std::max(std::thread::hardware_concurrency() / 2, 1u),
+            std::size_t maxPendingBytes = std::size_t(1) << 30);
+        ImageWriter(const ImageWriter&) = delete;
+        ImageWriter& operator=(const ImageWriter&) = delete;
+        // Waits for the queued images to be written
+        ~ImageWriter();
+
+        // Same pixel formats as ImageEncoding::Encode
+        void Write(const std::string& filename, ImageFileFormat fileFormat, std::size_t width, std::size_t height,
+            DXGI_FORMAT format, const void* pixels, std::size_t rowPitch, const TonemapSettings& tonemap = {});
+
+        // Waits until every queued image is on disk, then rethrows the first error
+        // encoding or writing one of them
+        void Flush();
+
+        // Images on disk so far
+        uint64_t GetWrittenCount();
+
+    private:
+        std::size_t _maxPendingBytes;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::size_t _pendingBytes = 0;
+        std::size_t _pendingImages = 0;
+        uint64_t _writtenCount = 0;
+        std::exception_ptr _error;
+        // Declared last so their threads stop before anything they use goes away
+        ThreadPool _encoders;
+        ThreadPool _diskWriter;
+
+        // Releases a queued image, recording the error that ended it, if any
+        void _Finish(std::size_t bytes, std::exception_ptr error);
+        void _WaitForPendingImages();
+    };
+}
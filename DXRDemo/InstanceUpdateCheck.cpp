@@ -0,0 +1,236 @@
+#include "InstanceUpdateCheck.h"
+
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "InstanceUpdateTracker.h"
+#include "DXRUtils/TopLevelASGenerator.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // Game refits up to this fraction of moved instances
+        const float RefitMaxDirtyFraction = 0.25f;
+
+        // Instance ranges of the meshes the scene starts with
+        const InstanceRange MeshA = { 0, 4 };
+        const InstanceRange MeshB = { 4, 2 };
+        const InstanceRange MeshC = { 6, 6 };
+
+        struct Step
+        {
+            std::string Name;
+            std::function<void(InstanceUpdateTracker&)> Apply;
+            std::vector<InstanceRange> ExpectedRanges;
+            TopLevelASUpdate ExpectedUpdate;
+            // Whether Apply must be refused for an index past the instances
+            bool ExpectOutOfRange = false;
+        };
+
+        void MarkDirty(InstanceUpdateTracker& tracker, const InstanceRange& range)
+        {
+            for (uint32_t i = range.First; i < range.First + range.Count; ++i)
+            {
+                tracker.MarkDirty(i);
+            }
+        }
+
+        bool SameRanges(const std::vector<InstanceRange>& a, const std::vector<InstanceRange>& b)
+        {
+            if (a.size() != b.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                if (a[i].First != b[i].First || a[i].Count != b[i].Count)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::string FormatRanges(const std::vector<InstanceRange>& ranges)
+        {
+            std::ostringstream stream;
+            for (size_t i = 0; i < ranges.size(); ++i)
+            {
+                stream << (i > 0 ? " " : "") << ranges[i].First << "-" << ranges[i].First + ranges[i].Count - 1;
+            }
+            return stream.str();
+        }
+
+        const char* FormatUpdate(TopLevelASUpdate update)
+        {
+            switch (update)
+            {
+            case TopLevelASUpdate::None:
+                return "none";
+            case TopLevelASUpdate::Refit:
+                return "refit";
+            default:
+                return "rebuild";
+            }
+        }
+
+        std::vector<Step> CreateSteps()
+        {
+            return {
+                { "add meshes", [](InstanceUpdateTracker& t) { t.Add(MeshA.Count); t.Add(MeshB.Count); t.Add(MeshC.Count); },
+                    { { 0, 12 } }, TopLevelASUpdate::Rebuild },
+                { "nothing moved", [](InstanceUpdateTracker&) {},
+                    {}, TopLevelASUpdate::None },
+                { "move one mesh", [](InstanceUpdateTracker& t) { MarkDirty(t, MeshB); },
+                    { MeshB }, TopLevelASUpdate::Refit },
+                { "move one mesh twice", [](InstanceUpdateTracker& t) { MarkDirty(t, MeshB); MarkDirty(t, MeshB); },
+                    { MeshB }, TopLevelASUpdate::Refit },
+                { "move scattered instances", [](InstanceUpdateTracker& t) { t.MarkDirty(11); t.MarkDirty(0); t.MarkDirty(3); t.MarkDirty(2); },
+                    { { 0, 1 }, { 2, 2 }, { 11, 1 } }, TopLevelASUpdate::Rebuild },
+                { "move at the refit limit", [](InstanceUpdateTracker& t) { t.MarkDirty(6); t.MarkDirty(7); t.MarkDirty(8); },
+                    { { 6, 3 } }, TopLevelASUpdate::Refit },
+                { "move two meshes", [](InstanceUpdateTracker& t) { MarkDirty(t, MeshC); MarkDirty(t, MeshA); },
+                    { MeshA, MeshC }, TopLevelASUpdate::Rebuild },
+                { "add a mesh", [](InstanceUpdateTracker& t) { t.Add(3); },
+                    { { 12, 3 } }, TopLevelASUpdate::Rebuild },
+                // Few instances changed, but a refit cannot take in a new one
+                { "add an instance and move one", [](InstanceUpdateTracker& t) { t.Add(); t.MarkDirty(0); },
+                    { { 0, 1 }, { 15, 1 } }, TopLevelASUpdate::Rebuild },
+                { "remove an instance", [](InstanceUpdateTracker& t) { t.Remove(4); },
+                    { { 4, 11 } }, TopLevelASUpdate::Rebuild },
+                { "remove the last instance", [](InstanceUpdateTracker& t) { t.Remove(14); },
+                    {}, TopLevelASUpdate::Rebuild },
+                { "move after removals", [](InstanceUpdateTracker& t) { t.MarkDirty(13); },
+                    { { 13, 1 } }, TopLevelASUpdate::Refit },
+                { "move past the last instance", [](InstanceUpdateTracker& t) { t.MarkDirty(14); },
+                    {}, TopLevelASUpdate::None, true },
+                { "remove past the last instance", [](InstanceUpdateTracker& t) { t.Remove(14); },
+                    {}, TopLevelASUpdate::None, true },
+                // The moved instance before the removed one keeps its slot, the one
+                // after it shifts down with every later instance
+                { "remove between moved instances", [](InstanceUpdateTracker& t) { t.MarkDirty(2); t.MarkDirty(9); t.Remove(5); },
+                    { { 2, 1 }, { 5, 8 } }, TopLevelASUpdate::Rebuild },
+            };
+        }
+
+        // The generator forwards its instance changes to its tracker. It cannot
+        // build without a device, so its instances are only ever added.
+        bool CheckGenerator(std::ostream& output)
+        {
+            nv_helpers_dx12::TopLevelASGenerator generator;
+            for (uint32_t i = 0; i < MeshA.Count + MeshB.Count + MeshC.Count; ++i)
+            {
+                generator.AddInstance(nullptr, DirectX::XMMatrixIdentity(), i, 0);
+            }
+            generator.SetInstanceTransform(3, DirectX::XMMatrixTranslation(1.0f, 0.0f, 0.0f));
+            generator.RemoveInstance(10);
+
+            bool outOfRange = false;
+            try
+            {
+                generator.SetInstanceTransform(11, DirectX::XMMatrixIdentity());
+            }
+            catch (const std::out_of_range&)
+            {
+                outOfRange = true;
+            }
+
+            const InstanceUpdateTracker& updates = generator.GetInstanceUpdates();
+            std::vector<InstanceRange> ranges = updates.GetDirtyRanges();
+            TopLevelASUpdate update = updates.GetUpdate(RefitMaxDirtyFraction);
+            bool passed = outOfRange && updates.GetInstanceCount() == 11 && generator.GetDirtyInstanceCount() == 11 &&
+                SameRanges(ranges, { { 0, 11 } }) && update == TopLevelASUpdate::Rebuild;
+            if (!passed)
+            {
+                std::cerr << "Generator: expected instances 0-10 dirty and a rebuild, got " << FormatRanges(ranges)
+                    << " and " << FormatUpdate(update) << std::endl;
+            }
+
+            output << "generator before its first build,"
+                << updates.GetInstanceCount() << ","
+                << updates.GetDirtyInstances().size() << ","
+                << FormatRanges(ranges) << ","
+                << FormatUpdate(update) << ","
+                << (passed ? 1 : 0) << "\n";
+            return passed;
+        }
+    }
+
+    bool RunInstanceUpdateCheck(const std::string& filename)
+    {
+        std::ofstream output(filename);
+        if (!output)
+        {
+            throw std::runtime_error("Could not open " + filename);
+        }
+
+        bool passed = true;
+        output << "step,instances,dirty,dirty_ranges,update,passed\n";
+
+        InstanceUpdateTracker tracker;
+        for (const Step& step : CreateSteps())
+        {
+            bool outOfRange = false;
+            try
+            {
+                step.Apply(tracker);
+            }
+            catch (const std::out_of_range&)
+            {
+                outOfRange = true;
+            }
+
+            std::vector<InstanceRange> ranges = tracker.GetDirtyRanges();
+            TopLevelASUpdate update = tracker.GetUpdate(RefitMaxDirtyFraction);
+
+            // Each instance is listed once however often it moved
+            uint32_t expectedDirty = 0;
+            for (const InstanceRange& range : step.ExpectedRanges)
+            {
+                expectedDirty += range.Count;
+            }
+
+            bool stepPassed = true;
+            if (outOfRange != step.ExpectOutOfRange)
+            {
+                std::cerr << step.Name << ": " << (outOfRange ? "refused" : "accepted") << " the instance index" << std::endl;
+                stepPassed = false;
+            }
+            if (!SameRanges(ranges, step.ExpectedRanges) || tracker.GetDirtyInstances().size() != expectedDirty)
+            {
+                std::cerr << step.Name << ": expected instances " << FormatRanges(step.ExpectedRanges)
+                    << " dirty, got " << FormatRanges(ranges) << std::endl;
+                stepPassed = false;
+            }
+            if (update != step.ExpectedUpdate)
+            {
+                std::cerr << step.Name << ": expected a " << FormatUpdate(step.ExpectedUpdate)
+                    << ", got a " << FormatUpdate(update) << std::endl;
+                stepPassed = false;
+            }
+
+            output << step.Name << ","
+                << tracker.GetInstanceCount() << ","
+                << tracker.GetDirtyInstances().size() << ","
+                << FormatRanges(ranges) << ","
+                << FormatUpdate(update) << ","
+                << (stepPassed ? 1 : 0) << "\n";
+            passed = passed && stepPassed;
+
+            // Build the structure the way Game does, leaving nothing dirty
+            tracker.MarkBuilt();
+            if (tracker.GetUpdate(RefitMaxDirtyFraction) != TopLevelASUpdate::None || !tracker.GetDirtyRanges().empty())
+            {
+                std::cerr << step.Name << ": instances still dirty after the build" << std::endl;
+                passed = false;
+            }
+        }
+
+        passed = CheckGenerator(output) && passed;
+        return passed;
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    // Moves, adds and removes the instances of a synthetic scene of meshes, each
+    // owning a range of top-level AS instances, and writes the instances marked
+    // dirty and the update chosen at every step as CSV. Returns whether each step
+    // marked exactly the expected instance ranges, refitted when few instances
+    // moved, and rebuilt when many moved or any were added or removed.
+    bool RunInstanceUpdateCheck(const std::string& filename);
+}
@@ -0,0 +1,102 @@
+#include "InstanceUpdateTracker.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    void InstanceUpdateTracker::Add(uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            _dirtyInstances.push_back(GetInstanceCount());
+            _instanceDirty.push_back(true);
+        }
+    }
+
+    void InstanceUpdateTracker::Remove(uint32_t index)
+    {
+        if (index >= GetInstanceCount())
+        {
+            throw std::out_of_range("Invalid top-level AS instance index");
+        }
+
+        _instanceDirty.erase(_instanceDirty.begin() + index);
+
+        // The instances after the removed one now sit in other slots
+        _dirtyInstances.erase(
+            std::remove_if(_dirtyInstances.begin(), _dirtyInstances.end(), [index](uint32_t i) { return i >= index; }),
+            _dirtyInstances.end());
+        for (uint32_t i = index; i < GetInstanceCount(); ++i)
+        {
+            _instanceDirty[i] = true;
+            _dirtyInstances.push_back(i);
+        }
+    }
+
+    void InstanceUpdateTracker::MarkDirty(uint32_t index)
+    {
+        if (index >= GetInstanceCount())
+        {
+            throw std::out_of_range("Invalid top-level AS instance index");
+        }
+
+        if (!_instanceDirty[index])
+        {
+            _instanceDirty[index] = true;
+            _dirtyInstances.push_back(index);
+        }
+    }
+
+    float InstanceUpdateTracker::GetDirtyFraction() const
+    {
+        if (_instanceDirty.empty())
+        {
+            return 0.0f;
+        }
+        return static_cast<float>(_dirtyInstances.size()) / static_cast<float>(_instanceDirty.size());
+    }
+
+    std::vector<InstanceRange> InstanceUpdateTracker::GetDirtyRanges() const
+    {
+        std::vector<uint32_t> dirtyInstances = _dirtyInstances;
+        std::sort(dirtyInstances.begin(), dirtyInstances.end());
+
+        std::vector<InstanceRange> ranges;
+        for (uint32_t i : dirtyInstances)
+        {
+            if (!ranges.empty() && ranges.back().First + ranges.back().Count == i)
+            {
+                ++ranges.back().Count;
+            }
+            else
+            {
+                ranges.push_back({ i, 1 });
+            }
+        }
+        return ranges;
+    }
+
+    TopLevelASUpdate InstanceUpdateTracker::GetUpdate(float refitMaxDirtyFraction) const
+    {
+        if (HasCountChanged())
+        {
+            return TopLevelASUpdate::Rebuild;
+        }
+        if (_dirtyInstances.empty())
+        {
+            return TopLevelASUpdate::None;
+        }
+        return GetDirtyFraction() <= refitMaxDirtyFraction ? TopLevelASUpdate::Refit : TopLevelASUpdate::Rebuild;
+    }
+
+    void InstanceUpdateTracker::MarkBuilt()
+    {
+        for (uint32_t i : _dirtyInstances)
+        {
+            _instanceDirty[i] = false;
+        }
+        _dirtyInstances.clear();
+        _builtInstanceCount = GetInstanceCount();
+    }
+}
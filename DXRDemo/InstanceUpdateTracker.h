@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace DXRDemo
+{
+    // How a top-level acceleration structure catches up with its instances
+    enum class TopLevelASUpdate
+    {
+        // Nothing changed since the last build
+        None,
+        // Few instances moved, the previous hierarchy is refitted around them
+        Refit,
+        // Many instances moved, or instances were added or removed, which a refit
+        // cannot account for
+        Rebuild
+    };
+
+    // Consecutive instances, in the order they were added
+    struct InstanceRange
+    {
+        uint32_t First = 0;
+        uint32_t Count = 0;
+    };
+
+    // Which instances of a top-level acceleration structure changed since it was
+    // last built, and whether that calls for a refit or a rebuild. Instances are
+    // only known by their index; removing one moves every later instance down a
+    // slot, which marks them as changed.
+    class InstanceUpdateTracker final
+    {
+    public:
+        // Appends instances, changed until the next build
+        void Add(uint32_t count = 1);
+
+        // Throws std::out_of_range for an index past the instances
+        void Remove(uint32_t index);
+        void MarkDirty(uint32_t index);
+
+        inline uint32_t GetInstanceCount() const
+        {
+            return static_cast<uint32_t>(_instanceDirty.size());
+        }
+
+        // Changed instances, each once, in the order they were marked
+        inline const std::vector<uint32_t>& GetDirtyInstances() const
+        {
+            return _dirtyInstances;
+        }
+
+        // Fraction of the instances that changed
+        float GetDirtyFraction() const;
+
+        // Changed instances merged into sorted ranges
+        std::vector<InstanceRange> GetDirtyRanges() const;
+
+        // Whether instances were added or removed since the last build, the
+        // structure's buffers then no longer have the right size
+        inline bool HasCountChanged() const
+        {
+            return GetInstanceCount() != _builtInstanceCount;
+        }
+
+        // Refits when at most refitMaxDirtyFraction of the instances changed and
+        // none were added or removed, rebuilds otherwise
+        TopLevelASUpdate GetUpdate(float refitMaxDirtyFraction) const;
+
+        // The structure now holds every instance as it is
+        void MarkBuilt();
+
+    private:
+        std::vector<uint32_t> _dirtyInstances;
+        // Per-instance flag avoiding duplicates in _dirtyInstances
+        std::vector<bool> _instanceDirty;
+        uint32_t _builtInstanceCount = 0;
+    };
+}
@@ -0,0 +1,186 @@
+#include "LaunchOptions.h"
+
+#include "framework.h"
+#include <shellapi.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace DXRDemo
+{
+    namespace
+    {
+        std::string ToUtf8(const wchar_t* value)
+        {
+            int size = WideCharToMultiByte(CP_UTF8, 0, value, -1, nullptr, 0, nullptr, nullptr);
+            if (size <= 1)
+            {
+                return std::string();
+            }
+
+            std::string result(static_cast<size_t>(size) - 1, '\0');
+            WideCharToMultiByte(CP_UTF8, 0, value, -1, result.data(), size, nullptr, nullptr);
+            return result;
+        }
+    }
+
+    LaunchOptions LaunchOptions::Parse(const wchar_t* commandLine)
+    {
+        LaunchOptions options;
+        if (commandLine == nullptr || commandLine[0] == L'\0')
+        {
+            return options;
+        }
+
+        int argc = 0;
+        LPWSTR* argv = CommandLineToArgvW(commandLine, &argc);
+        if (argv == nullptr)
+        {
+            return options;
+        }
+
+        std::vector<std::string> arguments;
+        for (int i = 0; i < argc; ++i)
+        {
+            arguments.push_back(ToUtf8(argv[i]));
+        }
+        LocalFree(argv);
+
+        auto value = [&arguments](size_t& i)
+        {
+            if (i + 1 >= arguments.size())
+            {
+                throw std::invalid_argument("Missing value for command line option " + arguments[i]);
+            }
+            return arguments[++i];
+        };
+
+        for (size_t i = 0; i < arguments.size(); ++i)
+        {
+            const std::string& argument = arguments[i];
+            if (argument == "--scene")
+            {
+                options.ScenePath = value(i);
+            }
+            else if (argument == "--save-scene")
+            {
+                options.SaveScenePath = value(i);
+            }
+            else if (argument == "--record-frame-times")
+            {
+                options.RecordFrameTimesPath = value(i);
+            }
+            else if (argument == "--replay-frame-times")
+            {
+                options.ReplayFrameTimesPath = value(i);
+            }
+            else if (argument == "--simulation-rate")
+            {
+                options.SimulationRate = std::stod(value(i));
+                if (!(options.SimulationRate > 0.0))
+                {
+                    throw std::invalid_argument("Simulation rate must be positive");
+                }
+            }
+            else if (argument == "--frames-in-flight")
+            {
+                options.FramesInFlight = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--recording-threads")
+            {
+                options.RecordingThreads = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--radiance-format")
+            {
+                std::string format = value(i);
+                if (format != "rgba16f" && format != "rgba32f")
+                {
+                    throw std::invalid_argument("Radiance format must be rgba16f or rgba32f");
+                }
+                options.FullPrecisionRadiance = format == "rgba32f";
+            }
+            else if (argument == "--denoise-latency")
+            {
+                options.DenoiseLatency = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--denoise-queue-depth")
+            {
+                options.DenoiseQueueDepth = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--denoise-tile-size")
+            {
+                options.DenoiseTileSize = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--denoise-tile-overlap")
+            {
+                options.DenoiseTileOverlap = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--denoise-memory-limit")
+            {
+                options.DenoiseMemoryLimitMB = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--benchmark-conversion")
+            {
+                options.ConversionBenchmarkPath = value(i);
+            }
+            else if (argument == "--compare-tiled-denoise")
+            {
+                options.TiledDenoiseComparisonPath = value(i);
+            }
+            else if (argument == "--check-temporal-accumulation")
+            {
+                options.TemporalAccumulationCheckPath = value(i);
+            }
+            else if (argument == "--benchmark-wavelet-denoise")
+            {
+                options.WaveletDenoiseBenchmarkPath = value(i);
+            }
+            else if (argument == "--benchmark-image-output")
+            {
+                options.ImageOutputBenchmarkPath = value(i);
+            }
+            else if (argument == "--check-render-backend")
+            {
+                options.RenderBackendCheckPath = value(i);
+            }
+            else if (argument == "--check-heap-allocator")
+            {
+                options.HeapAllocatorCheckPath = value(i);
+            }
+            else if (argument == "--check-scene-serializer")
+            {
+                options.SceneSerializerCheckPath = value(i);
+            }
+            else if (argument == "--check-instance-updates")
+            {
+                options.InstanceUpdateCheckPath = value(i);
+            }
+            else if (argument == "--quality-sweep")
+            {
+                options.QualitySweepPath = value(i);
+            }
+            else if (argument == "--sweep-reference-samples")
+            {
+                options.QualitySweepReferenceSamples = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--sweep-max-samples")
+            {
+                options.QualitySweepMaxSamples = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else if (argument == "--save-frames")
+            {
+                options.FrameOutputPath = value(i);
+            }
+            else if (argument == "--frame-count")
+            {
+                options.FrameOutputCount = static_cast<uint32_t>(std::stoul(value(i)));
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown command line option " + argument);
+            }
+        }
+
+        return options;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace DXRDemo
+{
+    // Options given on the command line
+    struct LaunchOptions final
+    {
+        // Scene file to load instead of the built-in scene
+        std::string ScenePath;
+
+        // File the scene is saved to after it has been loaded or built. A .txt
+        // extension selects the text encoding, anything else the binary one.
+        std::string SaveScenePath;
+
+        // File the measured frame times are written to on exit
+        std::string RecordFrameTimesPath;
+
+        // Frame times recorded by an earlier run, used instead of measured ones.
+        // The application exits once they have all been played.
+        std::string ReplayFrameTimesPath;
+
+        // Simulation steps per second
+        double SimulationRate = 60.0;
+
+        // Frames the CPU can record ahead of the GPU
+        uint32_t FramesInFlight = 2;
+
+        // Worker threads recording command lists alongside the render thread, 0
+        // for half the hardware threads
+        uint32_t RecordingThreads = 0;
+
+        // Store the ray traced radiance as 32 bit floats instead of 16 bit ones
+        bool FullPrecisionRadiance = false;
+
+        // Frames between tracing an image and showing it denoised. 0 denoises on
+        // the render thread's critical path.
+        uint32_t DenoiseLatency = 1;
+
+        // Frames the denoiser can have in flight, 0 for one more than the latency
+        uint32_t DenoiseQueueDepth = 0;
+
+        // Tile size, overlap and memory limit of the denoiser. A tile size of 0
+        // denoises whole frames.
+        uint32_t DenoiseTileSize = 0;
+        uint32_t DenoiseTileOverlap = 64;
+        uint32_t DenoiseMemoryLimitMB = 2048;
+
+        // File the pixel conversion benchmark results are written to. When set,
+        // the benchmark runs instead of the application.
+        std::string ConversionBenchmarkPath;
+
+        // File the tiled denoising comparison results are written to. When set, the
+        // comparison runs instead of the application.
+        std::string TiledDenoiseComparisonPath;
+
+        // File the temporal accumulation check results are written to. When set,
+        // the check runs instead of the application.
+        std::string TemporalAccumulationCheckPath;
+
+        // File the wavelet denoiser benchmark results are written to. When set, the
+        // benchmark runs instead of the application.
+        std::string WaveletDenoiseBenchmarkPath;
+
+        // File the image output benchmark results are written to. When set, the
+        // benchmark runs instead of the application.
+        std::string ImageOutputBenchmarkPath;
+
+        // File the render backend check results are written to. When set, the
+        // check runs instead of the application.
+        std::string RenderBackendCheckPath;
+
+        // File the heap allocator check results are written to. When set, the
+        // check runs instead of the application.
+        std::string HeapAllocatorCheckPath;
+
+        // File the scene serializer check results are written to. When set, the
+        // check runs instead of the application.
+        std::string SceneSerializerCheckPath;
+
+        // File the top-level AS instance update check results are written to. When
+        // set, the check runs instead of the application.
+        std::string InstanceUpdateCheckPath;
+
+        // File the quality sweep results are written to, JSON for a .json extension
+        // and CSV otherwise. When set, the sweep runs on the first frame, then the
+        // application exits.
+        std::string QualitySweepPath;
+
+        // Samples per pixel of the quality sweep reference, and the most samples
+        // per pixel the swept images are traced with
+        uint32_t QualitySweepReferenceSamples = 4096;
+        uint32_t QualitySweepMaxSamples = 256;
+
+        // File name pattern ray traced frames are saved to, numbered in place of
+        // its last run of # characters. The extension picks the format, .exr,
+        // .pfm or .png.
+        std::string FrameOutputPath;
+
+        // Frames to save before the application exits, 0 to save until it is closed
+        uint32_t FrameOutputCount = 0;
+
+        static LaunchOptions Parse(const wchar_t* commandLine);
+    };
+}
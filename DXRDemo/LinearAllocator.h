@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    // Hands out aligned ranges of a fixed size block by bumping an offset, and
+    // frees them all at once. Only does the bookkeeping, the memory itself
+    // belongs to the caller.
+    class LinearAllocator final
+    {
+    public:
+        static constexpr uint64_t InvalidOffset = std::numeric_limits<uint64_t>::max();
+
+        LinearAllocator(uint64_t baseOffset = 0, uint64_t capacity = 0) :
+            _baseOffset(baseOffset),
+            _capacity(capacity)
+        {
+        }
+
+        // Returns the offset of the range from the start of the memory the
+        // allocator covers, or InvalidOffset if it does not fit.
+        // Alignment must be a power of two.
+        inline uint64_t Allocate(uint64_t size, uint64_t alignment)
+        {
+            if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+            {
+                throw std::invalid_argument("Alignment must be a power of two");
+            }
+
+            // Aligned relative to the whole memory, not just to the start of the block
+            uint64_t offset = (_baseOffset + _usedSize + alignment - 1) & ~(alignment - 1);
+            if (offset + size > _baseOffset + _capacity)
+            {
+                return InvalidOffset;
+            }
+
+            _usedSize = offset + size - _baseOffset;
+            return offset;
+        }
+
+        inline void Reset()
+        {
+            _usedSize = 0;
+        }
+
+        inline uint64_t GetBaseOffset() const
+        {
+            return _baseOffset;
+        }
+
+        inline uint64_t GetCapacity() const
+        {
+            return _capacity;
+        }
+
+        inline uint64_t GetUsedSize() const
+        {
+            return _usedSize;
+        }
+
+    private:
+        uint64_t _baseOffset;
+        uint64_t _capacity;
+        uint64_t _usedSize = 0;
+    };
+}
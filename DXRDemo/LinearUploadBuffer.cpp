@@ -0,0 +1,51 @@
+#include "LinearUploadBuffer.h"
+
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    LinearUploadBuffer::LinearUploadBuffer(RenderDevice& device, uint64_t frameSize, uint32_t frameCount)
+    {
+        if (frameCount == 0)
+        {
+            throw std::invalid_argument("An upload buffer needs at least one frame");
+        }
+
+        // Every region starts on a constant buffer boundary
+        frameSize = (frameSize + ConstantBufferAlignment - 1) / ConstantBufferAlignment * ConstantBufferAlignment;
+
+        _buffer = device.CreateResource(ResourceDesc::Buffer(frameSize * frameCount, HeapType::Upload, ResourceState::GenericRead));
+
+        // Upload heaps can stay mapped, the CPU only ever writes to them
+        _mappedData = static_cast<uint8_t*>(_buffer->Map());
+        _gpuAddress = _buffer->GetGpuAddress();
+
+        _frames.reserve(frameCount);
+        for (uint32_t i = 0; i < frameCount; ++i)
+        {
+            _frames.emplace_back(frameSize * i, frameSize);
+        }
+    }
+
+    LinearUploadBuffer::~LinearUploadBuffer()
+    {
+        _buffer->Unmap();
+    }
+
+    void LinearUploadBuffer::BeginFrame(uint32_t frameIndex)
+    {
+        _frameIndex = frameIndex % static_cast<uint32_t>(_frames.size());
+        _frames[_frameIndex].Reset();
+    }
+
+    LinearUploadBuffer::Allocation LinearUploadBuffer::Allocate(uint64_t size, uint64_t alignment)
+    {
+        uint64_t offset = _frames[_frameIndex].Allocate(size, alignment);
+        if (offset == LinearAllocator::InvalidOffset)
+        {
+            throw std::runtime_error("Upload buffer frame region is full");
+        }
+
+        return { _mappedData + offset, _gpuAddress + offset };
+    }
+}
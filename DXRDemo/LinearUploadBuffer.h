@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "LinearAllocator.h"
+#include "RenderBackend.h"
+
+namespace DXRDemo
+{
+    // Upload heap buffer mapped for its whole lifetime, split into one region per
+    // frame. Constants of a frame are packed into its region with suballocations
+    // aligned for constant buffer views, and the region is reused once the GPU
+    // is done with that frame. With a single region that is never reset, the
+    // buffer holds constants that live as long as it does.
+    class LinearUploadBuffer final
+    {
+    public:
+        // Placement of constant buffer views, and of every region
+        static constexpr uint64_t ConstantBufferAlignment = 256;
+
+        struct Allocation
+        {
+            void* CpuAddress = nullptr;
+            uint64_t GpuAddress = 0;
+        };
+
+        // frameSize is rounded up to the constant buffer alignment
+        LinearUploadBuffer(RenderDevice& device, uint64_t frameSize, uint32_t frameCount = 1);
+        LinearUploadBuffer(const LinearUploadBuffer&) = delete;
+        LinearUploadBuffer& operator=(const LinearUploadBuffer&) = delete;
+        ~LinearUploadBuffer();
+
+        // Starts writing to the region of a frame, dropping what it held before.
+        // The GPU must be done reading it.
+        void BeginFrame(uint32_t frameIndex);
+
+        // Throws std::runtime_error when the frame's region is full
+        Allocation Allocate(uint64_t size, uint64_t alignment = ConstantBufferAlignment);
+
+        // Copies data into a new allocation and returns its GPU address
+        template <typename T>
+        inline uint64_t Upload(const T& data)
+        {
+            Allocation allocation = Allocate(sizeof(T));
+            memcpy(allocation.CpuAddress, &data, sizeof(T));
+            return allocation.GpuAddress;
+        }
+
+        inline RenderResource& GetResource() const
+        {
+            return *_buffer;
+        }
+
+        // Bytes each frame's region holds
+        inline uint64_t GetFrameSize() const
+        {
+            return _frames[0].GetCapacity();
+        }
+
+        // Bytes allocated from the current frame's region
+        inline uint64_t GetUsedSize() const
+        {
+            return _frames[_frameIndex].GetUsedSize();
+        }
+
+    private:
+        std::shared_ptr<RenderResource> _buffer;
+        uint8_t* _mappedData = nullptr;
+        uint64_t _gpuAddress = 0;
+        std::vector<LinearAllocator> _frames;
+        uint32_t _frameIndex = 0;
+    };
+}
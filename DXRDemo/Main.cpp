@@ -8,6 +8,17 @@
 #include "Window.h"
 #include "Game.h"
 #include "DXContext.h"
+#include "LaunchOptions.h"
+#include "ThreadPool.h"
+#include "ConversionBenchmark.h"
+#include "TiledDenoiseComparison.h"
+#include "TemporalAccumulationCheck.h"
+#include "WaveletDenoiseBenchmark.h"
+#include "ImageOutputBenchmark.h"
+#include "RenderBackendCheck.h"
+#include "HeapAllocatorCheck.h"
+#include "SceneSerializerCheck.h"
+#include "InstanceUpdateCheck.h"
 
 using namespace DXRDemo;
 
@@ -17,7 +28,6 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
                      _In_ int       nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
     UNREFERENCED_PARAMETER(nCmdShow);
 
     SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
@@ -25,9 +35,63 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     const uint32_t width = 800;
     const uint32_t height = 600;
 
+    LaunchOptions options = LaunchOptions::Parse(lpCmdLine);
+
+    if (!options.ConversionBenchmarkPath.empty())
+    {
+        ThreadPool threadPool;
+        RunConversionBenchmark(options.ConversionBenchmarkPath, threadPool);
+        return EXIT_SUCCESS;
+    }
+
+    if (!options.TiledDenoiseComparisonPath.empty())
+    {
+        ThreadPool threadPool;
+        return RunTiledDenoiseComparison(options.TiledDenoiseComparisonPath, threadPool) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (!options.TemporalAccumulationCheckPath.empty())
+    {
+        ThreadPool threadPool;
+        return RunTemporalAccumulationCheck(options.TemporalAccumulationCheckPath, threadPool) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (!options.WaveletDenoiseBenchmarkPath.empty())
+    {
+        ThreadPool threadPool;
+        RunWaveletDenoiseBenchmark(options.WaveletDenoiseBenchmarkPath, threadPool);
+        return EXIT_SUCCESS;
+    }
+
+    if (!options.ImageOutputBenchmarkPath.empty())
+    {
+        RunImageOutputBenchmark(options.ImageOutputBenchmarkPath);
+        return EXIT_SUCCESS;
+    }
+
+    if (!options.RenderBackendCheckPath.empty())
+    {
+        return RunRenderBackendCheck(options.RenderBackendCheckPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (!options.HeapAllocatorCheckPath.empty())
+    {
+        return RunHeapAllocatorCheck(options.HeapAllocatorCheckPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (!options.SceneSerializerCheckPath.empty())
+    {
+        return RunSceneSerializerCheck(options.SceneSerializerCheckPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (!options.InstanceUpdateCheckPath.empty())
+    {
+        return RunInstanceUpdateCheck(options.InstanceUpdateCheckPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     Window window(hInstance, L"DXR Demo", width, height);
 
-    Game game(window, width, height);
+    Game game(window, width, height, options);
 
     Window::OnPaintCallback onPaintCallback = [&game]() {
         game.Update();
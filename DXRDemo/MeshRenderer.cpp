@@ -3,6 +3,9 @@
 #include "DxContext.h"
 #include "DXRUtils/DXRHelper.h"
 #include "DXRUtils/BottomLevelASGenerator.h"
+#include "GameObject.h"
+#include "GeometryPool.h"
+#include "UploadRingBuffer.h"
 #include <random>
 
 using namespace std;
@@ -16,122 +19,51 @@ namespace DXRDemo
     default_random_engine generator(device());
     uniform_real_distribution<float> colorDistribution(0, 1);
 
-    void MeshRenderer::CreateBuffers(
-        DXContext& dxContext,
-        ID3D12GraphicsCommandList4* commandList)
+    void MeshRenderer::AddGeometries(GeometryPool& geometryPool)
     {
-        VertexBuffers.resize(Meshes.size());
-        IndexBuffers.resize(Meshes.size());
-        UploadVertexBuffers.resize(Meshes.size());
-        UploadIndexBuffers.resize(Meshes.size());
+        FirstGeometryIndex = geometryPool.GetGeometryCount();
 
-        uint32_t meshIndex = 0;
         for (auto& mesh : Meshes)
         {
-            bool verticesHaveColor = mesh->VertexColors.size() > 0;
-            Vector4 diffuse = mesh->Material->DiffuseColor;
-
             // Create 'GPU' vertices to transfer to buffers
-            std::vector<VertexPosColor> gpuVertices;
-            for (size_t i = 0; i < mesh->Vertices.size(); ++i)
-            {
-                VertexPosColor gpuVertex;
-                gpuVertex.Position = mesh->Vertices[i];
-                gpuVertex.Normal = mesh->Normals[i];
-                gpuVertex.Color = diffuse;
-                gpuVertex.Emission = mesh->Material->EmissionColor;
-
-                //gpuVertex.Color = verticesHaveColor && i < mesh->VertexColors[0].size() ? mesh->VertexColors[0][i] :
-                //    Vector4(
-                //        colorDistribution(generator),
-                //        colorDistribution(generator),
-                //        colorDistribution(generator),
-                //        1.0f);
-
-                gpuVertices.push_back(std::move(gpuVertex));
-            }
+            std::vector<VertexPosColor> gpuVertices = _CreateVertices(*mesh);
 
-            // Vertex buffer 
-            {
-                dxContext.UpdateBufferResource(
-                    commandList,
-                    &VertexBuffers[meshIndex],
-                    &UploadVertexBuffers[meshIndex],
-                    gpuVertices.size(),
-                    sizeof(VertexPosColor),
-                    gpuVertices.data());
-            }
-
-            // Index buffer
-            {
-                dxContext.UpdateBufferResource(commandList,
-                    &IndexBuffers[meshIndex],
-                    &UploadIndexBuffers[meshIndex],
-                    mesh->Indices.size(),
-                    sizeof(int32_t),
-                    mesh->Indices.data());
-            } 
-
-            ++meshIndex;
+            geometryPool.AddGeometry(
+                gpuVertices.data(),
+                static_cast<uint32_t>(gpuVertices.size()),
+                mesh->Indices.data(),
+                static_cast<uint32_t>(mesh->Indices.size()));
         }
     }
 
-    void MeshRenderer::CreateBufferViews(DXContext& dxContext)
+    void MeshRenderer::CreateBottomLevelAS(
+        DXContext& dxContext,
+        const GeometryPool& geometryPool,
+        ID3D12GraphicsCommandList4* commandList,
+        std::vector<ComPtr<ID3D12Resource>>& scratchBuffers)
     {
-        VertexBufferViews.resize(Meshes.size());
-        IndexBufferViews.resize(Meshes.size());
+        BottomLevelASBuffers.clear();
 
-        uint32_t meshIndex = 0;
-        for (auto& mesh : Meshes)
+        for (uint32_t meshIndex = 0; meshIndex < Meshes.size(); ++meshIndex)
         {
-            // Vertex buffer view
-            {
-                VertexBufferViews[meshIndex].BufferLocation = VertexBuffers[meshIndex]->GetGPUVirtualAddress();
-                VertexBufferViews[meshIndex].SizeInBytes = static_cast<UINT>(mesh->Vertices.size() * sizeof(VertexPosColor));
-                VertexBufferViews[meshIndex].StrideInBytes = sizeof(VertexPosColor);
-            }
+            const GeometryRange& geometry = geometryPool.GetGeometry(FirstGeometryIndex + meshIndex);
 
-            // Index buffer view
+            // Adding the mesh's range of the pool and not transforming its position.
+            BottomLevelASGenerator bottomLevelAS;
+            if (geometry.IndexCount > 0)
             {
-                IndexBufferViews[meshIndex].BufferLocation = IndexBuffers[meshIndex]->GetGPUVirtualAddress();
-                IndexBufferViews[meshIndex].Format = DXGI_FORMAT_R32_UINT;
-                IndexBufferViews[meshIndex].SizeInBytes = static_cast<UINT>(mesh->Indices.size() * sizeof(uint32_t));
+                bottomLevelAS.AddVertexBuffer(
+                    geometryPool.GetVertexBuffer(), static_cast<UINT64>(geometry.FirstVertex) * sizeof(VertexPosColor),
+                    geometry.VertexCount, sizeof(VertexPosColor),
+                    geometryPool.GetIndexBuffer(), static_cast<UINT64>(geometry.FirstIndex) * sizeof(uint32_t),
+                    geometry.IndexCount, nullptr, 0, true);
             }
-
-            ++meshIndex;
-        }
-    }
-
-    void MeshRenderer::CreateBottomLevelAS(DXContext& dxContext, ID3D12GraphicsCommandList4* commandList)
-    {
-        BottomLevelASBuffers.clear();
-
-        uint32_t meshIndex = 0;
-        for (auto& mesh : Meshes)
-        {
-            using VVertexBuffer = std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, uint32_t>>;
-
-            BottomLevelASGenerator bottomLevelAS; // Adding all vertex buffers and not transforming their position.
-            VVertexBuffer vVertexBuffers({ {VertexBuffers[meshIndex].Get(), static_cast<uint32_t>(mesh->Vertices.size())} });
-            VVertexBuffer vIndexBuffers({ {IndexBuffers[meshIndex].Get(), static_cast<uint32_t>(mesh->Indices.size())}});
-
-            for (size_t i = 0; i < vVertexBuffers.size(); ++i)
+            else
             {
-                if (i < vIndexBuffers.size() && vIndexBuffers[i].second > 0)
-                {
-                    bottomLevelAS.AddVertexBuffer(
-                        vVertexBuffers[i].first.Get(), 0,
-                        vVertexBuffers[i].second, sizeof(MeshRenderer::VertexPosColor),
-                        vIndexBuffers[i].first.Get(), 0,
-                        vIndexBuffers[i].second, nullptr, 0, true);
-                }
-                else
-                {
-                    bottomLevelAS.AddVertexBuffer(
-                        vVertexBuffers[i].first.Get(), 0,
-                        vVertexBuffers[i].second, sizeof(VertexPosColor), 0,
-                        0);
-                }    
+                bottomLevelAS.AddVertexBuffer(
+                    geometryPool.GetVertexBuffer(), static_cast<UINT64>(geometry.FirstVertex) * sizeof(VertexPosColor),
+                    geometry.VertexCount, sizeof(VertexPosColor), 0,
+                    0);
             }
 
             // The AS build requires some scratch space to store temporary information.
@@ -145,20 +77,77 @@ namespace DXRDemo
 
             // Once the sizes are obtained, the application is responsible for allocating
             // the necessary buffers. Since the entire generation will be done on the GPU,
-            // we can directly allocate those on the default heap
-            Microsoft::WRL::ComPtr<ID3D12Resource> scratch = nv_helpers_dx12::CreateBuffer(dxContext.Device.Get(), scratchSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON, nv_helpers_dx12::kDefaultHeapProps);
-            Microsoft::WRL::ComPtr<ID3D12Resource> buffer = nv_helpers_dx12::CreateBuffer(dxContext.Device.Get(), resultSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE, nv_helpers_dx12::kDefaultHeapProps);
+            // we can directly allocate those on the default heap, packed with the others
+            Microsoft::WRL::ComPtr<ID3D12Resource> scratch = dxContext.BufferHeaps->CreateBuffer(scratchSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+            Microsoft::WRL::ComPtr<ID3D12Resource> buffer = dxContext.BufferHeaps->CreateBuffer(resultSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
 
             // Build the acceleration structure. Note that this call integrates a barrier
             // on the generated AS, so that it can be used to compute a top-level AS right
             // after this method.
             bottomLevelAS.Generate(commandList, scratch.Get(), buffer.Get(), false, nullptr);
             BottomLevelASBuffers.push_back(std::move(buffer));
-
-            ++meshIndex;
+            scratchBuffers.push_back(std::move(scratch));
         }
 
         //auto fenceValue = dxContext.DirectCommandQueue->ExecuteCommandList(commandList);
         //dxContext.DirectCommandQueue->WaitForFenceValue(fenceValue);
     }
-}
+
+    void MeshRenderer::MarkMaterialsDirty()
+    {
+        if (Parent != nullptr)
+        {
+            Parent->RecordChange(ChangeType::Material, this);
+        }
+    }
+
+    void MeshRenderer::UpdateMaterials(
+        RenderCommandList& commandList,
+        ResourceStateTracker& stateTracker,
+        UploadRingBuffer& uploadRing,
+        GeometryPool& geometryPool)
+    {
+        // One transition of the pool's vertex buffer around the copies of all
+        // meshes, merged with those of other renderers updated in the same frame
+        RenderResource& vertexResource = geometryPool.GetVertexResource();
+        stateTracker.Transition(vertexResource, ResourceState::CopyDest);
+        stateTracker.FlushBarriers(commandList);
+
+        ID3D12GraphicsCommandList4* nativeCommandList = static_cast<D3D12RenderCommandList&>(commandList).GetNative().Get();
+        for (uint32_t meshIndex = 0; meshIndex < Meshes.size(); ++meshIndex)
+        {
+            std::vector<VertexPosColor> gpuVertices = _CreateVertices(*Meshes[meshIndex]);
+            geometryPool.CopyVertices(nativeCommandList, uploadRing, FirstGeometryIndex + meshIndex, gpuVertices.data());
+        }
+
+        stateTracker.Transition(vertexResource, ResourceState::Common);
+    }
+
+    std::vector<MeshRenderer::VertexPosColor> MeshRenderer::_CreateVertices(const Mesh& mesh) const
+    {
+        bool verticesHaveColor = mesh.VertexColors.size() > 0;
+        Vector4 diffuse = mesh.Material->DiffuseColor;
+
+        std::vector<VertexPosColor> gpuVertices;
+        gpuVertices.reserve(mesh.Vertices.size());
+        for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+        {
+            VertexPosColor gpuVertex;
+            gpuVertex.Position = mesh.Vertices[i];
+            gpuVertex.Normal = mesh.Normals[i];
+            gpuVertex.Color = diffuse;
+            gpuVertex.Emission = mesh.Material->EmissionColor;
+
+            //gpuVertex.Color = verticesHaveColor && i < mesh.VertexColors[0].size() ? mesh.VertexColors[0][i] :
+            //    Vector4(
+            //        colorDistribution(generator),
+            //        colorDistribution(generator),
+            //        colorDistribution(generator),
+            //        1.0f);
+
+            gpuVertices.push_back(std::move(gpuVertex));
+        }
+
+        return gpuVertices;
+    }
+}
\ No newline at end of file
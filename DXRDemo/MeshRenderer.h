@@ -3,11 +3,16 @@
 #include "Component.h"
 #include <vector>
 #include <memory>
+#include <string>
 #include "Mesh.h"
 
 namespace DXRDemo
 {
     class DXContext;
+    class GeometryPool;
+    class RenderCommandList;
+    class ResourceStateTracker;
+    class UploadRingBuffer;
 
     struct AccelerationStructureBuffers
     {
@@ -30,23 +35,48 @@ namespace DXRDemo
 
         std::vector<std::shared_ptr<Mesh>> Meshes;
 
-        // Vertex buffer
-        std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> VertexBuffers;
-        std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> UploadVertexBuffers;
-        std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> UploadIndexBuffers;
-        std::vector<D3D12_VERTEX_BUFFER_VIEW> VertexBufferViews;
+        // Asset the meshes were imported from, and their indices in that asset
+        std::string AssetPath;
+        std::vector<uint32_t> AssetMeshIndices;
 
-        // Index buffer
-        std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> IndexBuffers;
-        std::vector<D3D12_INDEX_BUFFER_VIEW> IndexBufferViews;
+        // Index in the geometry pool of the first mesh, the other ones follow
+        // contiguously
+        uint32_t FirstGeometryIndex = 0;
 
         // Acceleration structure buffers
         std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> BottomLevelASBuffers;
 
-        void CreateBuffers(DXContext& dxContext, ID3D12GraphicsCommandList4* commandList);
-        void CreateBufferViews(DXContext& dxContext);
+        // Index of the top-level AS instance of the first bottom-level AS, the
+        // other ones follow contiguously
+        uint32_t FirstInstanceIndex = 0;
+
+        // Adds the vertices and indices of the meshes to geometryPool, before it
+        // is created
+        void AddGeometries(GeometryPool& geometryPool);
+        // The scratch buffers of the builds are added to scratchBuffers, to be
+        // kept until commandList completes
         void CreateBottomLevelAS(
             DXContext& dxContext,
-            ID3D12GraphicsCommandList4* commandList);
+            const GeometryPool& geometryPool,
+            ID3D12GraphicsCommandList4* commandList,
+            std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>& scratchBuffers);
+
+        // To be called after changing the material of one of the meshes
+        void MarkMaterialsDirty();
+
+        // Rewrites the material data of the meshes' vertices in geometryPool, staged
+        // in uploadRing, which the caller retires with the fence value of
+        // commandList's submission. The vertex buffer's transitions go through
+        // stateTracker, the one back to the common state left queued for the
+        // next flush. Positions are unchanged, so the acceleration structures
+        // stay valid.
+        void UpdateMaterials(
+            RenderCommandList& commandList,
+            ResourceStateTracker& stateTracker,
+            UploadRingBuffer& uploadRing,
+            GeometryPool& geometryPool);
+
+    private:
+        std::vector<VertexPosColor> _CreateVertices(const Mesh& mesh) const;
     };
 }
\ No newline at end of file
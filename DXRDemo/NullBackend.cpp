@@ -0,0 +1,747 @@
+#include "NullBackend.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // Placed resources and committed ones land on 64 KiB boundaries
+        constexpr uint64_t ResourceAlignment = 65536;
+        constexpr uint64_t TextureRowPitchAlignment = 256;
+        constexpr uint64_t TexturePlacementAlignment = 512;
+        // Keeps GPU handles apart from CPU ones
+        constexpr uint64_t GpuDescriptorOffset = uint64_t(1) << 48;
+
+        uint64_t AlignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        uint64_t GetRowSize(const ResourceDesc& desc)
+        {
+            return desc.Dimension == ResourceDimension::Buffer ? desc.Width : desc.Width * GetFormatSize(desc.Format);
+        }
+
+        NullRenderResource& AsNull(RenderResource* resource)
+        {
+            return *static_cast<NullRenderResource*>(resource);
+        }
+
+        // Bytes left in placed resources when an aliasing barrier hands them the memory
+        constexpr uint8_t UndefinedContents = 0xCD;
+
+        void CheckActive(const NullRenderResource& resource)
+        {
+            if (!resource.IsActive())
+            {
+                throw std::logic_error("Placed resource used while an overlapping one holds the memory");
+            }
+        }
+
+        // Buffers in the common state are promoted to copy states implicitly
+        void CheckCopyState(const NullRenderResource& resource, ResourceState required)
+        {
+            CheckActive(resource);
+            if (resource.IsSplitting())
+            {
+                throw std::logic_error("Resource used between the halves of a split barrier");
+            }
+
+            if (required == ResourceState::CopySource && resource.NeedsInitialization())
+            {
+                throw std::logic_error("Render target or depth buffer read after an aliasing barrier before it was discarded or copied to");
+            }
+
+            bool promoted = resource.GetDesc().Dimension == ResourceDimension::Buffer && resource.GetState() == ResourceState::Common;
+            if (!promoted && !HasState(resource.GetState(), required))
+            {
+                throw std::logic_error(required == ResourceState::CopyDest ?
+                    "Copy destination is not in the copy destination state" :
+                    "Copy source is not in the copy source state");
+            }
+        }
+    }
+
+    NullRenderResource::NullRenderResource(NullRenderDevice& device, const ResourceDesc& desc, uint64_t gpuAddress) :
+        _device(&device),
+        _desc(desc),
+        _gpuAddress(gpuAddress),
+        _state(desc.InitialState),
+        _ownedData(GetRowSize(desc) * desc.Height),
+        _data(_ownedData)
+    {
+    }
+
+    NullRenderResource::NullRenderResource(NullRenderDevice& device, const ResourceDesc& desc, std::shared_ptr<NullRenderHeap> heap, uint64_t heapOffset) :
+        _device(&device),
+        _desc(desc),
+        _gpuAddress(heap->_gpuAddress + heapOffset),
+        _state(desc.InitialState),
+        _heap(std::move(heap)),
+        _heapOffset(heapOffset),
+        _data(_heap->_memory.data() + heapOffset, GetRowSize(desc) * desc.Height)
+    {
+        // Created in use unless it lies over one already placed
+        std::lock_guard<std::mutex> lock(_device->_mutex);
+        _active = std::none_of(_heap->_resources.begin(), _heap->_resources.end(), [this](const NullRenderResource* other)
+        {
+            return _Overlaps(*other) && other->_active;
+        });
+        _heap->_resources.push_back(this);
+    }
+
+    NullRenderResource::~NullRenderResource()
+    {
+        std::lock_guard<std::mutex> lock(_device->_mutex);
+        ++_device->_statistics.ResourceReleases;
+        std::erase_if(_device->_descriptors, [this](const auto& descriptor) { return descriptor.second == this; });
+        if (_heap)
+        {
+            std::erase(_heap->_resources, this);
+        }
+    }
+
+    const ResourceDesc& NullRenderResource::GetDesc() const
+    {
+        return _desc;
+    }
+
+    void* NullRenderResource::Map()
+    {
+        if (_desc.Heap == HeapType::Default)
+        {
+            throw std::logic_error("Resources on the default heap cannot be mapped");
+        }
+        return _data.data();
+    }
+
+    void NullRenderResource::Unmap()
+    {
+    }
+
+    uint64_t NullRenderResource::GetGpuAddress() const
+    {
+        return _desc.Dimension == ResourceDimension::Buffer ? _gpuAddress : 0;
+    }
+
+    bool NullRenderResource::_Overlaps(const NullRenderResource& other) const
+    {
+        return &other != this && other._heap == _heap &&
+            other._data.data() < _data.data() + _data.size() && _data.data() < other._data.data() + other._data.size();
+    }
+
+    NullRenderHeap::NullRenderHeap(uint64_t size, uint64_t gpuAddress) :
+        _gpuAddress(gpuAddress),
+        _memory(size)
+    {
+    }
+
+    uint64_t NullRenderHeap::GetSize() const
+    {
+        return _memory.size();
+    }
+
+    uint64_t NullRenderFence::GetCompletedValue() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _completedValue;
+    }
+
+    void NullRenderFence::Wait(uint64_t value)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (value > _signaledValue)
+        {
+            throw std::logic_error("Waiting for a fence value that was never signaled");
+        }
+        _completedValue = std::max(_completedValue, value);
+    }
+
+    void NullRenderFence::Signal(uint64_t value, uint32_t latency)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _signaledValue = value;
+        if (value > latency)
+        {
+            _completedValue = std::max(_completedValue, value - latency);
+        }
+    }
+
+    uint64_t NullRenderFence::GetSignaledValue() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _signaledValue;
+    }
+
+    NullRenderDescriptorHeap::NullRenderDescriptorHeap(DescriptorHeapType type, uint32_t count, bool shaderVisible, uint64_t start) :
+        _type(type),
+        _count(count),
+        _shaderVisible(shaderVisible),
+        _start(start)
+    {
+    }
+
+    DescriptorHeapType NullRenderDescriptorHeap::GetType() const
+    {
+        return _type;
+    }
+
+    uint32_t NullRenderDescriptorHeap::GetCount() const
+    {
+        return _count;
+    }
+
+    bool NullRenderDescriptorHeap::IsShaderVisible() const
+    {
+        return _shaderVisible;
+    }
+
+    DescriptorHandle NullRenderDescriptorHeap::GetHandle(uint32_t index) const
+    {
+        if (index >= _count)
+        {
+            throw std::out_of_range("Descriptor index past the end of the heap");
+        }
+        uint64_t cpu = _start + static_cast<uint64_t>(index) * IncrementSize;
+        return { cpu, _shaderVisible ? cpu + GpuDescriptorOffset : 0 };
+    }
+
+    NullRenderCommandList::NullRenderCommandList(CommandListType type) :
+        _type(type)
+    {
+    }
+
+    CommandListType NullRenderCommandList::GetType() const
+    {
+        return _type;
+    }
+
+    void NullRenderCommandList::Barriers(std::span<const ResourceBarrier> barriers)
+    {
+        if (!barriers.empty())
+        {
+            NullCommand command = { NullCommand::Type::Barriers };
+            command.Barriers.assign(barriers.begin(), barriers.end());
+            _commands.push_back(std::move(command));
+        }
+    }
+
+    void NullRenderCommandList::CopyBufferRegion(RenderResource& destination, uint64_t destinationOffset,
+        RenderResource& source, uint64_t sourceOffset, uint64_t size)
+    {
+        NullCommand command = { NullCommand::Type::CopyBufferRegion };
+        command.Destination = &destination;
+        command.Source = &source;
+        command.DestinationOffset = destinationOffset;
+        command.SourceOffset = sourceOffset;
+        command.Size = size;
+        _commands.push_back(std::move(command));
+    }
+
+    void NullRenderCommandList::CopyResource(RenderResource& destination, RenderResource& source)
+    {
+        NullCommand command = { NullCommand::Type::CopyResource };
+        command.Destination = &destination;
+        command.Source = &source;
+        _commands.push_back(std::move(command));
+    }
+
+    void NullRenderCommandList::CopyTextureToBuffer(RenderResource& destination, uint64_t bufferOffset, RenderResource& source)
+    {
+        NullCommand command = { NullCommand::Type::CopyTextureToBuffer };
+        command.Destination = &destination;
+        command.Source = &source;
+        command.DestinationOffset = bufferOffset;
+        _commands.push_back(std::move(command));
+    }
+
+    void NullRenderCommandList::CopyBufferToTexture(RenderResource& destination, RenderResource& source, uint64_t bufferOffset)
+    {
+        NullCommand command = { NullCommand::Type::CopyBufferToTexture };
+        command.Destination = &destination;
+        command.Source = &source;
+        command.SourceOffset = bufferOffset;
+        _commands.push_back(std::move(command));
+    }
+
+    void NullRenderCommandList::DiscardResource(RenderResource& resource)
+    {
+        NullCommand command = { NullCommand::Type::DiscardResource };
+        command.Destination = &resource;
+        _commands.push_back(std::move(command));
+    }
+
+    void NullRenderCommandList::SetDescriptorHeaps(std::span<RenderDescriptorHeap* const> heaps)
+    {
+        _commands.push_back({ NullCommand::Type::SetDescriptorHeaps });
+    }
+
+    NullRenderQueue::NullRenderQueue(NullRenderDevice& device, CommandListType type) :
+        _device(&device),
+        _type(type)
+    {
+    }
+
+    CommandListType NullRenderQueue::GetType() const
+    {
+        return _type;
+    }
+
+    RenderFence& NullRenderQueue::GetFence()
+    {
+        return _fence;
+    }
+
+    std::unique_ptr<RenderCommandList> NullRenderQueue::GetCommandList()
+    {
+        std::lock_guard<std::mutex> lock(_device->_mutex);
+
+        // Command lists can be reused as soon as they are submitted
+        if (!_commandLists.empty())
+        {
+            std::unique_ptr<RenderCommandList> commandList = std::move(_commandLists.back());
+            _commandLists.pop_back();
+            return commandList;
+        }
+
+        ++_device->_statistics.CommandListAllocations;
+        return std::make_unique<NullRenderCommandList>(_type);
+    }
+
+    uint64_t NullRenderQueue::ExecuteCommandList(std::unique_ptr<RenderCommandList> commandList)
+    {
+        std::lock_guard<std::mutex> lock(_device->_mutex);
+
+        NullRenderCommandList& nullCommandList = static_cast<NullRenderCommandList&>(*commandList);
+        // A command throwing leaves the list unexecuted, so it is dropped either way
+        std::vector<NullCommand> commands = std::move(nullCommandList._commands);
+        nullCommandList._commands.clear();
+        _commandLists.push_back(std::move(commandList));
+
+        try
+        {
+            for (const NullCommand& command : commands)
+            {
+                _Execute(command);
+            }
+            if (!_splitResources.empty())
+            {
+                throw std::logic_error("Split barrier begun but not ended in the command list");
+            }
+        }
+        catch (const std::logic_error&)
+        {
+            for (NullRenderResource* resource : _splitResources)
+            {
+                resource->_splitting = false;
+            }
+            _splitResources.clear();
+            throw;
+        }
+        ++_device->_statistics.ExecutedCommandLists;
+
+        return _Signal();
+    }
+
+    uint64_t NullRenderQueue::Signal()
+    {
+        std::lock_guard<std::mutex> lock(_device->_mutex);
+        return _Signal();
+    }
+
+    void NullRenderQueue::Wait(RenderQueue& queue, uint64_t fenceValue)
+    {
+        if (fenceValue > static_cast<NullRenderFence&>(queue.GetFence()).GetSignaledValue())
+        {
+            throw std::logic_error("Queue waits for a fence value that was never signaled");
+        }
+    }
+
+    void NullRenderQueue::SetLatency(uint32_t signals)
+    {
+        _latency = signals;
+    }
+
+    uint64_t NullRenderQueue::_Signal()
+    {
+        uint64_t fenceValue = ++_fenceValue;
+        ++_device->_statistics.Signals;
+        _fence.Signal(fenceValue, _latency);
+        return fenceValue;
+    }
+
+    void NullRenderQueue::_Execute(const NullCommand& command)
+    {
+        NullBackendStatistics& statistics = _device->_statistics;
+        switch (command.Kind)
+        {
+            case NullCommand::Type::Barriers:
+                for (const ResourceBarrier& barrier : command.Barriers)
+                {
+                    if (barrier.Kind == ResourceBarrier::Type::Transition)
+                    {
+                        _Transition(barrier);
+                    }
+                    else if (barrier.Kind == ResourceBarrier::Type::Aliasing)
+                    {
+                        _Alias(barrier);
+                    }
+                }
+                statistics.Barriers += command.Barriers.size();
+                ++statistics.BarrierBatches;
+                break;
+
+            case NullCommand::Type::CopyBufferRegion:
+                _Copy(AsNull(command.Destination), command.DestinationOffset, AsNull(command.Source), command.SourceOffset, command.Size);
+                break;
+
+            case NullCommand::Type::CopyResource:
+                if (command.Destination->GetDesc().Width != command.Source->GetDesc().Width ||
+                    command.Destination->GetDesc().Height != command.Source->GetDesc().Height)
+                {
+                    throw std::logic_error("Resources copied as a whole differ in size");
+                }
+                _Copy(AsNull(command.Destination), 0, AsNull(command.Source), 0, AsNull(command.Source)._data.size());
+                break;
+
+            case NullCommand::Type::CopyTextureToBuffer:
+                _CopyTexture(AsNull(command.Source), AsNull(command.Destination), command.DestinationOffset, true);
+                break;
+
+            case NullCommand::Type::CopyBufferToTexture:
+                _CopyTexture(AsNull(command.Destination), AsNull(command.Source), command.SourceOffset, false);
+                break;
+
+            case NullCommand::Type::DiscardResource:
+                _Discard(AsNull(command.Destination));
+                break;
+
+            case NullCommand::Type::SetDescriptorHeaps:
+                break;
+        }
+    }
+
+    void NullRenderQueue::_Transition(const ResourceBarrier& barrier)
+    {
+        NullRenderResource& resource = AsNull(barrier.Resource);
+        CheckActive(resource);
+        if (resource._state != barrier.StateBefore)
+        {
+            throw std::logic_error("Transition barrier does not start from the state of the resource");
+        }
+        if (barrier.StateBefore == barrier.StateAfter)
+        {
+            throw std::logic_error("Transition barrier does not change the state of the resource");
+        }
+
+        switch (barrier.SplitFlags)
+        {
+            case ResourceBarrier::Split::None:
+                if (resource._splitting)
+                {
+                    throw std::logic_error("Transition of a resource between the halves of a split barrier");
+                }
+                resource._state = barrier.StateAfter;
+                break;
+
+            case ResourceBarrier::Split::BeginOnly:
+                if (resource._splitting)
+                {
+                    throw std::logic_error("Split barrier begun twice");
+                }
+                resource._splitting = true;
+                resource._splitState = barrier.StateAfter;
+                _splitResources.push_back(&resource);
+                ++_device->_statistics.SplitBarriers;
+                break;
+
+            case ResourceBarrier::Split::EndOnly:
+                if (!resource._splitting || resource._splitState != barrier.StateAfter)
+                {
+                    throw std::logic_error("Split barrier ended without a matching beginning");
+                }
+                resource._splitting = false;
+                resource._state = barrier.StateAfter;
+                std::erase(_splitResources, &resource);
+                break;
+
+            default:
+                throw std::logic_error("Transition barrier both begins and ends a split");
+        }
+    }
+
+    void NullRenderQueue::_Alias(const ResourceBarrier& barrier)
+    {
+        for (RenderResource* named : { barrier.ResourceBefore, barrier.Resource })
+        {
+            if (named != nullptr && !AsNull(named)._heap)
+            {
+                throw std::logic_error("Aliasing barrier names a resource that is not placed");
+            }
+        }
+        ++_device->_statistics.AliasingBarriers;
+
+        // Without a resource after, any can be used next, which leaves it to the
+        // barriers that follow
+        if (barrier.Resource == nullptr)
+        {
+            return;
+        }
+
+        NullRenderResource& resource = AsNull(barrier.Resource);
+        if (resource.IsSplitting())
+        {
+            throw std::logic_error("Aliasing barrier names a resource between the halves of a split barrier");
+        }
+        for (NullRenderResource* other : resource._heap->_resources)
+        {
+            if (resource._Overlaps(*other))
+            {
+                other->_active = false;
+            }
+        }
+        resource._active = true;
+        resource._needsInitialization = (resource._desc.Flags & (ResourceFlags::AllowRenderTarget | ResourceFlags::AllowDepthStencil)) != ResourceFlags::None;
+        std::fill(resource._data.begin(), resource._data.end(), UndefinedContents);
+    }
+
+    void NullRenderQueue::_Discard(NullRenderResource& resource)
+    {
+        CheckActive(resource);
+        if (resource.IsSplitting())
+        {
+            throw std::logic_error("Resource discarded between the halves of a split barrier");
+        }
+        ResourceState required = (resource._desc.Flags & ResourceFlags::AllowDepthStencil) != ResourceFlags::None ?
+            ResourceState::DepthWrite : ResourceState::RenderTarget;
+        if (resource._desc.Dimension == ResourceDimension::Buffer || resource._state != required)
+        {
+            throw std::logic_error("Discarded resource is not a render target or depth buffer in its write state");
+        }
+        resource._needsInitialization = false;
+        std::fill(resource._data.begin(), resource._data.end(), UndefinedContents);
+        ++_device->_statistics.Discards;
+    }
+
+    void NullRenderQueue::_Copy(NullRenderResource& destination, uint64_t destinationOffset,
+        NullRenderResource& source, uint64_t sourceOffset, uint64_t size)
+    {
+        CheckCopyState(destination, ResourceState::CopyDest);
+        CheckCopyState(source, ResourceState::CopySource);
+        destination._needsInitialization = false;
+        if (destinationOffset + size > destination._data.size() || sourceOffset + size > source._data.size())
+        {
+            throw std::out_of_range("Copy past the end of a resource");
+        }
+
+        std::memmove(destination._data.data() + destinationOffset, source._data.data() + sourceOffset, size);
+        ++_device->_statistics.Copies;
+        _device->_statistics.CopiedBytes += size;
+    }
+
+    void NullRenderQueue::_CopyTexture(NullRenderResource& texture, NullRenderResource& buffer, uint64_t bufferOffset, bool toBuffer)
+    {
+        CheckCopyState(toBuffer ? buffer : texture, ResourceState::CopyDest);
+        CheckCopyState(toBuffer ? texture : buffer, ResourceState::CopySource);
+        (toBuffer ? buffer : texture)._needsInitialization = false;
+
+        uint64_t rowPitch;
+        uint64_t footprintSize = _device->GetCopyableFootprint(texture._desc, &rowPitch);
+        if (bufferOffset % TexturePlacementAlignment != 0 || bufferOffset + footprintSize > buffer._data.size())
+        {
+            throw std::out_of_range("Texture footprint misaligned or past the end of the buffer");
+        }
+
+        uint64_t rowSize = GetRowSize(texture._desc);
+        for (uint32_t y = 0; y < texture._desc.Height; ++y)
+        {
+            uint8_t* textureRow = texture._data.data() + y * rowSize;
+            uint8_t* bufferRow = buffer._data.data() + bufferOffset + y * rowPitch;
+            if (toBuffer)
+            {
+                std::memcpy(bufferRow, textureRow, rowSize);
+            }
+            else
+            {
+                std::memcpy(textureRow, bufferRow, rowSize);
+            }
+        }
+        ++_device->_statistics.Copies;
+        _device->_statistics.CopiedBytes += rowSize * texture._desc.Height;
+    }
+
+    NullRenderDevice::NullRenderDevice() :
+        _directQueue(*this, CommandListType::Direct),
+        _computeQueue(*this, CommandListType::Compute),
+        _copyQueue(*this, CommandListType::Copy)
+    {
+    }
+
+    RenderQueue& NullRenderDevice::GetQueue(CommandListType type)
+    {
+        switch (type)
+        {
+            case CommandListType::Direct:
+                return _directQueue;
+            case CommandListType::Compute:
+                return _computeQueue;
+            case CommandListType::Copy:
+                return _copyQueue;
+            default:
+                throw std::invalid_argument("The device has no queue of this type");
+        }
+    }
+
+    std::shared_ptr<RenderResource> NullRenderDevice::CreateResource(const ResourceDesc& desc)
+    {
+        _CheckResourceDesc(desc);
+
+        uint64_t size = GetRowSize(desc) * desc.Height;
+        uint64_t gpuAddress;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            gpuAddress = _nextGpuAddress;
+            _nextGpuAddress += AlignUp(std::max<uint64_t>(size, 1), ResourceAlignment);
+            ++_statistics.ResourceAllocations;
+            _statistics.AllocatedBytes += size;
+        }
+        return std::make_shared<NullRenderResource>(*this, desc, gpuAddress);
+    }
+
+    std::shared_ptr<RenderHeap> NullRenderDevice::CreateHeap(uint64_t size)
+    {
+        uint64_t gpuAddress;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            gpuAddress = _nextGpuAddress;
+            _nextGpuAddress += AlignUp(std::max<uint64_t>(size, 1), ResourceAlignment);
+            ++_statistics.HeapAllocations;
+            _statistics.AllocatedBytes += size;
+        }
+        return std::make_shared<NullRenderHeap>(size, gpuAddress);
+    }
+
+    std::shared_ptr<RenderResource> NullRenderDevice::CreatePlacedResource(std::shared_ptr<RenderHeap> heap, uint64_t offset, const ResourceDesc& desc)
+    {
+        _CheckResourceDesc(desc);
+        if (desc.Heap != HeapType::Default)
+        {
+            throw std::invalid_argument("Placed resources must be on the default heap");
+        }
+        if (offset % ResourceAlignment != 0 || offset + GetAllocationSize(desc) > heap->GetSize())
+        {
+            throw std::invalid_argument("Placed resource misaligned or past the end of the heap");
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_statistics.ResourceAllocations;
+        }
+        return std::make_shared<NullRenderResource>(*this, desc, std::static_pointer_cast<NullRenderHeap>(std::move(heap)), offset);
+    }
+
+    uint64_t NullRenderDevice::GetAllocationSize(const ResourceDesc& desc, uint64_t* alignment) const
+    {
+        if (alignment != nullptr)
+        {
+            *alignment = ResourceAlignment;
+        }
+        return AlignUp(std::max<uint64_t>(GetRowSize(desc) * desc.Height, 1), ResourceAlignment);
+    }
+
+    std::shared_ptr<RenderDescriptorHeap> NullRenderDevice::CreateDescriptorHeap(DescriptorHeapType type, uint32_t count, bool shaderVisible)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint64_t start = _nextDescriptorAddress;
+        _nextDescriptorAddress += AlignUp(static_cast<uint64_t>(count) * NullRenderDescriptorHeap::IncrementSize + 1, ResourceAlignment);
+        ++_statistics.DescriptorHeapAllocations;
+        return std::make_shared<NullRenderDescriptorHeap>(type, count, shaderVisible, start);
+    }
+
+    uint64_t NullRenderDevice::GetCopyableFootprint(const ResourceDesc& desc, uint64_t* rowPitch) const
+    {
+        uint64_t rowSize = GetRowSize(desc);
+        uint64_t pitch = desc.Dimension == ResourceDimension::Buffer ? rowSize : AlignUp(rowSize, TextureRowPitchAlignment);
+        if (rowPitch != nullptr)
+        {
+            *rowPitch = pitch;
+        }
+        return pitch * (desc.Height - 1) + rowSize;
+    }
+
+    void NullRenderDevice::CreateShaderResourceView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _descriptors[destination.Cpu] = &resource;
+        ++_statistics.DescriptorWrites;
+    }
+
+    void NullRenderDevice::CreateUnorderedAccessView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride)
+    {
+        if ((resource.GetDesc().Flags & ResourceFlags::AllowUnorderedAccess) == ResourceFlags::None)
+        {
+            throw std::invalid_argument("Unordered access views need a resource allowing unordered access");
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _descriptors[destination.Cpu] = &resource;
+        ++_statistics.DescriptorWrites;
+    }
+
+    void NullRenderDevice::CopyDescriptors(DescriptorHandle destination, DescriptorHandle source, uint32_t count, DescriptorHeapType type)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint64_t offset = static_cast<uint64_t>(i) * NullRenderDescriptorHeap::IncrementSize;
+            auto described = _descriptors.find(source.Cpu + offset);
+            if (described != _descriptors.end())
+            {
+                _descriptors[destination.Cpu + offset] = described->second;
+            }
+            else
+            {
+                _descriptors.erase(destination.Cpu + offset);
+            }
+        }
+        _statistics.DescriptorWrites += count;
+    }
+
+    NullBackendStatistics NullRenderDevice::GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _statistics;
+    }
+
+    void NullRenderDevice::ResetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _statistics = {};
+    }
+
+    void NullRenderDevice::_CheckResourceDesc(const ResourceDesc& desc)
+    {
+        if (desc.Dimension != ResourceDimension::Buffer && desc.Heap != HeapType::Default)
+        {
+            throw std::invalid_argument("Textures must be on the default heap");
+        }
+        if (desc.Heap == HeapType::Upload && desc.InitialState != ResourceState::GenericRead)
+        {
+            throw std::invalid_argument("Upload heap resources must start in the generic read state");
+        }
+        if (desc.Heap == HeapType::Readback && desc.InitialState != ResourceState::CopyDest)
+        {
+            throw std::invalid_argument("Readback heap resources must start in the copy destination state");
+        }
+    }
+
+    const RenderResource* NullRenderDevice::GetDescribedResource(DescriptorHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto described = _descriptors.find(handle.Cpu);
+        return described != _descriptors.end() ? described->second : nullptr;
+    }
+}
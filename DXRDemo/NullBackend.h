@@ -0,0 +1,308 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "RenderBackend.h"
+
+namespace DXRDemo
+{
+    // RenderBackend without a GPU, for building frames headless.
+    //
+    // Command lists record their commands, which the queues replay on submission:
+    // barriers are checked against the state the resource is in and move it to the
+    // next, split ones keeping it out of use until they end in the same list,
+    // copies check their states and move the bytes between resources held in
+    // memory. Placed resources share their heap's bytes, and only the one an
+    // aliasing barrier named last among those overlapping can be used, its
+    // contents filled with a pattern in place of undefined ones. Mismatches
+    // throw std::logic_error where D3D12 would report an error.
+    // The device counts what frames cost, barriers, copies and allocations, and
+    // queues can complete their work a few signals late, the way a GPU running
+    // behind the CPU would.
+    //
+    // The device must outlive everything it creates.
+
+    class NullRenderDevice;
+    class NullRenderResource;
+
+    struct NullBackendStatistics
+    {
+        uint64_t CommandListAllocations = 0;
+        uint64_t ExecutedCommandLists = 0;
+        uint64_t Signals = 0;
+        // Barriers, and the calls submitting them
+        uint64_t Barriers = 0;
+        uint64_t BarrierBatches = 0;
+        // Split transitions, counted once each
+        uint64_t SplitBarriers = 0;
+        uint64_t AliasingBarriers = 0;
+        uint64_t Discards = 0;
+        uint64_t Copies = 0;
+        uint64_t CopiedBytes = 0;
+        // Resources, committed or placed, and the bytes of the committed ones and heaps
+        uint64_t ResourceAllocations = 0;
+        uint64_t HeapAllocations = 0;
+        uint64_t AllocatedBytes = 0;
+        uint64_t ResourceReleases = 0;
+        uint64_t DescriptorHeapAllocations = 0;
+        uint64_t DescriptorWrites = 0;
+    };
+
+    class NullRenderHeap final : public RenderHeap
+    {
+    public:
+        NullRenderHeap(uint64_t size, uint64_t gpuAddress);
+
+        uint64_t GetSize() const override;
+
+    private:
+        friend class NullRenderResource;
+        friend class NullRenderQueue;
+        friend class NullRenderDevice;
+
+        uint64_t _gpuAddress;
+        std::vector<uint8_t> _memory;
+        // Placed in the heap, guarded by the device mutex
+        std::vector<NullRenderResource*> _resources;
+    };
+
+    class NullRenderResource final : public RenderResource
+    {
+    public:
+        NullRenderResource(NullRenderDevice& device, const ResourceDesc& desc, uint64_t gpuAddress);
+        // Placed at heapOffset in the heap
+        NullRenderResource(NullRenderDevice& device, const ResourceDesc& desc, std::shared_ptr<NullRenderHeap> heap, uint64_t heapOffset);
+        NullRenderResource(const NullRenderResource&) = delete;
+        NullRenderResource& operator=(const NullRenderResource&) = delete;
+        ~NullRenderResource();
+
+        const ResourceDesc& GetDesc() const override;
+        void* Map() override;
+        void Unmap() override;
+        uint64_t GetGpuAddress() const override;
+
+        // State left by the commands executed so far
+        inline ResourceState GetState() const
+        {
+            return _state;
+        }
+
+        // Between the halves of a split transition, when it must not be used
+        inline bool IsSplitting() const
+        {
+            return _splitting;
+        }
+
+        // Whether the resource can be used, placed ones losing their memory to
+        // the overlapping one an aliasing barrier names
+        inline bool IsActive() const
+        {
+            return _active;
+        }
+
+        // Render targets and depth buffers an aliasing barrier handed memory to
+        // must be discarded or copied to before anything reads them
+        inline bool NeedsInitialization() const
+        {
+            return _needsInitialization;
+        }
+
+        // Contents, rows packed without padding for textures
+        inline std::span<uint8_t> GetData()
+        {
+            return _data;
+        }
+
+    private:
+        friend class NullRenderQueue;
+
+        NullRenderDevice* _device;
+        ResourceDesc _desc;
+        uint64_t _gpuAddress;
+        ResourceState _state;
+        bool _splitting = false;
+        ResourceState _splitState = ResourceState::Common;
+        bool _active = true;
+        bool _needsInitialization = false;
+        // Null for committed resources, which own their bytes
+        std::shared_ptr<NullRenderHeap> _heap;
+        uint64_t _heapOffset = 0;
+        std::vector<uint8_t> _ownedData;
+        std::span<uint8_t> _data;
+
+        // With the device mutex held
+        bool _Overlaps(const NullRenderResource& other) const;
+    };
+
+    class NullRenderFence final : public RenderFence
+    {
+    public:
+        uint64_t GetCompletedValue() const override;
+
+        // Throws std::logic_error for a value never signaled, which would never complete
+        void Wait(uint64_t value) override;
+
+        // Marks value as submitted. Everything but the last latency values
+        // submitted counts as completed.
+        void Signal(uint64_t value, uint32_t latency);
+
+        uint64_t GetSignaledValue() const;
+
+    private:
+        mutable std::mutex _mutex;
+        uint64_t _signaledValue = 0;
+        uint64_t _completedValue = 0;
+    };
+
+    class NullRenderDescriptorHeap final : public RenderDescriptorHeap
+    {
+    public:
+        // Handles are spaced like D3D12 CBV/SRV/UAV descriptors on most hardware
+        static constexpr uint32_t IncrementSize = 32;
+
+        NullRenderDescriptorHeap(DescriptorHeapType type, uint32_t count, bool shaderVisible, uint64_t start);
+
+        DescriptorHeapType GetType() const override;
+        uint32_t GetCount() const override;
+        bool IsShaderVisible() const override;
+        DescriptorHandle GetHandle(uint32_t index) const override;
+
+    private:
+        DescriptorHeapType _type;
+        uint32_t _count;
+        bool _shaderVisible;
+        uint64_t _start;
+    };
+
+    struct NullCommand
+    {
+        enum class Type
+        {
+            Barriers,
+            CopyBufferRegion,
+            CopyResource,
+            CopyTextureToBuffer,
+            CopyBufferToTexture,
+            DiscardResource,
+            SetDescriptorHeaps
+        };
+
+        Type Kind;
+        std::vector<ResourceBarrier> Barriers;
+        RenderResource* Destination = nullptr;
+        RenderResource* Source = nullptr;
+        uint64_t DestinationOffset = 0;
+        uint64_t SourceOffset = 0;
+        uint64_t Size = 0;
+    };
+
+    class NullRenderCommandList final : public RenderCommandList
+    {
+    public:
+        explicit NullRenderCommandList(CommandListType type);
+
+        CommandListType GetType() const override;
+        void Barriers(std::span<const ResourceBarrier> barriers) override;
+        void CopyBufferRegion(RenderResource& destination, uint64_t destinationOffset,
+            RenderResource& source, uint64_t sourceOffset, uint64_t size) override;
+        void CopyResource(RenderResource& destination, RenderResource& source) override;
+        void CopyTextureToBuffer(RenderResource& destination, uint64_t bufferOffset, RenderResource& source) override;
+        void CopyBufferToTexture(RenderResource& destination, RenderResource& source, uint64_t bufferOffset) override;
+        void DiscardResource(RenderResource& resource) override;
+        void SetDescriptorHeaps(std::span<RenderDescriptorHeap* const> heaps) override;
+
+        inline const std::vector<NullCommand>& GetCommands() const
+        {
+            return _commands;
+        }
+
+    private:
+        friend class NullRenderQueue;
+
+        CommandListType _type;
+        std::vector<NullCommand> _commands;
+    };
+
+    class NullRenderQueue final : public RenderQueue
+    {
+    public:
+        NullRenderQueue(NullRenderDevice& device, CommandListType type);
+
+        CommandListType GetType() const override;
+        RenderFence& GetFence() override;
+        std::unique_ptr<RenderCommandList> GetCommandList() override;
+        uint64_t ExecuteCommandList(std::unique_ptr<RenderCommandList> commandList) override;
+        uint64_t Signal() override;
+        void Wait(RenderQueue& queue, uint64_t fenceValue) override;
+
+        // Signals after which the work before one is complete, 0 to complete
+        // everything as soon as it is submitted
+        void SetLatency(uint32_t signals);
+
+    private:
+        NullRenderDevice* _device;
+        CommandListType _type;
+        NullRenderFence _fence;
+        uint64_t _fenceValue = 0;
+        uint32_t _latency = 0;
+        std::vector<std::unique_ptr<RenderCommandList>> _commandLists;
+        // Resources whose split transition the list executing began
+        std::vector<NullRenderResource*> _splitResources;
+
+        // All with the device mutex held
+        uint64_t _Signal();
+        void _Execute(const NullCommand& command);
+        void _Transition(const ResourceBarrier& barrier);
+        void _Alias(const ResourceBarrier& barrier);
+        void _Discard(NullRenderResource& resource);
+        void _Copy(NullRenderResource& destination, uint64_t destinationOffset,
+            NullRenderResource& source, uint64_t sourceOffset, uint64_t size);
+        // Copies between a texture and its footprint in a buffer
+        void _CopyTexture(NullRenderResource& texture, NullRenderResource& buffer, uint64_t bufferOffset, bool toBuffer);
+    };
+
+    class NullRenderDevice final : public RenderDevice
+    {
+    public:
+        NullRenderDevice();
+
+        RenderQueue& GetQueue(CommandListType type) override;
+        std::shared_ptr<RenderResource> CreateResource(const ResourceDesc& desc) override;
+        std::shared_ptr<RenderHeap> CreateHeap(uint64_t size) override;
+        std::shared_ptr<RenderResource> CreatePlacedResource(std::shared_ptr<RenderHeap> heap, uint64_t offset, const ResourceDesc& desc) override;
+        uint64_t GetAllocationSize(const ResourceDesc& desc, uint64_t* alignment = nullptr) const override;
+        std::shared_ptr<RenderDescriptorHeap> CreateDescriptorHeap(DescriptorHeapType type, uint32_t count, bool shaderVisible) override;
+        uint64_t GetCopyableFootprint(const ResourceDesc& desc, uint64_t* rowPitch = nullptr) const override;
+        void CreateShaderResourceView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride = 0) override;
+        void CreateUnorderedAccessView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride = 0) override;
+        void CopyDescriptors(DescriptorHandle destination, DescriptorHandle source, uint32_t count, DescriptorHeapType type) override;
+
+        NullBackendStatistics GetStatistics();
+        void ResetStatistics();
+
+        // Resource the view last written to a CPU descriptor handle refers to, or null
+        const RenderResource* GetDescribedResource(DescriptorHandle handle);
+
+    private:
+        friend class NullRenderResource;
+        friend class NullRenderQueue;
+
+        // The rules the D3D12 debug layer enforces on resource creation
+        static void _CheckResourceDesc(const ResourceDesc& desc);
+
+        // Guards the statistics and the resources replayed commands touch, which
+        // several queues can share
+        std::mutex _mutex;
+        NullBackendStatistics _statistics;
+        uint64_t _nextGpuAddress = 0x10000;
+        uint64_t _nextDescriptorAddress = 0x10000;
+        std::unordered_map<uint64_t, const RenderResource*> _descriptors;
+        NullRenderQueue _directQueue;
+        NullRenderQueue _computeQueue;
+        NullRenderQueue _copyQueue;
+    };
+}
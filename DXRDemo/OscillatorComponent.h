@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Component.h"
+#include "GameObject.h"
 #include <vector>
 #include <memory>
 
@@ -22,6 +23,7 @@ namespace DXRDemo
                 
                 Parent->Transform.Position.x = Radius * cos(angle);
                 Parent->Transform.Position.z = Radius * sin(angle);
+                Parent->MarkTransformDirty();
             }
         };
 
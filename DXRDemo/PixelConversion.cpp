@@ -0,0 +1,398 @@
+#include "PixelConversion.h"
+
+#include <algorithm>
+#include <immintrin.h>
+#include <DirectXPackedVector.h>
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    namespace PixelConversion
+    {
+        namespace
+        {
+            constexpr uint16_t HalfOne = 0x3C00;
+
+            // Vectors of two RGBA pixels are compacted to six RGB floats and stored
+            // at six float steps, each store overwriting the two spare floats of the
+            // previous one. The last store of a block spills into the next pixel,
+            // which is why the loops stop one pixel before the end.
+            namespace Avx2
+            {
+                size_t Rgba8ToRgb32f(const uint8_t* source, float* destination, size_t pixelCount)
+                {
+                    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+                    size_t i = 0;
+                    for (; i + 9 <= pixelCount; i += 8)
+                    {
+                        const uint8_t* in = source + i * 4;
+                        float* out = destination + i * 3;
+                        for (size_t k = 0; k < 4; ++k)
+                        {
+                            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + k * 8));
+                            __m256 pixels = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+                            _mm256_storeu_ps(out + k * 6, _mm256_permutevar8x32_ps(pixels, compact));
+                        }
+                    }
+
+                    return i;
+                }
+
+                size_t Rgb32fToRgba8(const float* source, uint8_t* destination, size_t pixelCount)
+                {
+                    const __m256i expand = _mm256_setr_epi32(0, 1, 2, 2, 3, 4, 5, 5);
+                    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+                    const __m256 zero = _mm256_setzero_ps();
+                    const __m256 maximum = _mm256_set1_ps(255.0f);
+                    const __m256i alpha = _mm256_set1_epi32(255);
+
+                    auto convert = [&](const float* in)
+                    {
+                        __m256 pixels = _mm256_permutevar8x32_ps(_mm256_loadu_ps(in), expand);
+                        // NaN becomes 0, max returns its second operand when one is NaN
+                        pixels = _mm256_min_ps(_mm256_max_ps(pixels, zero), maximum);
+                        return _mm256_blend_epi32(_mm256_cvttps_epi32(pixels), alpha, 0x88);
+                    };
+
+                    size_t i = 0;
+                    for (; i + 9 <= pixelCount; i += 8)
+                    {
+                        const float* in = source + i * 3;
+
+                        // Packing works within 128-bit lanes, so the pixels come out
+                        // in the order 0 2 4 6 1 3 5 7 and are reordered afterwards
+                        __m256i pixels01 = convert(in);
+                        __m256i pixels23 = convert(in + 6);
+                        __m256i pixels45 = convert(in + 12);
+                        __m256i pixels67 = convert(in + 18);
+                        __m256i words0123 = _mm256_packus_epi32(pixels01, pixels23);
+                        __m256i words4567 = _mm256_packus_epi32(pixels45, pixels67);
+                        __m256i bytes = _mm256_packus_epi16(words0123, words4567);
+                        bytes = _mm256_permutevar8x32_epi32(bytes, order);
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), bytes);
+                    }
+
+                    return i;
+                }
+
+                size_t Rgba16fToRgb32f(const uint16_t* source, float* destination, size_t pixelCount)
+                {
+                    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+                    size_t i = 0;
+                    for (; i + 9 <= pixelCount; i += 8)
+                    {
+                        const uint16_t* in = source + i * 4;
+                        float* out = destination + i * 3;
+                        for (size_t k = 0; k < 4; ++k)
+                        {
+                            __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + k * 8));
+                            __m256 pixels = _mm256_cvtph_ps(halves);
+                            _mm256_storeu_ps(out + k * 6, _mm256_permutevar8x32_ps(pixels, compact));
+                        }
+                    }
+
+                    return i;
+                }
+
+                size_t Rgb32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount)
+                {
+                    const __m256i expand = _mm256_setr_epi32(0, 1, 2, 2, 3, 4, 5, 5);
+                    const __m256 alpha = _mm256_set1_ps(1.0f);
+
+                    size_t i = 0;
+                    for (; i + 9 <= pixelCount; i += 8)
+                    {
+                        const float* in = source + i * 3;
+                        uint16_t* out = destination + i * 4;
+                        for (size_t k = 0; k < 4; ++k)
+                        {
+                            __m256 pixels = _mm256_permutevar8x32_ps(_mm256_loadu_ps(in + k * 6), expand);
+                            pixels = _mm256_blend_ps(pixels, alpha, 0x88);
+                            __m128i halves = _mm256_cvtps_ph(pixels, _MM_FROUND_TO_NEAREST_INT);
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k * 8), halves);
+                        }
+                    }
+
+                    return i;
+                }
+
+                size_t Rgba16fToRgba32f(const uint16_t* source, float* destination, size_t pixelCount)
+                {
+                    size_t i = 0;
+                    for (; i + 2 <= pixelCount; i += 2)
+                    {
+                        __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+                        _mm256_storeu_ps(destination + i * 4, _mm256_cvtph_ps(halves));
+                    }
+
+                    return i;
+                }
+
+                size_t Rgba32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount)
+                {
+                    size_t i = 0;
+                    for (; i + 2 <= pixelCount; i += 2)
+                    {
+                        __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(source + i * 4), _MM_FROUND_TO_NEAREST_INT);
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), halves);
+                    }
+
+                    return i;
+                }
+            }
+
+            namespace Sse41
+            {
+                size_t Rgba8ToRgb32f(const uint8_t* source, float* destination, size_t pixelCount)
+                {
+                    size_t i = 0;
+                    for (; i + 4 <= pixelCount; i += 4)
+                    {
+                        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+                        __m128 pixel0 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes));
+                        __m128 pixel1 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)));
+                        __m128 pixel2 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+                        __m128 pixel3 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12)));
+
+                        // r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+                        float* out = destination + i * 3;
+                        _mm_storeu_ps(out, _mm_blend_ps(pixel0, _mm_shuffle_ps(pixel1, pixel1, _MM_SHUFFLE(0, 0, 0, 0)), 0x8));
+                        _mm_storeu_ps(out + 4, _mm_shuffle_ps(pixel1, pixel2, _MM_SHUFFLE(1, 0, 2, 1)));
+                        _mm_storeu_ps(out + 8, _mm_move_ss(
+                            _mm_shuffle_ps(pixel3, pixel3, _MM_SHUFFLE(2, 1, 0, 0)),
+                            _mm_shuffle_ps(pixel2, pixel2, _MM_SHUFFLE(2, 2, 2, 2))));
+                    }
+
+                    return i;
+                }
+
+                size_t Rgb32fToRgba8(const float* source, uint8_t* destination, size_t pixelCount)
+                {
+                    const __m128 zero = _mm_setzero_ps();
+                    const __m128 maximum = _mm_set1_ps(255.0f);
+                    const __m128i alpha = _mm_set1_epi32(255);
+
+                    auto convert = [&](__m128 pixel)
+                    {
+                        // NaN becomes 0, max returns its second operand when one is NaN
+                        pixel = _mm_min_ps(_mm_max_ps(pixel, zero), maximum);
+                        return _mm_blend_epi16(_mm_cvttps_epi32(pixel), alpha, 0xC0);
+                    };
+
+                    size_t i = 0;
+                    for (; i + 4 <= pixelCount; i += 4)
+                    {
+                        // r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+                        const float* in = source + i * 3;
+                        __m128 floats0 = _mm_loadu_ps(in);
+                        __m128 floats1 = _mm_loadu_ps(in + 4);
+                        __m128 floats2 = _mm_loadu_ps(in + 8);
+
+                        __m128 red1 = _mm_shuffle_ps(floats0, floats1, _MM_SHUFFLE(1, 0, 3, 3));
+                        __m128i pixel0 = convert(floats0);
+                        __m128i pixel1 = convert(_mm_shuffle_ps(red1, red1, _MM_SHUFFLE(3, 3, 2, 0)));
+                        __m128i pixel2 = convert(_mm_shuffle_ps(floats1, floats2, _MM_SHUFFLE(0, 0, 3, 2)));
+                        __m128i pixel3 = convert(_mm_shuffle_ps(floats2, floats2, _MM_SHUFFLE(3, 3, 2, 1)));
+
+                        __m128i words01 = _mm_packus_epi32(pixel0, pixel1);
+                        __m128i words23 = _mm_packus_epi32(pixel2, pixel3);
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_packus_epi16(words01, words23));
+                    }
+
+                    return i;
+                }
+            }
+
+            template <typename Source, typename Destination>
+            void ConvertRows(
+                void (*convert)(const Source*, Destination*, size_t),
+                const void* source, size_t sourceRowPitch,
+                void* destination, size_t destinationRowPitch,
+                size_t width, size_t height, ThreadPool& threadPool)
+            {
+                // Rows are handed out in ranges large enough to amortize the dispatch
+                const size_t minPixelsPerRange = 16384;
+                size_t minRows = std::max<size_t>(1, minPixelsPerRange / std::max<size_t>(width, 1));
+
+                threadPool.ParallelFor(height, minRows, [&](size_t begin, size_t end)
+                {
+                    for (size_t y = begin; y < end; ++y)
+                    {
+                        convert(
+                            reinterpret_cast<const Source*>(reinterpret_cast<const uint8_t*>(source) + y * sourceRowPitch),
+                            reinterpret_cast<Destination*>(reinterpret_cast<uint8_t*>(destination) + y * destinationRowPitch),
+                            width);
+                    }
+                });
+            }
+        }
+
+        namespace Scalar
+        {
+            void Rgba8ToRgb32f(const uint8_t* source, float* destination, size_t pixelCount)
+            {
+                for (size_t i = 0; i < pixelCount; ++i)
+                {
+                    destination[i * 3 + 0] = static_cast<float>(source[i * 4 + 0]);
+                    destination[i * 3 + 1] = static_cast<float>(source[i * 4 + 1]);
+                    destination[i * 3 + 2] = static_cast<float>(source[i * 4 + 2]);
+                }
+            }
+
+            void Rgb32fToRgba8(const float* source, uint8_t* destination, size_t pixelCount)
+            {
+                auto convert = [](float value)
+                {
+                    // Written so that NaN becomes 0 like in the vector versions
+                    return static_cast<uint8_t>(value > 0.0f ? (value < 255.0f ? value : 255.0f) : 0.0f);
+                };
+
+                for (size_t i = 0; i < pixelCount; ++i)
+                {
+                    destination[i * 4 + 0] = convert(source[i * 3 + 0]);
+                    destination[i * 4 + 1] = convert(source[i * 3 + 1]);
+                    destination[i * 4 + 2] = convert(source[i * 3 + 2]);
+                    destination[i * 4 + 3] = 255;
+                }
+            }
+
+            void Rgba16fToRgb32f(const uint16_t* source, float* destination, size_t pixelCount)
+            {
+                for (size_t i = 0; i < pixelCount; ++i)
+                {
+                    destination[i * 3 + 0] = DirectX::PackedVector::XMConvertHalfToFloat(source[i * 4 + 0]);
+                    destination[i * 3 + 1] = DirectX::PackedVector::XMConvertHalfToFloat(source[i * 4 + 1]);
+                    destination[i * 3 + 2] = DirectX::PackedVector::XMConvertHalfToFloat(source[i * 4 + 2]);
+                }
+            }
+
+            void Rgb32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount)
+            {
+                for (size_t i = 0; i < pixelCount; ++i)
+                {
+                    destination[i * 4 + 0] = DirectX::PackedVector::XMConvertFloatToHalf(source[i * 3 + 0]);
+                    destination[i * 4 + 1] = DirectX::PackedVector::XMConvertFloatToHalf(source[i * 3 + 1]);
+                    destination[i * 4 + 2] = DirectX::PackedVector::XMConvertFloatToHalf(source[i * 3 + 2]);
+                    destination[i * 4 + 3] = HalfOne;
+                }
+            }
+
+            void Rgba16fToRgba32f(const uint16_t* source, float* destination, size_t pixelCount)
+            {
+                for (size_t i = 0; i < pixelCount * 4; ++i)
+                {
+                    destination[i] = DirectX::PackedVector::XMConvertHalfToFloat(source[i]);
+                }
+            }
+
+            void Rgba32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount)
+            {
+                for (size_t i = 0; i < pixelCount * 4; ++i)
+                {
+                    destination[i] = DirectX::PackedVector::XMConvertFloatToHalf(source[i]);
+                }
+            }
+        }
+
+        void Rgba8ToRgb32f(const uint8_t* source, float* destination, size_t pixelCount)
+        {
+            const CpuFeatures& features = GetCpuFeatures();
+            size_t done = 0;
+            if (features.Avx2)
+            {
+                done = Avx2::Rgba8ToRgb32f(source, destination, pixelCount);
+            }
+            else if (features.Sse41)
+            {
+                done = Sse41::Rgba8ToRgb32f(source, destination, pixelCount);
+            }
+            Scalar::Rgba8ToRgb32f(source + done * 4, destination + done * 3, pixelCount - done);
+        }
+
+        void Rgb32fToRgba8(const float* source, uint8_t* destination, size_t pixelCount)
+        {
+            const CpuFeatures& features = GetCpuFeatures();
+            size_t done = 0;
+            if (features.Avx2)
+            {
+                done = Avx2::Rgb32fToRgba8(source, destination, pixelCount);
+            }
+            else if (features.Sse41)
+            {
+                done = Sse41::Rgb32fToRgba8(source, destination, pixelCount);
+            }
+            Scalar::Rgb32fToRgba8(source + done * 3, destination + done * 4, pixelCount - done);
+        }
+
+        void Rgba16fToRgb32f(const uint16_t* source, float* destination, size_t pixelCount)
+        {
+            const CpuFeatures& features = GetCpuFeatures();
+            size_t done = 0;
+            if (features.Avx2 && features.F16c)
+            {
+                done = Avx2::Rgba16fToRgb32f(source, destination, pixelCount);
+            }
+            Scalar::Rgba16fToRgb32f(source + done * 4, destination + done * 3, pixelCount - done);
+        }
+
+        void Rgb32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount)
+        {
+            const CpuFeatures& features = GetCpuFeatures();
+            size_t done = 0;
+            if (features.Avx2 && features.F16c)
+            {
+                done = Avx2::Rgb32fToRgba16f(source, destination, pixelCount);
+            }
+            Scalar::Rgb32fToRgba16f(source + done * 3, destination + done * 4, pixelCount - done);
+        }
+
+        void Rgba16fToRgba32f(const uint16_t* source, float* destination, size_t pixelCount)
+        {
+            const CpuFeatures& features = GetCpuFeatures();
+            size_t done = 0;
+            if (features.F16c)
+            {
+                done = Avx2::Rgba16fToRgba32f(source, destination, pixelCount);
+            }
+            Scalar::Rgba16fToRgba32f(source + done * 4, destination + done * 4, pixelCount - done);
+        }
+
+        void Rgba32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount)
+        {
+            const CpuFeatures& features = GetCpuFeatures();
+            size_t done = 0;
+            if (features.F16c)
+            {
+                done = Avx2::Rgba32fToRgba16f(source, destination, pixelCount);
+            }
+            Scalar::Rgba32fToRgba16f(source + done * 4, destination + done * 4, pixelCount - done);
+        }
+
+        void Rgba8ToRgb32f(const void* source, size_t sourceRowPitch, void* destination, size_t destinationRowPitch,
+            size_t width, size_t height, ThreadPool& threadPool)
+        {
+            ConvertRows<uint8_t, float>(Rgba8ToRgb32f, source, sourceRowPitch, destination, destinationRowPitch, width, height, threadPool);
+        }
+
+        void Rgb32fToRgba8(const void* source, size_t sourceRowPitch, void* destination, size_t destinationRowPitch,
+            size_t width, size_t height, ThreadPool& threadPool)
+        {
+            ConvertRows<float, uint8_t>(Rgb32fToRgba8, source, sourceRowPitch, destination, destinationRowPitch, width, height, threadPool);
+        }
+
+        void Rgba16fToRgb32f(const void* source, size_t sourceRowPitch, void* destination, size_t destinationRowPitch,
+            size_t width, size_t height, ThreadPool& threadPool)
+        {
+            ConvertRows<uint16_t, float>(Rgba16fToRgb32f, source, sourceRowPitch, destination, destinationRowPitch, width, height, threadPool);
+        }
+
+        void Rgb32fToRgba16f(const void* source, size_t sourceRowPitch, void* destination, size_t destinationRowPitch,
+            size_t width, size_t height, ThreadPool& threadPool)
+        {
+            ConvertRows<float, uint16_t>(Rgb32fToRgba16f, source, sourceRowPitch, destination, destinationRowPitch, width, height, threadPool);
+        }
+    }
+}
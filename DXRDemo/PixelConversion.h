@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DXRDemo
+{
+    class ThreadPool;
+
+    // Conversions between the images read back from the GPU and the packed RGB
+    // float images the denoiser works on. RGBA8 channels convert to floats in
+    // [0, 255] unscaled, and floats convert back clamped to [0, 255] and
+    // truncated. Alpha is dropped on the way in and written opaque on the way out.
+    //
+    // The kernels use AVX2 or SSE4.1 when the CPU has them, half conversions also
+    // need F16C, and fall back to the scalar versions otherwise.
+    namespace PixelConversion
+    {
+        void Rgba8ToRgb32f(const uint8_t* source, float* destination, size_t pixelCount);
+        void Rgb32fToRgba8(const float* source, uint8_t* destination, size_t pixelCount);
+        void Rgba16fToRgb32f(const uint16_t* source, float* destination, size_t pixelCount);
+        void Rgb32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount);
+
+        // Half and single precision RGBA, alpha included
+        void Rgba16fToRgba32f(const uint16_t* source, float* destination, size_t pixelCount);
+        void Rgba32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount);
+
+        // Reference versions, one pixel at a time
+        namespace Scalar
+        {
+            void Rgba8ToRgb32f(const uint8_t* source, float* destination, size_t pixelCount);
+            void Rgb32fToRgba8(const float* source, uint8_t* destination, size_t pixelCount);
+            void Rgba16fToRgb32f(const uint16_t* source, float* destination, size_t pixelCount);
+            void Rgb32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount);
+            void Rgba16fToRgba32f(const uint16_t* source, float* destination, size_t pixelCount);
+            void Rgba32fToRgba16f(const float* source, uint16_t* destination, size_t pixelCount);
+        }
+
+        // Whole images split across a thread pool by rows. Row pitches are in bytes.
+        void Rgba8ToRgb32f(const void* source, size_t sourceRowPitch, void* destination, size_t destinationRowPitch,
+            size_t width, size_t height, ThreadPool& threadPool);
+        void Rgb32fToRgba8(const void* source, size_t sourceRowPitch, void* destination, size_t destinationRowPitch,
+            size_t width, size_t height, ThreadPool& threadPool);
+        void Rgba16fToRgb32f(const void* source, size_t sourceRowPitch, void* destination, size_t destinationRowPitch,
+            size_t width, size_t height, ThreadPool& threadPool);
+        void Rgb32fToRgba16f(const void* source, size_t sourceRowPitch, void* destination, size_t destinationRowPitch,
+            size_t width, size_t height, ThreadPool& threadPool);
+    }
+}
@@ -0,0 +1,191 @@
+#include "PlacedResourceAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <d3dx12.h>
+#include "Utilities.h"
+
+using namespace Microsoft::WRL;
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // Private data of a placed resource, owning its range of the heap
+        // {8E1D4C27-3B5A-4F60-A2D9-6C7E0B9F1A35}
+        const GUID RangeOwnerGuid = { 0x8e1d4c27, 0x3b5a, 0x4f60, { 0xa2, 0xd9, 0x6c, 0x7e, 0x0b, 0x9f, 0x1a, 0x35 } };
+    }
+
+    // The runtime releases private data interfaces with the resource, the last
+    // reference to the owner then freeing the range
+    class PlacedResourceAllocator::RangeOwner final : public IUnknown
+    {
+    public:
+        RangeOwner(std::shared_ptr<State> state, uint32_t heapIndex, uint64_t offset) :
+            _state(std::move(state)),
+            _heapIndex(heapIndex),
+            _offset(offset)
+        {
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+        {
+            if (object == nullptr)
+            {
+                return E_POINTER;
+            }
+            if (riid != __uuidof(IUnknown))
+            {
+                *object = nullptr;
+                return E_NOINTERFACE;
+            }
+
+            AddRef();
+            *object = static_cast<IUnknown*>(this);
+            return S_OK;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++_references;
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            ULONG references = --_references;
+            if (references == 0)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(_state->Mutex);
+                    _state->Heaps[_heapIndex].Ranges.Free(_offset);
+                    --_state->ResourceCount;
+                }
+                delete this;
+            }
+            return references;
+        }
+
+        inline uint32_t GetHeapIndex() const
+        {
+            return _heapIndex;
+        }
+
+        inline uint64_t GetOffset() const
+        {
+            return _offset;
+        }
+
+    private:
+        std::atomic<ULONG> _references = 1;
+        std::shared_ptr<State> _state;
+        uint32_t _heapIndex;
+        uint64_t _offset;
+    };
+
+    PlacedResourceAllocator::PlacedResourceAllocator(ID3D12Device* device, uint64_t heapSize) :
+        _device(device),
+        _heapSize(heapSize),
+        _state(std::make_shared<State>())
+    {
+    }
+
+    ComPtr<ID3D12Resource> PlacedResourceAllocator::CreateBuffer(uint64_t size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initialState)
+    {
+        CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(size, flags);
+        D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = _device->GetResourceAllocationInfo(0, 1, &desc);
+
+        uint32_t heapIndex = 0;
+        uint64_t offset = TlsfAllocator::InvalidOffset;
+        {
+            std::lock_guard<std::mutex> lock(_state->Mutex);
+            for (; heapIndex < _state->Heaps.size(); ++heapIndex)
+            {
+                offset = _state->Heaps[heapIndex].Ranges.Allocate(allocationInfo.SizeInBytes, allocationInfo.Alignment);
+                if (offset != TlsfAllocator::InvalidOffset)
+                {
+                    break;
+                }
+            }
+
+            if (offset == TlsfAllocator::InvalidOffset)
+            {
+                // Buffers larger than a heap get one of their own size
+                CD3DX12_HEAP_DESC heapDesc(
+                    std::max(_heapSize, allocationInfo.SizeInBytes),
+                    D3D12_HEAP_TYPE_DEFAULT,
+                    D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+                    D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS);
+                Heap heap{ nullptr, TlsfAllocator(heapDesc.SizeInBytes) };
+                ThrowIfFailed(_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap.NativeHeap)));
+
+                heapIndex = static_cast<uint32_t>(_state->Heaps.size());
+                _state->Heaps.push_back(std::move(heap));
+                offset = _state->Heaps[heapIndex].Ranges.Allocate(allocationInfo.SizeInBytes, allocationInfo.Alignment);
+            }
+        }
+
+        return _CreatePlacedResource(desc, initialState, heapIndex, offset);
+    }
+
+    ComPtr<ID3D12Resource> PlacedResourceAllocator::Relocate(ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState)
+    {
+        ComPtr<IUnknown> owner;
+        UINT dataSize = sizeof(IUnknown*);
+        ThrowIfFailed(resource->GetPrivateData(RangeOwnerGuid, &dataSize, owner.GetAddressOf()));
+        const RangeOwner& range = *static_cast<RangeOwner*>(owner.Get());
+
+        D3D12_RESOURCE_DESC desc = resource->GetDesc();
+        uint64_t offset;
+        {
+            std::lock_guard<std::mutex> lock(_state->Mutex);
+            TlsfAllocator& ranges = _state->Heaps[range.GetHeapIndex()].Ranges;
+            offset = ranges.AllocateBelow(ranges.GetAllocationSize(range.GetOffset()),
+                D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, range.GetOffset());
+            if (offset == TlsfAllocator::InvalidOffset)
+            {
+                return nullptr;
+            }
+            ++_state->Relocations;
+        }
+
+        return _CreatePlacedResource(desc, initialState, range.GetHeapIndex(), offset);
+    }
+
+    PlacedResourceStatistics PlacedResourceAllocator::GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(_state->Mutex);
+
+        PlacedResourceStatistics statistics;
+        statistics.HeapCount = static_cast<uint32_t>(_state->Heaps.size());
+        statistics.ResourceCount = _state->ResourceCount;
+        statistics.Relocations = _state->Relocations;
+        for (const Heap& heap : _state->Heaps)
+        {
+            TlsfStatistics rangeStatistics = heap.Ranges.GetStatistics();
+            statistics.HeapBytes += heap.Ranges.GetCapacity();
+            statistics.UsedBytes += rangeStatistics.UsedSize;
+            statistics.LargestFreeBlock = std::max(statistics.LargestFreeBlock, rangeStatistics.LargestFreeBlock);
+        }
+        return statistics;
+    }
+
+    ComPtr<ID3D12Resource> PlacedResourceAllocator::_CreatePlacedResource(
+        const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, uint32_t heapIndex, uint64_t offset)
+    {
+        // Owns the range from here, freeing it if the resource cannot be created
+        ComPtr<IUnknown> owner;
+        owner.Attach(new RangeOwner(_state, heapIndex, offset));
+
+        ComPtr<ID3D12Heap> heap;
+        {
+            std::lock_guard<std::mutex> lock(_state->Mutex);
+            heap = _state->Heaps[heapIndex].NativeHeap;
+            ++_state->ResourceCount;
+        }
+
+        ComPtr<ID3D12Resource> resource;
+        ThrowIfFailed(_device->CreatePlacedResource(heap.Get(), offset, &desc, initialState, nullptr, IID_PPV_ARGS(&resource)));
+        ThrowIfFailed(resource->SetPrivateDataInterface(RangeOwnerGuid, owner.Get()));
+        return resource;
+    }
+}
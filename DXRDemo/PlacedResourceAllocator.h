@@ -0,0 +1,75 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "TlsfAllocator.h"
+
+namespace DXRDemo
+{
+    struct PlacedResourceStatistics
+    {
+        uint32_t HeapCount = 0;
+        uint32_t ResourceCount = 0;
+        uint64_t HeapBytes = 0;
+        uint64_t UsedBytes = 0;
+        uint64_t LargestFreeBlock = 0;
+        uint64_t Relocations = 0;
+    };
+
+    // Creates default heap buffers as placed resources packed into large heaps,
+    // instead of committed resources each taking a heap of its own. Ranges are
+    // suballocated with a TlsfAllocator per heap on the placement alignment the
+    // device reports, and come back to it when the resource is destroyed, so the
+    // buffers are kept alive and released like any other ComPtr. Thread safe.
+    class PlacedResourceAllocator final
+    {
+    public:
+        static constexpr uint64_t DefaultHeapSize = 64 * 1024 * 1024;
+
+        explicit PlacedResourceAllocator(ID3D12Device* device, uint64_t heapSize = DefaultHeapSize);
+        PlacedResourceAllocator(const PlacedResourceAllocator&) = delete;
+        PlacedResourceAllocator& operator=(const PlacedResourceAllocator&) = delete;
+
+        // Stands in for nv_helpers_dx12::CreateBuffer on the default heap
+        Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(uint64_t size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initialState);
+
+        // Defragmentation hook. Creates a buffer like resource placed lower in its
+        // heap, or returns null if there is no room below it. The caller copies
+        // the contents over and replaces its references, and the range of the old
+        // buffer comes back once that one is released.
+        Microsoft::WRL::ComPtr<ID3D12Resource> Relocate(ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState);
+
+        PlacedResourceStatistics GetStatistics() const;
+
+    private:
+        // Set as private data of each resource, frees its range on destruction
+        class RangeOwner;
+
+        struct Heap
+        {
+            Microsoft::WRL::ComPtr<ID3D12Heap> NativeHeap;
+            TlsfAllocator Ranges;
+        };
+
+        // Shared with the resources' range owners, which may outlive the allocator
+        struct State
+        {
+            std::mutex Mutex;
+            std::vector<Heap> Heaps;
+            uint32_t ResourceCount = 0;
+            uint64_t Relocations = 0;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D12Device> _device;
+        uint64_t _heapSize;
+        std::shared_ptr<State> _state;
+
+        // Places a resource of desc in the range, which it then owns
+        Microsoft::WRL::ComPtr<ID3D12Resource> _CreatePlacedResource(
+            const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, uint32_t heapIndex, uint64_t offset);
+    };
+}
@@ -0,0 +1,179 @@
+#include "QualitySweep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include "DenoiserService.h"
+#include "ImageMetrics.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        struct Measurement
+        {
+            int32_t Samples;
+            const char* Denoiser;
+            double TraceMilliseconds;
+            double DenoiseMilliseconds;
+            ImageMetrics::Comparison Error;
+        };
+
+        const char* QualityName(DenoiseQuality quality)
+        {
+            switch (quality)
+            {
+            case DenoiseQuality::Fast:
+                return "fast";
+            case DenoiseQuality::Balanced:
+                return "balanced";
+            default:
+                return "high";
+            }
+        }
+
+        bool EndsWith(const std::string& value, const std::string& suffix)
+        {
+            return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        // Infinite PSNRs have no JSON representation
+        double Finite(double value)
+        {
+            return std::isfinite(value) ? value : 1e9;
+        }
+
+        void WriteCsv(std::ofstream& file, const QualitySweepSettings& settings, double referenceMilliseconds,
+            const std::vector<Measurement>& measurements)
+        {
+            file << "# reference_samples=" << settings.ReferenceSamples << " reference_ms=" << referenceMilliseconds
+                << " denoise_quality=" << QualityName(settings.Quality);
+            for (const auto& [name, value] : settings.Parameters)
+            {
+                file << " " << name << "=" << value;
+            }
+            file << "\n";
+
+            file << "samples,denoiser,trace_ms,denoise_ms,total_ms,rmse,relative_rmse,psnr_db,ssim,flip\n";
+            for (const Measurement& measurement : measurements)
+            {
+                file << measurement.Samples << "," << measurement.Denoiser << ","
+                    << measurement.TraceMilliseconds << "," << measurement.DenoiseMilliseconds << ","
+                    << measurement.TraceMilliseconds + measurement.DenoiseMilliseconds << ","
+                    << measurement.Error.Rmse << "," << measurement.Error.RelativeRmse << ","
+                    << measurement.Error.Psnr << "," << measurement.Error.Ssim << "," << measurement.Error.Flip << "\n";
+            }
+        }
+
+        void WriteJson(std::ofstream& file, std::size_t width, std::size_t height, const QualitySweepSettings& settings,
+            double referenceMilliseconds, const std::vector<Measurement>& measurements)
+        {
+            file << "{\n";
+            file << "  \"width\": " << width << ",\n";
+            file << "  \"height\": " << height << ",\n";
+            file << "  \"reference\": { \"samples\": " << settings.ReferenceSamples << ", \"ms\": " << referenceMilliseconds << " },\n";
+            file << "  \"denoise_quality\": \"" << QualityName(settings.Quality) << "\",\n";
+            file << "  \"settings\": {";
+            for (std::size_t i = 0; i < settings.Parameters.size(); ++i)
+            {
+                file << (i == 0 ? " " : ", ") << "\"" << settings.Parameters[i].first << "\": " << settings.Parameters[i].second;
+            }
+            file << " },\n";
+            file << "  \"measurements\": [\n";
+            for (std::size_t i = 0; i < measurements.size(); ++i)
+            {
+                const Measurement& measurement = measurements[i];
+                file << "    { \"samples\": " << measurement.Samples
+                    << ", \"denoiser\": \"" << measurement.Denoiser << "\""
+                    << ", \"trace_ms\": " << measurement.TraceMilliseconds
+                    << ", \"denoise_ms\": " << measurement.DenoiseMilliseconds
+                    << ", \"total_ms\": " << measurement.TraceMilliseconds + measurement.DenoiseMilliseconds
+                    << ", \"rmse\": " << measurement.Error.Rmse
+                    << ", \"relative_rmse\": " << measurement.Error.RelativeRmse
+                    << ", \"psnr_db\": " << Finite(measurement.Error.Psnr)
+                    << ", \"ssim\": " << measurement.Error.Ssim
+                    << ", \"flip\": " << measurement.Error.Flip
+                    << " }" << (i + 1 < measurements.size() ? "," : "") << "\n";
+            }
+            file << "  ]\n";
+            file << "}\n";
+        }
+    }
+
+    void RunQualitySweep(const std::string& filename, std::size_t width, std::size_t height,
+        const QualitySweepSettings& settings, const QualitySweepTraceFunction& trace,
+        DenoiserService& denoiser, ThreadPool& threadPool)
+    {
+        if (settings.ReferenceSamples < 1 || settings.ReferencePassSamples < 1 || settings.MaxSamples < 1)
+        {
+            throw std::invalid_argument("Quality sweep sample counts must be positive");
+        }
+
+        std::ofstream file(filename);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open quality sweep file for writing");
+        }
+
+        // Seed 0 is left to the swept images, so the reference shares no samples with them
+        std::vector<float> reference(width * height * 4, 0.0f);
+        double referenceMilliseconds = 0;
+        int32_t seed = 1;
+        for (int32_t traced = 0; traced < settings.ReferenceSamples; ++seed)
+        {
+            int32_t samples = std::min(settings.ReferencePassSamples, settings.ReferenceSamples - traced);
+            QualitySweepImage pass = trace(samples, seed);
+            float weight = static_cast<float>(samples) / settings.ReferenceSamples;
+            for (std::size_t i = 0; i < reference.size(); ++i)
+            {
+                reference[i] += weight * pass.Radiance[i];
+            }
+            referenceMilliseconds += pass.TraceMilliseconds;
+            traced += samples;
+        }
+
+        struct SweptDenoiser
+        {
+            DenoiserBackend Backend;
+            const char* Name;
+        };
+        std::vector<SweptDenoiser> backends;
+        if (denoiser.IsOpenImageDenoiseAvailable())
+        {
+            backends.push_back({ DenoiserBackend::OpenImageDenoise, "oidn" });
+        }
+        backends.push_back({ DenoiserBackend::Wavelet, "wavelet" });
+
+        std::vector<Measurement> measurements;
+        std::vector<float> denoised(width * height * 4);
+        std::size_t rowPitch = width * 4 * sizeof(float);
+
+        for (int32_t samples = 1; samples <= settings.MaxSamples; samples *= 2)
+        {
+            QualitySweepImage image = trace(samples, 0);
+            measurements.push_back({ samples, "none", image.TraceMilliseconds, 0,
+                ImageMetrics::Compare(image.Radiance.data(), reference.data(), width, height, settings.Tonemap, threadPool) });
+
+            for (const SweptDenoiser& backend : backends)
+            {
+                // Setup is a one-time cost, left out of the time to quality
+                DenoiserService::Timing timing = denoiser.Denoise(width, height, DXGI_FORMAT_R32G32B32A32_FLOAT,
+                    backend.Backend, settings.Quality, image.Radiance.data(), image.Albedo.data(), image.Normal.data(),
+                    rowPitch, denoised.data(), rowPitch);
+                measurements.push_back({ samples, backend.Name, image.TraceMilliseconds, timing.DenoiseMilliseconds,
+                    ImageMetrics::Compare(denoised.data(), reference.data(), width, height, settings.Tonemap, threadPool) });
+            }
+        }
+
+        if (EndsWith(filename, ".json"))
+        {
+            WriteJson(file, width, height, settings, referenceMilliseconds, measurements);
+        }
+        else
+        {
+            WriteCsv(file, settings, referenceMilliseconds, measurements);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "DenoiseQuality.h"
+#include "Tonemap.h"
+
+namespace DXRDemo
+{
+    class DenoiserService;
+    class ThreadPool;
+
+    // A traced image as RGBA floats, with the denoiser features of its first hits
+    struct QualitySweepImage
+    {
+        std::vector<float> Radiance;
+        std::vector<float> Albedo;
+        std::vector<float> Normal;
+        // Wall clock time of the trace, in milliseconds
+        double TraceMilliseconds = 0;
+    };
+
+    // Traces the view at a sample count per pixel. Traces with the same sample
+    // count and seed give the same image.
+    using QualitySweepTraceFunction = std::function<QualitySweepImage(int32_t samples, int32_t seed)>;
+
+    struct QualitySweepSettings
+    {
+        // Samples per pixel of the reference, traced in passes of at most
+        // ReferencePassSamples with different seeds and averaged, which keeps each
+        // dispatch short enough for the GPU watchdog
+        int32_t ReferenceSamples = 4096;
+        int32_t ReferencePassSamples = 256;
+        // Images are traced at powers of two samples per pixel up to this
+        int32_t MaxSamples = 256;
+        DenoiseQuality Quality = DenoiseQuality::High;
+        // Display transform of the SSIM and FLIP comparisons
+        TonemapSettings Tonemap;
+        // Render settings the images are traced with, written along with the results
+        std::vector<std::pair<std::string, double>> Parameters;
+    };
+
+    // Measures time to quality: traces a high sample count reference, then images
+    // at increasing sample counts, each compared to the reference as is and after
+    // denoising with every denoiser available. The errors against the samples and
+    // against the trace plus denoise time are written as JSON when the filename
+    // ends in .json, CSV otherwise.
+    void RunQualitySweep(const std::string& filename, std::size_t width, std::size_t height,
+        const QualitySweepSettings& settings, const QualitySweepTraceFunction& trace,
+        DenoiserService& denoiser, ThreadPool& threadPool);
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace DXRDemo
+{
+    // Backend neutral description of the GPU objects frames are built from:
+    // devices, queues, command lists, resources, heaps, fences and descriptor
+    // heaps.
+    //
+    // Code written against these interfaces runs on D3D12Backend, or on
+    // NullBackend, which records the commands and keeps resources in memory so
+    // frame logic can be exercised and measured without a GPU. Pipelines, root
+    // signatures and the draws and dispatches using them stay native D3D12.
+    //
+    // Enumeration values match their D3D12 counterparts.
+
+    enum class CommandListType : uint32_t
+    {
+        Direct = 0,
+        Compute = 2,
+        Copy = 3
+    };
+
+    enum class HeapType : uint32_t
+    {
+        Default = 1,
+        Upload = 2,
+        Readback = 3
+    };
+
+    enum class ResourceDimension : uint32_t
+    {
+        Buffer = 1,
+        Texture2D = 3
+    };
+
+    enum class ResourceFormat : uint32_t
+    {
+        Unknown = 0,
+        R32G32B32A32Float = 2,
+        R32G32B32Float = 6,
+        R16G16B16A16Float = 10,
+        R8G8B8A8Unorm = 28,
+        D32Float = 40,
+        R32Uint = 42,
+        R16Uint = 57
+    };
+
+    enum class ResourceFlags : uint32_t
+    {
+        None = 0,
+        AllowRenderTarget = 0x1,
+        AllowDepthStencil = 0x2,
+        AllowUnorderedAccess = 0x4
+    };
+
+    enum class ResourceState : uint32_t
+    {
+        Common = 0,
+        Present = 0,
+        VertexAndConstantBuffer = 0x1,
+        IndexBuffer = 0x2,
+        RenderTarget = 0x4,
+        UnorderedAccess = 0x8,
+        DepthWrite = 0x10,
+        DepthRead = 0x20,
+        NonPixelShaderResource = 0x40,
+        PixelShaderResource = 0x80,
+        IndirectArgument = 0x200,
+        CopyDest = 0x400,
+        CopySource = 0x800,
+        RaytracingAccelerationStructure = 0x400000,
+        GenericRead = 0x1 | 0x2 | 0x40 | 0x80 | 0x200 | 0x800
+    };
+
+    constexpr ResourceFlags operator|(ResourceFlags a, ResourceFlags b)
+    {
+        return static_cast<ResourceFlags>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+    }
+
+    constexpr ResourceFlags operator&(ResourceFlags a, ResourceFlags b)
+    {
+        return static_cast<ResourceFlags>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
+    }
+
+    constexpr ResourceState operator|(ResourceState a, ResourceState b)
+    {
+        return static_cast<ResourceState>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+    }
+
+    constexpr ResourceState operator&(ResourceState a, ResourceState b)
+    {
+        return static_cast<ResourceState>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
+    }
+
+    // Whether state includes every bit of required
+    constexpr bool HasState(ResourceState state, ResourceState required)
+    {
+        return (state & required) == required;
+    }
+
+    // Bytes per pixel of a format, 0 for Unknown
+    constexpr uint32_t GetFormatSize(ResourceFormat format)
+    {
+        switch (format)
+        {
+            case ResourceFormat::R32G32B32A32Float:
+                return 16;
+            case ResourceFormat::R32G32B32Float:
+                return 12;
+            case ResourceFormat::R16G16B16A16Float:
+                return 8;
+            case ResourceFormat::R8G8B8A8Unorm:
+            case ResourceFormat::D32Float:
+            case ResourceFormat::R32Uint:
+                return 4;
+            case ResourceFormat::R16Uint:
+                return 2;
+            default:
+                return 0;
+        }
+    }
+
+    struct ResourceDesc
+    {
+        ResourceDimension Dimension = ResourceDimension::Buffer;
+        // Bytes for buffers, pixels for textures
+        uint64_t Width = 0;
+        uint32_t Height = 1;
+        ResourceFormat Format = ResourceFormat::Unknown;
+        ResourceFlags Flags = ResourceFlags::None;
+        HeapType Heap = HeapType::Default;
+        ResourceState InitialState = ResourceState::Common;
+
+        static inline ResourceDesc Buffer(uint64_t size, HeapType heap = HeapType::Default,
+            ResourceState initialState = ResourceState::Common, ResourceFlags flags = ResourceFlags::None)
+        {
+            return { ResourceDimension::Buffer, size, 1, ResourceFormat::Unknown, flags, heap, initialState };
+        }
+
+        static inline ResourceDesc Texture2D(uint64_t width, uint32_t height, ResourceFormat format,
+            ResourceState initialState = ResourceState::Common, ResourceFlags flags = ResourceFlags::None)
+        {
+            return { ResourceDimension::Texture2D, width, height, format, flags, HeapType::Default, initialState };
+        }
+    };
+
+    class RenderResource
+    {
+    public:
+        virtual ~RenderResource() = default;
+
+        virtual const ResourceDesc& GetDesc() const = 0;
+
+        // Pointer to the contents of a buffer on an upload or readback heap, valid
+        // until Unmap
+        virtual void* Map() = 0;
+        virtual void Unmap() = 0;
+
+        // Address of a buffer for root views and acceleration structures
+        virtual uint64_t GetGpuAddress() const = 0;
+    };
+
+    // Default heap memory resources are placed in, several of them at the same
+    // offset when their uses never overlap
+    class RenderHeap
+    {
+    public:
+        virtual ~RenderHeap() = default;
+
+        virtual uint64_t GetSize() const = 0;
+    };
+
+    class RenderFence
+    {
+    public:
+        virtual ~RenderFence() = default;
+
+        virtual uint64_t GetCompletedValue() const = 0;
+
+        // Blocks the calling thread until the fence reaches value
+        virtual void Wait(uint64_t value) = 0;
+    };
+
+    enum class DescriptorHeapType : uint32_t
+    {
+        CbvSrvUav = 0,
+        Sampler = 1,
+        Rtv = 2,
+        Dsv = 3
+    };
+
+    struct DescriptorHandle
+    {
+        uint64_t Cpu = 0;
+        // 0 unless the heap is shader visible
+        uint64_t Gpu = 0;
+    };
+
+    class RenderDescriptorHeap
+    {
+    public:
+        virtual ~RenderDescriptorHeap() = default;
+
+        virtual DescriptorHeapType GetType() const = 0;
+        virtual uint32_t GetCount() const = 0;
+        virtual bool IsShaderVisible() const = 0;
+        virtual DescriptorHandle GetHandle(uint32_t index) const = 0;
+    };
+
+    struct ResourceBarrier
+    {
+        enum class Type
+        {
+            Transition,
+            UnorderedAccess,
+            Aliasing
+        };
+
+        // Halves of a split transition. The resource is not to be used between
+        // the two, which must be in the same command list.
+        enum class Split : uint32_t
+        {
+            None = 0,
+            BeginOnly = 0x1,
+            EndOnly = 0x2
+        };
+
+        Type Kind = Type::Transition;
+        // The resource after an aliasing barrier
+        RenderResource* Resource = nullptr;
+        // The resource before an aliasing barrier, unused by the others
+        RenderResource* ResourceBefore = nullptr;
+        ResourceState StateBefore = ResourceState::Common;
+        ResourceState StateAfter = ResourceState::Common;
+        Split SplitFlags = Split::None;
+
+        static inline ResourceBarrier Transition(RenderResource& resource, ResourceState stateBefore, ResourceState stateAfter,
+            Split splitFlags = Split::None)
+        {
+            return { Type::Transition, &resource, nullptr, stateBefore, stateAfter, splitFlags };
+        }
+
+        static inline ResourceBarrier UnorderedAccess(RenderResource& resource)
+        {
+            return { Type::UnorderedAccess, &resource };
+        }
+
+        // Either resource can be null, to stand for any resource of the heap
+        static inline ResourceBarrier Aliasing(RenderResource* resourceBefore, RenderResource* resourceAfter)
+        {
+            return { Type::Aliasing, resourceAfter, resourceBefore };
+        }
+    };
+
+    class RenderCommandList
+    {
+    public:
+        virtual ~RenderCommandList() = default;
+
+        virtual CommandListType GetType() const = 0;
+
+        virtual void Barriers(std::span<const ResourceBarrier> barriers) = 0;
+
+        inline void Barrier(const ResourceBarrier& barrier)
+        {
+            Barriers({ &barrier, 1 });
+        }
+
+        virtual void CopyBufferRegion(RenderResource& destination, uint64_t destinationOffset,
+            RenderResource& source, uint64_t sourceOffset, uint64_t size) = 0;
+
+        virtual void CopyResource(RenderResource& destination, RenderResource& source) = 0;
+
+        // Copies between a texture and a buffer holding it in the layout
+        // RenderDevice::GetCopyableFootprint gives, starting at bufferOffset
+        virtual void CopyTextureToBuffer(RenderResource& destination, uint64_t bufferOffset, RenderResource& source) = 0;
+        virtual void CopyBufferToTexture(RenderResource& destination, RenderResource& source, uint64_t bufferOffset) = 0;
+
+        // Leaves the contents undefined, which initializes a render target or
+        // depth buffer after an aliasing barrier without a clear. The resource
+        // must be in the render target or depth write state.
+        virtual void DiscardResource(RenderResource& resource) = 0;
+
+        virtual void SetDescriptorHeaps(std::span<RenderDescriptorHeap* const> heaps) = 0;
+    };
+
+    class RenderQueue
+    {
+    public:
+        virtual ~RenderQueue() = default;
+
+        virtual CommandListType GetType() const = 0;
+
+        // Fence the queue signals with the values returned by ExecuteCommandList and Signal
+        virtual RenderFence& GetFence() = 0;
+
+        // Command list ready for recording
+        virtual std::unique_ptr<RenderCommandList> GetCommandList() = 0;
+
+        // Closes and submits the command list, which goes back to the queue, and
+        // returns the fence value that marks its completion
+        virtual uint64_t ExecuteCommandList(std::unique_ptr<RenderCommandList> commandList) = 0;
+
+        virtual uint64_t Signal() = 0;
+
+        // Makes the GPU wait for another queue to reach fenceValue before running
+        // the work submitted after this call
+        virtual void Wait(RenderQueue& queue, uint64_t fenceValue) = 0;
+
+        inline bool IsFenceComplete(uint64_t fenceValue)
+        {
+            return GetFence().GetCompletedValue() >= fenceValue;
+        }
+
+        inline void WaitForFenceValue(uint64_t fenceValue)
+        {
+            GetFence().Wait(fenceValue);
+        }
+
+        inline void Flush()
+        {
+            WaitForFenceValue(Signal());
+        }
+    };
+
+    class RenderDevice
+    {
+    public:
+        virtual ~RenderDevice() = default;
+
+        // Throws std::invalid_argument for a queue type the device has none of
+        virtual RenderQueue& GetQueue(CommandListType type) = 0;
+
+        // Resource with its own memory. The device must outlive it.
+        virtual std::shared_ptr<RenderResource> CreateResource(const ResourceDesc& desc) = 0;
+
+        // Heap buffers and textures of any kind can be placed in together
+        virtual std::shared_ptr<RenderHeap> CreateHeap(uint64_t size) = 0;
+
+        // Resource in the heap's memory at offset, which it keeps alive. Resources
+        // placed over each other take turns through aliasing barriers, the one
+        // named last by a barrier being the one in use, and its contents are
+        // undefined until written. The description must be on the default heap.
+        virtual std::shared_ptr<RenderResource> CreatePlacedResource(std::shared_ptr<RenderHeap> heap, uint64_t offset, const ResourceDesc& desc) = 0;
+
+        // Heap bytes a placed resource of desc takes, and the alignment of its offset
+        virtual uint64_t GetAllocationSize(const ResourceDesc& desc, uint64_t* alignment = nullptr) const = 0;
+
+        virtual std::shared_ptr<RenderDescriptorHeap> CreateDescriptorHeap(DescriptorHeapType type, uint32_t count, bool shaderVisible) = 0;
+
+        // Size of a buffer holding a copy of the resource, and the pitch of its rows
+        virtual uint64_t GetCopyableFootprint(const ResourceDesc& desc, uint64_t* rowPitch = nullptr) const = 0;
+
+        // Views of whole resources. Buffers are viewed as structured buffers when
+        // a stride is given and as raw ones otherwise.
+        virtual void CreateShaderResourceView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride = 0) = 0;
+        virtual void CreateUnorderedAccessView(RenderResource& resource, DescriptorHandle destination, uint32_t structureStride = 0) = 0;
+
+        virtual void CopyDescriptors(DescriptorHandle destination, DescriptorHandle source, uint32_t count, DescriptorHeapType type) = 0;
+    };
+}
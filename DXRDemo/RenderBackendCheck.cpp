@@ -0,0 +1,1509 @@
+#include "RenderBackendCheck.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "DescriptorAllocator.h"
+#include "FencedPool.h"
+#include "FrameGraph.h"
+#include "FramesInFlight.h"
+#include "LinearUploadBuffer.h"
+#include "NullBackend.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+#include "RingAllocator.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        const uint32_t Width = 320;
+        const uint32_t Height = 240;
+        const int FrameCount = 8;
+        const ResourceFormat Format = ResourceFormat::R16G16B16A16Float;
+
+        // Resources of a ray traced frame, as Game creates them
+        struct FrameResources
+        {
+            std::shared_ptr<RenderResource> BackBuffer;
+            std::shared_ptr<RenderResource> Radiance;
+            std::shared_ptr<RenderResource> Albedo;
+            std::shared_ptr<RenderResource> Normal;
+            // Radiance, albedo and normal read back, then the denoised radiance
+            std::shared_ptr<RenderResource> Readback;
+            std::shared_ptr<RenderResource> Upload;
+            uint64_t ImageFootprintSize = 0;
+        };
+
+        FrameResources CreateFrameResources(RenderDevice& device)
+        {
+            FrameResources resources;
+            resources.BackBuffer = device.CreateResource(ResourceDesc::Texture2D(Width, Height, ResourceFormat::R8G8B8A8Unorm,
+                ResourceState::Present, ResourceFlags::AllowRenderTarget));
+            // Ready to be traced into, the state frames recorded by hand leave them in
+            ResourceDesc imageDesc = ResourceDesc::Texture2D(Width, Height, Format, ResourceState::UnorderedAccess, ResourceFlags::AllowUnorderedAccess);
+            resources.Radiance = device.CreateResource(imageDesc);
+            resources.Albedo = device.CreateResource(imageDesc);
+            resources.Normal = device.CreateResource(imageDesc);
+
+            // Footprints follow each other, the image size being a multiple of their 512 byte alignment
+            uint64_t rowPitch;
+            device.GetCopyableFootprint(imageDesc, &rowPitch);
+            resources.ImageFootprintSize = rowPitch * Height;
+            resources.Readback = device.CreateResource(ResourceDesc::Buffer(3 * resources.ImageFootprintSize, HeapType::Readback, ResourceState::CopyDest));
+            resources.Upload = device.CreateResource(ResourceDesc::Buffer(resources.ImageFootprintSize, HeapType::Upload, ResourceState::GenericRead));
+            return resources;
+        }
+
+        // What the passes of a denoised ray traced frame copy, the draws and
+        // dispatches left out
+        void RecordReadback(RenderCommandList& commandList, FrameResources& resources)
+        {
+            commandList.CopyTextureToBuffer(*resources.Readback, 0, *resources.Radiance);
+            commandList.CopyTextureToBuffer(*resources.Readback, resources.ImageFootprintSize, *resources.Albedo);
+            commandList.CopyTextureToBuffer(*resources.Readback, 2 * resources.ImageFootprintSize, *resources.Normal);
+        }
+
+        void RecordResult(RenderCommandList& commandList, FrameResources& resources)
+        {
+            commandList.CopyBufferToTexture(*resources.Radiance, *resources.Upload, 0);
+        }
+
+        // The passes of DeclareFrame with their barriers recorded by hand, as Game
+        // did before the tracker: the images stay ready to be traced into between
+        // frames, the transitions each point of the frame needs go in one call,
+        // and the list ends after the readback, which the denoiser waits for.
+        void RecordFrame(RenderQueue& queue, FrameResources& resources)
+        {
+            std::unique_ptr<RenderCommandList> commandList = queue.GetCommandList();
+            // DispatchRays
+            ResourceBarrier readbackTransitions[] = {
+                ResourceBarrier::Transition(*resources.Radiance, ResourceState::UnorderedAccess, ResourceState::CopySource),
+                ResourceBarrier::Transition(*resources.Albedo, ResourceState::UnorderedAccess, ResourceState::CopySource),
+                ResourceBarrier::Transition(*resources.Normal, ResourceState::UnorderedAccess, ResourceState::CopySource)
+            };
+            commandList->Barriers(readbackTransitions);
+            RecordReadback(*commandList, resources);
+            queue.ExecuteCommandList(std::move(commandList));
+
+            commandList = queue.GetCommandList();
+            commandList->Barrier(ResourceBarrier::Transition(*resources.Radiance, ResourceState::CopySource, ResourceState::CopyDest));
+            RecordResult(*commandList, resources);
+            ResourceBarrier tonemapTransitions[] = {
+                ResourceBarrier::Transition(*resources.Radiance, ResourceState::CopyDest, ResourceState::PixelShaderResource),
+                ResourceBarrier::Transition(*resources.BackBuffer, ResourceState::Present, ResourceState::RenderTarget)
+            };
+            commandList->Barriers(tonemapTransitions);
+            // Tonemap and interface draws
+            ResourceBarrier presentTransitions[] = {
+                ResourceBarrier::Transition(*resources.Radiance, ResourceState::PixelShaderResource, ResourceState::UnorderedAccess),
+                ResourceBarrier::Transition(*resources.Albedo, ResourceState::CopySource, ResourceState::UnorderedAccess),
+                ResourceBarrier::Transition(*resources.Normal, ResourceState::CopySource, ResourceState::UnorderedAccess),
+                ResourceBarrier::Transition(*resources.BackBuffer, ResourceState::RenderTarget, ResourceState::Present)
+            };
+            commandList->Barriers(presentTransitions);
+            queue.WaitForFenceValue(queue.ExecuteCommandList(std::move(commandList)));
+        }
+
+        // The same frame declared by DeclareFrame, as Game renders it, its barriers
+        // left to the render graph and a ResourceStateTracker. Declared for the
+        // first frame, the graph is executed again for the next ones, their
+        // callbacks given through passes.
+        void RecordTrackedFrame(RenderQueue& queue, RenderGraph& graph, ResourceStateTracker& tracker, FramePasses& passes,
+            FrameResources& resources, bool declare)
+        {
+            FrameImages images;
+            images.BackBuffer = resources.BackBuffer.get();
+            images.Radiance = resources.Radiance.get();
+            images.Features = { resources.Albedo.get(), resources.Normal.get() };
+
+            auto draw = [](RenderCommandList&) {};
+            passes = {};
+            passes.DispatchRays = draw;
+            passes.Readback = [&resources](RenderCommandList& commandList) { RecordReadback(commandList, resources); };
+            passes.Result = [&resources](RenderCommandList& commandList) { RecordResult(commandList, resources); };
+            passes.Tonemap = draw;
+            passes.Interface = draw;
+
+            if (declare)
+            {
+                graph.Reset();
+                DeclareFrame(graph, tracker, images, passes);
+            }
+
+            std::unique_ptr<RenderCommandList> commandList = queue.GetCommandList();
+            graph.Execute(*commandList, tracker, [&](RenderCommandList&) -> RenderCommandList&
+            {
+                tracker.ExecuteCommandList(queue, std::move(commandList));
+                commandList = queue.GetCommandList();
+                return *commandList;
+            });
+            queue.WaitForFenceValue(tracker.ExecuteCommandList(queue, std::move(commandList)));
+        }
+
+        // ResourceStateTracker merges, batches, resolves across lists and splits
+        // transitions the way the null backend accepts.
+        bool CheckResourceStateTracker()
+        {
+            bool passed = true;
+            auto fail = [&passed](const char* message)
+            {
+                std::cerr << "Resource state tracker: " << message << std::endl;
+                passed = false;
+            };
+
+            NullRenderDevice device;
+            RenderQueue& queue = device.GetQueue(CommandListType::Direct);
+            ResourceDesc imageDesc = ResourceDesc::Texture2D(Width, Height, Format, ResourceState::CopySource, ResourceFlags::AllowUnorderedAccess);
+            auto upload = device.CreateResource(ResourceDesc::Buffer(256, HeapType::Upload, ResourceState::GenericRead));
+
+            // Each case starts with resources in their initial states, as a new
+            // registry takes them to be
+            std::shared_ptr<RenderResource> image, other, buffer;
+            auto createResources = [&]()
+            {
+                image = device.CreateResource(imageDesc);
+                other = device.CreateResource(imageDesc);
+                buffer = device.CreateResource(ResourceDesc::Buffer(256, HeapType::Default, ResourceState::CopyDest));
+            };
+
+            // Transitions queued between flushes merge, or cancel out, and every
+            // barrier of a flush goes in one call
+            {
+                createResources();
+                ResourceStateRegistry registry;
+                ResourceStateTracker tracker(registry);
+                std::unique_ptr<RenderCommandList> commandList = queue.GetCommandList();
+                tracker.Transition(*image, ResourceState::CopySource);
+                tracker.Transition(*other, ResourceState::CopySource);
+                tracker.FlushBarriers(*commandList);
+                commandList->CopyBufferRegion(*buffer, 0, *upload, 0, 256);
+
+                tracker.Transition(*image, ResourceState::UnorderedAccess);
+                tracker.Transition(*image, ResourceState::CopyDest);
+                tracker.Transition(*other, ResourceState::UnorderedAccess);
+                tracker.Transition(*other, ResourceState::CopySource);
+                tracker.Transition(*buffer, ResourceState::CopyDest);
+                tracker.FlushBarriers(*commandList);
+
+                tracker.Transition(*image, ResourceState::PixelShaderResource);
+                tracker.Transition(*image, ResourceState::PixelShaderResource | ResourceState::NonPixelShaderResource);
+                tracker.Transition(*image, ResourceState::NonPixelShaderResource);
+                tracker.FlushBarriers(*commandList);
+                tracker.Transition(*image, ResourceState::PixelShaderResource);
+                tracker.FlushBarriers(*commandList);
+
+                device.ResetStatistics();
+                tracker.ExecuteCommandList(queue, std::move(commandList));
+                ResourceStateTrackerStatistics statistics = tracker.GetStatistics();
+                if (statistics.Barriers != 2 || statistics.BarrierBatches != 2 || statistics.MergedTransitions != 3 ||
+                    statistics.RedundantTransitions != 2 || statistics.ResolvedBarriers != 0)
+                {
+                    fail("did not merge, drop and batch the transitions");
+                }
+                if (device.GetStatistics().Barriers != 2 || device.GetStatistics().ExecutedCommandLists != 1)
+                {
+                    fail("recorded other barriers than it counted");
+                }
+                if (registry.GetState(*image) != (ResourceState::PixelShaderResource | ResourceState::NonPixelShaderResource) ||
+                    registry.GetState(*other) != ResourceState::CopySource)
+                {
+                    fail("did not record the states the list left the resources in");
+                }
+            }
+
+            // Lists start from the states the lists submitted before them left the
+            // resources in, through barriers resolved on submission
+            {
+                createResources();
+                ResourceStateRegistry registry;
+                ResourceStateTracker first(registry);
+                ResourceStateTracker second(registry);
+                std::unique_ptr<RenderCommandList> firstCommandList = queue.GetCommandList();
+                std::unique_ptr<RenderCommandList> secondCommandList = queue.GetCommandList();
+
+                // Recorded in any order, submitted in order
+                second.Transition(*image, ResourceState::CopySource);
+                second.Transition(*buffer, ResourceState::CopyDest);
+                second.FlushBarriers(*secondCommandList);
+                first.Transition(*image, ResourceState::UnorderedAccess);
+                first.FlushBarriers(*firstCommandList);
+                first.Transition(*image, ResourceState::RenderTarget);
+                first.Transition(*buffer, ResourceState::CopySource);
+                first.FlushBarriers(*firstCommandList);
+
+                device.ResetStatistics();
+                first.ExecuteCommandList(queue, std::move(firstCommandList));
+                second.ExecuteCommandList(queue, std::move(secondCommandList));
+                if (first.GetStatistics().ResolvedBarriers != 2 || second.GetStatistics().ResolvedBarriers != 2 ||
+                    device.GetStatistics().ExecutedCommandLists != 4)
+                {
+                    fail("did not resolve the states the lists start with");
+                }
+                if (registry.GetState(*image) != ResourceState::CopySource || registry.GetState(*buffer) != ResourceState::CopyDest)
+                {
+                    fail("did not record the states the last list left the resources in");
+                }
+
+                registry.Forget(*image);
+                if (registry.GetState(*image) != imageDesc.InitialState)
+                {
+                    fail("kept the state of a resource forgotten");
+                }
+            }
+
+            // Split barriers overlap the commands in between, and close with the list
+            {
+                createResources();
+                ResourceStateRegistry registry;
+                ResourceStateTracker tracker(registry);
+                std::unique_ptr<RenderCommandList> commandList = queue.GetCommandList();
+                tracker.Transition(*image, ResourceState::CopySource);
+                tracker.Transition(*other, ResourceState::CopySource);
+                tracker.FlushBarriers(*commandList);
+                commandList->CopyBufferRegion(*buffer, 0, *upload, 0, 256);
+
+                tracker.BeginTransition(*image, ResourceState::UnorderedAccess);
+                tracker.BeginTransition(*other, ResourceState::PixelShaderResource);
+                tracker.FlushBarriers(*commandList);
+                commandList->CopyBufferRegion(*buffer, 0, *upload, 0, 256);
+                try
+                {
+                    tracker.BeginTransition(*image, ResourceState::CopyDest);
+                    fail("began a split barrier twice");
+                }
+                catch (const std::logic_error&)
+                {
+                }
+                tracker.Transition(*image, ResourceState::UnorderedAccess);
+                tracker.FlushBarriers(*commandList);
+
+                device.ResetStatistics();
+                tracker.ExecuteCommandList(queue, std::move(commandList));
+                ResourceStateTrackerStatistics statistics = tracker.GetStatistics();
+                if (statistics.SplitBarriers != 2 || statistics.Barriers != 4 || device.GetStatistics().SplitBarriers != 2)
+                {
+                    fail("did not split the barriers");
+                }
+                if (registry.GetState(*other) != ResourceState::PixelShaderResource)
+                {
+                    fail("did not end the split barrier left open");
+                }
+
+                // Splitting one begun since the last flush leaves a whole barrier
+                ResourceStateTracker merging(registry);
+                commandList = queue.GetCommandList();
+                merging.Transition(*image, ResourceState::UnorderedAccess);
+                merging.FlushBarriers(*commandList);
+                merging.BeginTransition(*image, ResourceState::CopySource);
+                merging.Transition(*image, ResourceState::CopySource);
+                merging.ExecuteCommandList(queue, std::move(commandList));
+                if (merging.GetStatistics().SplitBarriers != 0 || merging.GetStatistics().Barriers != 1)
+                {
+                    fail("split a barrier with nothing to overlap");
+                }
+
+                // The null backend catches a resource used mid split
+                commandList = queue.GetCommandList();
+                commandList->Barrier(ResourceBarrier::Transition(*buffer, ResourceState::CopyDest, ResourceState::CopySource, ResourceBarrier::Split::BeginOnly));
+                commandList->CopyBufferRegion(*buffer, 0, *upload, 0, 256);
+                try
+                {
+                    queue.ExecuteCommandList(std::move(commandList));
+                    fail("the backend let a resource be used mid split");
+                }
+                catch (const std::logic_error&)
+                {
+                }
+            }
+
+            // Barriers still queued cannot be resolved
+            {
+                createResources();
+                ResourceStateRegistry registry;
+                ResourceStateTracker tracker(registry);
+                tracker.Transition(*image, ResourceState::CopySource);
+                tracker.FlushBarriers(*queue.GetCommandList());
+                tracker.Transition(*image, ResourceState::CopyDest);
+                std::vector<ResourceBarrier> barriers;
+                try
+                {
+                    tracker.ResolveBarriers(barriers);
+                    fail("resolved a list with barriers not recorded");
+                }
+                catch (const std::logic_error&)
+                {
+                }
+            }
+
+            return passed;
+        }
+
+        // FramesInFlight only hands out slots and releases deferred objects the
+        // GPU is done with, on a queue completing work latency signals late.
+        bool CheckFramesInFlight(uint32_t frameCount, uint32_t latency)
+        {
+            const uint64_t RegionSize = 256;
+            const int PipelinedFrameCount = 16;
+
+            bool passed = true;
+            auto fail = [&passed, frameCount, latency](int frame, const char* message)
+            {
+                std::cerr << frameCount << " frames in flight, GPU " << latency << " frames behind, frame " << frame << ": " << message << std::endl;
+                passed = false;
+            };
+
+            NullRenderDevice device;
+            NullRenderQueue& queue = static_cast<NullRenderQueue&>(device.GetQueue(CommandListType::Direct));
+            queue.SetLatency(latency);
+
+            // One region per frame in flight, written by the CPU and copied by the GPU
+            auto upload = device.CreateResource(ResourceDesc::Buffer(frameCount * RegionSize, HeapType::Upload, ResourceState::GenericRead));
+            auto readback = device.CreateResource(ResourceDesc::Buffer(frameCount * RegionSize, HeapType::Readback, ResourceState::CopyDest));
+
+            struct Deferred
+            {
+                std::weak_ptr<RenderResource> Resource;
+                uint64_t FenceValue;
+            };
+            std::vector<Deferred> deferred;
+            std::vector<uint64_t> slotFenceValues(frameCount, 0);
+            uint64_t mostFramesBehind = 0;
+
+            {
+                FramesInFlight framesInFlight(queue, frameCount);
+                for (int frame = 0; frame < PipelinedFrameCount; ++frame)
+                {
+                    uint32_t slot = framesInFlight.BeginFrame();
+                    if (!queue.IsFenceComplete(slotFenceValues[slot]))
+                    {
+                        fail(frame, "the GPU may still read the slot handed out");
+                    }
+
+                    // The region holds what the frame that last used the slot copied
+                    if (frame >= static_cast<int>(frameCount))
+                    {
+                        uint8_t* data = static_cast<uint8_t*>(readback->Map());
+                        if (data[slot * RegionSize] != static_cast<uint8_t>(frame - frameCount))
+                        {
+                            fail(frame, "read back another frame's data");
+                        }
+                        readback->Unmap();
+                    }
+
+                    for (const Deferred& resource : deferred)
+                    {
+                        bool complete = queue.IsFenceComplete(resource.FenceValue);
+                        if (!complete && resource.Resource.expired())
+                        {
+                            fail(frame, "released a resource frames in flight may use");
+                        }
+                        else if (complete && !resource.Resource.expired())
+                        {
+                            fail(frame, "kept a resource after the frames using it completed");
+                        }
+                    }
+
+                    uint8_t* data = static_cast<uint8_t*>(upload->Map());
+                    std::memset(data + slot * RegionSize, frame, RegionSize);
+                    upload->Unmap();
+
+                    // A resource the frame uses, replaced right after recording
+                    std::shared_ptr<RenderResource> resource = device.CreateResource(ResourceDesc::Buffer(RegionSize));
+
+                    std::unique_ptr<RenderCommandList> commandList = queue.GetCommandList();
+                    commandList->CopyBufferRegion(*readback, slot * RegionSize, *upload, slot * RegionSize, RegionSize);
+                    commandList->CopyBufferRegion(*resource, 0, *upload, slot * RegionSize, RegionSize);
+                    std::weak_ptr<RenderResource> deferredResource = resource;
+                    framesInFlight.DeferRelease(std::move(resource));
+                    uint64_t fenceValue = queue.ExecuteCommandList(std::move(commandList));
+                    framesInFlight.EndFrame(fenceValue);
+
+                    slotFenceValues[slot] = fenceValue;
+                    deferred.push_back({ deferredResource, fenceValue });
+                    mostFramesBehind = std::max(mostFramesBehind, fenceValue - queue.GetFence().GetCompletedValue());
+                }
+
+                // The CPU runs ahead as far as the GPU lags, up to the frames in flight
+                uint64_t expectedFramesBehind = std::min(latency, frameCount);
+                if (mostFramesBehind != expectedFramesBehind)
+                {
+                    fail(PipelinedFrameCount, "the CPU did not run ahead of the GPU as far as it could");
+                }
+                bool shouldWait = latency >= frameCount;
+                if ((framesInFlight.GetWaitCount() != 0) != shouldWait)
+                {
+                    fail(PipelinedFrameCount, shouldWait ? "never waited for the GPU" : "waited for the GPU");
+                }
+            }
+
+            if (device.GetStatistics().ResourceReleases != PipelinedFrameCount)
+            {
+                fail(PipelinedFrameCount, "leaked deferred resources");
+            }
+            return passed;
+        }
+        using IdPool = FencedPool<uint32_t>;
+
+        // A pool of numbered objects over the queue's fence, 0 standing for none
+        IdPool CreateIdPool(RenderQueue& queue, uint32_t capacity, uint64_t idleFenceValues,
+            std::atomic<uint32_t>& nextId, std::atomic<uint64_t>& resets)
+        {
+            return IdPool(capacity, idleFenceValues,
+                [&queue]() { return queue.GetFence().GetCompletedValue(); },
+                [&queue](uint64_t fenceValue) { queue.WaitForFenceValue(fenceValue); },
+                [&nextId]() { return nextId.fetch_add(1) + 1; },
+                [&resets](uint32_t&) { resets.fetch_add(1); });
+        }
+
+        // FencedPool only hands command allocators out again once the GPU is done
+        // with them, growing no further than the GPU lag needs.
+        bool CheckFencedPool()
+        {
+            bool passed = true;
+            auto fail = [&passed](const char* message)
+            {
+                std::cerr << "Fenced pool: " << message << std::endl;
+                passed = false;
+            };
+
+            // Reuses an allocator whose work completed behind one still in flight
+            {
+                NullRenderDevice device;
+                NullRenderQueue& queue = static_cast<NullRenderQueue&>(device.GetQueue(CommandListType::Direct));
+                queue.SetLatency(2);
+                std::atomic<uint32_t> nextId = 0;
+                std::atomic<uint64_t> resets = 0;
+                IdPool pool = CreateIdPool(queue, 8, 1024, nextId, resets);
+
+                uint32_t first = pool.Acquire();
+                uint32_t second = pool.Acquire();
+                uint64_t firstFenceValue = queue.Signal();
+                queue.Signal();
+                uint64_t secondFenceValue = queue.Signal();
+                pool.Release(second, secondFenceValue);
+                pool.Release(first, firstFenceValue);
+                if (pool.Acquire() != first || pool.GetStatistics().Creations != 2 || resets != 1)
+                {
+                    fail("did not reuse the completed allocator behind one in flight");
+                }
+            }
+
+            // Steady frames create one allocator per frame the GPU lags behind, plus
+            // the one recorded, and reuse them from then on
+            for (uint32_t latency : { 0u, 1u, 3u })
+            {
+                const uint32_t Frames = 64;
+
+                NullRenderDevice device;
+                NullRenderQueue& queue = static_cast<NullRenderQueue&>(device.GetQueue(CommandListType::Direct));
+                queue.SetLatency(latency);
+                std::atomic<uint32_t> nextId = 0;
+                std::atomic<uint64_t> resets = 0;
+                IdPool pool = CreateIdPool(queue, 8, 1024, nextId, resets);
+
+                for (uint32_t frame = 0; frame < Frames; ++frame)
+                {
+                    uint32_t allocator = pool.Acquire();
+                    pool.Release(allocator, queue.Signal());
+                }
+
+                FencedPoolStatistics statistics = pool.GetStatistics();
+                if (statistics.Creations != latency + 1 || statistics.Reuses != Frames - latency - 1 || statistics.Waits != 0)
+                {
+                    fail("created more allocators than the GPU lag needs");
+                }
+            }
+
+            // Waits for the oldest allocator once every slot holds one in flight
+            {
+                NullRenderDevice device;
+                NullRenderQueue& queue = static_cast<NullRenderQueue&>(device.GetQueue(CommandListType::Direct));
+                queue.SetLatency(100);
+                std::atomic<uint32_t> nextId = 0;
+                std::atomic<uint64_t> resets = 0;
+                IdPool pool = CreateIdPool(queue, 4, 1024, nextId, resets);
+
+                std::vector<uint32_t> allocators;
+                for (int i = 0; i < 5; ++i)
+                {
+                    allocators.push_back(pool.Acquire());
+                }
+                for (uint32_t allocator : allocators)
+                {
+                    pool.Release(allocator, queue.Signal());
+                }
+
+                FencedPoolStatistics statistics = pool.GetStatistics();
+                if (statistics.Waits != 1 || statistics.Size != 4 || statistics.PeakSize != 4 || queue.GetFence().GetCompletedValue() != 1)
+                {
+                    fail("grew past its capacity instead of waiting for the oldest allocator");
+                }
+            }
+
+            // Releases allocators a burst of work needed once they stay unused
+            {
+                NullRenderDevice device;
+                RenderQueue& queue = device.GetQueue(CommandListType::Direct);
+                std::atomic<uint32_t> nextId = 0;
+                std::atomic<uint64_t> resets = 0;
+                IdPool pool = CreateIdPool(queue, 8, 4, nextId, resets);
+
+                std::vector<uint32_t> allocators;
+                for (int i = 0; i < 3; ++i)
+                {
+                    allocators.push_back(pool.Acquire());
+                }
+                for (uint32_t allocator : allocators)
+                {
+                    pool.Release(allocator, queue.Signal());
+                }
+                for (int frame = 0; frame < 10; ++frame)
+                {
+                    uint32_t allocator = pool.Acquire();
+                    pool.Release(allocator, queue.Signal());
+                }
+
+                FencedPoolStatistics statistics = pool.GetStatistics();
+                if (statistics.Trims != 2 || statistics.Size != 1 || statistics.PeakSize != 3)
+                {
+                    fail("kept allocators left unused");
+                }
+            }
+
+            // Threads recording and submitting at once never share an allocator, nor
+            // get one whose work is still in flight
+            {
+                const uint32_t Threads = 4;
+                const uint32_t Iterations = 4000;
+
+                NullRenderDevice device;
+                NullRenderQueue& queue = static_cast<NullRenderQueue&>(device.GetQueue(CommandListType::Direct));
+                queue.SetLatency(3);
+                std::atomic<uint32_t> nextId = 0;
+                std::atomic<uint64_t> resets = 0;
+                IdPool pool = CreateIdPool(queue, 16, 64, nextId, resets);
+
+                // Indexed by allocator, at most one new per acquire
+                std::vector<std::atomic<bool>> inUse(Threads * Iterations + 1);
+                std::vector<std::atomic<uint64_t>> fenceValues(Threads * Iterations + 1);
+                std::atomic<uint64_t> sharedCount = 0;
+                std::atomic<uint64_t> inFlightCount = 0;
+
+                std::vector<std::thread> threads;
+                for (uint32_t thread = 0; thread < Threads; ++thread)
+                {
+                    threads.emplace_back([&]()
+                    {
+                        for (uint32_t i = 0; i < Iterations; ++i)
+                        {
+                            uint32_t allocator = pool.Acquire();
+                            if (inUse[allocator].exchange(true))
+                            {
+                                ++sharedCount;
+                            }
+                            if (!queue.IsFenceComplete(fenceValues[allocator]))
+                            {
+                                ++inFlightCount;
+                            }
+
+                            uint64_t fenceValue = queue.Signal();
+                            fenceValues[allocator] = fenceValue;
+                            inUse[allocator] = false;
+                            pool.Release(allocator, fenceValue);
+                        }
+                    });
+                }
+                for (std::thread& thread : threads)
+                {
+                    thread.join();
+                }
+
+                FencedPoolStatistics statistics = pool.GetStatistics();
+                if (sharedCount != 0)
+                {
+                    fail("handed the same allocator to two threads");
+                }
+                if (inFlightCount != 0)
+                {
+                    fail("handed out an allocator still in flight");
+                }
+                if (statistics.Creations + statistics.Reuses != Threads * Iterations || statistics.Reuses != resets ||
+                    statistics.Creations != nextId || statistics.PeakSize > pool.GetCapacity())
+                {
+                    fail("miscounted allocators across threads");
+                }
+            }
+
+            return passed;
+        }
+
+        // RingAllocator never overlaps staging the GPU may still copy from, and
+        // gets all its space back once the queue is idle.
+        bool CheckRingAllocator()
+        {
+            const uint64_t Capacity = 4096;
+            const int Uploads = 2000;
+            const int UploadsPerBatch = 4;
+
+            bool passed = true;
+            auto fail = [&passed](int upload, const char* message)
+            {
+                std::cerr << "Ring allocator, upload " << upload << ": " << message << std::endl;
+                passed = false;
+            };
+
+            NullRenderDevice device;
+            NullRenderQueue& queue = static_cast<NullRenderQueue&>(device.GetQueue(CommandListType::Copy));
+            queue.SetLatency(2);
+            RingAllocator ring(Capacity);
+
+            struct Range
+            {
+                uint64_t Offset;
+                uint64_t Size;
+                // 0 until its batch is submitted
+                uint64_t FenceValue;
+            };
+            std::vector<Range> liveRanges;
+            uint64_t lastFenceValue = 0;
+            auto submit = [&]()
+            {
+                lastFenceValue = queue.Signal();
+                ring.Retire(lastFenceValue);
+                for (Range& range : liveRanges)
+                {
+                    range.FenceValue = range.FenceValue == 0 ? lastFenceValue : range.FenceValue;
+                }
+            };
+            auto reclaim = [&]()
+            {
+                uint64_t completedValue = queue.GetFence().GetCompletedValue();
+                ring.Reclaim(completedValue);
+                std::erase_if(liveRanges, [completedValue](const Range& range)
+                {
+                    return range.FenceValue != 0 && range.FenceValue <= completedValue;
+                });
+            };
+
+            for (int upload = 0; upload < Uploads; ++upload)
+            {
+                uint64_t size = (upload * 37) % 700 + 1;
+                uint64_t alignment = uint64_t(1) << (upload % 5 * 2);
+
+                reclaim();
+                uint64_t offset = ring.Allocate(size, alignment);
+                while (offset == RingAllocator::InvalidOffset)
+                {
+                    // As UploadRingBuffer does, wait for the oldest batch, or submit
+                    // the open one when nothing else holds the space
+                    if (ring.HasRetiredRanges())
+                    {
+                        queue.WaitForFenceValue(ring.GetOldestFenceValue());
+                        reclaim();
+                    }
+                    else
+                    {
+                        submit();
+                    }
+                    offset = ring.Allocate(size, alignment);
+                }
+
+                if (offset % alignment != 0 || offset + size > Capacity)
+                {
+                    fail(upload, "handed out a misaligned range or one out of the block");
+                }
+                for (const Range& range : liveRanges)
+                {
+                    if (offset < range.Offset + range.Size && range.Offset < offset + size)
+                    {
+                        fail(upload, "overlapped a range still in use");
+                        break;
+                    }
+                }
+                if (ring.GetUsedSize() > Capacity)
+                {
+                    fail(upload, "used more than its capacity");
+                }
+
+                liveRanges.push_back({ offset, size, 0 });
+                if (upload % UploadsPerBatch == UploadsPerBatch - 1)
+                {
+                    submit();
+                }
+            }
+
+            submit();
+            queue.WaitForFenceValue(lastFenceValue);
+            reclaim();
+            if (ring.GetUsedSize() != 0 || ring.HasRetiredRanges() || ring.HasOpenRanges())
+            {
+                fail(Uploads, "kept space after the queue went idle");
+            }
+            return passed;
+        }
+
+        // LinearUploadBuffer keeps the constants of frames in flight intact,
+        // aligned inside their frame's region, and refuses what does not fit.
+        bool CheckLinearUploadBuffer()
+        {
+            const uint64_t FrameSize = 1000;
+            const uint32_t FrameCount = 3;
+            const int Frames = 100;
+
+            bool passed = true;
+            auto fail = [&passed](int frame, const char* message)
+            {
+                std::cerr << "Linear upload buffer, frame " << frame << ": " << message << std::endl;
+                passed = false;
+            };
+
+            // Aligned relative to the whole memory, not to the start of the block
+            LinearAllocator allocator(100, 1000);
+            if (allocator.Allocate(1, 64) != 128 || allocator.Allocate(8, 8) != 136 || allocator.Allocate(957, 1) != LinearAllocator::InvalidOffset)
+            {
+                fail(0, "linear allocator misplaced a range or handed out one past its capacity");
+            }
+            allocator.Reset();
+            if (allocator.GetUsedSize() != 0 || allocator.Allocate(1000, 4) != 100)
+            {
+                fail(0, "linear allocator did not hand its whole capacity back on reset");
+            }
+
+            NullRenderDevice device;
+            NullRenderQueue& queue = static_cast<NullRenderQueue&>(device.GetQueue(CommandListType::Direct));
+            queue.SetLatency(2);
+            LinearUploadBuffer buffer(device, FrameSize, FrameCount);
+            uint64_t frameSize = buffer.GetFrameSize();
+            if (frameSize % LinearUploadBuffer::ConstantBufferAlignment != 0 || frameSize < FrameSize)
+            {
+                fail(0, "frame regions are not rounded up to the constant buffer alignment");
+            }
+
+            uint8_t* cpuBase = static_cast<uint8_t*>(buffer.GetResource().Map());
+            uint64_t gpuBase = buffer.GetResource().GetGpuAddress();
+
+            struct Written
+            {
+                uint64_t Offset;
+                uint64_t Size;
+                uint8_t Value;
+                // 0 until its frame is submitted
+                uint64_t FenceValue;
+            };
+            std::vector<Written> written;
+
+            {
+                FramesInFlight framesInFlight(queue, FrameCount);
+                for (int frame = 0; frame < Frames; ++frame)
+                {
+                    uint32_t frameIndex = framesInFlight.BeginFrame();
+                    buffer.BeginFrame(frameIndex);
+                    if (buffer.GetUsedSize() != 0)
+                    {
+                        fail(frame, "the region was not reset");
+                    }
+
+                    // What the GPU may still read must be intact
+                    std::erase_if(written, [&](const Written& range)
+                    {
+                        return range.FenceValue != 0 && queue.IsFenceComplete(range.FenceValue);
+                    });
+                    for (const Written& range : written)
+                    {
+                        if (std::any_of(cpuBase + range.Offset, cpuBase + range.Offset + range.Size,
+                            [&range](uint8_t value) { return value != range.Value; }))
+                        {
+                            fail(frame, "overwrote the constants of a frame in flight");
+                            break;
+                        }
+                    }
+
+                    uint64_t regionBegin = frameIndex * frameSize;
+                    uint8_t value = static_cast<uint8_t>(frame + 1);
+                    for (int i = 0;; ++i)
+                    {
+                        uint64_t size = (frame * 13 + i * 29) % 150 + 1;
+                        uint64_t alignment = i % 3 == 0 ? LinearUploadBuffer::ConstantBufferAlignment : uint64_t(1) << (i % 5);
+                        uint64_t usedBefore = buffer.GetUsedSize();
+                        LinearUploadBuffer::Allocation allocation;
+                        try
+                        {
+                            allocation = buffer.Allocate(size, alignment);
+                        }
+                        catch (const std::runtime_error&)
+                        {
+                            // Full, which it must only be when the range did not fit
+                            uint64_t alignedUsed = (regionBegin + usedBefore + alignment - 1) / alignment * alignment - regionBegin;
+                            if (alignedUsed + size <= frameSize)
+                            {
+                                fail(frame, "refused an allocation that fit in the region");
+                            }
+                            break;
+                        }
+
+                        uint64_t offset = allocation.GpuAddress - gpuBase;
+                        if (static_cast<uint8_t*>(allocation.CpuAddress) != cpuBase + offset)
+                        {
+                            fail(frame, "CPU and GPU addresses of an allocation disagree");
+                        }
+                        if (allocation.GpuAddress % alignment != 0)
+                        {
+                            fail(frame, "handed out a misaligned allocation");
+                        }
+                        if (offset < regionBegin || offset + size > regionBegin + frameSize)
+                        {
+                            fail(frame, "handed out an allocation outside the frame's region");
+                        }
+
+                        std::memset(allocation.CpuAddress, value, size);
+                        written.push_back({ offset, size, value, 0 });
+                    }
+
+                    uint64_t fenceValue = queue.Signal();
+                    for (Written& range : written)
+                    {
+                        range.FenceValue = range.FenceValue == 0 ? fenceValue : range.FenceValue;
+                    }
+                    framesInFlight.EndFrame(fenceValue);
+                }
+            }
+
+            try
+            {
+                buffer.Allocate(16, 3);
+                fail(Frames, "accepted an alignment that is not a power of two");
+            }
+            catch (const std::invalid_argument&)
+            {
+            }
+            return passed;
+        }
+
+        // RenderGraph orders and culls a denoise-like chain of passes, aliases and
+        // discards its transient resources, and carries the image through intact.
+        bool CheckRenderGraph()
+        {
+            const uint32_t ImageWidth = 64;
+            const uint32_t ImageHeight = 16;
+            const int Frames = 6;
+
+            bool passed = true;
+            auto fail = [&passed](const char* message)
+            {
+                std::cerr << "Render graph: " << message << std::endl;
+                passed = false;
+            };
+            auto expectLogicError = [&fail](const char* message, const std::function<void()>& action)
+            {
+                try
+                {
+                    action();
+                    fail(message);
+                }
+                catch (const std::logic_error&)
+                {
+                }
+            };
+
+            NullRenderDevice device;
+            RenderQueue& queue = device.GetQueue(CommandListType::Direct);
+            ResourceStateRegistry registry;
+            std::vector<std::shared_ptr<void>> released;
+            auto deferRelease = [&released](std::shared_ptr<void> object) { released.push_back(std::move(object)); };
+
+            ResourceDesc imageDesc = ResourceDesc::Texture2D(ImageWidth, ImageHeight, ResourceFormat::R8G8B8A8Unorm, ResourceState::CopySource);
+            uint64_t footprintSize = device.GetCopyableFootprint(imageDesc);
+            auto output = device.CreateResource(imageDesc);
+            auto upload = device.CreateResource(ResourceDesc::Buffer(footprintSize, HeapType::Upload, ResourceState::GenericRead));
+            auto readback = device.CreateResource(ResourceDesc::Buffer(footprintSize, HeapType::Readback, ResourceState::CopyDest));
+
+            RenderGraph graph(device, registry, deferRelease);
+            // The frame as Game would declare it, with a debug view nothing reads
+            // unless it is shown
+            auto declareFrame = [&](bool showDebugView)
+            {
+                // Written as render targets in Game, which need discarding once aliased
+                ResourceDesc desc = imageDesc;
+                desc.Flags = ResourceFlags::AllowRenderTarget;
+                RenderGraphResource radiance = graph.CreateResource("Radiance", desc);
+                RenderGraphResource albedo = graph.CreateResource("Albedo", desc);
+                RenderGraphResource normal = graph.CreateResource("Normal", desc);
+                RenderGraphResource filtered = graph.CreateResource("Filtered", desc);
+                RenderGraphResource denoised = graph.CreateResource("Denoised", desc);
+                RenderGraphResource debugView = graph.CreateResource("DebugView", desc);
+                RenderGraphResource outputImage = graph.Import("Output", *output);
+                RenderGraphResource readbackBuffer = graph.Import("Readback", *readback);
+
+                graph.AddPass("Trace", [&](RenderGraphBuilder& builder)
+                {
+                    radiance = builder.Write(radiance, ResourceState::CopyDest);
+                    albedo = builder.Write(albedo, ResourceState::CopyDest);
+                    normal = builder.Write(normal, ResourceState::CopyDest);
+                }, [=](RenderGraphContext& context)
+                {
+                    for (RenderGraphResource image : { radiance, albedo, normal })
+                    {
+                        context.GetCommandList().CopyBufferToTexture(context.GetResource(image), *upload, 0);
+                    }
+                });
+                graph.AddPass("Debug", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(normal, ResourceState::CopySource);
+                    debugView = builder.Write(debugView, ResourceState::CopyDest);
+                    if (showDebugView)
+                    {
+                        builder.HasSideEffects();
+                    }
+                }, [=](RenderGraphContext& context)
+                {
+                    context.GetCommandList().CopyResource(context.GetResource(debugView), context.GetResource(normal));
+                });
+                graph.AddPass("Filter", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(radiance, ResourceState::CopySource);
+                    builder.Read(albedo, ResourceState::CopySource);
+                    builder.Read(normal, ResourceState::CopySource);
+                    filtered = builder.Write(filtered, ResourceState::CopyDest);
+                }, [=](RenderGraphContext& context)
+                {
+                    context.GetCommandList().CopyResource(context.GetResource(filtered), context.GetResource(radiance));
+                });
+                graph.AddPass("Refine", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(filtered, ResourceState::CopySource);
+                    builder.Read(albedo, ResourceState::CopySource);
+                    builder.Read(normal, ResourceState::CopySource);
+                    denoised = builder.Write(denoised, ResourceState::CopyDest);
+                }, [=](RenderGraphContext& context)
+                {
+                    context.GetCommandList().CopyResource(context.GetResource(denoised), context.GetResource(filtered));
+                });
+                graph.AddPass("Tonemap", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(denoised, ResourceState::CopySource);
+                    outputImage = builder.Write(outputImage, ResourceState::CopyDest);
+                }, [=](RenderGraphContext& context)
+                {
+                    context.GetCommandList().CopyResource(context.GetResource(outputImage), context.GetResource(denoised));
+                });
+                graph.AddPass("Capture", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(outputImage, ResourceState::CopySource);
+                    readbackBuffer = builder.Write(readbackBuffer, ResourceState::CopyDest);
+                }, [=](RenderGraphContext& context)
+                {
+                    context.GetCommandList().CopyTextureToBuffer(context.GetResource(readbackBuffer), 0, context.GetResource(outputImage));
+                });
+                graph.Compile();
+                return std::vector<RenderGraphResource>{ radiance, albedo, normal, filtered, denoised, debugView };
+            };
+
+            for (int frame = 0; frame < Frames; ++frame)
+            {
+                uint8_t* uploadData = static_cast<uint8_t*>(upload->Map());
+                for (uint64_t i = 0; i < footprintSize; ++i)
+                {
+                    uploadData[i] = static_cast<uint8_t>(i * 13 + frame);
+                }
+                upload->Unmap();
+
+                // The last frame shows the debug view, which needs the resources placed again
+                device.ResetStatistics();
+                graph.Reset();
+                std::vector<RenderGraphResource> transients = declareFrame(frame == Frames - 1);
+
+                if (frame == 0)
+                {
+                    std::vector<std::string> order = graph.GetPassOrder();
+                    if (order != std::vector<std::string>{ "Trace", "Filter", "Refine", "Tonemap", "Capture" } ||
+                        graph.GetStatistics().CulledPasses != 1)
+                    {
+                        fail("did not order the passes or cull the one nothing reads");
+                    }
+                    expectLogicError("placed a resource only a culled pass uses", [&]() { graph.GetResource(transients.back()); });
+
+                    // Resources in use at the same time never share memory
+                    transients.pop_back();
+                    for (RenderGraphResource a : transients)
+                    {
+                        for (RenderGraphResource b : transients)
+                        {
+                            uint64_t aOffset = graph.GetHeapOffset(a);
+                            uint64_t bOffset = graph.GetHeapOffset(b);
+                            uint64_t size = device.GetAllocationSize(imageDesc);
+                            bool memoryOverlaps = aOffset < bOffset + size && bOffset < aOffset + size;
+                            // Radiance is done with once Filter has run, before Denoised is written
+                            bool lifetimesOverlap = !((a.Index == 0 && b.Index == 4) || (a.Index == 4 && b.Index == 0));
+                            if (a.Index != b.Index && memoryOverlaps && lifetimesOverlap)
+                            {
+                                fail("gave resources in use at the same time the same memory");
+                            }
+                        }
+                    }
+                    RenderGraphStatistics statistics = graph.GetStatistics();
+                    if (statistics.TransientResources != 5 || statistics.HeapBytes >= statistics.TransientBytes)
+                    {
+                        fail("did not alias the transient resources");
+                    }
+                }
+
+                ResourceStateTracker tracker(registry);
+                std::unique_ptr<RenderCommandList> commandList = queue.GetCommandList();
+                graph.Execute(*commandList, tracker);
+                queue.WaitForFenceValue(tracker.ExecuteCommandList(queue, std::move(commandList)));
+
+                const uint8_t* readbackData = static_cast<const uint8_t*>(readback->Map());
+                bool intact = std::memcmp(readbackData, uploadData, footprintSize) == 0;
+                readback->Unmap();
+                if (!intact)
+                {
+                    fail("lost the image on its way through the aliased resources");
+                }
+
+                NullBackendStatistics statistics = device.GetStatistics();
+                if (statistics.AliasingBarriers == 0)
+                {
+                    fail("recorded no aliasing barriers");
+                }
+                if (statistics.Discards == 0 || statistics.Discards != graph.GetStatistics().DiscardedResources)
+                {
+                    fail("did not discard each aliased render target at its first use");
+                }
+                if (frame > 0 && frame < Frames - 1 && (statistics.ResourceAllocations != 0 || statistics.HeapAllocations != 0))
+                {
+                    fail("placed the resources again for the same frame");
+                }
+            }
+            if (graph.GetStatistics().HeapCreations != 2 || released.empty())
+            {
+                fail("did not replace the heap for the debug view, deferring the release of the old one");
+            }
+
+            // Passes declared out of order run after what they read and before
+            // what overwrites it, and mistakes are caught
+            {
+                auto buffer = device.CreateResource(ResourceDesc::Buffer(256));
+                RenderGraph outOfOrder(device, registry, deferRelease);
+                auto noop = [](RenderGraphContext&) {};
+                RenderGraphResource imported = outOfOrder.Import("Imported", *buffer);
+                RenderGraphResource first = outOfOrder.CreateResource("Value", ResourceDesc::Buffer(256));
+                RenderGraphResource second;
+                outOfOrder.AddPass("WriteFirst", [&](RenderGraphBuilder& builder) { first = builder.Write(first, ResourceState::CopyDest); }, noop);
+                outOfOrder.AddPass("WriteSecond", [&](RenderGraphBuilder& builder) { second = builder.Write(first, ResourceState::CopyDest); }, noop);
+                outOfOrder.AddPass("ReadFirst", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(first, ResourceState::CopySource);
+                    builder.HasSideEffects();
+                }, noop);
+                outOfOrder.AddPass("ReadSecond", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(second, ResourceState::CopySource);
+                    imported = builder.Write(imported, ResourceState::CopyDest);
+                }, noop);
+                outOfOrder.Compile();
+                if (outOfOrder.GetPassOrder() != std::vector<std::string>{ "WriteFirst", "ReadFirst", "WriteSecond", "ReadSecond" })
+                {
+                    fail("ran a pass after the one overwriting what it reads");
+                }
+
+                expectLogicError("let a version already overwritten be written", [&]()
+                {
+                    outOfOrder.AddPass("Stale", [&](RenderGraphBuilder& builder) { builder.Write(first, ResourceState::CopyDest); }, noop);
+                });
+                expectLogicError("let a transient be read before anything writes it", [&]()
+                {
+                    RenderGraphResource unwritten = outOfOrder.CreateResource("Unwritten", ResourceDesc::Buffer(256));
+                    outOfOrder.AddPass("ReadUnwritten", [&](RenderGraphBuilder& builder) { builder.Read(unwritten, ResourceState::CopySource); }, noop);
+                });
+                expectLogicError("let a pass use a resource in two states", [&]()
+                {
+                    outOfOrder.AddPass("TwoStates", [&](RenderGraphBuilder& builder)
+                    {
+                        builder.Read(second, ResourceState::CopySource);
+                        builder.Read(second, ResourceState::UnorderedAccess);
+                    }, noop);
+                });
+
+                // Reading the first version after the pass writing the second, and
+                // what that pass writes, leaves no order to run them in
+                outOfOrder.Reset();
+                RenderGraphResource value = outOfOrder.CreateResource("Value", ResourceDesc::Buffer(256));
+                RenderGraphResource other = outOfOrder.CreateResource("Other", ResourceDesc::Buffer(256));
+                imported = outOfOrder.Import("Imported", *buffer);
+                outOfOrder.AddPass("A", [&](RenderGraphBuilder& builder) { value = builder.Write(value, ResourceState::CopyDest); }, noop);
+                RenderGraphResource firstValue = value;
+                outOfOrder.AddPass("B", [&](RenderGraphBuilder& builder)
+                {
+                    value = builder.Write(value, ResourceState::CopyDest);
+                    other = builder.Write(other, ResourceState::CopyDest);
+                }, noop);
+                outOfOrder.AddPass("C", [&](RenderGraphBuilder& builder)
+                {
+                    builder.Read(firstValue, ResourceState::CopySource);
+                    builder.Read(other, ResourceState::CopySource);
+                    imported = builder.Write(imported, ResourceState::CopyDest);
+                }, noop);
+                expectLogicError("compiled passes depending on each other in a cycle", [&]() { outOfOrder.Compile(); });
+            }
+
+            // A compiled graph executed again uses the resource reimported in place
+            // of the one it was declared with, as Game does with its back buffers
+            {
+                auto source = device.CreateResource(ResourceDesc::Buffer(256, HeapType::Upload, ResourceState::GenericRead));
+                std::shared_ptr<RenderResource> targets[] = {
+                    device.CreateResource(ResourceDesc::Buffer(256, HeapType::Readback, ResourceState::CopyDest)),
+                    device.CreateResource(ResourceDesc::Buffer(256, HeapType::Readback, ResourceState::CopyDest))
+                };
+                RenderGraph reused(device, registry, deferRelease);
+                RenderGraphResource target = reused.Import("Target", *targets[0]);
+                RenderGraphResource transient = reused.CreateResource("Transient", ResourceDesc::Buffer(256));
+                reused.AddPass("Copy", [&](RenderGraphBuilder& builder) { target = builder.Write(target, ResourceState::CopyDest); },
+                    [&](RenderGraphContext& context) { context.GetCommandList().CopyBufferRegion(context.GetResource(target), 0, *source, 0, 256); });
+                reused.Compile();
+
+                for (uint8_t value : { 1, 2 })
+                {
+                    std::memset(source->Map(), value, 256);
+                    source->Unmap();
+                    reused.Reimport(target, *targets[value - 1]);
+
+                    ResourceStateTracker tracker(registry);
+                    std::unique_ptr<RenderCommandList> commandList = queue.GetCommandList();
+                    reused.Execute(*commandList, tracker);
+                    queue.WaitForFenceValue(tracker.ExecuteCommandList(queue, std::move(commandList)));
+                }
+
+                for (uint8_t value : { 1, 2 })
+                {
+                    const uint8_t* targetData = static_cast<const uint8_t*>(targets[value - 1]->Map());
+                    bool written = std::all_of(targetData, targetData + 256, [value](uint8_t byte) { return byte == value; });
+                    targets[value - 1]->Unmap();
+                    if (!written)
+                    {
+                        fail("did not execute again on the reimported resource");
+                    }
+                }
+                expectLogicError("let a transient resource be reimported", [&]() { reused.Reimport(transient, *targets[0]); });
+            }
+
+            return passed;
+        }
+
+        // DescriptorAllocator never hands out a view a frame in flight may still
+        // read, and merges everything freed back once the queue is idle.
+        bool CheckDescriptorAllocator()
+        {
+            const uint32_t PersistentCount = 64;
+            const uint32_t TransientCount = 16;
+            const uint32_t FrameCount = 3;
+            const int Frames = 200;
+
+            bool passed = true;
+            auto fail = [&passed](int frame, const char* message)
+            {
+                std::cerr << "Descriptor allocator, frame " << frame << ": " << message << std::endl;
+                passed = false;
+            };
+
+            NullRenderDevice device;
+            NullRenderQueue& queue = static_cast<NullRenderQueue&>(device.GetQueue(CommandListType::Direct));
+            queue.SetLatency(2);
+            DescriptorAllocator allocator(PersistentCount, TransientCount, FrameCount);
+            auto heap = device.CreateDescriptorHeap(DescriptorHeapType::CbvSrvUav, allocator.GetCount(), true);
+            auto resource = device.CreateResource(ResourceDesc::Buffer(256));
+
+            struct Range
+            {
+                uint32_t Index;
+                uint32_t Count;
+            };
+            std::vector<Range> live;
+            // Fence value of the last frame that could read each descriptor
+            std::vector<uint64_t> lastUses(allocator.GetCount(), 0);
+            uint64_t fenceValue = 0;
+            auto checkRange = [&](int frame, uint32_t index, uint32_t count, uint32_t begin, uint32_t end)
+            {
+                if (index < begin || index + count > end)
+                {
+                    fail(frame, "handed out a range outside its part of the heap");
+                    return;
+                }
+                for (uint32_t i = index; i < index + count; ++i)
+                {
+                    if (!queue.IsFenceComplete(lastUses[i]))
+                    {
+                        fail(frame, "handed out a descriptor a frame in flight may read");
+                        return;
+                    }
+                }
+            };
+
+            {
+                FramesInFlight framesInFlight(queue, FrameCount);
+                for (int frame = 0; frame < Frames; ++frame)
+                {
+                    uint32_t frameIndex = framesInFlight.BeginFrame();
+                    allocator.BeginFrame(frameIndex);
+                    allocator.Reclaim(queue.GetFence().GetCompletedValue());
+
+                    // Views of the last frames go out of use, others come in
+                    for (int i = 0; i < frame % 3 && !live.empty(); ++i)
+                    {
+                        size_t freed = (frame * 7 + i) % live.size();
+                        allocator.Free(live[freed].Index, fenceValue);
+                        live.erase(live.begin() + freed);
+                    }
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        uint32_t count = (frame + i) % 4 + 1;
+                        uint32_t index;
+                        try
+                        {
+                            index = allocator.Allocate(count);
+                        }
+                        catch (const std::runtime_error&)
+                        {
+                            // Full until more is reclaimed
+                            continue;
+                        }
+                        checkRange(frame, index, count, 0, PersistentCount);
+                        for (const Range& range : live)
+                        {
+                            if (index < range.Index + range.Count && range.Index < index + count)
+                            {
+                                fail(frame, "overlapped a live range");
+                            }
+                        }
+                        live.push_back({ index, count });
+                    }
+
+                    // Views only this frame reads, written through the heap at their index
+                    uint32_t regionStart = PersistentCount + frameIndex * TransientCount;
+                    std::vector<uint32_t> transients;
+                    for (uint32_t used = 0, count = frame % 5 + 1; used + count <= TransientCount; used += count)
+                    {
+                        uint32_t index = allocator.AllocateTransient(count);
+                        checkRange(frame, index, count, regionStart, regionStart + TransientCount);
+                        for (uint32_t i = index; i < index + count; ++i)
+                        {
+                            transients.push_back(i);
+                        }
+                    }
+                    device.CreateShaderResourceView(*resource, heap->GetHandle(transients.back()));
+                    if (device.GetDescribedResource(heap->GetHandle(transients.back())) != resource.get())
+                    {
+                        fail(frame, "index did not address the view written for it");
+                    }
+                    try
+                    {
+                        allocator.AllocateTransient(TransientCount);
+                        fail(frame, "handed out more than the frame region holds");
+                    }
+                    catch (const std::runtime_error&)
+                    {
+                    }
+
+                    fenceValue = queue.ExecuteCommandList(queue.GetCommandList());
+                    framesInFlight.EndFrame(fenceValue);
+                    for (uint32_t index : transients)
+                    {
+                        lastUses[index] = fenceValue;
+                    }
+                    for (const Range& range : live)
+                    {
+                        std::fill(lastUses.begin() + range.Index, lastUses.begin() + range.Index + range.Count, fenceValue);
+                    }
+                }
+
+                for (const Range& range : live)
+                {
+                    allocator.Free(range.Index, fenceValue);
+                }
+                try
+                {
+                    allocator.Free(0, fenceValue - 1);
+                    fail(Frames, "took a fence value lower than the last");
+                }
+                catch (const std::invalid_argument&)
+                {
+                }
+                framesInFlight.WaitForIdle();
+            }
+
+            allocator.Reclaim(fenceValue);
+            DescriptorAllocatorStatistics statistics = allocator.GetStatistics();
+            if (statistics.PersistentUsed != 0 || statistics.PendingFrees != 0 || statistics.LargestFreeRange != PersistentCount)
+            {
+                fail(Frames, "did not merge every range freed back once the queue went idle");
+            }
+            if (statistics.PeakTransientUsed > TransientCount)
+            {
+                fail(Frames, "used more than a frame region");
+            }
+            return passed;
+        }
+    }
+
+    bool RunRenderBackendCheck(const std::string& filename)
+    {
+        std::ofstream output(filename);
+        if (!output)
+        {
+            throw std::runtime_error("Could not open " + filename);
+        }
+
+        bool passed = true;
+        NullRenderDevice device;
+        RenderQueue& queue = device.GetQueue(CommandListType::Direct);
+        FrameResources resources = CreateFrameResources(device);
+
+        // The frame Game renders, with its barriers recorded by hand, then through
+        // the render graph and a tracker
+        ResourceStateRegistry registry;
+        NullBackendStatistics manualStatistics;
+        output << "recording,frame,command_lists,command_list_allocations,barriers,barrier_batches,copies,copied_bytes,resource_allocations,allocated_bytes\n";
+        RenderGraph graph(device, registry, [](std::shared_ptr<void>) {});
+        FramePasses passes;
+        for (bool tracked : { false, true })
+        {
+            ResourceStateTracker tracker(registry);
+            for (int frame = 0; frame < FrameCount; ++frame)
+            {
+                // What the denoiser would write back, different every frame
+                uint8_t* upload = static_cast<uint8_t*>(resources.Upload->Map());
+                for (uint64_t i = 0; i < resources.ImageFootprintSize; ++i)
+                {
+                    upload[i] = static_cast<uint8_t>(i * 7 + frame);
+                }
+                resources.Upload->Unmap();
+
+                if (tracked)
+                {
+                    RecordTrackedFrame(queue, graph, tracker, passes, resources, frame == 0);
+                }
+                else
+                {
+                    RecordFrame(queue, resources);
+                }
+
+                // The next frame reads back the result this one copied in
+                if (frame > 0)
+                {
+                    const uint8_t* readback = static_cast<const uint8_t*>(resources.Readback->Map());
+                    for (uint64_t i = 0; i < resources.ImageFootprintSize; ++i)
+                    {
+                        if (readback[i] != static_cast<uint8_t>(i * 7 + frame - 1))
+                        {
+                            std::cerr << "Frame " << frame << " read back the wrong radiance" << std::endl;
+                            passed = false;
+                            break;
+                        }
+                    }
+                    resources.Readback->Unmap();
+                }
+
+                NullBackendStatistics statistics = device.GetStatistics();
+                output << (tracked ? "tracked" : "manual") << ","
+                    << frame << ","
+                    << statistics.ExecutedCommandLists << ","
+                    << statistics.CommandListAllocations << ","
+                    << statistics.Barriers << ","
+                    << statistics.BarrierBatches << ","
+                    << statistics.Copies << ","
+                    << statistics.CopiedBytes << ","
+                    << statistics.ResourceAllocations << ","
+                    << statistics.AllocatedBytes << "\n";
+
+                if (frame > 0 && (statistics.ResourceAllocations != 0 || statistics.CommandListAllocations != 0))
+                {
+                    std::cerr << "Frame " << frame << " allocated resources or command lists" << std::endl;
+                    passed = false;
+                }
+
+                // Steady frames, the first of each recording setting up the states
+                if (frame == FrameCount - 1)
+                {
+                    if (!tracked)
+                    {
+                        manualStatistics = statistics;
+                    }
+                    else
+                    {
+                        // Either may come out ahead, only written down. The tracked
+                        // barriers count both halves of the split ones.
+                        auto delta = [](uint64_t trackedValue, uint64_t manualValue)
+                        {
+                            return static_cast<int64_t>(trackedValue) - static_cast<int64_t>(manualValue);
+                        };
+                        output << "tracked_minus_manual" << ","
+                            << frame << ","
+                            << delta(statistics.ExecutedCommandLists, manualStatistics.ExecutedCommandLists) << ","
+                            << delta(statistics.CommandListAllocations, manualStatistics.CommandListAllocations) << ","
+                            << delta(statistics.Barriers, manualStatistics.Barriers) << ","
+                            << delta(statistics.BarrierBatches, manualStatistics.BarrierBatches) << ","
+                            << delta(statistics.Copies, manualStatistics.Copies) << ","
+                            << delta(statistics.CopiedBytes, manualStatistics.CopiedBytes) << ","
+                            << delta(statistics.ResourceAllocations, manualStatistics.ResourceAllocations) << ","
+                            << delta(statistics.AllocatedBytes, manualStatistics.AllocatedBytes) << "\n";
+
+                        if (statistics.SplitBarriers == 0)
+                        {
+                            std::cerr << "Tracked frames did not begin the radiance's transition to the next trace early" << std::endl;
+                            passed = false;
+                        }
+                    }
+                }
+                device.ResetStatistics();
+            }
+        }
+
+        // Tracked frames leave the radiance ready for the next trace, the features
+        // as the readback needed them and the back buffer ready to present
+        auto getState = [](const std::shared_ptr<RenderResource>& resource)
+        {
+            return static_cast<const NullRenderResource&>(*resource).GetState();
+        };
+        if (getState(resources.Radiance) != ResourceState::UnorderedAccess || getState(resources.Albedo) != ResourceState::CopySource ||
+            getState(resources.Normal) != ResourceState::CopySource || getState(resources.BackBuffer) != ResourceState::Present)
+        {
+            std::cerr << "Tracked frames left the images in the wrong states" << std::endl;
+            passed = false;
+        }
+
+        // A frame recorded against the wrong starting state must not go through
+        std::unique_ptr<RenderCommandList> commandList = queue.GetCommandList();
+        commandList->Barrier(ResourceBarrier::Transition(*resources.Radiance, ResourceState::PixelShaderResource, ResourceState::CopySource));
+        try
+        {
+            queue.ExecuteCommandList(std::move(commandList));
+            std::cerr << "A barrier from the wrong state went through" << std::endl;
+            passed = false;
+        }
+        catch (const std::logic_error&)
+        {
+        }
+
+        // In lockstep, with the GPU keeping up, lagging as far as the CPU may run
+        // ahead, and lagging further
+        for (uint32_t latency : { 0u, 1u, 2u, 3u, 5u })
+        {
+            passed = CheckFramesInFlight(3, latency) && passed;
+        }
+        passed = CheckFramesInFlight(1, 1) && passed;
+        passed = CheckFencedPool() && passed;
+        passed = CheckRingAllocator() && passed;
+        passed = CheckLinearUploadBuffer() && passed;
+        passed = CheckResourceStateTracker() && passed;
+        passed = CheckRenderGraph() && passed;
+        passed = CheckDescriptorAllocator() && passed;
+
+        return passed;
+    }
+}
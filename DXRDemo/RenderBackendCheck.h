@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    // Runs the render backend checks on the null backend, each described where
+    // it is defined, and writes what the frames Game renders cost, barriers,
+    // copies and allocations, as CSV, followed by the difference between the
+    // frames tracked and recorded by hand. Returns whether every check passed.
+    bool RunRenderBackendCheck(const std::string& filename);
+}
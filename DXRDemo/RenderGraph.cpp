@@ -0,0 +1,609 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    namespace
+    {
+        constexpr ResourceState WriteStates =
+            ResourceState::RenderTarget | ResourceState::UnorderedAccess | ResourceState::DepthWrite | ResourceState::CopyDest;
+
+        uint64_t AlignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        bool IsReadState(ResourceState state)
+        {
+            return state != ResourceState::Common && (state & WriteStates) == ResourceState::Common;
+        }
+
+        // The state a pass needs a resource in for both uses
+        ResourceState CombineStates(ResourceState a, ResourceState b)
+        {
+            if (a == b)
+            {
+                return a;
+            }
+            if (IsReadState(a) && IsReadState(b))
+            {
+                return a | b;
+            }
+            throw std::logic_error("Pass uses a resource in two states");
+        }
+
+        // The state a resource is discarded in, Common for those that cannot be
+        ResourceState GetDiscardState(const ResourceDesc& desc)
+        {
+            if ((desc.Flags & ResourceFlags::AllowDepthStencil) != ResourceFlags::None)
+            {
+                return ResourceState::DepthWrite;
+            }
+            if ((desc.Flags & ResourceFlags::AllowRenderTarget) != ResourceFlags::None)
+            {
+                return ResourceState::RenderTarget;
+            }
+            return ResourceState::Common;
+        }
+
+        bool SameDesc(const ResourceDesc& a, const ResourceDesc& b)
+        {
+            return a.Dimension == b.Dimension && a.Width == b.Width && a.Height == b.Height &&
+                a.Format == b.Format && a.Flags == b.Flags && a.Heap == b.Heap && a.InitialState == b.InitialState;
+        }
+    }
+
+    RenderGraphBuilder::RenderGraphBuilder(RenderGraph& graph, uint32_t pass) :
+        _graph(&graph),
+        _pass(pass)
+    {
+    }
+
+    void RenderGraphBuilder::Read(RenderGraphResource resource, ResourceState state)
+    {
+        const RenderGraph::ResourceNode& node = _graph->_GetResource(resource);
+        if (node.Imported == nullptr && resource.Version == 0)
+        {
+            throw std::logic_error("Transient resource read before a pass writes it");
+        }
+
+        RenderGraph::Access& access = _graph->_GetAccess(_pass, resource.Index);
+        bool declared = access.Reads || access.WriteVersion != 0;
+        if ((access.Reads && access.ReadVersion != resource.Version) ||
+            (access.WriteVersion != 0 && access.WriteVersion != resource.Version + 1))
+        {
+            throw std::logic_error("Pass uses two versions of a resource");
+        }
+        access.State = declared ? CombineStates(access.State, state) : state;
+        access.Reads = true;
+        access.ReadVersion = resource.Version;
+    }
+
+    RenderGraphResource RenderGraphBuilder::Write(RenderGraphResource resource, ResourceState state)
+    {
+        _graph->_GetResource(resource);
+        RenderGraph::ResourceNode& node = _graph->_resources[resource.Index];
+        if (resource.Version != node.LastVersion)
+        {
+            throw std::logic_error("Write to a version of a resource already written");
+        }
+
+        RenderGraph::Access& access = _graph->_GetAccess(_pass, resource.Index);
+        if (access.Reads && access.ReadVersion != resource.Version)
+        {
+            throw std::logic_error("Pass uses two versions of a resource");
+        }
+        access.State = access.Reads ? CombineStates(access.State, state) : state;
+        access.WriteVersion = ++node.LastVersion;
+        return { resource.Index, node.LastVersion };
+    }
+
+    void RenderGraphBuilder::HasSideEffects()
+    {
+        _graph->_passes[_pass].SideEffects = true;
+    }
+
+    void RenderGraphBuilder::EndsCommandList()
+    {
+        _graph->_passes[_pass].EndsCommandList = true;
+    }
+
+    RenderGraphContext::RenderGraphContext(const RenderGraph& graph, RenderCommandList& commandList) :
+        _graph(&graph),
+        _commandList(&commandList)
+    {
+    }
+
+    RenderResource& RenderGraphContext::GetResource(RenderGraphResource resource) const
+    {
+        return _graph->GetResource(resource);
+    }
+
+    RenderGraph::RenderGraph(RenderDevice& device, ResourceStateRegistry& registry, std::function<void(std::shared_ptr<void>)> deferRelease) :
+        _device(&device),
+        _registry(&registry),
+        _deferRelease(std::move(deferRelease))
+    {
+    }
+
+    RenderGraph::~RenderGraph()
+    {
+        _ReleasePlacedResources();
+    }
+
+    RenderGraphResource RenderGraph::CreateResource(std::string name, const ResourceDesc& desc)
+    {
+        if (desc.Heap != HeapType::Default)
+        {
+            throw std::invalid_argument("Transient resources must be on the default heap");
+        }
+
+        ResourceNode& node = _resources.emplace_back();
+        node.Name = std::move(name);
+        node.Desc = desc;
+        // Placed resources start out in the common state, as the registry tracks them
+        node.Desc.InitialState = ResourceState::Common;
+        _compiled = false;
+        return { static_cast<uint32_t>(_resources.size() - 1), 0 };
+    }
+
+    RenderGraphResource RenderGraph::Import(std::string name, RenderResource& resource)
+    {
+        ResourceNode& node = _resources.emplace_back();
+        node.Name = std::move(name);
+        node.Desc = resource.GetDesc();
+        node.Imported = &resource;
+        _compiled = false;
+        return { static_cast<uint32_t>(_resources.size() - 1), 0 };
+    }
+
+    void RenderGraph::Reimport(RenderGraphResource resource, RenderResource& replacement)
+    {
+        _GetResource(resource);
+        ResourceNode& node = _resources[resource.Index];
+        if (node.Imported == nullptr)
+        {
+            throw std::logic_error("Transient resources cannot be reimported");
+        }
+        node.Imported = &replacement;
+    }
+
+    void RenderGraph::AddPass(std::string name, const SetupCallback& setup, ExecuteCallback execute)
+    {
+        PassNode& pass = _passes.emplace_back();
+        pass.Name = std::move(name);
+        pass.Execute = std::move(execute);
+        _compiled = false;
+
+        RenderGraphBuilder builder(*this, static_cast<uint32_t>(_passes.size() - 1));
+        setup(builder);
+    }
+
+    void RenderGraph::Compile()
+    {
+        // The passes writing and reading each version
+        std::vector<std::vector<uint32_t>> writers(_resources.size());
+        std::vector<std::vector<std::vector<uint32_t>>> readers(_resources.size());
+        for (size_t resource = 0; resource < _resources.size(); ++resource)
+        {
+            writers[resource].assign(_resources[resource].LastVersion + 1, NoPass);
+            readers[resource].resize(_resources[resource].LastVersion + 1);
+        }
+        for (uint32_t pass = 0; pass < _passes.size(); ++pass)
+        {
+            for (const Access& access : _passes[pass].Accesses)
+            {
+                if (access.WriteVersion != 0)
+                {
+                    writers[access.Resource][access.WriteVersion] = pass;
+                }
+                if (access.Reads)
+                {
+                    readers[access.Resource][access.ReadVersion].push_back(pass);
+                }
+            }
+        }
+
+        // A pass depends on the ones writing the versions it reads and the one it
+        // overwrites, and follows the ones reading what it overwrites
+        std::vector<std::vector<uint32_t>> dependencies(_passes.size());
+        std::vector<std::vector<uint32_t>> predecessors(_passes.size());
+        for (uint32_t pass = 0; pass < _passes.size(); ++pass)
+        {
+            for (const Access& access : _passes[pass].Accesses)
+            {
+                if (access.Reads && writers[access.Resource][access.ReadVersion] != NoPass)
+                {
+                    dependencies[pass].push_back(writers[access.Resource][access.ReadVersion]);
+                }
+                if (access.WriteVersion != 0)
+                {
+                    uint32_t previousVersion = access.WriteVersion - 1;
+                    if (writers[access.Resource][previousVersion] != NoPass)
+                    {
+                        dependencies[pass].push_back(writers[access.Resource][previousVersion]);
+                    }
+                    for (uint32_t reader : readers[access.Resource][previousVersion])
+                    {
+                        if (reader != pass)
+                        {
+                            predecessors[pass].push_back(reader);
+                        }
+                    }
+                }
+            }
+            predecessors[pass].insert(predecessors[pass].end(), dependencies[pass].begin(), dependencies[pass].end());
+        }
+
+        _Cull(dependencies);
+        _Sort(predecessors);
+
+        for (ResourceNode& resource : _resources)
+        {
+            resource.FirstUse = NoPass;
+            resource.LastUse = NoPass;
+        }
+        for (uint32_t position = 0; position < _order.size(); ++position)
+        {
+            for (const Access& access : _passes[_order[position]].Accesses)
+            {
+                ResourceNode& resource = _resources[access.Resource];
+                resource.FirstUse = std::min(resource.FirstUse, position);
+                resource.LastUse = position;
+            }
+        }
+
+        uint64_t heapSize = _PlaceTransientResources();
+
+        // Placed again unless every transient resource used keeps its place
+        bool samePlacement = _heap != nullptr && _heap->GetSize() == heapSize && _placedResources.size() == _resources.size();
+        for (size_t index = 0; samePlacement && index < _resources.size(); ++index)
+        {
+            const ResourceNode& resource = _resources[index];
+            const PlacedResource& placed = _placedResources[index];
+            bool used = resource.Imported == nullptr && resource.FirstUse != NoPass;
+            samePlacement = used ? placed.Resource != nullptr && SameDesc(placed.Desc, resource.Desc) && placed.Offset == resource.Offset :
+                placed.Resource == nullptr;
+        }
+
+        if (!samePlacement)
+        {
+            _ReleasePlacedResources();
+            _placedResources.resize(_resources.size());
+            if (heapSize != 0)
+            {
+                _heap = _device->CreateHeap(heapSize);
+                ++_statistics.HeapCreations;
+            }
+            for (size_t index = 0; index < _resources.size(); ++index)
+            {
+                const ResourceNode& resource = _resources[index];
+                if (resource.Imported == nullptr && resource.FirstUse != NoPass)
+                {
+                    _placedResources[index] = { resource.Desc, resource.Offset, _device->CreatePlacedResource(_heap, resource.Offset, resource.Desc) };
+                }
+            }
+        }
+
+        // Resources sharing memory with another take it over at their first use
+        _statistics.TransientResources = 0;
+        _statistics.TransientBytes = 0;
+        _statistics.DiscardedResources = 0;
+        for (ResourceNode& resource : _resources)
+        {
+            if (resource.Imported != nullptr || resource.FirstUse == NoPass)
+            {
+                continue;
+            }
+            ++_statistics.TransientResources;
+            _statistics.TransientBytes += resource.Size;
+            resource.NeedsAliasing = std::any_of(_resources.begin(), _resources.end(), [&resource](const ResourceNode& other)
+            {
+                return &other != &resource && other.Imported == nullptr && other.FirstUse != NoPass &&
+                    other.Offset < resource.Offset + resource.Size && resource.Offset < other.Offset + other.Size;
+            });
+            if (resource.NeedsAliasing && GetDiscardState(resource.Desc) != ResourceState::Common)
+            {
+                ++_statistics.DiscardedResources;
+            }
+        }
+        _statistics.Passes = _passes.size();
+        _statistics.CulledPasses = _passes.size() - _order.size();
+        _statistics.HeapBytes = heapSize;
+        _compiled = true;
+    }
+
+    void RenderGraph::Execute(RenderCommandList& firstCommandList, ResourceStateTracker& tracker, const SubmitCallback& submit)
+    {
+        if (!_compiled)
+        {
+            throw std::logic_error("Render graph executed before it was compiled");
+        }
+
+        RenderCommandList* commandList = &firstCommandList;
+        // Resources a pass before left for unordered access, which the next one
+        // using them that way must wait for
+        std::vector<bool> unorderedAccess(_resources.size(), false);
+        for (uint32_t position = 0; position < _order.size(); ++position)
+        {
+            PassNode& pass = _passes[_order[position]];
+
+            // Aliased render targets and depth buffers are discarded in their
+            // write state before the pass's own transitions
+            std::vector<RenderResource*> discarded;
+            for (const Access& access : pass.Accesses)
+            {
+                const ResourceNode& node = _resources[access.Resource];
+                if (node.NeedsAliasing && node.FirstUse == position)
+                {
+                    RenderResource& resource = GetResource({ access.Resource, 0 });
+                    tracker.Aliasing(resource);
+                    ResourceState discardState = GetDiscardState(node.Desc);
+                    if (discardState != ResourceState::Common)
+                    {
+                        tracker.Transition(resource, discardState);
+                        discarded.push_back(&resource);
+                    }
+                }
+            }
+            if (!discarded.empty())
+            {
+                tracker.FlushBarriers(*commandList);
+                for (RenderResource* resource : discarded)
+                {
+                    commandList->DiscardResource(*resource);
+                }
+            }
+
+            for (const Access& access : pass.Accesses)
+            {
+                RenderResource& resource = GetResource({ access.Resource, 0 });
+                if (access.State == ResourceState::UnorderedAccess && unorderedAccess[access.Resource])
+                {
+                    tracker.UnorderedAccess(resource);
+                }
+                tracker.Transition(resource, access.State);
+                unorderedAccess[access.Resource] = access.State == ResourceState::UnorderedAccess;
+            }
+            tracker.FlushBarriers(*commandList);
+
+            RenderGraphContext context(*this, *commandList);
+            pass.Execute(context);
+
+            if (pass.EndsCommandList)
+            {
+                if (!submit)
+                {
+                    throw std::logic_error("Render graph pass ends the command list without a submit callback");
+                }
+                commandList = &submit(*commandList);
+            }
+        }
+    }
+
+    void RenderGraph::Reset()
+    {
+        _passes.clear();
+        _resources.clear();
+        _order.clear();
+        _compiled = false;
+    }
+
+    std::vector<std::string> RenderGraph::GetPassOrder() const
+    {
+        std::vector<std::string> names;
+        for (uint32_t pass : _order)
+        {
+            names.push_back(_passes[pass].Name);
+        }
+        return names;
+    }
+
+    RenderResource& RenderGraph::GetResource(RenderGraphResource resource) const
+    {
+        const ResourceNode& node = _GetResource(resource);
+        if (node.Imported != nullptr)
+        {
+            return *node.Imported;
+        }
+        if (!_compiled || _placedResources[resource.Index].Resource == nullptr)
+        {
+            throw std::logic_error("Transient resource not placed, the graph not compiled or its passes culled");
+        }
+        return *_placedResources[resource.Index].Resource;
+    }
+
+    uint64_t RenderGraph::GetHeapOffset(RenderGraphResource resource) const
+    {
+        GetResource(resource);
+        if (_GetResource(resource).Imported != nullptr)
+        {
+            throw std::logic_error("Imported resources are not in the heap");
+        }
+        return _placedResources[resource.Index].Offset;
+    }
+
+    const RenderGraph::ResourceNode& RenderGraph::_GetResource(RenderGraphResource resource) const
+    {
+        if (resource.Index >= _resources.size() || resource.Version > _resources[resource.Index].LastVersion)
+        {
+            throw std::out_of_range("Resource not declared to the render graph");
+        }
+        return _resources[resource.Index];
+    }
+
+    RenderGraph::Access& RenderGraph::_GetAccess(uint32_t pass, uint32_t resource)
+    {
+        std::vector<Access>& accesses = _passes[pass].Accesses;
+        auto access = std::find_if(accesses.begin(), accesses.end(), [resource](const Access& access)
+        {
+            return access.Resource == resource;
+        });
+        if (access != accesses.end())
+        {
+            return *access;
+        }
+        return accesses.emplace_back(Access{ resource });
+    }
+
+    void RenderGraph::_Cull(const std::vector<std::vector<uint32_t>>& dependencies)
+    {
+        std::vector<uint32_t> kept;
+        for (uint32_t pass = 0; pass < _passes.size(); ++pass)
+        {
+            bool writesImported = std::any_of(_passes[pass].Accesses.begin(), _passes[pass].Accesses.end(), [this](const Access& access)
+            {
+                return access.WriteVersion != 0 && _resources[access.Resource].Imported != nullptr;
+            });
+            _passes[pass].Culled = !(_passes[pass].SideEffects || writesImported);
+            if (!_passes[pass].Culled)
+            {
+                kept.push_back(pass);
+            }
+        }
+
+        while (!kept.empty())
+        {
+            uint32_t pass = kept.back();
+            kept.pop_back();
+            for (uint32_t dependency : dependencies[pass])
+            {
+                if (_passes[dependency].Culled)
+                {
+                    _passes[dependency].Culled = false;
+                    kept.push_back(dependency);
+                }
+            }
+        }
+    }
+
+    void RenderGraph::_Sort(const std::vector<std::vector<uint32_t>>& predecessors)
+    {
+        // Kahn's algorithm, the passes ready to go in the order they were added
+        std::vector<uint32_t> waitingOn(_passes.size(), 0);
+        std::vector<std::vector<uint32_t>> successors(_passes.size());
+        size_t keptCount = 0;
+        for (uint32_t pass = 0; pass < _passes.size(); ++pass)
+        {
+            if (_passes[pass].Culled)
+            {
+                continue;
+            }
+            ++keptCount;
+            for (uint32_t predecessor : predecessors[pass])
+            {
+                if (!_passes[predecessor].Culled)
+                {
+                    ++waitingOn[pass];
+                    successors[predecessor].push_back(pass);
+                }
+            }
+        }
+
+        std::set<uint32_t> ready;
+        for (uint32_t pass = 0; pass < _passes.size(); ++pass)
+        {
+            if (!_passes[pass].Culled && waitingOn[pass] == 0)
+            {
+                ready.insert(pass);
+            }
+        }
+
+        _order.clear();
+        while (!ready.empty())
+        {
+            uint32_t pass = *ready.begin();
+            ready.erase(ready.begin());
+            _order.push_back(pass);
+            for (uint32_t successor : successors[pass])
+            {
+                if (--waitingOn[successor] == 0)
+                {
+                    ready.insert(successor);
+                }
+            }
+        }
+
+        if (_order.size() != keptCount)
+        {
+            _order.clear();
+            throw std::logic_error("Render graph passes depend on each other in a cycle");
+        }
+    }
+
+    uint64_t RenderGraph::_PlaceTransientResources()
+    {
+        std::vector<uint32_t> transients;
+        for (uint32_t index = 0; index < _resources.size(); ++index)
+        {
+            ResourceNode& resource = _resources[index];
+            if (resource.Imported == nullptr && resource.FirstUse != NoPass)
+            {
+                resource.Size = _device->GetAllocationSize(resource.Desc, &resource.Alignment);
+                transients.push_back(index);
+            }
+        }
+
+        // Largest first, each at the lowest offset clear of the ones placed whose
+        // lifetimes overlap its own
+        std::stable_sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b)
+        {
+            return _resources[a].Size > _resources[b].Size;
+        });
+
+        uint64_t heapSize = 0;
+        std::vector<const ResourceNode*> placed;
+        for (uint32_t index : transients)
+        {
+            ResourceNode& resource = _resources[index];
+            std::vector<const ResourceNode*> live;
+            std::vector<uint64_t> offsets = { 0 };
+            for (const ResourceNode* other : placed)
+            {
+                if (other->FirstUse <= resource.LastUse && resource.FirstUse <= other->LastUse)
+                {
+                    live.push_back(other);
+                    offsets.push_back(AlignUp(other->Offset + other->Size, resource.Alignment));
+                }
+            }
+            std::sort(offsets.begin(), offsets.end());
+
+            for (uint64_t offset : offsets)
+            {
+                bool clear = std::none_of(live.begin(), live.end(), [&resource, offset](const ResourceNode* other)
+                {
+                    return other->Offset < offset + resource.Size && offset < other->Offset + other->Size;
+                });
+                if (clear)
+                {
+                    resource.Offset = offset;
+                    break;
+                }
+            }
+            placed.push_back(&resource);
+            heapSize = std::max(heapSize, resource.Offset + resource.Size);
+        }
+        return heapSize;
+    }
+
+    void RenderGraph::_ReleasePlacedResources()
+    {
+        for (PlacedResource& placed : _placedResources)
+        {
+            if (placed.Resource != nullptr)
+            {
+                _registry->Forget(*placed.Resource);
+                _deferRelease(std::move(placed.Resource));
+            }
+        }
+        _placedResources.clear();
+        if (_heap != nullptr)
+        {
+            _deferRelease(std::move(_heap));
+            _heap = nullptr;
+        }
+    }
+}
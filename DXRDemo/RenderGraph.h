@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "RenderBackend.h"
+#include "ResourceStateTracker.h"
+
+namespace DXRDemo
+{
+    // A version of a resource declared to a RenderGraph, each write making the next
+    struct RenderGraphResource
+    {
+        static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+        uint32_t Index = InvalidIndex;
+        uint32_t Version = 0;
+    };
+
+    class RenderGraph;
+
+    // Handed to the setup callback of a pass to declare what it uses. A resource
+    // is in one state for the whole pass, read states combining.
+    class RenderGraphBuilder final
+    {
+    public:
+        void Read(RenderGraphResource resource, ResourceState state);
+
+        // Throws std::logic_error unless resource is the last version written,
+        // returns the version the pass leaves
+        RenderGraphResource Write(RenderGraphResource resource, ResourceState state);
+
+        // Keeps the pass when nothing reads what it writes, for readbacks
+        void HasSideEffects();
+
+        // Ends the command list after the pass, for work submitted on its own or
+        // lists recorded aside that must run in between
+        void EndsCommandList();
+
+    private:
+        friend class RenderGraph;
+
+        RenderGraphBuilder(RenderGraph& graph, uint32_t pass);
+
+        RenderGraph* _graph;
+        uint32_t _pass;
+    };
+
+    // Handed to the execute callback of a pass, with the barriers it needs recorded
+    class RenderGraphContext final
+    {
+    public:
+        RenderResource& GetResource(RenderGraphResource resource) const;
+
+        inline RenderCommandList& GetCommandList() const
+        {
+            return *_commandList;
+        }
+
+    private:
+        friend class RenderGraph;
+
+        RenderGraphContext(const RenderGraph& graph, RenderCommandList& commandList);
+
+        const RenderGraph* _graph;
+        RenderCommandList* _commandList;
+    };
+
+    struct RenderGraphStatistics
+    {
+        uint64_t Passes = 0;
+        uint64_t CulledPasses = 0;
+        uint64_t TransientResources = 0;
+        // Bytes the transient resources would take on their own, and the heap
+        // they share
+        uint64_t TransientBytes = 0;
+        uint64_t HeapBytes = 0;
+        // Aliased render targets and depth buffers, discarded at their first use
+        uint64_t DiscardedResources = 0;
+        // Compilations that had to place the transient resources again
+        uint64_t HeapCreations = 0;
+    };
+
+    // Frame built from passes declaring the resources they read and write, in
+    // any order consistent with the versions they use.
+    //
+    // Compile orders the passes after the ones producing what they read and
+    // before the ones overwriting it, and culls those whose writes no pass kept
+    // reads, passes writing imported resources or having side effects being
+    // kept. Transient resources, created by the graph, live from the first pass
+    // using them to the last, and share one heap with the others whose lifetimes
+    // do not overlap, aliasing barriers handing the memory over. Their contents
+    // are undefined before the first pass writes them. The heap and the
+    // resources are kept while the passes declared each frame need the same
+    // layout, otherwise replaced, the old ones going to deferRelease.
+    //
+    // Execute records the barriers each pass needs through a ResourceStateTracker
+    // and runs the passes, which must not use other graph resources than they
+    // declared. The list a pass ends goes to submit, which returns the one the
+    // passes after it record to. Aliased render targets and depth buffers are discarded after
+    // their aliasing barrier, as D3D12 requires before anything else uses them.
+    // A compiled graph may be executed again, Reset starting the next frame's
+    // declarations when the passes change.
+    class RenderGraph final
+    {
+    public:
+        using SetupCallback = std::function<void(RenderGraphBuilder&)>;
+        using ExecuteCallback = std::function<void(RenderGraphContext&)>;
+        using SubmitCallback = std::function<RenderCommandList&(RenderCommandList&)>;
+
+        // deferRelease keeps objects the GPU may still use alive until it is done
+        RenderGraph(RenderDevice& device, ResourceStateRegistry& registry, std::function<void(std::shared_ptr<void>)> deferRelease);
+        RenderGraph(const RenderGraph&) = delete;
+        RenderGraph& operator=(const RenderGraph&) = delete;
+        // Hands the heap and the placed resources to deferRelease
+        ~RenderGraph();
+
+        // Transient resource on the default heap, its initial state ignored
+        RenderGraphResource CreateResource(std::string name, const ResourceDesc& desc);
+
+        // Resource living outside the graph, its contents kept across frames
+        RenderGraphResource Import(std::string name, RenderResource& resource);
+
+        // Points an imported resource at another of the same kind, keeping the
+        // graph compiled, to execute it again on the next swap chain buffer.
+        // Throws std::logic_error for a transient resource.
+        void Reimport(RenderGraphResource resource, RenderResource& replacement);
+
+        // Runs setup right away
+        void AddPass(std::string name, const SetupCallback& setup, ExecuteCallback execute);
+
+        // Throws std::logic_error if the passes depend on each other in a cycle
+        void Compile();
+
+        // Throws std::logic_error if a pass ends the list without a submit callback
+        void Execute(RenderCommandList& commandList, ResourceStateTracker& tracker, const SubmitCallback& submit = {});
+
+        // Drops the passes and resources declared, keeping the heap
+        void Reset();
+
+        // Names of the passes kept, in the order Compile gave them
+        std::vector<std::string> GetPassOrder() const;
+
+        // Throws std::logic_error for a transient resource not placed by Compile
+        RenderResource& GetResource(RenderGraphResource resource) const;
+
+        // Offset of a transient resource in the heap
+        uint64_t GetHeapOffset(RenderGraphResource resource) const;
+
+        inline const RenderGraphStatistics& GetStatistics() const
+        {
+            return _statistics;
+        }
+
+    private:
+        friend class RenderGraphBuilder;
+
+        static constexpr uint32_t NoPass = UINT32_MAX;
+
+        struct Access
+        {
+            uint32_t Resource;
+            ResourceState State = ResourceState::Common;
+            bool Reads = false;
+            uint32_t ReadVersion = 0;
+            // 0 if the pass does not write the resource
+            uint32_t WriteVersion = 0;
+        };
+
+        struct PassNode
+        {
+            std::string Name;
+            ExecuteCallback Execute;
+            std::vector<Access> Accesses;
+            bool SideEffects = false;
+            bool EndsCommandList = false;
+            bool Culled = false;
+        };
+
+        struct ResourceNode
+        {
+            std::string Name;
+            ResourceDesc Desc;
+            // Null for transient resources
+            RenderResource* Imported = nullptr;
+            uint32_t LastVersion = 0;
+            // Positions in the pass order of the first and last pass using it
+            uint32_t FirstUse = NoPass;
+            uint32_t LastUse = NoPass;
+            uint64_t Size = 0;
+            uint64_t Alignment = 1;
+            uint64_t Offset = 0;
+            // Sharing memory with another, it needs an aliasing barrier first
+            bool NeedsAliasing = false;
+        };
+
+        // Placed transient resource, kept across frames
+        struct PlacedResource
+        {
+            ResourceDesc Desc;
+            uint64_t Offset = 0;
+            std::shared_ptr<RenderResource> Resource;
+        };
+
+        RenderDevice* _device;
+        ResourceStateRegistry* _registry;
+        std::function<void(std::shared_ptr<void>)> _deferRelease;
+        std::vector<PassNode> _passes;
+        std::vector<ResourceNode> _resources;
+        std::vector<uint32_t> _order;
+        bool _compiled = false;
+        std::shared_ptr<RenderHeap> _heap;
+        // By index of the resources declared, empty for those not placed
+        std::vector<PlacedResource> _placedResources;
+        RenderGraphStatistics _statistics;
+
+        const ResourceNode& _GetResource(RenderGraphResource resource) const;
+        Access& _GetAccess(uint32_t pass, uint32_t resource);
+        // Marks the passes none of the kept ones depend on as culled
+        void _Cull(const std::vector<std::vector<uint32_t>>& dependencies);
+        // Throws std::logic_error on a cycle
+        void _Sort(const std::vector<std::vector<uint32_t>>& predecessors);
+        // Sets the offsets of the transient resources used, returns the heap size
+        uint64_t _PlaceTransientResources();
+        // Forgets the states of the placed resources and defers their release
+        void _ReleasePlacedResources();
+    };
+}
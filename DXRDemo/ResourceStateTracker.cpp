@@ -0,0 +1,272 @@
+#include "ResourceStateTracker.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    namespace
+    {
+        constexpr ResourceState WriteStates =
+            ResourceState::RenderTarget | ResourceState::UnorderedAccess | ResourceState::DepthWrite | ResourceState::CopyDest;
+
+        // Read states combine, a resource in several of them can be used in any
+        constexpr bool IsRedundant(ResourceState current, ResourceState required)
+        {
+            if (current == required)
+            {
+                return true;
+            }
+            bool readOnly = current != ResourceState::Common && (current & WriteStates) == ResourceState::Common;
+            return readOnly && required != ResourceState::Common && HasState(current, required);
+        }
+    }
+
+    ResourceState ResourceStateRegistry::GetState(const RenderResource& resource) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _GetState(resource);
+    }
+
+    void ResourceStateRegistry::Forget(const RenderResource& resource)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _states.erase(&resource);
+    }
+
+    ResourceState ResourceStateRegistry::_GetState(const RenderResource& resource) const
+    {
+        auto state = _states.find(&resource);
+        return state != _states.end() ? state->second : resource.GetDesc().InitialState;
+    }
+
+    ResourceStateTracker::ResourceStateTracker(ResourceStateRegistry& registry) :
+        _registry(&registry)
+    {
+    }
+
+    void ResourceStateTracker::Transition(RenderResource& resource, ResourceState state)
+    {
+        ++_statistics.Transitions;
+        TrackedResource* tracked;
+        if (_TrackFirstState(resource, state, tracked))
+        {
+            return;
+        }
+
+        if (tracked->Splitting)
+        {
+            _EndSplit(resource, *tracked);
+        }
+
+        if (IsRedundant(tracked->State, state))
+        {
+            ++_statistics.RedundantTransitions;
+            return;
+        }
+
+        if (tracked->QueuedBarrier != NoBarrier)
+        {
+            // Leading back to where the resource was, the barrier is dropped on flush
+            _queuedBarriers[tracked->QueuedBarrier].StateAfter = state;
+            tracked->State = state;
+            ++_statistics.MergedTransitions;
+            return;
+        }
+
+        tracked->QueuedBarrier = _queuedBarriers.size();
+        _queuedBarriers.push_back(ResourceBarrier::Transition(resource, tracked->State, state));
+        tracked->State = state;
+    }
+
+    void ResourceStateTracker::BeginTransition(RenderResource& resource, ResourceState state)
+    {
+        ++_statistics.Transitions;
+        TrackedResource* tracked;
+        if (_TrackFirstState(resource, state, tracked))
+        {
+            return;
+        }
+
+        if (tracked->Splitting)
+        {
+            throw std::logic_error("Split barrier begun twice");
+        }
+        if (IsRedundant(tracked->State, state))
+        {
+            ++_statistics.RedundantTransitions;
+            return;
+        }
+
+        if (tracked->QueuedBarrier != NoBarrier)
+        {
+            _queuedBarriers[tracked->QueuedBarrier].StateAfter = state;
+            tracked->State = state;
+            ++_statistics.MergedTransitions;
+            return;
+        }
+
+        tracked->QueuedBarrier = _queuedBarriers.size();
+        _queuedBarriers.push_back(ResourceBarrier::Transition(resource, tracked->State, state, ResourceBarrier::Split::BeginOnly));
+        tracked->Splitting = true;
+        tracked->SplitState = state;
+    }
+
+    void ResourceStateTracker::UnorderedAccess(RenderResource& resource)
+    {
+        bool queued = std::any_of(_queuedBarriers.begin(), _queuedBarriers.end(), [&resource](const ResourceBarrier& barrier)
+        {
+            return barrier.Kind == ResourceBarrier::Type::UnorderedAccess && barrier.Resource == &resource;
+        });
+        if (!queued)
+        {
+            _queuedBarriers.push_back(ResourceBarrier::UnorderedAccess(resource));
+        }
+    }
+
+    void ResourceStateTracker::Aliasing(RenderResource& resource)
+    {
+        auto [entry, inserted] = _resources.try_emplace(&resource);
+        TrackedResource& tracked = entry->second;
+        if (!inserted && (tracked.QueuedBarrier != NoBarrier || tracked.Splitting))
+        {
+            throw std::logic_error("Aliasing barrier queued after a transition of the resource");
+        }
+        if (inserted)
+        {
+            tracked.FirstState = _registry->GetState(resource);
+            tracked.State = tracked.FirstState;
+            tracked.FirstFlush = _flushCount;
+        }
+        tracked.Pinned = true;
+
+        _queuedBarriers.push_back(ResourceBarrier::Aliasing(nullptr, &resource));
+        ++_statistics.AliasingBarriers;
+    }
+
+    void ResourceStateTracker::FlushBarriers(RenderCommandList& commandList)
+    {
+        for (const ResourceBarrier& barrier : _queuedBarriers)
+        {
+            if (barrier.Kind == ResourceBarrier::Type::Transition)
+            {
+                _resources[barrier.Resource].QueuedBarrier = NoBarrier;
+            }
+        }
+
+        std::erase_if(_queuedBarriers, [](const ResourceBarrier& barrier)
+        {
+            return barrier.Kind == ResourceBarrier::Type::Transition && barrier.StateBefore == barrier.StateAfter;
+        });
+
+        if (!_queuedBarriers.empty())
+        {
+            commandList.Barriers(_queuedBarriers);
+            _statistics.Barriers += _queuedBarriers.size();
+            ++_statistics.BarrierBatches;
+            _statistics.SplitBarriers += std::count_if(_queuedBarriers.begin(), _queuedBarriers.end(), [](const ResourceBarrier& barrier)
+            {
+                return barrier.SplitFlags == ResourceBarrier::Split::BeginOnly;
+            });
+            _queuedBarriers.clear();
+        }
+        ++_flushCount;
+    }
+
+    void ResourceStateTracker::Close(RenderCommandList& commandList)
+    {
+        for (auto& [resource, tracked] : _resources)
+        {
+            if (tracked.Splitting)
+            {
+                _EndSplit(*resource, tracked);
+            }
+        }
+        FlushBarriers(commandList);
+    }
+
+    void ResourceStateTracker::ResolveBarriers(std::vector<ResourceBarrier>& barriers)
+    {
+        if (!_queuedBarriers.empty())
+        {
+            throw std::logic_error("Barriers queued after the last flush of a list submitted");
+        }
+
+        for (const auto& [resource, tracked] : _resources)
+        {
+            if (tracked.Splitting)
+            {
+                throw std::logic_error("Split barrier left open in a list submitted");
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_registry->_mutex);
+        for (const auto& [resource, tracked] : _resources)
+        {
+            ResourceState state = _registry->_GetState(*resource);
+            if (state != tracked.FirstState)
+            {
+                barriers.push_back(ResourceBarrier::Transition(*resource, state, tracked.FirstState));
+                ++_statistics.ResolvedBarriers;
+            }
+            _registry->_states[resource] = tracked.State;
+        }
+        _resources.clear();
+    }
+
+    uint64_t ResourceStateTracker::ExecuteCommandList(RenderQueue& queue, std::unique_ptr<RenderCommandList> commandList)
+    {
+        Close(*commandList);
+
+        std::vector<ResourceBarrier> barriers;
+        ResolveBarriers(barriers);
+        if (!barriers.empty())
+        {
+            std::unique_ptr<RenderCommandList> barrierCommandList = queue.GetCommandList();
+            barrierCommandList->Barriers(barriers);
+            queue.ExecuteCommandList(std::move(barrierCommandList));
+        }
+        return queue.ExecuteCommandList(std::move(commandList));
+    }
+
+    bool ResourceStateTracker::_TrackFirstState(RenderResource& resource, ResourceState state, TrackedResource*& tracked)
+    {
+        auto [entry, inserted] = _resources.try_emplace(&resource);
+        tracked = &entry->second;
+        if (inserted)
+        {
+            tracked->FirstState = state;
+            tracked->State = state;
+            tracked->FirstFlush = _flushCount;
+            return true;
+        }
+
+        // No command used it yet, so the list can still start in the new state
+        if (tracked->FirstFlush == _flushCount && tracked->QueuedBarrier == NoBarrier && !tracked->Splitting && !tracked->Pinned)
+        {
+            if (tracked->FirstState != state)
+            {
+                ++_statistics.MergedTransitions;
+            }
+            tracked->FirstState = state;
+            tracked->State = state;
+            return true;
+        }
+        return false;
+    }
+
+    void ResourceStateTracker::_EndSplit(RenderResource& resource, TrackedResource& tracked)
+    {
+        tracked.Splitting = false;
+        if (tracked.QueuedBarrier != NoBarrier)
+        {
+            // Begun since the last flush, there is nothing for it to overlap with
+            _queuedBarriers[tracked.QueuedBarrier].SplitFlags = ResourceBarrier::Split::None;
+        }
+        else
+        {
+            _queuedBarriers.push_back(ResourceBarrier::Transition(resource, tracked.State, tracked.SplitState, ResourceBarrier::Split::EndOnly));
+        }
+        tracked.State = tracked.SplitState;
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "RenderBackend.h"
+
+namespace DXRDemo
+{
+    // State each resource is left in by the command lists submitted so far,
+    // which the trackers resolve their lists against. Resources it has not seen
+    // are in the initial state of their description. Thread safe.
+    class ResourceStateRegistry final
+    {
+    public:
+        ResourceState GetState(const RenderResource& resource) const;
+
+        // To be called before the resource is destroyed, so that another one
+        // created at its address does not take its state
+        void Forget(const RenderResource& resource);
+
+    private:
+        friend class ResourceStateTracker;
+
+        mutable std::mutex _mutex;
+        std::unordered_map<const RenderResource*, ResourceState> _states;
+
+        // With the mutex held
+        ResourceState _GetState(const RenderResource& resource) const;
+    };
+
+    struct ResourceStateTrackerStatistics
+    {
+        uint64_t Transitions = 0;
+        // Transitions to the state the resource was in already, or a read state
+        // it combined with others
+        uint64_t RedundantTransitions = 0;
+        // Transitions folded into a barrier queued before, or cancelling it
+        uint64_t MergedTransitions = 0;
+        // Barriers recorded, and the calls recording them
+        uint64_t Barriers = 0;
+        uint64_t BarrierBatches = 0;
+        uint64_t SplitBarriers = 0;
+        // Barriers added on submission, for the states lists first needed
+        uint64_t ResolvedBarriers = 0;
+        uint64_t AliasingBarriers = 0;
+    };
+
+    // Tracks the states of the resources used by a command list, or by several
+    // submitted together in the order they were recorded.
+    //
+    // Transition only notes the state the commands that follow need. The barriers
+    // are recorded in one call by FlushBarriers, right before those commands, and
+    // transitions of a resource queued in between merge into one barrier, or none
+    // when they lead back to where it was. The state a resource is in when the
+    // list starts is only known once the lists before it are submitted, so its
+    // first transition is resolved against the registry by ResolveBarriers on
+    // submission, which gives the barriers to run ahead of the list.
+    //
+    // BeginTransition starts a split barrier, leaving the GPU the commands up to
+    // the Transition ending it to carry it out. Close ends the ones still open.
+    class ResourceStateTracker final
+    {
+    public:
+        explicit ResourceStateTracker(ResourceStateRegistry& registry);
+        ResourceStateTracker(const ResourceStateTracker&) = delete;
+        ResourceStateTracker& operator=(const ResourceStateTracker&) = delete;
+
+        void Transition(RenderResource& resource, ResourceState state);
+
+        // The resource must not be used until a Transition to the same state
+        void BeginTransition(RenderResource& resource, ResourceState state);
+
+        void UnorderedAccess(RenderResource& resource);
+
+        // Queues an aliasing barrier handing a placed resource the memory it
+        // shares, ahead of the transitions of the resource queued after it. The
+        // resource keeps the state the registry has for it, so the lists using it
+        // before must be resolved, and none of its transitions be queued.
+        void Aliasing(RenderResource& resource);
+
+        // Records the barriers queued so far, before the commands needing the
+        // states noted since the last call, even if none were queued
+        void FlushBarriers(RenderCommandList& commandList);
+
+        // Ends the split barriers still open and records the queued barriers,
+        // after the last command of the list
+        void Close(RenderCommandList& commandList);
+
+        // Appends the barriers bringing the resources from their states in the
+        // registry to the ones the list starts with, and records the states the
+        // list leaves them in. Lists must be submitted in the order they are
+        // resolved in, each after the barriers. The tracker then starts over.
+        void ResolveBarriers(std::vector<ResourceBarrier>& barriers);
+
+        // Closes and resolves the list, then submits the barriers resolved in a
+        // list of their own if there are any, and the list
+        uint64_t ExecuteCommandList(RenderQueue& queue, std::unique_ptr<RenderCommandList> commandList);
+
+        inline const ResourceStateTrackerStatistics& GetStatistics() const
+        {
+            return _statistics;
+        }
+
+    private:
+        static constexpr size_t NoBarrier = static_cast<size_t>(-1);
+
+        struct TrackedResource
+        {
+            // State the list needs the resource in first, resolved on submission
+            ResourceState FirstState = ResourceState::Common;
+            // State after the barriers queued so far
+            ResourceState State = ResourceState::Common;
+            // Transition queued since the last flush
+            size_t QueuedBarrier = NoBarrier;
+            // Flush count when the resource was first seen, its first state can be
+            // changed until the next flush
+            uint64_t FirstFlush = 0;
+            bool Splitting = false;
+            ResourceState SplitState = ResourceState::Common;
+            // Named by an aliasing barrier, its transitions must follow it in the list
+            bool Pinned = false;
+        };
+
+        ResourceStateRegistry* _registry;
+        std::unordered_map<RenderResource*, TrackedResource> _resources;
+        std::vector<ResourceBarrier> _queuedBarriers;
+        uint64_t _flushCount = 0;
+        ResourceStateTrackerStatistics _statistics;
+
+        // Notes the first state of a resource seen for the first time since the
+        // last flush, returns false if the resource was known
+        bool _TrackFirstState(RenderResource& resource, ResourceState state, TrackedResource*& tracked);
+
+        // Queues the end of the split barrier, or makes it whole if its beginning
+        // is still queued
+        void _EndSplit(RenderResource& resource, TrackedResource& tracked);
+    };
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    // Hands out aligned ranges of a fixed size block in order, wrapping around to
+    // its start, and frees them in the same order. Retire tags the ranges handed
+    // out since the last call with the fence value of the submission using them,
+    // and Reclaim frees those of the fence values completed. Only does the
+    // bookkeeping, the memory itself belongs to the caller.
+    class RingAllocator final
+    {
+    public:
+        static constexpr uint64_t InvalidOffset = std::numeric_limits<uint64_t>::max();
+
+        explicit RingAllocator(uint64_t capacity = 0) :
+            _capacity(capacity)
+        {
+        }
+
+        // Returns the offset of the range, or InvalidOffset if it does not fit
+        // until more is reclaimed. Alignment must be a power of two.
+        inline uint64_t Allocate(uint64_t size, uint64_t alignment)
+        {
+            if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+            {
+                throw std::invalid_argument("Alignment must be a power of two");
+            }
+
+            if (size > _capacity || _capacity == 0)
+            {
+                return InvalidOffset;
+            }
+
+            uint64_t headOffset = _head % _capacity;
+            uint64_t offset = (headOffset + alignment - 1) & ~(alignment - 1);
+            if (offset + size > _capacity)
+            {
+                // Ranges are contiguous, the end of the block is skipped
+                offset = 0;
+            }
+
+            uint64_t advance = offset >= headOffset ? offset + size - headOffset : _capacity - headOffset + size;
+            if (GetUsedSize() + advance > _capacity)
+            {
+                return InvalidOffset;
+            }
+
+            _head += advance;
+            return offset;
+        }
+
+        // The ranges handed out since the last call are used until fenceValue completes
+        inline void Retire(uint64_t fenceValue)
+        {
+            if (HasOpenRanges())
+            {
+                _retired.push_back({ fenceValue, _head });
+            }
+        }
+
+        inline void Reclaim(uint64_t completedFenceValue)
+        {
+            // Retired in order, so their fence values only grow
+            while (!_retired.empty() && _retired.front().FenceValue <= completedFenceValue)
+            {
+                _tail = _retired.front().End;
+                _retired.pop_front();
+            }
+        }
+
+        // Whether ranges wait for a fence value, the oldest of which is then
+        // the one to wait for to make room
+        inline bool HasRetiredRanges() const
+        {
+            return !_retired.empty();
+        }
+
+        inline uint64_t GetOldestFenceValue() const
+        {
+            return _retired.front().FenceValue;
+        }
+
+        // Whether ranges were handed out since the last Retire
+        inline bool HasOpenRanges() const
+        {
+            return _head != (_retired.empty() ? _tail : _retired.back().End);
+        }
+
+        inline uint64_t GetCapacity() const
+        {
+            return _capacity;
+        }
+
+        // Including the padding skipped to align or wrap around
+        inline uint64_t GetUsedSize() const
+        {
+            return _head - _tail;
+        }
+
+    private:
+        struct RetiredRanges
+        {
+            uint64_t FenceValue;
+            // Where the head was when they were retired
+            uint64_t End;
+        };
+
+        uint64_t _capacity;
+        // Both only ever grow, the offset being taken modulo the capacity
+        uint64_t _head = 0;
+        uint64_t _tail = 0;
+        std::deque<RetiredRanges> _retired;
+    };
+}
@@ -2,17 +2,33 @@
 
 #include <memory>
 #include "GameObject.h"
+#include "ChangeJournal.h"
 
 namespace DXRDemo
 {
     class Scene final
     {
     public:
+        Scene() = default;
+        // Objects of the scene point to its journal
+        Scene(const Scene&) = delete;
+        Scene& operator=(const Scene&) = delete;
+
         std::shared_ptr<GameObject> RootSceneObject;
 
+        // Changes made to the scene since the renderer last processed them
+        ChangeJournal Journal;
+
+        inline void SetRootSceneObject(const std::shared_ptr<GameObject>& rootSceneObject)
+        {
+            RootSceneObject = rootSceneObject;
+            RootSceneObject->SetJournal(&Journal);
+            Journal.Record(ChangeType::Hierarchy, RootSceneObject.get());
+        }
+
         inline void Update(double deltaTime)
         {
             RootSceneObject->Update(deltaTime);
         }
     };
-}
\ No newline at end of file
+}
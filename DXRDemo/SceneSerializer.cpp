@@ -0,0 +1,516 @@
+#include "SceneSerializer.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "MeshRenderer.h"
+#include "OscillatorComponent.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        constexpr char BinaryMagic[4] = { 'D', 'X', 'R', 'S' };
+        constexpr char TextMagic[] = "dxrscene";
+        constexpr uint32_t FormatVersion = 1;
+
+        struct FileHeader
+        {
+            char Magic[4];
+            uint32_t Version;
+            uint32_t NodeCount;
+            uint32_t ComponentCount;
+            uint32_t IndexCount;
+            uint32_t ValueCount;
+            uint32_t StringBytes;
+        };
+
+        // Strings are referenced by their byte offset in the string section
+        struct ComponentRecord
+        {
+            uint32_t Type;
+            uint32_t Asset;
+            uint32_t FirstIndex;
+            uint32_t IndexCount;
+            uint32_t FirstValue;
+            uint32_t ValueCount;
+        };
+
+        static_assert(sizeof(FileHeader) == 28, "Scene file header must be tightly packed");
+        static_assert(sizeof(ComponentRecord) == 24, "Scene component record must be tightly packed");
+
+        template <typename T>
+        void WriteSection(std::ofstream& file, const std::vector<T>& section)
+        {
+            if (!section.empty())
+            {
+                file.write(reinterpret_cast<const char*>(section.data()), section.size() * sizeof(T));
+            }
+        }
+
+        // Counts come from the file, which must hold the section before anything
+        // is allocated for it
+        template <typename T>
+        void ReadSection(std::ifstream& file, std::vector<T>& section, uint32_t count, uint64_t& remainingBytes)
+        {
+            if (count > remainingBytes / sizeof(T))
+            {
+                throw std::runtime_error("Scene file is truncated");
+            }
+            remainingBytes -= static_cast<uint64_t>(count) * sizeof(T);
+
+            section.resize(count);
+            if (count > 0 && !file.read(reinterpret_cast<char*>(section.data()), static_cast<std::streamsize>(count) * sizeof(T)))
+            {
+                throw std::runtime_error("Scene file is truncated");
+            }
+        }
+    }
+
+    SceneSerializer::SceneSerializer()
+    {
+        RegisterComponent("MeshRenderer",
+            [](const Component& component, ComponentData& data)
+            {
+                const MeshRenderer* meshRenderer = dynamic_cast<const MeshRenderer*>(&component);
+                if (meshRenderer == nullptr)
+                {
+                    return false;
+                }
+
+                data.Asset = meshRenderer->AssetPath;
+                data.Indices = meshRenderer->AssetMeshIndices;
+                return true;
+            },
+            [](const ComponentData& data, AssetImporter& assetImporter)
+            {
+                const std::vector<std::shared_ptr<Mesh>>& meshes = assetImporter.ImportMeshes(data.Asset);
+
+                std::shared_ptr<MeshRenderer> meshRenderer = std::make_shared<MeshRenderer>();
+                meshRenderer->AssetPath = data.Asset;
+                meshRenderer->AssetMeshIndices = data.Indices;
+                meshRenderer->Meshes.reserve(data.Indices.size());
+                for (uint32_t meshIndex : data.Indices)
+                {
+                    meshRenderer->Meshes.push_back(meshes.at(meshIndex));
+                }
+                return std::static_pointer_cast<Component>(meshRenderer);
+            });
+
+        RegisterComponent("OscillatorComponent",
+            [](const Component& component, ComponentData& data)
+            {
+                const OscillatorComponent* oscillator = dynamic_cast<const OscillatorComponent*>(&component);
+                if (oscillator == nullptr)
+                {
+                    return false;
+                }
+
+                data.Values = { oscillator->Radius, oscillator->Speed };
+                return true;
+            },
+            [](const ComponentData& data, AssetImporter& assetImporter)
+            {
+                std::shared_ptr<OscillatorComponent> oscillator = std::make_shared<OscillatorComponent>();
+                oscillator->Radius = data.Values.at(0);
+                oscillator->Speed = data.Values.at(1);
+                return std::static_pointer_cast<Component>(oscillator);
+            });
+    }
+
+    void SceneSerializer::RegisterComponent(const std::string& type, ComponentSaver saver, ComponentLoader loader)
+    {
+        _componentTypes.push_back({ type, std::move(saver), std::move(loader) });
+    }
+
+    void SceneSerializer::Save(const Scene& scene, const std::string& filename, bool text) const
+    {
+        std::ofstream file(filename, text ? std::ios::out : std::ios::out | std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open scene file for writing");
+        }
+
+        FlatScene flatScene = _Flatten(scene);
+        if (text)
+        {
+            _SaveText(flatScene, file);
+        }
+        else
+        {
+            _SaveBinary(flatScene, file);
+        }
+
+        if (!file)
+        {
+            throw std::runtime_error("Could not write scene file");
+        }
+    }
+
+    void SceneSerializer::Load(Scene& scene, const std::string& filename, AssetImporter& assetImporter) const
+    {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open scene file");
+        }
+
+        char magic[sizeof(BinaryMagic)] = {};
+        file.read(magic, sizeof(magic));
+        file.clear();
+        file.seekg(0);
+
+        FlatScene flatScene = std::memcmp(magic, BinaryMagic, sizeof(BinaryMagic)) == 0 ?
+            _LoadBinary(file) :
+            _LoadText(file);
+
+        scene.SetRootSceneObject(_Build(flatScene, assetImporter));
+    }
+
+    SceneSerializer::FlatScene SceneSerializer::_Flatten(const Scene& scene) const
+    {
+        FlatScene flatScene;
+
+        // Pre-order traversal, so that parents are always stored before their children
+        std::vector<std::pair<const GameObject*, int32_t>> stack = { { scene.RootSceneObject.get(), -1 } };
+        while (!stack.empty())
+        {
+            auto [gameObject, parent] = stack.back();
+            stack.pop_back();
+
+            NodeData node = {};
+            node.Parent = parent;
+            std::memcpy(node.Position, &gameObject->Transform.Position, sizeof(node.Position));
+            std::memcpy(node.Rotation, &gameObject->Transform.Rotation, sizeof(node.Rotation));
+            std::memcpy(node.Scale, &gameObject->Transform.Scale, sizeof(node.Scale));
+            node.FirstComponent = static_cast<uint32_t>(flatScene.Components.size());
+
+            for (const std::shared_ptr<Component>& component : gameObject->Components)
+            {
+                ComponentData data;
+                for (const ComponentType& componentType : _componentTypes)
+                {
+                    if (componentType.Saver(*component, data))
+                    {
+                        data.Type = componentType.Type;
+                        break;
+                    }
+                }
+
+                if (data.Type.empty())
+                {
+                    OutputDebugStringA("Skipping component without a registered serializer\n");
+                    continue;
+                }
+
+                flatScene.Components.push_back(std::move(data));
+            }
+
+            node.ComponentCount = static_cast<uint32_t>(flatScene.Components.size()) - node.FirstComponent;
+
+            int32_t nodeIndex = static_cast<int32_t>(flatScene.Nodes.size());
+            flatScene.Nodes.push_back(node);
+
+            // Pushed in reverse so that children keep their order
+            for (auto child = gameObject->Children.rbegin(); child != gameObject->Children.rend(); ++child)
+            {
+                stack.push_back({ child->get(), nodeIndex });
+            }
+        }
+
+        return flatScene;
+    }
+
+    std::shared_ptr<GameObject> SceneSerializer::_Build(const FlatScene& flatScene, AssetImporter& assetImporter) const
+    {
+        const std::vector<NodeData>& nodes = flatScene.Nodes;
+        if (nodes.empty() || nodes[0].Parent != -1)
+        {
+            throw std::runtime_error("Scene file has no root node");
+        }
+
+        std::unordered_map<std::string, const ComponentType*> componentTypes;
+        for (const ComponentType& componentType : _componentTypes)
+        {
+            componentTypes[componentType.Type] = &componentType;
+        }
+
+        // All nodes live in one block, the shared pointers handed to the hierarchy
+        // alias it so that the block is released with the last reference to any node
+        std::shared_ptr<std::vector<GameObject>> storage = std::make_shared<std::vector<GameObject>>(nodes.size());
+
+        std::vector<uint32_t> childCounts(nodes.size(), 0);
+        for (size_t i = 1; i < nodes.size(); ++i)
+        {
+            if (nodes[i].Parent < 0 || static_cast<size_t>(nodes[i].Parent) >= i)
+            {
+                throw std::runtime_error("Scene nodes must be stored after their parent");
+            }
+            ++childCounts[nodes[i].Parent];
+        }
+
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const NodeData& node = nodes[i];
+            GameObject& gameObject = (*storage)[i];
+
+            gameObject.Transform.Position = DirectX::SimpleMath::Vector3(node.Position);
+            gameObject.Transform.Rotation = DirectX::SimpleMath::Quaternion(node.Rotation);
+            gameObject.Transform.Scale = DirectX::SimpleMath::Vector3(node.Scale);
+            gameObject.Children.reserve(childCounts[i]);
+
+            if (static_cast<size_t>(node.FirstComponent) + node.ComponentCount > flatScene.Components.size())
+            {
+                throw std::runtime_error("Scene node references missing components");
+            }
+
+            gameObject.Components.reserve(node.ComponentCount);
+            for (uint32_t c = 0; c < node.ComponentCount; ++c)
+            {
+                const ComponentData& data = flatScene.Components[node.FirstComponent + c];
+                auto componentType = componentTypes.find(data.Type);
+                if (componentType == componentTypes.end())
+                {
+                    throw std::runtime_error("Scene file references an unknown component type");
+                }
+                gameObject.AddComponent(componentType->second->Loader(data, assetImporter));
+            }
+
+            if (node.Parent >= 0)
+            {
+                (*storage)[node.Parent].AddChild(std::shared_ptr<GameObject>(storage, &gameObject));
+            }
+        }
+
+        return std::shared_ptr<GameObject>(storage, &(*storage)[0]);
+    }
+
+    void SceneSerializer::_SaveBinary(const FlatScene& flatScene, std::ofstream& file) const
+    {
+        std::vector<char> strings;
+        std::unordered_map<std::string, uint32_t> stringOffsets;
+        auto addString = [&strings, &stringOffsets](const std::string& value)
+        {
+            auto existing = stringOffsets.find(value);
+            if (existing != stringOffsets.end())
+            {
+                return existing->second;
+            }
+
+            uint32_t offset = static_cast<uint32_t>(strings.size());
+            strings.insert(strings.end(), value.begin(), value.end());
+            strings.push_back('\0');
+            stringOffsets.insert({ value, offset });
+            return offset;
+        };
+
+        std::vector<ComponentRecord> components;
+        std::vector<uint32_t> indices;
+        std::vector<float> values;
+        components.reserve(flatScene.Components.size());
+        for (const ComponentData& data : flatScene.Components)
+        {
+            ComponentRecord record = {};
+            record.Type = addString(data.Type);
+            record.Asset = addString(data.Asset);
+            record.FirstIndex = static_cast<uint32_t>(indices.size());
+            record.IndexCount = static_cast<uint32_t>(data.Indices.size());
+            record.FirstValue = static_cast<uint32_t>(values.size());
+            record.ValueCount = static_cast<uint32_t>(data.Values.size());
+            indices.insert(indices.end(), data.Indices.begin(), data.Indices.end());
+            values.insert(values.end(), data.Values.begin(), data.Values.end());
+            components.push_back(record);
+        }
+
+        FileHeader header = {};
+        std::memcpy(header.Magic, BinaryMagic, sizeof(BinaryMagic));
+        header.Version = FormatVersion;
+        header.NodeCount = static_cast<uint32_t>(flatScene.Nodes.size());
+        header.ComponentCount = static_cast<uint32_t>(components.size());
+        header.IndexCount = static_cast<uint32_t>(indices.size());
+        header.ValueCount = static_cast<uint32_t>(values.size());
+        header.StringBytes = static_cast<uint32_t>(strings.size());
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        WriteSection(file, flatScene.Nodes);
+        WriteSection(file, components);
+        WriteSection(file, indices);
+        WriteSection(file, values);
+        WriteSection(file, strings);
+    }
+
+    void SceneSerializer::_SaveText(const FlatScene& flatScene, std::ofstream& file) const
+    {
+        // Enough digits for every float to read back to the exact same value
+        file << std::setprecision(std::numeric_limits<float>::max_digits10);
+        file << TextMagic << " " << FormatVersion << "\n";
+
+        for (const NodeData& node : flatScene.Nodes)
+        {
+            file << "node " << node.Parent
+                << " " << node.Position[0] << " " << node.Position[1] << " " << node.Position[2]
+                << " " << node.Rotation[0] << " " << node.Rotation[1] << " " << node.Rotation[2] << " " << node.Rotation[3]
+                << " " << node.Scale[0] << " " << node.Scale[1] << " " << node.Scale[2] << "\n";
+
+            for (uint32_t c = 0; c < node.ComponentCount; ++c)
+            {
+                const ComponentData& data = flatScene.Components[node.FirstComponent + c];
+                file << "component " << data.Type << " " << std::quoted(data.Asset) << " " << data.Indices.size();
+                for (uint32_t index : data.Indices)
+                {
+                    file << " " << index;
+                }
+                file << " " << data.Values.size();
+                for (float value : data.Values)
+                {
+                    file << " " << value;
+                }
+                file << "\n";
+            }
+        }
+    }
+
+    SceneSerializer::FlatScene SceneSerializer::_LoadBinary(std::ifstream& file) const
+    {
+        FileHeader header = {};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        {
+            throw std::runtime_error("Scene file is truncated");
+        }
+        if (header.Version != FormatVersion)
+        {
+            throw std::runtime_error("Unsupported scene file version");
+        }
+
+        std::streampos sectionsStart = file.tellg();
+        file.seekg(0, std::ios::end);
+        uint64_t remainingBytes = static_cast<uint64_t>(file.tellg() - sectionsStart);
+        file.seekg(sectionsStart);
+
+        FlatScene flatScene;
+        std::vector<ComponentRecord> components;
+        std::vector<uint32_t> indices;
+        std::vector<float> values;
+        std::vector<char> strings;
+        ReadSection(file, flatScene.Nodes, header.NodeCount, remainingBytes);
+        ReadSection(file, components, header.ComponentCount, remainingBytes);
+        ReadSection(file, indices, header.IndexCount, remainingBytes);
+        ReadSection(file, values, header.ValueCount, remainingBytes);
+        ReadSection(file, strings, header.StringBytes, remainingBytes);
+
+        // Scenes without components reference no string and store none
+        if (!components.empty() && (strings.empty() || strings.back() != '\0'))
+        {
+            throw std::runtime_error("Scene file string section is corrupted");
+        }
+
+        auto getString = [&strings](uint32_t offset)
+        {
+            if (offset >= strings.size())
+            {
+                throw std::runtime_error("Scene file references a missing string");
+            }
+            return std::string(&strings[offset]);
+        };
+
+        flatScene.Components.resize(components.size());
+        for (size_t i = 0; i < components.size(); ++i)
+        {
+            const ComponentRecord& record = components[i];
+            if (static_cast<size_t>(record.FirstIndex) + record.IndexCount > indices.size() ||
+                static_cast<size_t>(record.FirstValue) + record.ValueCount > values.size())
+            {
+                throw std::runtime_error("Scene file component parameters are out of range");
+            }
+
+            ComponentData& data = flatScene.Components[i];
+            data.Type = getString(record.Type);
+            data.Asset = getString(record.Asset);
+            data.Indices.assign(indices.begin() + record.FirstIndex, indices.begin() + record.FirstIndex + record.IndexCount);
+            data.Values.assign(values.begin() + record.FirstValue, values.begin() + record.FirstValue + record.ValueCount);
+        }
+
+        return flatScene;
+    }
+
+    SceneSerializer::FlatScene SceneSerializer::_LoadText(std::ifstream& file) const
+    {
+        FlatScene flatScene;
+
+        std::string magic;
+        uint32_t version = 0;
+        file >> magic >> version;
+        if (magic != TextMagic || version != FormatVersion)
+        {
+            throw std::runtime_error("Unsupported scene file");
+        }
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::istringstream stream(line);
+            std::string keyword;
+            if (!(stream >> keyword) || keyword[0] == '#')
+            {
+                continue;
+            }
+
+            if (keyword == "node")
+            {
+                NodeData node = {};
+                stream >> node.Parent
+                    >> node.Position[0] >> node.Position[1] >> node.Position[2]
+                    >> node.Rotation[0] >> node.Rotation[1] >> node.Rotation[2] >> node.Rotation[3]
+                    >> node.Scale[0] >> node.Scale[1] >> node.Scale[2];
+                node.FirstComponent = static_cast<uint32_t>(flatScene.Components.size());
+                flatScene.Nodes.push_back(node);
+            }
+            else if (keyword == "component")
+            {
+                if (flatScene.Nodes.empty())
+                {
+                    throw std::runtime_error("Scene file component declared before any node");
+                }
+
+                // Counts are only trusted as far as the line holds the values,
+                // which it must hold exactly
+                ComponentData data;
+                size_t count = 0;
+                stream >> data.Type >> std::quoted(data.Asset) >> count;
+                uint32_t index;
+                for (size_t i = 0; i < count && stream >> index; ++i)
+                {
+                    data.Indices.push_back(index);
+                }
+                stream >> count;
+                float value;
+                for (size_t i = 0; i < count && stream >> value; ++i)
+                {
+                    data.Values.push_back(value);
+                }
+                if (!stream.fail() && !stream.eof() && !(stream >> std::ws).eof())
+                {
+                    throw std::runtime_error("Malformed line in scene file");
+                }
+
+                flatScene.Components.push_back(std::move(data));
+                ++flatScene.Nodes.back().ComponentCount;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown keyword in scene file");
+            }
+
+            if (stream.fail())
+            {
+                throw std::runtime_error("Malformed line in scene file");
+            }
+        }
+
+        return flatScene;
+    }
+}
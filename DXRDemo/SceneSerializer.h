@@ -0,0 +1,80 @@
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Scene.h"
+#include "AssetImporter.h"
+
+namespace DXRDemo
+{
+    // Saves and restores whole scene graphs: hierarchy, transforms, components with
+    // their parameters and asset references. Scenes are stored either in a compact
+    // binary encoding, read back with one bulk read per section, or in a line based
+    // text encoding meant for hand editing. Load detects the encoding on its own.
+    //
+    // Nodes are stored in pre-order, each one referencing its parent by index, so a
+    // scene is rebuilt in a single linear pass with all GameObjects constructed in
+    // one contiguous block.
+    class SceneSerializer final
+    {
+    public:
+        // Serialized parameters of a component. Each component type decides how its
+        // parameters map to an asset reference, a list of indices and a list of values.
+        struct ComponentData
+        {
+            std::string Type;
+            std::string Asset;
+            std::vector<uint32_t> Indices;
+            std::vector<float> Values;
+        };
+
+        // Fills the data of a component, returning false if the component is not of
+        // the type handled by the saver
+        using ComponentSaver = std::function<bool(const Component&, ComponentData&)>;
+        using ComponentLoader = std::function<std::shared_ptr<Component>(const ComponentData&, AssetImporter&)>;
+
+        SceneSerializer();
+
+        void RegisterComponent(const std::string& type, ComponentSaver saver, ComponentLoader loader);
+
+        void Save(const Scene& scene, const std::string& filename, bool text = false) const;
+        void Load(Scene& scene, const std::string& filename, AssetImporter& assetImporter) const;
+
+    private:
+        struct NodeData
+        {
+            int32_t Parent;
+            float Position[3];
+            float Rotation[4];
+            float Scale[3];
+            uint32_t FirstComponent;
+            uint32_t ComponentCount;
+        };
+
+        struct FlatScene
+        {
+            std::vector<NodeData> Nodes;
+            std::vector<ComponentData> Components;
+        };
+
+        struct ComponentType
+        {
+            std::string Type;
+            ComponentSaver Saver;
+            ComponentLoader Loader;
+        };
+
+        std::vector<ComponentType> _componentTypes;
+
+        FlatScene _Flatten(const Scene& scene) const;
+        std::shared_ptr<GameObject> _Build(const FlatScene& flatScene, AssetImporter& assetImporter) const;
+
+        void _SaveBinary(const FlatScene& flatScene, std::ofstream& file) const;
+        void _SaveText(const FlatScene& flatScene, std::ofstream& file) const;
+        FlatScene _LoadBinary(std::ifstream& file) const;
+        FlatScene _LoadText(std::ifstream& file) const;
+    };
+}
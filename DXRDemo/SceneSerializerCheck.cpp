@@ -0,0 +1,236 @@
+#include "SceneSerializerCheck.h"
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "AssetImporter.h"
+#include "OscillatorComponent.h"
+#include "Scene.h"
+#include "SceneSerializer.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        const uint32_t ChildCount = 8;
+        const uint32_t GrandchildCount = 4;
+
+        struct Result
+        {
+            std::string Scene;
+            std::string Encoding;
+            uint64_t Nodes = 0;
+            uint64_t Components = 0;
+            uint64_t FileBytes = 0;
+            bool Passed = false;
+        };
+
+        std::shared_ptr<GameObject> CreateNode(std::mt19937& random, bool withComponents, uint32_t index)
+        {
+            std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+            std::uniform_real_distribution<float> scale(0.1f, 2.0f);
+
+            std::shared_ptr<GameObject> gameObject = std::make_shared<GameObject>();
+            gameObject->Transform.Position = { position(random), position(random), position(random) };
+            gameObject->Transform.Scale = { scale(random), scale(random), scale(random) };
+            gameObject->Transform.Rotation = DirectX::SimpleMath::Quaternion::CreateFromYawPitchRoll(
+                position(random), position(random), position(random));
+
+            if (withComponents && index % 2 == 0)
+            {
+                std::shared_ptr<OscillatorComponent> oscillator = std::make_shared<OscillatorComponent>();
+                oscillator->Radius = scale(random);
+                oscillator->Speed = position(random);
+                gameObject->AddComponent(oscillator);
+            }
+            return gameObject;
+        }
+
+        std::shared_ptr<GameObject> CreateHierarchy(bool withComponents)
+        {
+            std::mt19937 random(1);
+            uint32_t index = 0;
+            std::shared_ptr<GameObject> root = CreateNode(random, withComponents, index++);
+            for (uint32_t c = 0; c < ChildCount; ++c)
+            {
+                std::shared_ptr<GameObject> child = CreateNode(random, withComponents, index++);
+                for (uint32_t g = 0; g < GrandchildCount; ++g)
+                {
+                    child->AddChild(CreateNode(random, withComponents, index++));
+                }
+                root->AddChild(child);
+            }
+            return root;
+        }
+
+        void Count(const GameObject& gameObject, Result& result)
+        {
+            ++result.Nodes;
+            result.Components += gameObject.Components.size();
+            for (const std::shared_ptr<GameObject>& child : gameObject.Children)
+            {
+                Count(*child, result);
+            }
+        }
+
+        bool SameHierarchy(const GameObject& expected, const GameObject& loaded)
+        {
+            const Transform& a = expected.Transform;
+            const Transform& b = loaded.Transform;
+            if (a.Position != b.Position || a.Scale != b.Scale || a.Rotation != b.Rotation ||
+                expected.Components.size() != loaded.Components.size() ||
+                expected.Children.size() != loaded.Children.size())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < expected.Components.size(); ++i)
+            {
+                const OscillatorComponent* expectedOscillator = dynamic_cast<const OscillatorComponent*>(expected.Components[i].get());
+                const OscillatorComponent* loadedOscillator = dynamic_cast<const OscillatorComponent*>(loaded.Components[i].get());
+                if (expectedOscillator == nullptr || loadedOscillator == nullptr ||
+                    expectedOscillator->Radius != loadedOscillator->Radius ||
+                    expectedOscillator->Speed != loadedOscillator->Speed ||
+                    loadedOscillator->Parent != &loaded)
+                {
+                    return false;
+                }
+            }
+
+            for (size_t i = 0; i < expected.Children.size(); ++i)
+            {
+                if (loaded.Children[i]->Parent != &loaded || !SameHierarchy(*expected.Children[i], *loaded.Children[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        Result RoundTrip(const std::string& name, bool withComponents, bool text)
+        {
+            Result result;
+            result.Scene = name;
+            result.Encoding = text ? "text" : "binary";
+
+            Scene scene;
+            scene.SetRootSceneObject(CreateHierarchy(withComponents));
+            Count(*scene.RootSceneObject, result);
+
+            std::filesystem::path path = std::filesystem::temp_directory_path() /
+                ("DXRDemoSceneCheck" + std::string(text ? ".txt" : ".dxrs"));
+
+            try
+            {
+                SceneSerializer serializer;
+                serializer.Save(scene, path.string(), text);
+                result.FileBytes = std::filesystem::file_size(path);
+
+                Scene loaded;
+                AssetImporter assetImporter;
+                serializer.Load(loaded, path.string(), assetImporter);
+                result.Passed = SameHierarchy(*scene.RootSceneObject, *loaded.RootSceneObject);
+                if (!result.Passed)
+                {
+                    std::cerr << name << " (" << result.Encoding << "): the loaded scene differs from the saved one" << std::endl;
+                }
+            }
+            catch (const std::exception& exception)
+            {
+                std::cerr << name << " (" << result.Encoding << "): " << exception.what() << std::endl;
+            }
+
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            return result;
+        }
+
+        // Loads a damaged file, which must be refused with the loader's own error
+        // rather than an allocation failure
+        Result LoadCorrupted(const std::string& name, bool text, const std::string& contents)
+        {
+            Result result;
+            result.Scene = name;
+            result.Encoding = text ? "text" : "binary";
+            result.FileBytes = contents.size();
+
+            std::filesystem::path path = std::filesystem::temp_directory_path() /
+                ("DXRDemoSceneCheckCorrupted" + std::string(text ? ".txt" : ".dxrs"));
+            {
+                std::ofstream file(path, std::ios::out | std::ios::binary);
+                file.write(contents.data(), contents.size());
+            }
+
+            try
+            {
+                Scene loaded;
+                AssetImporter assetImporter;
+                SceneSerializer().Load(loaded, path.string(), assetImporter);
+                std::cerr << name << " (" << result.Encoding << "): the damaged file was loaded" << std::endl;
+            }
+            catch (const std::runtime_error&)
+            {
+                result.Passed = true;
+            }
+            catch (const std::exception& exception)
+            {
+                std::cerr << name << " (" << result.Encoding << "): " << exception.what() << std::endl;
+            }
+
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            return result;
+        }
+
+        // Binary header claiming far more nodes than the file holds
+        std::string CreateOversizedBinary()
+        {
+            const uint32_t header[] = { 1, 0xFFFFFFFF, 0, 0, 0, 0 };
+            std::string contents = "DXRS";
+            contents.append(reinterpret_cast<const char*>(header), sizeof(header));
+            return contents;
+        }
+    }
+
+    bool RunSceneSerializerCheck(const std::string& filename)
+    {
+        std::ofstream output(filename);
+        if (!output)
+        {
+            throw std::runtime_error("Could not open " + filename);
+        }
+
+        std::vector<Result> results;
+        for (bool text : { false, true })
+        {
+            // Nothing references a string, the binary string section is empty
+            results.push_back(RoundTrip("without components", false, text));
+            results.push_back(RoundTrip("with components", true, text));
+        }
+
+        const std::string textNode = "dxrscene 1\nnode -1 0 0 0 0 0 0 1 1 1 1\n";
+        results.push_back(LoadCorrupted("oversized count", false, CreateOversizedBinary()));
+        results.push_back(LoadCorrupted("oversized count", true, textNode + "component OscillatorComponent \"\" 4294967295 0\n"));
+        results.push_back(LoadCorrupted("extra values", true, textNode + "component OscillatorComponent \"\" 0 2 0.5 2 3\n"));
+
+        bool passed = true;
+        output << "scene,encoding,nodes,components,file_bytes,passed\n";
+        for (const Result& result : results)
+        {
+            output << result.Scene << ","
+                << result.Encoding << ","
+                << result.Nodes << ","
+                << result.Components << ","
+                << result.FileBytes << ","
+                << (result.Passed ? 1 : 0) << "\n";
+            passed = passed && result.Passed;
+        }
+
+        return passed;
+    }
+}
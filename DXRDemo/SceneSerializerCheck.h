@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    // Saves synthetic scenes in both encodings and loads them back, one without
+    // any component, so with an empty string section, and one with components
+    // on most nodes, then loads damaged files whose counts do not match what
+    // they hold. Writes the file size and outcome of each as CSV. Returns
+    // whether every scene came back with the same hierarchy, transforms and
+    // component parameters, and every damaged file was refused.
+    bool RunSceneSerializerCheck(const std::string& filename);
+}
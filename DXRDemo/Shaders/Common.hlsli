@@ -10,6 +10,7 @@ struct Settings
     float lightIntensity;
     bool importanceSamplingEnabled;
     float importanceSamplingPercentage;
+    int seed;
 };
 
 struct VertexData
@@ -20,12 +21,26 @@ struct VertexData
     float3 Emission : EMISSION;
 };
 
+// Range of a mesh in the geometry pool, its indices relative to its first vertex
+struct GeometryData
+{
+    uint FirstVertex;
+    uint VertexCount;
+    uint FirstIndex;
+    uint IndexCount;
+};
+
 struct HitInfo
 {
   float3 Li;
   float Distance;
   uint Depth;
   uint Sample;
+  // Denoiser features of the first surface hit, only written by camera rays
+  float3 Albedo;
+  float3 Normal;
+  // Acceleration structure instance of the first surface hit plus one, 0 on a miss
+  uint Instance;
 };
 
 struct ShadowHitInfo
@@ -1,8 +1,10 @@
 #include "Common.hlsli"
 #include "RandomNumberGenerator.hlsli"
 
+// Every mesh of the scene, found through the geometry index of the instance
 StructuredBuffer<VertexData> vertices : register(t0);
 StructuredBuffer<int> indices : register(t1);
+StructuredBuffer<GeometryData> geometries : register(t3);
 ConstantBuffer<Settings> settings : register(b0);
 RaytracingAccelerationStructure SceneBVH : register(t2);
 
@@ -91,13 +93,15 @@ void ClosestHit(inout HitInfo payload, Attributes attrib)
     float lightDistance = length(lightPos - worldHit);
     
     float3 barycentrics = float3(1 - attrib.bary.x - attrib.bary.y, attrib.bary.x, attrib.bary.y);
-    uint vertId = 3 * PrimitiveIndex();
+    // Instances are given the geometry index of their mesh as ID
+    GeometryData geometry = geometries[InstanceID() + GeometryIndex()];
+    uint vertId = geometry.FirstIndex + 3 * PrimitiveIndex();
     
     VertexData vertexHitData[3] =
     {
-        vertices[indices[vertId + 0]],
-            vertices[indices[vertId + 1]],
-            vertices[indices[vertId + 2]]
+        vertices[geometry.FirstVertex + indices[vertId + 0]],
+            vertices[geometry.FirstVertex + indices[vertId + 1]],
+            vertices[geometry.FirstVertex + indices[vertId + 2]]
     };
     
     float3 hitColor = vertexHitData[0].Color.rgb * barycentrics.x +
@@ -113,6 +117,17 @@ void ClosestHit(inout HitInfo payload, Attributes attrib)
                            vertexHitData[2].Emission.rgb * barycentrics.z;
     
     payload.Li = hitEmissive * settings.lightIntensity;
+
+    if (payload.Depth == 0)
+    {
+        payload.Albedo = saturate(hitColor);
+        // Normals go through the inverse transpose of the object to world
+        // transform, which WorldToObject3x4 is laid out as for a row vector
+        payload.Normal = normalize(mul(hitNormal, (float3x3) WorldToObject3x4()));
+        // Lets the temporal accumulation reproject the surface
+        payload.Distance = RayTCurrent();
+        payload.Instance = InstanceIndex() + 1;
+    }
     
     if (length(payload.Li) > 0)
     {
@@ -127,7 +142,8 @@ void ClosestHit(inout HitInfo payload, Attributes attrib)
     uint seed = ((((payload.Depth * settings.bounces)
         + payload.Sample) * settings.samples
         + DispatchRaysIndex().x) * DispatchRaysDimensions().x
-        + DispatchRaysIndex().y) * DispatchRaysDimensions().y;
+        + DispatchRaysIndex().y) * DispatchRaysDimensions().y
+        + settings.seed * 0x9E3779B9;
         
     float random = RNG::Random01(seed);
     seed += 1;
@@ -12,5 +12,8 @@ void Miss(inout HitInfo payload : SV_RayPayload)
 {
     payload.Li = payload.Depth > 0 ? 0 : ClearColorCB.Color.rgb;
     payload.Distance = -1.f;
+    payload.Albedo = ClearColorCB.Color.rgb;
+    payload.Normal = 0;
+    payload.Instance = 0;
 
 }
\ No newline at end of file
@@ -14,6 +14,15 @@ ConstantBuffer<Settings> settings : register(b2);
 // Raytracing output texture, accessed as a UAV
 RWTexture2D<float4> gOutput : register(u0);
 
+// Denoiser features of the first surface hit
+RWTexture2D<float4> gAlbedo : register(u1);
+RWTexture2D<float4> gNormal : register(u2);
+
+// Instance and hit distance of the first surface hit, in full precision for
+// the temporal accumulation
+RWTexture2D<uint> gInstance : register(u3);
+RWTexture2D<float> gDistance : register(u4);
+
 // Raytracing acceleration structure, accessed as a SRV
 RaytracingAccelerationStructure SceneBVH : register(t0);
 
@@ -47,6 +56,8 @@ void RayGen()
     int depth = 0;
     
     double3 Li = (float3) 0;
+    float3 albedo = 0;
+    float3 normal = 0;
     
     for (uint i = 0; i < settings.samples; ++i)
     {
@@ -62,8 +73,16 @@ void RayGen()
         ray,
         payload);
         Li += payload.Li;
+        albedo += payload.Albedo;
+        normal += payload.Normal;
     }
     Li /= settings.samples;
     
     gOutput[launchIndex] = float4(Li, 1.f);
+    gAlbedo[launchIndex] = float4(albedo / settings.samples, 1.f);
+    gNormal[launchIndex] = float4(normal / settings.samples, 0.f);
+    // Every sample follows the same camera ray, so the first hit is the same for
+    // all of them
+    gInstance[launchIndex] = payload.Instance;
+    gDistance[launchIndex] = payload.Distance;
 }
@@ -0,0 +1,41 @@
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+// Matches DXRDemo::TonemapOperator
+static const int TONEMAP_CLAMP = 0;
+static const int TONEMAP_REINHARD = 1;
+static const int TONEMAP_ACES = 2;
+
+struct TonemapSettings
+{
+    float exposure;
+    int tonemapOperator;
+};
+
+// Fitted ACES filmic curve (Narkowicz 2015)
+float3 TonemapAces(float3 color)
+{
+    const float a = 2.51f;
+    const float b = 0.03f;
+    const float c = 2.43f;
+    const float d = 0.59f;
+    const float e = 0.14f;
+    return saturate((color * (a * color + b)) / (color * (c * color + d) + e));
+}
+
+float3 Tonemap(float3 radiance, TonemapSettings settings)
+{
+    float3 color = max(radiance * settings.exposure, 0);
+
+    if (settings.tonemapOperator == TONEMAP_REINHARD)
+    {
+        return color / (1 + color);
+    }
+    if (settings.tonemapOperator == TONEMAP_ACES)
+    {
+        return TonemapAces(color);
+    }
+    return saturate(color);
+}
+
+#endif // TONEMAP_H
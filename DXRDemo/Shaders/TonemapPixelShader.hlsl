@@ -0,0 +1,12 @@
+#include "Tonemap.hlsli"
+
+ConstantBuffer<TonemapSettings> tonemapSettings : register(b0);
+
+// HDR radiance written by the ray tracing pass and the denoiser
+Texture2D<float4> radiance : register(t0);
+
+float4 main(float4 position : SV_Position) : SV_Target
+{
+    float3 color = radiance.Load(int3(position.xy, 0)).rgb;
+    return float4(Tonemap(color, tonemapSettings), 1);
+}
@@ -0,0 +1,6 @@
+// Full screen triangle, no vertex buffer needed
+float4 main(uint vertexId : SV_VertexID) : SV_Position
+{
+    float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+    return float4(uv * float2(2, -2) + float2(-1, 1), 0, 1);
+}
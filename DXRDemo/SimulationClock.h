@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+namespace DXRDemo
+{
+    // Turns variable frame times into a whole number of fixed simulation steps.
+    // The time left over after the last step is kept for the next frame and
+    // exposed as an interpolation factor, so rendering can blend between the last
+    // two simulated states. Given the same sequence of frame times the same steps
+    // and factors come out, whatever the actual frame timing was.
+    class SimulationClock final
+    {
+    public:
+        explicit SimulationClock(double fixedDeltaTime = 1.0 / 60.0, uint32_t maxStepsPerFrame = 8) :
+            _fixedDeltaTime(fixedDeltaTime),
+            _maxStepsPerFrame(maxStepsPerFrame)
+        {
+        }
+
+        // Accumulates the time of a frame and returns how many fixed steps to run
+        inline uint32_t Advance(double frameDeltaTime)
+        {
+            _accumulator += frameDeltaTime;
+
+            uint32_t steps = 0;
+            while (_accumulator >= _fixedDeltaTime && steps < _maxStepsPerFrame)
+            {
+                _accumulator -= _fixedDeltaTime;
+                ++steps;
+            }
+
+            // After a long stall, drop the time that could not be simulated rather
+            // than trying to catch up over the next frames
+            if (steps == _maxStepsPerFrame && _accumulator >= _fixedDeltaTime)
+            {
+                _accumulator = 0.0;
+            }
+
+            _stepCount += steps;
+            return steps;
+        }
+
+        inline double GetFixedDeltaTime() const
+        {
+            return _fixedDeltaTime;
+        }
+
+        // Fraction of a step elapsed since the last simulated state, in [0, 1)
+        inline float GetInterpolationFactor() const
+        {
+            return static_cast<float>(_accumulator / _fixedDeltaTime);
+        }
+
+        inline uint64_t GetStepCount() const
+        {
+            return _stepCount;
+        }
+
+    private:
+        double _fixedDeltaTime;
+        uint32_t _maxStepsPerFrame;
+        double _accumulator = 0.0;
+        uint64_t _stepCount = 0;
+    };
+}
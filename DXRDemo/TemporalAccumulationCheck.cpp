@@ -0,0 +1,243 @@
+#include "TemporalAccumulationCheck.h"
+
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "TemporalAccumulator.h"
+#include "ThreadPool.h"
+
+using namespace DirectX;
+
+namespace DXRDemo
+{
+    namespace
+    {
+        const size_t Width = 320;
+        const size_t Height = 240;
+        const int FrameCount = 40;
+        // Frame dropping the history, as a settings change would
+        const int ResetFrame = 30;
+
+        // Walls and quad of the sequence. The sequence runs once with them as the
+        // only instances, and once as the last of a scene with more instances than
+        // a half float counts exactly.
+        const float WallZ = 100.0f;
+        const float QuadZ = 0.0f;
+        const float QuadHalfSize = 40.0f;
+        const uint32_t LargeSceneInstanceCount = 4096;
+
+        struct TestScene
+        {
+            uint32_t InstanceCount;
+            uint32_t WallInstance;
+            uint32_t QuadInstance;
+        };
+
+        struct TestFrame
+        {
+            std::vector<float> Color;
+            std::vector<float> Normal;
+            // Instance plus one and hit distance, as RayGen.hlsl writes them
+            std::vector<uint32_t> Instance;
+            std::vector<float> Distance;
+            std::vector<float> Reference;
+            std::vector<bool> QuadHit;
+        };
+
+        float QuadOffset(int frame)
+        {
+            return -60.0f + 3.0f * frame;
+        }
+
+        XMMATRIX ViewMatrix(int frame)
+        {
+            float cameraX = 0.5f * frame;
+            return XMMatrixLookAtLH(XMVectorSet(cameraX, 0, -250, 1), XMVectorSet(cameraX, 0, 0, 1), XMVectorSet(0, 1, 0, 0));
+        }
+
+        // Traces the camera rays of a frame the way RayGen.hlsl does and shades the
+        // hits with a noisy estimate of their radiance
+        TestFrame TraceFrame(const TestScene& scene, int frame, const XMFLOAT4X4& inverseView, const XMFLOAT4X4& inverseProjection,
+            std::mt19937& generator)
+        {
+            TestFrame result;
+            result.Color.resize(Width * Height * 4);
+            result.Normal.resize(Width * Height * 4);
+            result.Instance.resize(Width * Height);
+            result.Distance.resize(Width * Height);
+            result.Reference.resize(Width * Height * 3);
+            result.QuadHit.resize(Width * Height);
+
+            std::exponential_distribution<float> noise(1.0f);
+            float quadOffset = QuadOffset(frame);
+
+            for (size_t y = 0; y < Height; ++y)
+            {
+                for (size_t x = 0; x < Width; ++x)
+                {
+                    float ndcX = ((x + 0.5f) / Width) * 2.0f - 1.0f;
+                    float ndcY = ((y + 0.5f) / Height) * 2.0f - 1.0f;
+                    float target[3];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        target[c] = ndcX * inverseProjection.m[0][c] - ndcY * inverseProjection.m[1][c] +
+                            inverseProjection.m[2][c] + inverseProjection.m[3][c];
+                    }
+                    float origin[3];
+                    float direction[3];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        origin[c] = inverseView.m[3][c];
+                        direction[c] = target[0] * inverseView.m[0][c] + target[1] * inverseView.m[1][c] + target[2] * inverseView.m[2][c];
+                    }
+
+                    // The quad is in front of the wall
+                    float distance = (QuadZ - origin[2]) / direction[2];
+                    float hitX = origin[0] + distance * direction[0];
+                    float hitY = origin[1] + distance * direction[1];
+                    bool quadHit = std::abs(hitX - quadOffset) <= QuadHalfSize && std::abs(hitY) <= QuadHalfSize;
+                    if (!quadHit)
+                    {
+                        distance = (WallZ - origin[2]) / direction[2];
+                        hitX = origin[0] + distance * direction[0];
+                        hitY = origin[1] + distance * direction[1];
+                    }
+
+                    // Checkers on the wall, a gradient moving along with the quad
+                    float radiance[3];
+                    if (quadHit)
+                    {
+                        float u = (hitX - quadOffset + QuadHalfSize) / (2 * QuadHalfSize);
+                        radiance[0] = 2.0f * u;
+                        radiance[1] = 1.0f;
+                        radiance[2] = 0.5f;
+                    }
+                    else
+                    {
+                        bool dark = ((static_cast<int>(std::floor(hitX / 25.0f)) + static_cast<int>(std::floor(hitY / 25.0f))) & 1) != 0;
+                        radiance[0] = radiance[1] = radiance[2] = dark ? 0.2f : 1.0f;
+                    }
+
+                    size_t pixel = y * Width + x;
+                    float sample = noise(generator);
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        result.Color[pixel * 4 + c] = radiance[c] * sample;
+                        result.Reference[pixel * 3 + c] = radiance[c];
+                    }
+                    result.Color[pixel * 4 + 3] = 1.0f;
+                    result.Normal[pixel * 4 + 2] = -1.0f;
+                    result.Instance[pixel] = (quadHit ? scene.QuadInstance : scene.WallInstance) + 1;
+                    result.Distance[pixel] = distance;
+                    result.QuadHit[pixel] = quadHit;
+                }
+            }
+            return result;
+        }
+
+        // Over the pixels showing the quad only when quadOnly is set
+        double RelativeRmse(const TestFrame& frame, const std::vector<float>& image, bool quadOnly)
+        {
+            const std::vector<float>& reference = frame.Reference;
+            double squaredError = 0;
+            double squaredReference = 0;
+            for (size_t pixel = 0; pixel < Width * Height; ++pixel)
+            {
+                if (quadOnly && !frame.QuadHit[pixel])
+                {
+                    continue;
+                }
+                for (int c = 0; c < 3; ++c)
+                {
+                    double error = static_cast<double>(image[pixel * 4 + c]) - reference[pixel * 3 + c];
+                    squaredError += error * error;
+                    squaredReference += static_cast<double>(reference[pixel * 3 + c]) * reference[pixel * 3 + c];
+                }
+            }
+            return squaredReference > 0 ? std::sqrt(squaredError / squaredReference) : 0;
+        }
+
+        bool RunSequence(const TestScene& scene, std::ofstream& file, ThreadPool& threadPool)
+        {
+            TemporalAccumulator accumulator(threadPool);
+            std::mt19937 generator(0);
+
+            XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), static_cast<float>(Width) / Height, 0.1f, 10000.0f);
+            XMMATRIX previousQuadTransform = XMMatrixTranslation(QuadOffset(0), 0, 0);
+
+            bool passed = true;
+            for (int frame = 0; frame < FrameCount; ++frame)
+            {
+                XMMATRIX view = ViewMatrix(frame);
+                XMMATRIX quadTransform = XMMatrixTranslation(QuadOffset(frame), 0, 0);
+
+                // Only the quad moves, every other instance stays in place
+                TemporalAccumulator::Frame temporalFrame;
+                XMStoreFloat4x4(&temporalFrame.InverseView, XMMatrixInverse(nullptr, view));
+                XMStoreFloat4x4(&temporalFrame.InverseProjection, XMMatrixInverse(nullptr, projection));
+                XMStoreFloat4x4(&temporalFrame.ViewProjection, XMMatrixMultiply(view, projection));
+                TemporalAccumulator::InstanceMotion& quadMotion = temporalFrame.MovedInstances.emplace_back();
+                quadMotion.Instance = scene.QuadInstance;
+                XMStoreFloat4x4(&quadMotion.Motion, XMMatrixMultiply(XMMatrixInverse(nullptr, quadTransform), previousQuadTransform));
+                temporalFrame.ResetHistory = frame == ResetFrame;
+                previousQuadTransform = quadTransform;
+
+                TestFrame testFrame = TraceFrame(scene, frame, temporalFrame.InverseView, temporalFrame.InverseProjection, generator);
+                double inputError = RelativeRmse(testFrame, testFrame.Color, false);
+                double quadInputError = RelativeRmse(testFrame, testFrame.Color, true);
+
+                size_t rowPitch = Width * 4 * sizeof(float);
+                size_t surfaceRowPitch = Width * sizeof(uint32_t);
+                accumulator.Accumulate(Width, Height, DXGI_FORMAT_R32G32B32A32_FLOAT, testFrame.Color.data(),
+                    testFrame.Normal.data(), rowPitch, testFrame.Instance.data(), testFrame.Distance.data(),
+                    surfaceRowPitch, temporalFrame);
+                double outputError = RelativeRmse(testFrame, testFrame.Color, false);
+                double quadOutputError = RelativeRmse(testFrame, testFrame.Color, true);
+                float reprojectedFraction = accumulator.GetReprojectedFraction();
+
+                // The camera and quad only move a few pixels per frame, almost all of
+                // the image must be reprojected, and enough frames must have been
+                // averaged by the end to bring the noise down well below a single
+                // frame's. The quad only keeps its history when its motion is looked
+                // up with its exact instance, and only averages as many frames as
+                // the walls when that motion is applied.
+                if (frame == 0 || frame == ResetFrame)
+                {
+                    passed = passed && reprojectedFraction == 0;
+                }
+                else
+                {
+                    passed = passed && reprojectedFraction > 0.9f;
+                }
+                if (frame == ResetFrame - 1 || frame == FrameCount - 1)
+                {
+                    passed = passed && outputError < 0.5 * inputError && quadOutputError < 0.35 * quadInputError;
+                }
+
+                file << scene.InstanceCount << "," << frame << "," << reprojectedFraction << ","
+                    << inputError << "," << outputError << "," << quadInputError << "," << quadOutputError << "\n";
+            }
+
+            return passed;
+        }
+    }
+
+    bool RunTemporalAccumulationCheck(const std::string& filename, ThreadPool& threadPool)
+    {
+        std::ofstream file(filename);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open check file for writing");
+        }
+
+        file << "instances,frame,reprojected_fraction,input_relative_rmse,output_relative_rmse,"
+            "quad_input_relative_rmse,quad_output_relative_rmse\n";
+
+        bool passed = RunSequence({ 2, 0, 1 }, file, threadPool);
+        // Neighbouring instances past 2048, which would merge in a half float
+        passed = RunSequence({ LargeSceneInstanceCount, LargeSceneInstanceCount - 2, LargeSceneInstanceCount - 1 }, file, threadPool) && passed;
+        return passed;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    class ThreadPool;
+
+    // Accumulates a synthetic sequence, a quad sliding in front of a textured wall
+    // filmed by a panning camera, and writes the reprojected fraction and error of
+    // every frame as CSV. The sequence runs alone and as the last instances of a
+    // scene of 4096. Returns whether the accumulation reused history for most of
+    // the image, reduced the noise on the quad as well as overall and dropped the
+    // history when asked to.
+    bool RunTemporalAccumulationCheck(const std::string& filename, ThreadPool& threadPool);
+}
@@ -0,0 +1,310 @@
+#include "TemporalAccumulator.h"
+
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "PixelConversion.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // RGBA pixels of a readback row as floats
+        void LoadPixels(const uint8_t* source, DXGI_FORMAT format, float* destination, std::size_t pixelCount)
+        {
+            if (format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+            {
+                std::memcpy(destination, source, pixelCount * 4 * sizeof(float));
+                return;
+            }
+
+            PixelConversion::Rgba16fToRgba32f(reinterpret_cast<const uint16_t*>(source), destination, pixelCount);
+        }
+
+        // Writes the color of a pixel, keeping its alpha
+        void StoreColor(const float color[3], DXGI_FORMAT format, uint8_t* destination)
+        {
+            if (format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+            {
+                std::memcpy(destination, color, 3 * sizeof(float));
+                return;
+            }
+
+            uint16_t* halves = reinterpret_cast<uint16_t*>(destination);
+            for (int c = 0; c < 3; ++c)
+            {
+                halves[c] = DirectX::PackedVector::XMConvertFloatToHalf(color[c]);
+            }
+        }
+
+        // Row vector times matrix, as XMVector4Transform
+        void TransformPoint(const float point[3], const DirectX::XMFLOAT4X4& matrix, float result[4])
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                result[j] = point[0] * matrix.m[0][j] + point[1] * matrix.m[1][j] + point[2] * matrix.m[2][j] + matrix.m[3][j];
+            }
+        }
+
+        void TransformDirection(const float direction[3], const DirectX::XMFLOAT4X4& matrix, float result[3])
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                result[j] = direction[0] * matrix.m[0][j] + direction[1] * matrix.m[1][j] + direction[2] * matrix.m[2][j];
+            }
+        }
+    }
+
+    TemporalAccumulator::TemporalAccumulator(ThreadPool& threadPool, const TemporalAccumulation& settings) :
+        _threadPool(&threadPool),
+        _settings(settings)
+    {
+        if (_settings.MinAlpha <= 0 || _settings.MinAlpha > 1)
+        {
+            throw std::invalid_argument("The temporal accumulation weight must be in (0, 1]");
+        }
+    }
+
+    void TemporalAccumulator::Accumulate(std::size_t width, std::size_t height, DXGI_FORMAT format, void* image,
+        const void* normal, std::size_t rowPitch, const void* instances, const void* distances,
+        std::size_t surfaceRowPitch, const Frame& frame)
+    {
+        if (format != DXGI_FORMAT_R16G16B16A16_FLOAT && format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+        {
+            throw std::invalid_argument("Unsupported temporal accumulation image format");
+        }
+
+        if (width != _width || height != _height)
+        {
+            _width = width;
+            _height = height;
+            _history.resize(width * height);
+            _nextHistory.resize(width * height);
+            _hasHistory = false;
+        }
+
+        if (frame.ResetHistory)
+        {
+            _hasHistory = false;
+        }
+
+        // Where the pixels find the motion of their instance, the previous
+        // frame's entries cleared first
+        for (uint32_t instance : _movedInstances)
+        {
+            _motionIndices[instance] = NoMotion;
+        }
+        _movedInstances.clear();
+        for (std::size_t i = 0; i < frame.MovedInstances.size(); ++i)
+        {
+            uint32_t instance = frame.MovedInstances[i].Instance;
+            if (instance >= _motionIndices.size())
+            {
+                _motionIndices.resize(instance + std::size_t(1), NoMotion);
+            }
+            _motionIndices[instance] = static_cast<uint32_t>(i);
+            _movedInstances.push_back(instance);
+        }
+
+        // Camera rays as RayGen.hlsl traces them. Their directions are not normalized
+        // and linear in the pixel position, hit distances are in their length.
+        const DirectX::XMFLOAT4X4& inverseProjection = frame.InverseProjection;
+        float origin[3] = { frame.InverseView._41, frame.InverseView._42, frame.InverseView._43 };
+        float projectedX[3] = { inverseProjection._11, inverseProjection._12, inverseProjection._13 };
+        float projectedY[3] = { -inverseProjection._21, -inverseProjection._22, -inverseProjection._23 };
+        float projectedBase[3] = {
+            inverseProjection._31 + inverseProjection._41,
+            inverseProjection._32 + inverseProjection._42,
+            inverseProjection._33 + inverseProjection._43 };
+        float directionX[3], directionY[3], directionBase[3];
+        TransformDirection(projectedX, frame.InverseView, directionX);
+        TransformDirection(projectedY, frame.InverseView, directionY);
+        TransformDirection(projectedBase, frame.InverseView, directionBase);
+
+        std::atomic<std::size_t> reprojectedPixels = 0;
+
+        _threadPool->ParallelFor(height, 16, [&](std::size_t begin, std::size_t end)
+        {
+            std::vector<float> colors(width * 4);
+            std::vector<float> normals(width * 4);
+            std::size_t reprojected = 0;
+
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                uint8_t* imageRow = static_cast<uint8_t*>(image) + y * rowPitch;
+                LoadPixels(imageRow, format, colors.data(), width);
+                LoadPixels(static_cast<const uint8_t*>(normal) + y * rowPitch, format, normals.data(), width);
+                const uint32_t* instanceRow = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(instances) + y * surfaceRowPitch);
+                const float* distanceRow = reinterpret_cast<const float*>(static_cast<const uint8_t*>(distances) + y * surfaceRowPitch);
+
+                float ndcY = ((y + 0.5f) / height) * 2.0f - 1.0f;
+                std::size_t pixelSize = format == DXGI_FORMAT_R32G32B32A32_FLOAT ? 4 * sizeof(float) : 4 * sizeof(uint16_t);
+
+                for (std::size_t x = 0; x < width; ++x)
+                {
+                    const float* color = &colors[x * 4];
+                    const float* surfaceNormal = &normals[x * 4];
+                    float distance = distanceRow[x];
+                    HistorySample& next = _nextHistory[y * width + x];
+
+                    // Nothing to reproject for the sky
+                    if (distance < 0)
+                    {
+                        next = { { color[0], color[1], color[2] }, 0, { 0, 0, 0 }, -1, 0 };
+                        continue;
+                    }
+
+                    float ndcX = ((x + 0.5f) / width) * 2.0f - 1.0f;
+                    float position[3];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        float direction = ndcX * directionX[c] + ndcY * directionY[c] + directionBase[c];
+                        position[c] = origin[c] + distance * direction;
+                    }
+
+                    float clip[4];
+                    TransformPoint(position, frame.ViewProjection, clip);
+
+                    uint32_t instance = instanceRow[x];
+                    float result[3] = { color[0], color[1], color[2] };
+                    float count = 0;
+
+                    if (_hasHistory)
+                    {
+                        // Where the surface was last frame
+                        float previousPosition[3] = { position[0], position[1], position[2] };
+                        float previousNormal[3] = { surfaceNormal[0], surfaceNormal[1], surfaceNormal[2] };
+                        uint32_t motionIndex = instance != 0 && instance <= _motionIndices.size() ? _motionIndices[instance - 1] : NoMotion;
+                        if (motionIndex != NoMotion)
+                        {
+                            const DirectX::XMFLOAT4X4& motion = frame.MovedInstances[motionIndex].Motion;
+                            float movedPosition[4];
+                            TransformPoint(position, motion, movedPosition);
+                            TransformDirection(surfaceNormal, motion, previousNormal);
+                            float length = std::sqrt(previousNormal[0] * previousNormal[0] +
+                                previousNormal[1] * previousNormal[1] + previousNormal[2] * previousNormal[2]);
+                            for (int c = 0; c < 3; ++c)
+                            {
+                                previousPosition[c] = movedPosition[c];
+                                previousNormal[c] = length > 0 ? previousNormal[c] / length : 0;
+                            }
+                        }
+
+                        float previousClip[4];
+                        TransformPoint(previousPosition, _previousViewProjection, previousClip);
+
+                        float history[3];
+                        if (_SampleHistory(previousClip, previousNormal, instance, history, count))
+                        {
+                            float alpha = std::max(1.0f / (count + 1.0f), _settings.MinAlpha);
+                            for (int c = 0; c < 3; ++c)
+                            {
+                                result[c] = history[c] + alpha * (color[c] - history[c]);
+                            }
+                            ++reprojected;
+                        }
+                        else
+                        {
+                            count = 0;
+                        }
+                    }
+
+                    next = {
+                        { result[0], result[1], result[2] },
+                        count + 1,
+                        { surfaceNormal[0], surfaceNormal[1], surfaceNormal[2] },
+                        clip[3],
+                        instance };
+                    StoreColor(result, format, imageRow + x * pixelSize);
+                }
+            }
+
+            reprojectedPixels += reprojected;
+        });
+
+        std::swap(_history, _nextHistory);
+        _hasHistory = true;
+        _previousViewProjection = frame.ViewProjection;
+        _reprojectedFraction = width * height != 0 ? static_cast<float>(reprojectedPixels) / (width * height) : 0;
+    }
+
+    void TemporalAccumulator::Reset()
+    {
+        _hasHistory = false;
+        _reprojectedFraction = 0;
+    }
+
+    bool TemporalAccumulator::_SampleHistory(const float previousClip[4], const float previousNormal[3], uint32_t instance,
+        float color[3], float& count) const
+    {
+        // Behind the previous camera
+        float depth = previousClip[3];
+        if (depth <= 0)
+        {
+            return false;
+        }
+
+        // Pixel coordinates of the previous frame, with y flipped as in RayGen.hlsl
+        float x = (previousClip[0] / depth + 1.0f) * 0.5f * _width - 0.5f;
+        float y = (1.0f - previousClip[1] / depth) * 0.5f * _height - 0.5f;
+        float left = std::floor(x);
+        float top = std::floor(y);
+        float fractionX = x - left;
+        float fractionY = y - top;
+
+        float weightSum = 0;
+        color[0] = color[1] = color[2] = 0;
+        count = 0;
+
+        for (int tap = 0; tap < 4; ++tap)
+        {
+            float tapX = left + (tap & 1);
+            float tapY = top + (tap >> 1);
+            if (tapX < 0 || tapY < 0 || tapX >= _width || tapY >= _height)
+            {
+                continue;
+            }
+
+            const HistorySample& sample = _history[static_cast<std::size_t>(tapY) * _width + static_cast<std::size_t>(tapX)];
+            if (sample.Count == 0 || sample.Instance != instance)
+            {
+                continue;
+            }
+
+            // Disoccluded, the history shows another surface
+            if (std::abs(sample.Depth - depth) > _settings.DepthTolerance * depth)
+            {
+                continue;
+            }
+            float cosine = sample.Normal[0] * previousNormal[0] + sample.Normal[1] * previousNormal[1] + sample.Normal[2] * previousNormal[2];
+            if (cosine < _settings.NormalTolerance)
+            {
+                continue;
+            }
+
+            float weight = ((tap & 1) ? fractionX : 1.0f - fractionX) * ((tap >> 1) ? fractionY : 1.0f - fractionY);
+            for (int c = 0; c < 3; ++c)
+            {
+                color[c] += weight * sample.Color[c];
+            }
+            count += weight * sample.Count;
+            weightSum += weight;
+        }
+
+        if (weightSum < 1e-3f)
+        {
+            return false;
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            color[c] /= weightSum;
+        }
+        count /= weightSum;
+        return true;
+    }
+}
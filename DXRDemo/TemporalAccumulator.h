@@ -0,0 +1,123 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DXRDemo
+{
+    class ThreadPool;
+
+    struct TemporalAccumulation
+    {
+        // Lowest weight of the current frame in the blend. New history is averaged
+        // until it holds 1 / MinAlpha frames, after which it fades exponentially.
+        float MinAlpha = 0.1f;
+        // Largest difference between the reprojected and the stored view depth,
+        // relative to the depth, for history to be reused
+        float DepthTolerance = 0.05f;
+        // Smallest cosine between the reprojected and the stored normal
+        float NormalTolerance = 0.9f;
+    };
+
+    // Accumulates ray traced radiance over frames, reprojecting the history of
+    // the previous frame so it stays in place when the camera or objects move.
+    //
+    // Each pixel is traced back to the surface it shows with its hit distance and
+    // the camera matrices, moved to where that surface was last frame with the
+    // motion of its instance, and projected into the previous frame. History
+    // samples there that belong to another instance or disagree on depth or normal
+    // are disoccluded and dropped, the remaining ones are filtered bilinearly and
+    // blended with the current radiance with an exponential moving average.
+    //
+    // Works on the images read back for the denoiser and runs on the CPU, so it
+    // needs no device. Calls must come from one thread at a time.
+    class TemporalAccumulator final
+    {
+    public:
+        // Maps world positions of an acceleration structure instance in this frame
+        // to the previous one
+        struct InstanceMotion
+        {
+            uint32_t Instance;
+            DirectX::XMFLOAT4X4 Motion;
+        };
+
+        // Matrices use the DirectXMath row vector convention
+        struct Frame
+        {
+            DirectX::XMFLOAT4X4 InverseView;
+            DirectX::XMFLOAT4X4 InverseProjection;
+            DirectX::XMFLOAT4X4 ViewProjection;
+            // Instances that moved since the previous frame, each once. The others
+            // did not move.
+            std::vector<InstanceMotion> MovedInstances;
+            // Drops the history, for changes reprojection cannot follow such as
+            // different lighting or materials
+            bool ResetHistory = false;
+        };
+
+        // Formats of the surface images the camera rays write next to the radiance:
+        // the acceleration structure instance of the first hit plus one, 0 where
+        // nothing was hit, and the hit distance along the camera ray, negative on a
+        // miss. Both keep 32 bits so that instances past 2048 and far hits survive.
+        static constexpr DXGI_FORMAT InstanceFormat = DXGI_FORMAT_R32_UINT;
+        static constexpr DXGI_FORMAT DistanceFormat = DXGI_FORMAT_R32_FLOAT;
+
+        explicit TemporalAccumulator(ThreadPool& threadPool, const TemporalAccumulation& settings = {});
+        TemporalAccumulator(const TemporalAccumulator&) = delete;
+        TemporalAccumulator& operator=(const TemporalAccumulator&) = delete;
+
+        // Blends image with the reprojected history in place, then keeps the result
+        // as the history of the next frame. image and normal are
+        // DXGI_FORMAT_R16G16B16A16_FLOAT or DXGI_FORMAT_R32G32B32A32_FLOAT and share
+        // rowPitch, instances and distances are in InstanceFormat and DistanceFormat
+        // and share surfaceRowPitch.
+        void Accumulate(std::size_t width, std::size_t height, DXGI_FORMAT format, void* image,
+            const void* normal, std::size_t rowPitch, const void* instances, const void* distances,
+            std::size_t surfaceRowPitch, const Frame& frame);
+
+        void Reset();
+
+        // Fraction of the pixels of the last frame that reused history
+        inline float GetReprojectedFraction() const
+        {
+            return _reprojectedFraction;
+        }
+
+    private:
+        struct HistorySample
+        {
+            float Color[3];
+            // Frames accumulated, 0 when the pixel has no history
+            float Count;
+            float Normal[3];
+            float Depth;
+            uint32_t Instance;
+        };
+
+        ThreadPool* _threadPool;
+        TemporalAccumulation _settings;
+        std::size_t _width = 0;
+        std::size_t _height = 0;
+        // Read from _history, written to _nextHistory, then swapped
+        std::vector<HistorySample> _history;
+        std::vector<HistorySample> _nextHistory;
+        bool _hasHistory = false;
+        DirectX::XMFLOAT4X4 _previousViewProjection;
+        // Position in the moved instances of the frame being accumulated, by
+        // instance, NoMotion for the others. Only the entries of the moved
+        // instances are written, and cleared again by the next frame.
+        static constexpr uint32_t NoMotion = UINT32_MAX;
+        std::vector<uint32_t> _motionIndices;
+        std::vector<uint32_t> _movedInstances;
+        float _reprojectedFraction = 0;
+
+        // Filters the history around the previous frame position of a surface.
+        // Returns false when none of the samples matches it.
+        bool _SampleHistory(const float previousClip[4], const float previousNormal[3], uint32_t instance,
+            float color[3], float& count) const;
+    };
+}
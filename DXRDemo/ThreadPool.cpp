@@ -0,0 +1,142 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace DXRDemo
+{
+    ThreadPool::ThreadPool(uint32_t threadCount)
+    {
+        threadCount = std::max(threadCount, 1u);
+        _threads.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; ++i)
+        {
+            _threads.emplace_back(&ThreadPool::_Run, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _condition.notify_all();
+
+        for (std::thread& thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    std::future<void> ThreadPool::Submit(std::function<void()> task)
+    {
+        std::packaged_task<void()> packagedTask(std::move(task));
+        std::future<void> future = packagedTask.get_future();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.push_back(std::move(packagedTask));
+        }
+        _condition.notify_one();
+        return future;
+    }
+
+    void ThreadPool::ParallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& function)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        // One range per worker plus one for the calling thread
+        minRangeSize = std::max<size_t>(minRangeSize, 1);
+        size_t rangeCount = std::min<size_t>(_threads.size() + 1, (count + minRangeSize - 1) / minRangeSize);
+        size_t rangeSize = (count + rangeCount - 1) / rangeCount;
+
+        std::vector<std::future<void>> futures;
+        futures.reserve(rangeCount);
+        for (size_t begin = rangeSize; begin < count; begin += rangeSize)
+        {
+            size_t end = std::min(begin + rangeSize, count);
+            futures.push_back(Submit([&function, begin, end]() { function(begin, end); }));
+        }
+
+        std::exception_ptr exception;
+        try
+        {
+            function(0, std::min(rangeSize, count));
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+
+        for (std::future<void>& future : futures)
+        {
+            // Help with the queue instead of blocking, so that a ParallelFor issued
+            // from a worker cannot starve the pool
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                if (!_RunPendingTask())
+                {
+                    future.wait();
+                }
+            }
+
+            try
+            {
+                future.get();
+            }
+            catch (...)
+            {
+                if (!exception)
+                {
+                    exception = std::current_exception();
+                }
+            }
+        }
+
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    void ThreadPool::_Run()
+    {
+        while (true)
+        {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+                if (_tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    bool ThreadPool::_RunPendingTask()
+    {
+        std::packaged_task<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_tasks.empty())
+            {
+                return false;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+        return true;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DXRDemo
+{
+    // Fixed set of worker threads running queued tasks
+    class ThreadPool final
+    {
+    public:
+        explicit ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        std::future<void> Submit(std::function<void()> task);
+
+        // Calls function(begin, end) over ranges covering [0, count), each at least
+        // minRangeSize long, on the workers and the calling thread. Returns once all
+        // ranges are done, rethrowing the first exception thrown by one of them.
+        void ParallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& function);
+
+        inline uint32_t GetThreadCount() const
+        {
+            return static_cast<uint32_t>(_threads.size());
+        }
+
+    private:
+        std::vector<std::thread> _threads;
+        std::deque<std::packaged_task<void()>> _tasks;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _stopping = false;
+
+        void _Run();
+        // Runs a queued task on the calling thread, if there is one
+        bool _RunPendingTask();
+    };
+}
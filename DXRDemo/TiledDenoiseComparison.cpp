@@ -0,0 +1,152 @@
+#include "TiledDenoiseComparison.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "Denoiser.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // Relative RMS difference allowed between tiled and whole frame results
+        const double Tolerance = 1e-2;
+
+        struct TestImage
+        {
+            size_t Width;
+            size_t Height;
+            std::vector<float> Color;
+            std::vector<float> Albedo;
+            std::vector<float> Normal;
+        };
+
+        // RGBA float images of a few boxes on a gradient, the color with Monte Carlo
+        // like noise and occasional fireflies, the features noise free
+        TestImage CreateTestImage(size_t width, size_t height)
+        {
+            TestImage image = { width, height };
+            image.Color.resize(width * height * 4);
+            image.Albedo.resize(width * height * 4);
+            image.Normal.resize(width * height * 4);
+
+            std::mt19937 generator(0);
+            std::exponential_distribution<float> noise(1.0f);
+
+            for (size_t y = 0; y < height; ++y)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    float u = static_cast<float>(x) / width;
+                    float v = static_cast<float>(y) / height;
+                    size_t cell = (x * 8 / width) + (y * 8 / height) * 8;
+                    bool box = (cell % 3) == 0;
+
+                    float albedo[3] = { box ? 0.8f : 0.5f, box ? 0.2f : 0.5f, box ? 0.1f : 0.5f };
+                    float normal[3] = { box ? 0.0f : 0.3f, box ? 0.0f : 0.0f, box ? 1.0f : 0.95f };
+                    float light = 0.2f + 2.0f * u * v;
+
+                    float* color = &image.Color[(y * width + x) * 4];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        color[c] = albedo[c] * light * noise(generator);
+                        image.Albedo[(y * width + x) * 4 + c] = albedo[c];
+                        image.Normal[(y * width + x) * 4 + c] = normal[c];
+                    }
+                    color[3] = 1.0f;
+                    image.Albedo[(y * width + x) * 4 + 3] = 1.0f;
+                    image.Normal[(y * width + x) * 4 + 3] = 1.0f;
+                }
+            }
+            return image;
+        }
+
+        double Denoise(Denoiser& denoiser, const TestImage& image, std::vector<float>& output)
+        {
+            size_t rowPitch = image.Width * 4 * sizeof(float);
+            auto start = std::chrono::high_resolution_clock::now();
+            denoiser.Denoise(image.Color.data(), image.Albedo.data(), image.Normal.data(), rowPitch, output.data(), rowPitch);
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<double, std::milli>(end - start).count();
+        }
+    }
+
+    bool RunTiledDenoiseComparison(const std::string& filename, ThreadPool& threadPool)
+    {
+        std::ofstream file(filename);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open comparison file for writing");
+        }
+
+        struct Resolution
+        {
+            size_t Width;
+            size_t Height;
+        };
+        const Resolution resolutions[] = { { 1920, 1080 }, { 2731, 1999 } };
+
+        struct Tiling
+        {
+            uint32_t TileSize;
+            uint32_t Overlap;
+        };
+        const Tiling tilings[] = { { 256, 32 }, { 256, 64 }, { 512, 64 }, { 512, 128 } };
+
+        bool withinTolerance = true;
+
+        file << "width,height,tile_size,overlap,concurrent_tiles,full_frame_ms,tiled_ms,relative_rmse,max_abs_error,within_tolerance\n";
+        for (const Resolution& resolution : resolutions)
+        {
+            TestImage image = CreateTestImage(resolution.Width, resolution.Height);
+            std::vector<float> reference(image.Color.size());
+            std::vector<float> tiled(image.Color.size());
+
+            Denoiser fullFrameDenoiser(image.Width, image.Height, DXGI_FORMAT_R32G32B32A32_FLOAT, threadPool);
+            // The first run includes one-time initialization
+            Denoise(fullFrameDenoiser, image, reference);
+            double fullFrameTime = Denoise(fullFrameDenoiser, image, reference);
+
+            for (const Tiling& tiling : tilings)
+            {
+                DenoiseTiling denoiseTiling;
+                denoiseTiling.TileSize = tiling.TileSize;
+                denoiseTiling.Overlap = tiling.Overlap;
+
+                Denoiser tiledDenoiser(image.Width, image.Height, DXGI_FORMAT_R32G32B32A32_FLOAT, threadPool, denoiseTiling);
+                Denoise(tiledDenoiser, image, tiled);
+                double tiledTime = Denoise(tiledDenoiser, image, tiled);
+
+                double squaredError = 0;
+                double squaredReference = 0;
+                double maxError = 0;
+                for (size_t i = 0; i < reference.size(); ++i)
+                {
+                    if (i % 4 == 3)
+                    {
+                        continue;
+                    }
+                    double error = static_cast<double>(tiled[i]) - reference[i];
+                    squaredError += error * error;
+                    squaredReference += static_cast<double>(reference[i]) * reference[i];
+                    maxError = std::max(maxError, std::abs(error));
+                }
+                double relativeRmse = squaredReference > 0 ? std::sqrt(squaredError / squaredReference) : 0;
+                bool passed = relativeRmse <= Tolerance;
+                withinTolerance = withinTolerance && passed;
+
+                file << image.Width << "," << image.Height << ","
+                    << tiling.TileSize << "," << tiling.Overlap << "," << tiledDenoiser.GetConcurrentTiles() << ","
+                    << fullFrameTime << "," << tiledTime << ","
+                    << relativeRmse << "," << maxError << "," << (passed ? "true" : "false") << "\n";
+            }
+        }
+
+        return withinTolerance;
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    class ThreadPool;
+
+    // Denoises synthetic noisy images whole and in tiles with several tile sizes and
+    // overlaps, and writes the timings and the difference between the two as CSV.
+    // Returns whether every tiled result is within tolerance of the whole one.
+    bool RunTiledDenoiseComparison(const std::string& filename, ThreadPool& threadPool);
+}
@@ -0,0 +1,276 @@
+#include "TiledDenoiser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include "PixelConversion.h"
+#include "Utilities.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        void CheckDeviceError(oidn::DeviceRef& device)
+        {
+            const char* errorMessage;
+            if (device.getError(errorMessage) != oidn::Error::None)
+            {
+                OutputDebugStringA(errorMessage);
+                throw std::runtime_error(errorMessage);
+            }
+        }
+    }
+
+    TiledDenoiser::TiledDenoiser(std::size_t width, std::size_t height, DXGI_FORMAT format, const DenoiseTiling& tiling,
+        DenoiseQuality quality, ThreadPool& threadPool) :
+        _width(width),
+        _height(height),
+        _format(format),
+        _tileSize(tiling.TileSize),
+        _blendRadius(tiling.Overlap / 2),
+        _overlap(tiling.Overlap),
+        _threadPool(&threadPool)
+    {
+        if (_format != DXGI_FORMAT_R16G16B16A16_FLOAT && _format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+        {
+            throw std::invalid_argument("Unsupported denoiser image format");
+        }
+        if (_tileSize == 0)
+        {
+            throw std::invalid_argument("Tiled denoising needs a tile size");
+        }
+        if (_overlap > _tileSize)
+        {
+            throw std::invalid_argument("Denoise tile overlap must not exceed the tile size");
+        }
+
+        _tilesX = (_width + _tileSize - 1) / _tileSize;
+        _tilesY = (_height + _tileSize - 1) / _tileSize;
+        _windowWidth = std::min(_width, _tileSize + 2 * _overlap);
+        _windowHeight = std::min(_height, _tileSize + 2 * _overlap);
+        // Float images are used as they are, skipping over alpha
+        _pixelStride = _format == DXGI_FORMAT_R32G32B32A32_FLOAT ? 4 * sizeof(float) : 3 * sizeof(float);
+
+        // A band spans its tiles plus the cross-fades above and below them
+        _bandRows = std::min(_height, _tileSize + 2 * _blendRadius);
+        _band.assign(_width * _bandRows * 3, 0.0f);
+        _seamMutexes = std::make_unique<std::mutex[]>(_tilesX + 1);
+
+        // Run as many tiles at once as there are threads, as long as each one
+        // leaves the denoiser at least as much working memory as its own buffers
+        std::size_t windowBytes = _windowWidth * _windowHeight * _pixelStride;
+        std::size_t laneBufferBytes = 3 * windowBytes;
+        std::size_t memoryLimit = static_cast<std::size_t>(tiling.MemoryLimitMB) << 20;
+        std::size_t bandBytes = _band.size() * sizeof(float);
+        std::size_t availableMemory = memoryLimit > bandBytes ? memoryLimit - bandBytes : 0;
+
+        std::size_t laneCount = std::min<std::size_t>(threadPool.GetThreadCount() + 1, _tilesX);
+        laneCount = std::max<std::size_t>(1, std::min(laneCount, availableMemory / (2 * laneBufferBytes)));
+
+        std::size_t laneMemory = availableMemory / laneCount;
+        int laneMemoryMB = static_cast<int>(std::max<std::size_t>(1, (laneMemory > laneBufferBytes ? laneMemory - laneBufferBytes : 0) >> 20));
+        int deviceThreads = static_cast<int>(std::max<std::size_t>(1, std::thread::hardware_concurrency() / laneCount));
+
+        for (std::size_t i = 0; i < laneCount; ++i)
+        {
+            std::unique_ptr<Lane> lane = std::make_unique<Lane>();
+
+            // One device per lane, so the tiles really are denoised side by side
+            lane->Device = oidn::newDevice(oidn::DeviceType::Default);
+            lane->Device.set("numThreads", deviceThreads);
+            lane->Device.commit();
+            CheckDeviceError(lane->Device);
+
+            lane->Color = lane->Device.newBuffer(windowBytes);
+            lane->Albedo = lane->Device.newBuffer(windowBytes);
+            lane->Normal = lane->Device.newBuffer(windowBytes);
+
+            std::size_t rowBytes = _windowWidth * _pixelStride;
+            lane->Filter = lane->Device.newFilter("RT");
+            lane->Filter.setImage("color", lane->Color, oidn::Format::Float3, _windowWidth, _windowHeight, 0, _pixelStride, rowBytes);
+            lane->Filter.setImage("albedo", lane->Albedo, oidn::Format::Float3, _windowWidth, _windowHeight, 0, _pixelStride, rowBytes);
+            lane->Filter.setImage("normal", lane->Normal, oidn::Format::Float3, _windowWidth, _windowHeight, 0, _pixelStride, rowBytes);
+            lane->Filter.setImage("output", lane->Color, oidn::Format::Float3, _windowWidth, _windowHeight, 0, _pixelStride, rowBytes);
+            lane->Filter.set("hdr", true);
+            lane->Filter.set("cleanAux", true);
+            lane->Filter.set("quality", ToOidnQuality(quality));
+            lane->Filter.set("maxMemoryMB", laneMemoryMB);
+            lane->Filter.commit();
+            CheckDeviceError(lane->Device);
+
+            _lanes.push_back(std::move(lane));
+        }
+    }
+
+    void TiledDenoiser::Denoise(const void* image, const void* albedo, const void* normal, std::size_t inputRowPitch,
+        void* output, std::size_t outputRowPitch)
+    {
+        Inputs inputs = { image, albedo, normal, inputRowPitch };
+
+        // First image row held by the band buffer
+        std::size_t bandOrigin = 0;
+        for (std::size_t tileY = 0; tileY < _tilesY; ++tileY)
+        {
+            // Each lane takes the next tile of the band until there are none left
+            std::atomic<std::size_t> nextTile = 0;
+            _threadPool->ParallelFor(_lanes.size(), 1, [this, &inputs, &nextTile, tileY, bandOrigin](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t lane = begin; lane < end; ++lane)
+                {
+                    for (std::size_t tileX = nextTile++; tileX < _tilesX; tileX = nextTile++)
+                    {
+                        _DenoiseTile(*_lanes[lane], inputs, tileX, tileY, bandOrigin);
+                    }
+                }
+            });
+
+            // Rows cross-faded with the next band are carried over to it
+            bool lastBand = tileY + 1 == _tilesY;
+            std::size_t coreEnd = std::min(_height, (tileY + 1) * _tileSize);
+            std::size_t writtenEnd = lastBand ? _height : coreEnd - _blendRadius;
+            std::size_t carriedRows = lastBand ? 0 : std::min(_height, coreEnd + _blendRadius) - writtenEnd;
+
+            _WriteRows(bandOrigin, writtenEnd - bandOrigin, output, outputRowPitch);
+
+            float* band = _band.data();
+            memmove(band, band + (writtenEnd - bandOrigin) * _width * 3, carriedRows * _width * 3 * sizeof(float));
+            std::fill(band + carriedRows * _width * 3, band + _band.size(), 0.0f);
+            bandOrigin = writtenEnd;
+        }
+    }
+
+    void TiledDenoiser::_DenoiseTile(Lane& lane, const Inputs& inputs, std::size_t tileX, std::size_t tileY, std::size_t bandOrigin)
+    {
+        std::size_t coreX = tileX * _tileSize;
+        std::size_t coreY = tileY * _tileSize;
+        std::size_t coreEndX = std::min(_width, coreX + _tileSize);
+
+        // The window keeps its size at the borders, moving inwards instead
+        std::size_t windowX = std::min(coreX > _overlap ? coreX - _overlap : 0, _width - _windowWidth);
+        std::size_t windowY = std::min(coreY > _overlap ? coreY - _overlap : 0, _height - _windowHeight);
+
+        uint8_t* color = reinterpret_cast<uint8_t*>(lane.Color.getData());
+        _LoadWindow(inputs.Image, inputs.RowPitch, windowX, windowY, color);
+        _LoadWindow(inputs.Albedo, inputs.RowPitch, windowX, windowY, reinterpret_cast<uint8_t*>(lane.Albedo.getData()));
+        _LoadWindow(inputs.Normal, inputs.RowPitch, windowX, windowY, reinterpret_cast<uint8_t*>(lane.Normal.getData()));
+
+        lane.Filter.execute();
+        CheckDeviceError(lane.Device);
+
+        // Columns cross-faded with a neighbour are shared with it
+        std::size_t columnBegin = coreX > _blendRadius ? coreX - _blendRadius : 0;
+        std::size_t columnEnd = std::min(_width, coreEndX + _blendRadius);
+        std::size_t sharedLeftEnd = tileX > 0 ? std::min(columnEnd, coreX + _blendRadius) : columnBegin;
+        std::size_t sharedRightBegin = tileX + 1 < _tilesX ? coreEndX - _blendRadius : columnEnd;
+
+        if (sharedLeftEnd > columnBegin)
+        {
+            std::lock_guard<std::mutex> lock(_seamMutexes[tileX]);
+            _AccumulateColumns(color, windowX, windowY, tileX, tileY, columnBegin, sharedLeftEnd, bandOrigin);
+        }
+        _AccumulateColumns(color, windowX, windowY, tileX, tileY, sharedLeftEnd, sharedRightBegin, bandOrigin);
+        if (columnEnd > sharedRightBegin)
+        {
+            std::lock_guard<std::mutex> lock(_seamMutexes[tileX + 1]);
+            _AccumulateColumns(color, windowX, windowY, tileX, tileY, sharedRightBegin, columnEnd, bandOrigin);
+        }
+    }
+
+    void TiledDenoiser::_LoadWindow(const void* image, std::size_t rowPitch, std::size_t windowX, std::size_t windowY, uint8_t* window) const
+    {
+        const uint8_t* source = reinterpret_cast<const uint8_t*>(image);
+        std::size_t windowRowBytes = _windowWidth * _pixelStride;
+
+        for (std::size_t row = 0; row < _windowHeight; ++row)
+        {
+            const uint8_t* sourceRow = source + (windowY + row) * rowPitch;
+            uint8_t* windowRow = window + row * windowRowBytes;
+
+            if (_format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+            {
+                PixelConversion::Rgba16fToRgb32f(reinterpret_cast<const uint16_t*>(sourceRow) + windowX * 4,
+                    reinterpret_cast<float*>(windowRow), _windowWidth);
+            }
+            else
+            {
+                memcpy(windowRow, sourceRow + windowX * 4 * sizeof(float), windowRowBytes);
+            }
+        }
+    }
+
+    void TiledDenoiser::_AccumulateColumns(const uint8_t* window, std::size_t windowX, std::size_t windowY,
+        std::size_t tileX, std::size_t tileY, std::size_t columnBegin, std::size_t columnEnd, std::size_t bandOrigin)
+    {
+        std::size_t coreX = tileX * _tileSize;
+        std::size_t coreY = tileY * _tileSize;
+        std::size_t coreEndX = std::min(_width, coreX + _tileSize);
+        std::size_t coreEndY = std::min(_height, coreY + _tileSize);
+
+        std::size_t rowBegin = coreY > _blendRadius ? coreY - _blendRadius : 0;
+        std::size_t rowEnd = std::min(_height, coreEndY + _blendRadius);
+        std::size_t floatStride = _pixelStride / sizeof(float);
+
+        for (std::size_t y = rowBegin; y < rowEnd; ++y)
+        {
+            float rowWeight = _BlendWeight(y, coreY, coreEndY, _height);
+            const float* windowRow = reinterpret_cast<const float*>(window + (y - windowY) * _windowWidth * _pixelStride);
+            float* bandRow = _band.data() + (y - bandOrigin) * _width * 3;
+
+            for (std::size_t x = columnBegin; x < columnEnd; ++x)
+            {
+                float weight = rowWeight * _BlendWeight(x, coreX, coreEndX, _width);
+                const float* pixel = windowRow + (x - windowX) * floatStride;
+                bandRow[x * 3 + 0] += weight * pixel[0];
+                bandRow[x * 3 + 1] += weight * pixel[1];
+                bandRow[x * 3 + 2] += weight * pixel[2];
+            }
+        }
+    }
+
+    void TiledDenoiser::_WriteRows(std::size_t firstRow, std::size_t rowCount, void* output, std::size_t outputRowPitch)
+    {
+        uint8_t* destination = reinterpret_cast<uint8_t*>(output) + firstRow * outputRowPitch;
+
+        if (_format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+        {
+            PixelConversion::Rgb32fToRgba16f(_band.data(), _width * 3 * sizeof(float), destination, outputRowPitch,
+                _width, rowCount, *_threadPool);
+            return;
+        }
+
+        _threadPool->ParallelFor(rowCount, 16, [this, destination, outputRowPitch](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t row = begin; row < end; ++row)
+            {
+                const float* source = _band.data() + row * _width * 3;
+                float* destinationRow = reinterpret_cast<float*>(destination + row * outputRowPitch);
+                for (std::size_t x = 0; x < _width; ++x)
+                {
+                    destinationRow[x * 4 + 0] = source[x * 3 + 0];
+                    destinationRow[x * 4 + 1] = source[x * 3 + 1];
+                    destinationRow[x * 4 + 2] = source[x * 3 + 2];
+                    destinationRow[x * 4 + 3] = 1.0f;
+                }
+            }
+        });
+    }
+
+    float TiledDenoiser::_BlendWeight(std::size_t position, std::size_t coreBegin, std::size_t coreEnd, std::size_t size) const
+    {
+        // Linear ramps across each seam, those of the two tiles meeting there add up to one
+        float center = static_cast<float>(position) + 0.5f;
+        float width = static_cast<float>(2 * _blendRadius);
+        float weight = 1.0f;
+        if (coreBegin > 0 && position < coreBegin + _blendRadius)
+        {
+            weight *= (center - static_cast<float>(coreBegin - _blendRadius)) / width;
+        }
+        if (coreEnd < size && position + _blendRadius >= coreEnd)
+        {
+            weight *= (static_cast<float>(coreEnd + _blendRadius) - center) / width;
+        }
+        return weight;
+    }
+}
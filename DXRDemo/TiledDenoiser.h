@@ -0,0 +1,99 @@
+#pragma once
+
+#include <OpenImageDenoise/oidn.hpp>
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "DenoiseQuality.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    // How images are split for denoising. A tile size of 0 denoises whole frames.
+    struct DenoiseTiling
+    {
+        uint32_t TileSize = 0;
+        // Pixels of context denoised around each tile. The inner half of it is
+        // cross-faded with the neighbouring tiles to hide the seams.
+        uint32_t Overlap = 64;
+        // Memory the tiles in flight may use, in megabytes. The denoiser treats its
+        // share as a soft limit, so this is approximate.
+        uint32_t MemoryLimitMB = 2048;
+    };
+
+    // Denoises images too large to denoise at once, in overlapping tiles.
+    //
+    // Tiles are processed one row of tiles (a band) at a time, several tiles of a
+    // band at once, each on its own denoiser. Their results are weighted so the
+    // weights of overlapping tiles add up to one and summed into a buffer covering
+    // the band. Rows no longer overlapped by the next band are written out, the
+    // rest is carried over, so memory does not grow with the image height.
+    class TiledDenoiser final
+    {
+    public:
+        // Images are in the formats taken by Denoiser
+        TiledDenoiser(std::size_t width, std::size_t height, DXGI_FORMAT format, const DenoiseTiling& tiling,
+            DenoiseQuality quality, ThreadPool& threadPool);
+        TiledDenoiser(const TiledDenoiser&) = delete;
+        TiledDenoiser& operator=(const TiledDenoiser&) = delete;
+
+        // Same contract as Denoiser::Denoise
+        void Denoise(const void* image, const void* albedo, const void* normal, std::size_t inputRowPitch,
+            void* output, std::size_t outputRowPitch);
+
+        inline std::size_t GetConcurrentTiles() const
+        {
+            return _lanes.size();
+        }
+
+    private:
+        // A denoiser working on one tile at a time
+        struct Lane
+        {
+            oidn::DeviceRef Device;
+            oidn::FilterRef Filter;
+            oidn::BufferRef Color;
+            oidn::BufferRef Albedo;
+            oidn::BufferRef Normal;
+        };
+
+        struct Inputs
+        {
+            const void* Image;
+            const void* Albedo;
+            const void* Normal;
+            std::size_t RowPitch;
+        };
+
+        std::size_t _width;
+        std::size_t _height;
+        DXGI_FORMAT _format;
+        std::size_t _tileSize;
+        // Half of the overlap, the distance the cross-fade reaches on each side of a seam
+        std::size_t _blendRadius;
+        std::size_t _overlap;
+        std::size_t _tilesX;
+        std::size_t _tilesY;
+        // Size of the window denoised around each tile
+        std::size_t _windowWidth;
+        std::size_t _windowHeight;
+        std::size_t _pixelStride;
+        ThreadPool* _threadPool;
+        std::vector<std::unique_ptr<Lane>> _lanes;
+        // Weighted sum of the tiles of the current band, packed RGB floats
+        std::vector<float> _band;
+        std::size_t _bandRows;
+        // Guards the columns cross-faded across each vertical seam
+        std::unique_ptr<std::mutex[]> _seamMutexes;
+
+        void _DenoiseTile(Lane& lane, const Inputs& inputs, std::size_t tileX, std::size_t tileY, std::size_t bandOrigin);
+        void _LoadWindow(const void* image, std::size_t rowPitch, std::size_t windowX, std::size_t windowY, uint8_t* window) const;
+        void _AccumulateColumns(const uint8_t* window, std::size_t windowX, std::size_t windowY,
+            std::size_t tileX, std::size_t tileY, std::size_t columnBegin, std::size_t columnEnd, std::size_t bandOrigin);
+        void _WriteRows(std::size_t firstRow, std::size_t rowCount, void* output, std::size_t outputRowPitch);
+        float _BlendWeight(std::size_t position, std::size_t coreBegin, std::size_t coreEnd, std::size_t size) const;
+    };
+}
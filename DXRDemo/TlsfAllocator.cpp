@@ -0,0 +1,337 @@
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace DXRDemo
+{
+    namespace
+    {
+        inline void CheckAlignment(uint64_t alignment)
+        {
+            if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+            {
+                throw std::invalid_argument("Alignment must be a power of two");
+            }
+        }
+
+        inline uint64_t AlignUp(uint64_t offset, uint64_t alignment)
+        {
+            return (offset + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    TlsfAllocator::TlsfAllocator(uint64_t capacity) :
+        _capacity(capacity)
+    {
+        for (auto& secondLevel : _freeLists)
+        {
+            std::fill(std::begin(secondLevel), std::end(secondLevel), NoBlock);
+        }
+
+        if (capacity != 0)
+        {
+            _firstBlock = _NewBlock(0, capacity);
+            _InsertFree(_firstBlock);
+        }
+    }
+
+    uint64_t TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+    {
+        CheckAlignment(alignment);
+
+        // Empty ranges still get an offset of their own
+        size = std::max<uint64_t>(size, 1);
+        if (size > _capacity || alignment > _capacity)
+        {
+            return InvalidOffset;
+        }
+
+        // Blocks are often aligned already, as when every range is a multiple of
+        // the alignment. Otherwise any block of the class found with room for the
+        // worst padding fits.
+        uint32_t block = _FindFreeBlock(size);
+        if (block != NoBlock && AlignUp(_blocks[block].Offset, alignment) + size > _blocks[block].Offset + _blocks[block].Size)
+        {
+            block = _FindFreeBlock(size + alignment - 1);
+        }
+        if (block == NoBlock)
+        {
+            return InvalidOffset;
+        }
+
+        return _Use(block, size, alignment);
+    }
+
+    uint64_t TlsfAllocator::AllocateBelow(uint64_t size, uint64_t alignment, uint64_t limit)
+    {
+        CheckAlignment(alignment);
+        size = std::max<uint64_t>(size, 1);
+
+        // First fit in address order, rare enough for a walk through the block
+        for (uint32_t block = _firstBlock; block != NoBlock && _blocks[block].Offset < limit; block = _blocks[block].NextPhysical)
+        {
+            const Block& candidate = _blocks[block];
+            if (!candidate.Free)
+            {
+                continue;
+            }
+
+            uint64_t offset = AlignUp(candidate.Offset, alignment);
+            if (offset + size <= candidate.Offset + candidate.Size && offset + size <= limit)
+            {
+                return _Use(block, size, alignment);
+            }
+        }
+
+        return InvalidOffset;
+    }
+
+    void TlsfAllocator::Free(uint64_t offset)
+    {
+        auto allocated = _allocatedBlocks.find(offset);
+        if (allocated == _allocatedBlocks.end())
+        {
+            throw std::invalid_argument("Freeing a range that was not allocated");
+        }
+
+        uint32_t block = allocated->second;
+        _allocatedBlocks.erase(allocated);
+        _usedSize -= _blocks[block].Size;
+        _blocks[block].Free = true;
+
+        // Absorb the next block, then let the previous one absorb this one
+        uint32_t next = _blocks[block].NextPhysical;
+        if (next != NoBlock && _blocks[next].Free)
+        {
+            _RemoveFree(next);
+            _blocks[block].Size += _blocks[next].Size;
+            _blocks[block].NextPhysical = _blocks[next].NextPhysical;
+            if (_blocks[next].NextPhysical != NoBlock)
+            {
+                _blocks[_blocks[next].NextPhysical].PreviousPhysical = block;
+            }
+            _unusedBlocks.push_back(next);
+        }
+
+        uint32_t previous = _blocks[block].PreviousPhysical;
+        if (previous != NoBlock && _blocks[previous].Free)
+        {
+            _RemoveFree(previous);
+            _blocks[previous].Size += _blocks[block].Size;
+            _blocks[previous].NextPhysical = _blocks[block].NextPhysical;
+            if (_blocks[block].NextPhysical != NoBlock)
+            {
+                _blocks[_blocks[block].NextPhysical].PreviousPhysical = previous;
+            }
+            _unusedBlocks.push_back(block);
+            block = previous;
+        }
+
+        _InsertFree(block);
+    }
+
+    uint64_t TlsfAllocator::GetAllocationSize(uint64_t offset) const
+    {
+        auto allocated = _allocatedBlocks.find(offset);
+        if (allocated == _allocatedBlocks.end())
+        {
+            throw std::invalid_argument("Range was not allocated");
+        }
+        return _blocks[allocated->second].Size;
+    }
+
+    TlsfStatistics TlsfAllocator::GetStatistics() const
+    {
+        TlsfStatistics statistics;
+        statistics.AllocationCount = static_cast<uint32_t>(_allocatedBlocks.size());
+        statistics.FreeBlockCount = _freeBlockCount;
+        statistics.UsedSize = _usedSize;
+        statistics.FreeSize = _capacity - _usedSize;
+
+        // The largest free block is in the highest non-empty class
+        if (_firstLevelBitmap != 0)
+        {
+            uint32_t firstLevel = static_cast<uint32_t>(std::bit_width(_firstLevelBitmap) - 1);
+            uint32_t secondLevel = static_cast<uint32_t>(std::bit_width(_secondLevelBitmaps[firstLevel]) - 1);
+            for (uint32_t block = _freeLists[firstLevel][secondLevel]; block != NoBlock; block = _blocks[block].NextFree)
+            {
+                statistics.LargestFreeBlock = std::max(statistics.LargestFreeBlock, _blocks[block].Size);
+            }
+        }
+        return statistics;
+    }
+
+    void TlsfAllocator::_GetSizeClass(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+    {
+        if (size < SecondLevelCount)
+        {
+            // Small sizes share the first class, one size per second level
+            firstLevel = 0;
+            secondLevel = static_cast<uint32_t>(size);
+            return;
+        }
+
+        uint32_t mostSignificantBit = static_cast<uint32_t>(std::bit_width(size) - 1);
+        secondLevel = static_cast<uint32_t>(size >> (mostSignificantBit - SecondLevelBits)) - SecondLevelCount;
+        firstLevel = mostSignificantBit - SecondLevelBits + 1;
+    }
+
+    uint32_t TlsfAllocator::_FindFreeBlock(uint64_t size) const
+    {
+        // Rounded up to the next class, every block of which is large enough
+        if (size >= SecondLevelCount)
+        {
+            uint64_t classSize = uint64_t(1) << (std::bit_width(size) - 1 - SecondLevelBits);
+            if (size > std::numeric_limits<uint64_t>::max() - classSize)
+            {
+                return NoBlock;
+            }
+            size += classSize - 1;
+        }
+
+        uint32_t firstLevel;
+        uint32_t secondLevel;
+        _GetSizeClass(size, firstLevel, secondLevel);
+
+        uint32_t secondLevelBitmap = _secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+        if (secondLevelBitmap == 0)
+        {
+            uint64_t firstLevelBitmap = firstLevel + 1 < 64 ? _firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1)) : 0;
+            if (firstLevelBitmap == 0)
+            {
+                return NoBlock;
+            }
+
+            firstLevel = static_cast<uint32_t>(std::countr_zero(firstLevelBitmap));
+            secondLevelBitmap = _secondLevelBitmaps[firstLevel];
+        }
+
+        secondLevel = static_cast<uint32_t>(std::countr_zero(secondLevelBitmap));
+        return _freeLists[firstLevel][secondLevel];
+    }
+
+    void TlsfAllocator::_InsertFree(uint32_t block)
+    {
+        uint32_t firstLevel;
+        uint32_t secondLevel;
+        _GetSizeClass(_blocks[block].Size, firstLevel, secondLevel);
+
+        uint32_t head = _freeLists[firstLevel][secondLevel];
+        _blocks[block].Free = true;
+        _blocks[block].PreviousFree = NoBlock;
+        _blocks[block].NextFree = head;
+        if (head != NoBlock)
+        {
+            _blocks[head].PreviousFree = block;
+        }
+
+        _freeLists[firstLevel][secondLevel] = block;
+        _secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+        _firstLevelBitmap |= uint64_t(1) << firstLevel;
+        ++_freeBlockCount;
+    }
+
+    void TlsfAllocator::_RemoveFree(uint32_t block)
+    {
+        uint32_t firstLevel;
+        uint32_t secondLevel;
+        _GetSizeClass(_blocks[block].Size, firstLevel, secondLevel);
+
+        Block& removed = _blocks[block];
+        if (removed.PreviousFree != NoBlock)
+        {
+            _blocks[removed.PreviousFree].NextFree = removed.NextFree;
+        }
+        else
+        {
+            _freeLists[firstLevel][secondLevel] = removed.NextFree;
+        }
+        if (removed.NextFree != NoBlock)
+        {
+            _blocks[removed.NextFree].PreviousFree = removed.PreviousFree;
+        }
+
+        if (_freeLists[firstLevel][secondLevel] == NoBlock)
+        {
+            _secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+            if (_secondLevelBitmaps[firstLevel] == 0)
+            {
+                _firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+            }
+        }
+
+        removed.PreviousFree = NoBlock;
+        removed.NextFree = NoBlock;
+        removed.Free = false;
+        --_freeBlockCount;
+    }
+
+    uint32_t TlsfAllocator::_NewBlock(uint64_t offset, uint64_t size)
+    {
+        uint32_t block;
+        if (!_unusedBlocks.empty())
+        {
+            block = _unusedBlocks.back();
+            _unusedBlocks.pop_back();
+            _blocks[block] = Block{};
+        }
+        else
+        {
+            block = static_cast<uint32_t>(_blocks.size());
+            _blocks.emplace_back();
+        }
+
+        _blocks[block].Offset = offset;
+        _blocks[block].Size = size;
+        return block;
+    }
+
+    uint64_t TlsfAllocator::_Use(uint32_t block, uint64_t size, uint64_t alignment)
+    {
+        _RemoveFree(block);
+
+        // Free neighbours were merged with the block, so the pieces split off
+        // it need no merging
+        uint64_t offset = AlignUp(_blocks[block].Offset, alignment);
+        uint64_t padding = offset - _blocks[block].Offset;
+        if (padding != 0)
+        {
+            uint32_t before = _NewBlock(_blocks[block].Offset, padding);
+            _blocks[before].PreviousPhysical = _blocks[block].PreviousPhysical;
+            _blocks[before].NextPhysical = block;
+            if (_blocks[block].PreviousPhysical != NoBlock)
+            {
+                _blocks[_blocks[block].PreviousPhysical].NextPhysical = before;
+            }
+            else
+            {
+                _firstBlock = before;
+            }
+            _blocks[block].PreviousPhysical = before;
+            _blocks[block].Offset = offset;
+            _blocks[block].Size -= padding;
+            _InsertFree(before);
+        }
+
+        if (_blocks[block].Size > size)
+        {
+            uint32_t after = _NewBlock(offset + size, _blocks[block].Size - size);
+            _blocks[after].PreviousPhysical = block;
+            _blocks[after].NextPhysical = _blocks[block].NextPhysical;
+            if (_blocks[block].NextPhysical != NoBlock)
+            {
+                _blocks[_blocks[block].NextPhysical].PreviousPhysical = after;
+            }
+            _blocks[block].NextPhysical = after;
+            _blocks[block].Size = size;
+            _InsertFree(after);
+        }
+
+        _blocks[block].Free = false;
+        _usedSize += size;
+        _allocatedBlocks.emplace(offset, block);
+        return offset;
+    }
+}
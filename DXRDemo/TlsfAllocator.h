@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace DXRDemo
+{
+    struct TlsfStatistics
+    {
+        uint32_t AllocationCount = 0;
+        uint32_t FreeBlockCount = 0;
+        uint64_t UsedSize = 0;
+        // Alignment padding included
+        uint64_t FreeSize = 0;
+        uint64_t LargestFreeBlock = 0;
+    };
+
+    // Two-level segregated fit allocator of ranges of a fixed size block, as
+    // used to place resources in heaps. Free ranges are kept in lists by size
+    // class, with bitmaps of the non-empty ones, so allocating and freeing take
+    // constant time whatever the number of ranges, and a freed range merges
+    // with its free neighbours. Only does the bookkeeping, the memory itself
+    // belongs to the caller.
+    //
+    // AllocateBelow is the hook for defragmentation: it places a copy of a range
+    // as low in the block as it fits, and the caller frees the original once it
+    // moved the data.
+    class TlsfAllocator final
+    {
+    public:
+        static constexpr uint64_t InvalidOffset = std::numeric_limits<uint64_t>::max();
+
+        explicit TlsfAllocator(uint64_t capacity);
+
+        // Returns the offset of the range, or InvalidOffset if no free range is
+        // large enough. Alignment must be a power of two.
+        uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+        // Same, at the lowest offset the range fits at without reaching limit
+        uint64_t AllocateBelow(uint64_t size, uint64_t alignment, uint64_t limit);
+
+        // Takes the offset Allocate returned
+        void Free(uint64_t offset);
+
+        uint64_t GetAllocationSize(uint64_t offset) const;
+
+        TlsfStatistics GetStatistics() const;
+
+        inline uint64_t GetCapacity() const
+        {
+            return _capacity;
+        }
+
+        inline bool IsEmpty() const
+        {
+            return _allocatedBlocks.empty();
+        }
+
+    private:
+        // Each power of two of sizes is split in 2^SecondLevelBits classes
+        static constexpr uint32_t SecondLevelBits = 4;
+        static constexpr uint32_t SecondLevelCount = 1 << SecondLevelBits;
+        static constexpr uint32_t FirstLevelCount = 64 - SecondLevelBits + 1;
+        static constexpr uint32_t NoBlock = std::numeric_limits<uint32_t>::max();
+
+        struct Block
+        {
+            uint64_t Offset = 0;
+            uint64_t Size = 0;
+            // Neighbours in the block, and in the free list of the size class
+            uint32_t PreviousPhysical = NoBlock;
+            uint32_t NextPhysical = NoBlock;
+            uint32_t PreviousFree = NoBlock;
+            uint32_t NextFree = NoBlock;
+            bool Free = false;
+        };
+
+        uint64_t _capacity;
+        // Indexed, as the vector grows, with the slots of merged blocks reused
+        std::vector<Block> _blocks;
+        std::vector<uint32_t> _unusedBlocks;
+        uint32_t _firstBlock = NoBlock;
+        uint64_t _firstLevelBitmap = 0;
+        uint32_t _secondLevelBitmaps[FirstLevelCount] = {};
+        uint32_t _freeLists[FirstLevelCount][SecondLevelCount];
+        uint32_t _freeBlockCount = 0;
+        uint64_t _usedSize = 0;
+        std::unordered_map<uint64_t, uint32_t> _allocatedBlocks;
+
+        static void _GetSizeClass(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+        // A free block of at least size bytes, or NoBlock
+        uint32_t _FindFreeBlock(uint64_t size) const;
+        void _InsertFree(uint32_t block);
+        void _RemoveFree(uint32_t block);
+        uint32_t _NewBlock(uint64_t offset, uint64_t size);
+        // Allocates the aligned range from a free block it fits in, splitting
+        // off what is left before and after it
+        uint64_t _Use(uint32_t block, uint64_t size, uint64_t alignment);
+    };
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace DXRDemo
+{
+    // Maps HDR radiance to the displayable range. Values match Tonemap.hlsli.
+    enum class TonemapOperator : int32_t
+    {
+        Clamp,
+        Reinhard,
+        Aces
+    };
+
+    // Root constants of the tonemap pass
+    struct TonemapSettings
+    {
+        float Exposure = 1.0f;
+        TonemapOperator Operator = TonemapOperator::Clamp;
+    };
+
+    // The tonemap pass on the CPU, for images read back from the GPU. Results
+    // are the display values in [0, 1] the back buffer receives.
+    inline void ApplyTonemap(const TonemapSettings& settings, const float radiance[3], float color[3])
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            float value = std::max(radiance[c] * settings.Exposure, 0.0f);
+            switch (settings.Operator)
+            {
+            case TonemapOperator::Reinhard:
+                value = value / (1.0f + value);
+                break;
+            case TonemapOperator::Aces:
+                // Fitted ACES filmic curve (Narkowicz 2015)
+                value = (value * (2.51f * value + 0.03f)) / (value * (2.43f * value + 0.59f) + 0.14f);
+                break;
+            default:
+                break;
+            }
+            color[c] = std::clamp(value, 0.0f, 1.0f);
+        }
+    }
+}
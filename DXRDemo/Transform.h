@@ -13,13 +13,49 @@ struct Transform final
     DirectX::SimpleMath::Quaternion Rotation;
 
     DirectX::XMMATRIX ModelMatrix = DirectX::XMMatrixIdentity();
-    Microsoft::WRL::ComPtr<ID3D12Resource> MvpBuffer;
-    inline void UpdateModelMatrix()
+
+    // State before the last simulation step that moved the transform
+    DirectX::SimpleMath::Vector3 PreviousPosition;
+    DirectX::SimpleMath::Vector3 PreviousScale = { 1.0f, 1.0f, 1.0f };
+    DirectX::SimpleMath::Quaternion PreviousRotation;
+
+    // Set while a change of the transform is waiting in the scene change journal
+    bool Dirty = true;
+
+    // Set when Position, Scale or Rotation changed during the current simulation step
+    bool Moved = false;
+
+    // Set while the rendered transform is blended between the previous and the
+    // current state
+    bool Interpolating = false;
+
+    // Makes the current state the starting point of the next simulation step
+    inline void SavePreviousState()
     {
+        PreviousPosition = Position;
+        PreviousScale = Scale;
+        PreviousRotation = Rotation;
+        Interpolating = false;
+    }
+
+    // Computes the model matrix, blending the previous and current state by
+    // interpolationFactor when the transform moved during the last step
+    inline void UpdateModelMatrix(float interpolationFactor = 1.0f)
+    {
+        if (!Interpolating)
+        {
+            ModelMatrix = XMMatrixAffineTransformation(
+                Scale,
+                DirectX::SimpleMath::Vector3(0, 0, 0),
+                Rotation,
+                Position);
+            return;
+        }
+
         ModelMatrix = XMMatrixAffineTransformation(
-            Scale,
+            DirectX::SimpleMath::Vector3::Lerp(PreviousScale, Scale, interpolationFactor),
             DirectX::SimpleMath::Vector3(0, 0, 0),
-            Rotation,
-            Position);
+            DirectX::SimpleMath::Quaternion::Slerp(PreviousRotation, Rotation, interpolationFactor),
+            DirectX::SimpleMath::Vector3::Lerp(PreviousPosition, Position, interpolationFactor));
     }
 };
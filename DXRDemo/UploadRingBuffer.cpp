@@ -0,0 +1,142 @@
+#include "UploadRingBuffer.h"
+
+#include <algorithm>
+#include <d3dx12.h>
+#include "DXRUtils/DXRHelper.h"
+#include "Utilities.h"
+
+namespace DXRDemo
+{
+    UploadRingBuffer::UploadRingBuffer(ID3D12Device* device, CommandQueue& queue, uint64_t capacity) :
+        _device(device),
+        _queue(&queue),
+        _allocator(capacity)
+    {
+        if (capacity == 0)
+        {
+            throw std::invalid_argument("An upload ring needs some capacity");
+        }
+
+        _buffer = nv_helpers_dx12::CreateBuffer(
+            device,
+            capacity,
+            D3D12_RESOURCE_FLAG_NONE,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nv_helpers_dx12::kUploadHeapProps);
+        ++_statistics.ResourceCreations;
+
+        // Upload heaps can stay mapped, the CPU only ever writes to them
+        CD3DX12_RANGE readRange(0, 0);
+        ThrowIfFailed(_buffer->Map(0, &readRange, reinterpret_cast<void**>(&_mappedData)));
+    }
+
+    UploadRingBuffer::~UploadRingBuffer()
+    {
+        _buffer->Unmap(0, nullptr);
+    }
+
+    UploadRingBuffer::Allocation UploadRingBuffer::Allocate(uint64_t size, uint64_t alignment)
+    {
+        _ReleaseCompleted();
+
+        uint64_t offset = _allocator.Allocate(size, alignment);
+        while (offset == RingAllocator::InvalidOffset && size <= _allocator.GetCapacity())
+        {
+            if (_allocator.HasRetiredRanges())
+            {
+                ++_statistics.Waits;
+                _queue->WaitForFenceValue(_allocator.GetOldestFenceValue());
+                _ReleaseCompleted();
+            }
+            else if (_commandList)
+            {
+                // The space left is held by the copies recorded so far
+                Flush();
+            }
+            else
+            {
+                // Held by copies recorded elsewhere and not submitted yet
+                break;
+            }
+
+            offset = _allocator.Allocate(size, alignment);
+        }
+
+        if (offset == RingAllocator::InvalidOffset)
+        {
+            return _AllocateDedicated(size);
+        }
+
+        _statistics.UploadedBytes += size;
+        _statistics.PeakUsedSize = std::max(_statistics.PeakUsedSize, _allocator.GetUsedSize());
+        return { _mappedData + offset, _buffer.Get(), offset };
+    }
+
+    void UploadRingBuffer::CopyBuffer(ID3D12Resource* destination, uint64_t destinationOffset, const void* data, uint64_t size)
+    {
+        // Before getting the command list, as allocating may submit the current one
+        Allocation allocation = Allocate(size);
+        memcpy(allocation.CpuAddress, data, size);
+
+        if (!_commandList)
+        {
+            _commandList = _queue->GetCommandList();
+        }
+        _commandList->CopyBufferRegion(destination, destinationOffset, allocation.Resource, allocation.Offset, size);
+    }
+
+    uint64_t UploadRingBuffer::Flush()
+    {
+        if (!_commandList)
+        {
+            return 0;
+        }
+
+        uint64_t fenceValue = _queue->ExecuteCommandList(_commandList);
+        _commandList.Reset();
+        ++_statistics.Flushes;
+        Retire(fenceValue);
+        return fenceValue;
+    }
+
+    void UploadRingBuffer::Retire(uint64_t fenceValue)
+    {
+        _allocator.Retire(fenceValue);
+        for (auto dedicated = _dedicatedBuffers.rbegin(); dedicated != _dedicatedBuffers.rend() && dedicated->FenceValue == 0; ++dedicated)
+        {
+            dedicated->FenceValue = fenceValue;
+        }
+    }
+
+    void UploadRingBuffer::_ReleaseCompleted()
+    {
+        uint64_t completedValue = _queue->GetD3D12Fence()->GetCompletedValue();
+        _allocator.Reclaim(completedValue);
+        while (!_dedicatedBuffers.empty() && _dedicatedBuffers.front().FenceValue != 0 &&
+            _dedicatedBuffers.front().FenceValue <= completedValue)
+        {
+            _dedicatedBuffers.pop_front();
+        }
+    }
+
+    UploadRingBuffer::Allocation UploadRingBuffer::_AllocateDedicated(uint64_t size)
+    {
+        Microsoft::WRL::ComPtr<ID3D12Resource> resource = nv_helpers_dx12::CreateBuffer(
+            _device,
+            size,
+            D3D12_RESOURCE_FLAG_NONE,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nv_helpers_dx12::kUploadHeapProps);
+        ++_statistics.ResourceCreations;
+        ++_statistics.DedicatedAllocations;
+        _statistics.UploadedBytes += size;
+
+        // Released with the resource
+        void* mappedData;
+        CD3DX12_RANGE readRange(0, 0);
+        ThrowIfFailed(resource->Map(0, &readRange, &mappedData));
+
+        _dedicatedBuffers.push_back({ 0, resource });
+        return { mappedData, resource.Get(), 0 };
+    }
+}
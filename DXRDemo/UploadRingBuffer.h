@@ -0,0 +1,92 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <cstdint>
+#include <deque>
+#include "CommandQueue.h"
+#include "RingAllocator.h"
+
+namespace DXRDemo
+{
+    struct UploadRingStatistics
+    {
+        // Upload resources created, the ring's own included
+        uint64_t ResourceCreations = 0;
+        // Staging that did not fit in the ring and got a resource of its own
+        uint64_t DedicatedAllocations = 0;
+        uint64_t Flushes = 0;
+        // Allocations that had to wait for the GPU to free space
+        uint64_t Waits = 0;
+        uint64_t UploadedBytes = 0;
+        uint64_t PeakUsedSize = 0;
+    };
+
+    // Upload heap buffer mapped for its whole lifetime, from which the staging
+    // memory of copies to default heap resources is suballocated in a ring. Space
+    // comes back once the queue's fence passes the submission that copied from
+    // it, so uploading a whole scene takes a single upload resource.
+    //
+    // CopyBuffer records copies into a command list of the ring's own, submitted
+    // by Flush, or when the ring runs out of space. Allocate is for copies
+    // recorded elsewhere on the same queue instead, and Retire must then be given
+    // the fence value of the submission holding them. The two are not to be mixed
+    // between submissions. Staging larger than the ring gets a resource of its
+    // own, released in the same way.
+    class UploadRingBuffer final
+    {
+    public:
+        static constexpr uint64_t DefaultAlignment = 16;
+
+        struct Allocation
+        {
+            void* CpuAddress = nullptr;
+            ID3D12Resource* Resource = nullptr;
+            uint64_t Offset = 0;
+        };
+
+        UploadRingBuffer(ID3D12Device* device, CommandQueue& queue, uint64_t capacity);
+        UploadRingBuffer(const UploadRingBuffer&) = delete;
+        UploadRingBuffer& operator=(const UploadRingBuffer&) = delete;
+        // Copies not flushed are dropped
+        ~UploadRingBuffer();
+
+        // Waits for the GPU when every byte is still in flight
+        Allocation Allocate(uint64_t size, uint64_t alignment = DefaultAlignment);
+
+        // Stages data and records its copy to destination
+        void CopyBuffer(ID3D12Resource* destination, uint64_t destinationOffset, const void* data, uint64_t size);
+
+        // Submits the copies recorded by CopyBuffer, returning the fence value
+        // marking their completion, or 0 if there were none
+        uint64_t Flush();
+
+        // The allocations made since the last call are used until fenceValue completes
+        void Retire(uint64_t fenceValue);
+
+        inline const UploadRingStatistics& GetStatistics() const
+        {
+            return _statistics;
+        }
+
+    private:
+        struct DedicatedBuffer
+        {
+            // 0 until retired
+            uint64_t FenceValue;
+            Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+        };
+
+        ID3D12Device* _device;
+        CommandQueue* _queue;
+        Microsoft::WRL::ComPtr<ID3D12Resource> _buffer;
+        uint8_t* _mappedData = nullptr;
+        RingAllocator _allocator;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> _commandList;
+        std::deque<DedicatedBuffer> _dedicatedBuffers;
+        UploadRingStatistics _statistics;
+
+        void _ReleaseCompleted();
+        Allocation _AllocateDedicated(uint64_t size);
+    };
+}
@@ -0,0 +1,229 @@
+#include "WaveletDenoiseBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "Denoiser.h"
+#include "ThreadPool.h"
+#include "WaveletDenoiser.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        struct TestFrame
+        {
+            size_t Width;
+            size_t Height;
+            std::vector<float> Color;
+            std::vector<float> Albedo;
+            std::vector<float> Normal;
+            // Noise free color
+            std::vector<float> Reference;
+        };
+
+        // RGBA float images of boxes in front of a checkered wall receding from the
+        // camera, below a strip of sky. The color has Monte Carlo like noise, the
+        // features are noise free and carry the hit distance in the normal alpha.
+        TestFrame CreateTestFrame(size_t width, size_t height)
+        {
+            TestFrame frame = { width, height };
+            frame.Color.resize(width * height * 4);
+            frame.Albedo.resize(width * height * 4);
+            frame.Normal.resize(width * height * 4);
+            frame.Reference.resize(width * height * 4);
+
+            std::mt19937 generator(0);
+            std::exponential_distribution<float> noise(1.0f);
+            const float sky[3] = { 0.4f, 0.6f, 0.9f };
+
+            for (size_t y = 0; y < height; ++y)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    size_t i = (y * width + x) * 4;
+                    float u = static_cast<float>(x) / width;
+                    float v = static_cast<float>(y) / height;
+
+                    if (v < 0.125f)
+                    {
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            frame.Color[i + c] = frame.Reference[i + c] = frame.Albedo[i + c] = sky[c];
+                        }
+                        frame.Normal[i + 3] = -1.0f;
+                    }
+                    else
+                    {
+                        size_t cell = (x * 8 / width) + (y * 8 / height) * 8;
+                        bool box = (cell % 3) == 0;
+                        bool checker = ((x / 16 + y / 16) & 1) != 0;
+
+                        float albedo[3] = { 0.8f, 0.2f, 0.1f };
+                        if (!box)
+                        {
+                            albedo[0] = albedo[1] = albedo[2] = checker ? 0.7f : 0.3f;
+                        }
+                        float normal[3] = { box ? 0.0f : 0.3f, box ? 0.0f : 0.0f, box ? -1.0f : -0.95f };
+                        float light = 0.2f + 2.0f * u * v;
+                        float sample = noise(generator);
+
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            frame.Reference[i + c] = albedo[c] * light;
+                            frame.Color[i + c] = frame.Reference[i + c] * sample;
+                            frame.Albedo[i + c] = albedo[c];
+                            frame.Normal[i + c] = normal[c];
+                        }
+                        frame.Normal[i + 3] = box ? 120.0f : 200.0f + 100.0f * v;
+                    }
+                    frame.Color[i + 3] = 1.0f;
+                    frame.Reference[i + 3] = 1.0f;
+                }
+            }
+            return frame;
+        }
+
+        // Best of several runs, in milliseconds
+        double Time(const std::function<void()>& function)
+        {
+            const int runs = 5;
+            double best = std::numeric_limits<double>::max();
+            for (int i = 0; i < runs; ++i)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                function();
+                auto end = std::chrono::high_resolution_clock::now();
+                best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+            }
+            return best;
+        }
+
+        struct Error
+        {
+            double RelativeRmse;
+            // Peak signal to noise ratio against the brightest reference value, in dB
+            double Psnr;
+        };
+
+        Error Compare(const std::vector<float>& image, const std::vector<float>& reference)
+        {
+            double squaredError = 0;
+            double squaredReference = 0;
+            double peak = 0;
+            size_t count = 0;
+            for (size_t i = 0; i < reference.size(); ++i)
+            {
+                if (i % 4 == 3)
+                {
+                    continue;
+                }
+                double error = static_cast<double>(image[i]) - reference[i];
+                squaredError += error * error;
+                squaredReference += static_cast<double>(reference[i]) * reference[i];
+                peak = std::max(peak, static_cast<double>(reference[i]));
+                ++count;
+            }
+
+            Error result;
+            result.RelativeRmse = squaredReference > 0 ? std::sqrt(squaredError / squaredReference) : 0;
+            double meanSquaredError = squaredError / std::max<size_t>(count, 1);
+            result.Psnr = meanSquaredError > 0 ? 10.0 * std::log10(peak * peak / meanSquaredError) : std::numeric_limits<double>::infinity();
+            return result;
+        }
+    }
+
+    void RunWaveletDenoiseBenchmark(const std::string& filename, ThreadPool& threadPool)
+    {
+        std::ofstream file(filename);
+        if (!file)
+        {
+            throw std::runtime_error("Could not open benchmark file for writing");
+        }
+
+        struct Resolution
+        {
+            size_t Width;
+            size_t Height;
+        };
+        const Resolution resolutions[] = { { 800, 600 }, { 1920, 1080 } };
+        const DenoiseQuality qualities[] = { DenoiseQuality::Fast, DenoiseQuality::Balanced, DenoiseQuality::High };
+        const char* qualityNames[] = { "fast", "balanced", "high" };
+
+        file << "width,height,denoiser,quality,vectorized,ms,relative_rmse,psnr_db,relative_rmse_vs_oidn\n";
+        for (const Resolution& resolution : resolutions)
+        {
+            TestFrame frame = CreateTestFrame(resolution.Width, resolution.Height);
+            size_t rowPitch = frame.Width * 4 * sizeof(float);
+            std::vector<float> output(frame.Color.size());
+
+            auto write = [&](const char* denoiser, const char* quality, const char* vectorized, double milliseconds,
+                const std::vector<float>& image, const std::vector<float>* oidn)
+            {
+                Error error = Compare(image, frame.Reference);
+                file << frame.Width << "," << frame.Height << "," << denoiser << "," << quality << "," << vectorized << ","
+                    << milliseconds << "," << error.RelativeRmse << "," << error.Psnr << ",";
+                if (oidn != nullptr)
+                {
+                    file << Compare(image, *oidn).RelativeRmse;
+                }
+                file << "\n";
+            };
+
+            write("none", "", "", 0, frame.Color, nullptr);
+
+            // Open Image Denoise at high quality is what the wavelet filter is held
+            // against, if it can run here at all. OIDN has no fast mode.
+            std::vector<float> oidnHigh;
+            for (DenoiseQuality quality : { DenoiseQuality::High, DenoiseQuality::Balanced })
+            {
+                std::unique_ptr<Denoiser> denoiser;
+                try
+                {
+                    denoiser = std::make_unique<Denoiser>(frame.Width, frame.Height, DXGI_FORMAT_R32G32B32A32_FLOAT,
+                        threadPool, DenoiseTiling{}, quality);
+                }
+                catch (const std::exception&)
+                {
+                    break;
+                }
+
+                // The first run includes one-time initialization
+                denoiser->Denoise(frame.Color.data(), frame.Albedo.data(), frame.Normal.data(), rowPitch, output.data(), rowPitch);
+                double milliseconds = Time([&]()
+                {
+                    denoiser->Denoise(frame.Color.data(), frame.Albedo.data(), frame.Normal.data(), rowPitch, output.data(), rowPitch);
+                });
+
+                bool high = quality == DenoiseQuality::High;
+                write("oidn", qualityNames[static_cast<int>(quality)], "", milliseconds, output, high ? nullptr : &oidnHigh);
+                if (high)
+                {
+                    oidnHigh = output;
+                }
+            }
+
+            for (size_t q = 0; q < std::size(qualities); ++q)
+            {
+                WaveletDenoiser denoiser(frame.Width, frame.Height, DXGI_FORMAT_R32G32B32A32_FLOAT, threadPool, qualities[q]);
+                for (bool vectorized : { false, true })
+                {
+                    denoiser.SetVectorized(vectorized);
+                    double milliseconds = Time([&]()
+                    {
+                        denoiser.Denoise(frame.Color.data(), frame.Albedo.data(), frame.Normal.data(), rowPitch, output.data(), rowPitch);
+                    });
+                    write("wavelet", qualityNames[q], vectorized ? "true" : "false", milliseconds, output,
+                        oidnHigh.empty() ? nullptr : &oidnHigh);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+namespace DXRDemo
+{
+    class ThreadPool;
+
+    // Denoises a synthetic noisy frame with known noise free radiance using the
+    // wavelet filter, scalar and vectorized, and Open Image Denoise, and writes
+    // the timings and the errors against the noise free radiance and against the
+    // high quality Open Image Denoise result as CSV
+    void RunWaveletDenoiseBenchmark(const std::string& filename, ThreadPool& threadPool);
+}
@@ -0,0 +1,508 @@
+#include "WaveletDenoiser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+#include <stdexcept>
+#include "CpuFeatures.h"
+#include "PixelConversion.h"
+
+namespace DXRDemo
+{
+    namespace
+    {
+        // B3 spline
+        const float Kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+        // Lowest albedo the radiance is divided by, so black surfaces stay finite
+        const float MinAlbedo = 1e-2f;
+        // Depth difference always tolerated, relative to the depth, as the hit
+        // distance of a flat surface facing the camera has no gradient to go by
+        const float DepthEpsilon = 1e-2f;
+        const float LuminanceEpsilon = 1e-4f;
+
+        // Pointers into the planes of one filter pass
+        struct Pass
+        {
+            std::size_t Width;
+            std::size_t Height;
+            std::ptrdiff_t Step;
+            const float* Input[4];
+            float* Output[4];
+            const float* Normal[3];
+            const float* Depth;
+            const float* Gradient[2];
+            float LuminanceSigma;
+            float DepthSigma;
+        };
+
+        inline float Luminance(float red, float green, float blue)
+        {
+            return 0.2126f * red + 0.7152f * green + 0.0722f * blue;
+        }
+
+        // RGBA pixels of a row as floats
+        void LoadPixels(const uint8_t* source, DXGI_FORMAT format, float* destination, std::size_t pixelCount)
+        {
+            if (format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+            {
+                std::memcpy(destination, source, pixelCount * 4 * sizeof(float));
+                return;
+            }
+
+            PixelConversion::Rgba16fToRgba32f(reinterpret_cast<const uint16_t*>(source), destination, pixelCount);
+        }
+
+        namespace Scalar
+        {
+            inline float NormalWeight(float cosine)
+            {
+                // Cosine to the power of 128, as in SVGF
+                float weight = std::max(cosine, 0.0f);
+                for (int i = 0; i < 7; ++i)
+                {
+                    weight *= weight;
+                }
+                return weight;
+            }
+
+            void FilterRow(const Pass& pass, std::size_t y, std::size_t xBegin, std::size_t xEnd)
+            {
+                const std::ptrdiff_t width = static_cast<std::ptrdiff_t>(pass.Width);
+                const std::ptrdiff_t height = static_cast<std::ptrdiff_t>(pass.Height);
+
+                for (std::size_t x = xBegin; x < xEnd; ++x)
+                {
+                    std::size_t i = y * pass.Width + x;
+                    float depth = pass.Depth[i];
+                    float luminance = Luminance(pass.Input[0][i], pass.Input[1][i], pass.Input[2][i]);
+                    float luminanceScale = 1.0f / (pass.LuminanceSigma * std::sqrt(std::max(pass.Input[3][i], 0.0f)) + LuminanceEpsilon);
+
+                    float centerWeight = Kernel[2] * Kernel[2];
+                    float sum[3] = {
+                        centerWeight * pass.Input[0][i],
+                        centerWeight * pass.Input[1][i],
+                        centerWeight * pass.Input[2][i] };
+                    float weightSum = centerWeight;
+                    float varianceSum = centerWeight * centerWeight * pass.Input[3][i];
+
+                    for (std::ptrdiff_t dy = -2; dy <= 2; ++dy)
+                    {
+                        std::ptrdiff_t tapY = static_cast<std::ptrdiff_t>(y) + dy * pass.Step;
+                        if (tapY < 0 || tapY >= height)
+                        {
+                            continue;
+                        }
+
+                        for (std::ptrdiff_t dx = -2; dx <= 2; ++dx)
+                        {
+                            std::ptrdiff_t tapX = static_cast<std::ptrdiff_t>(x) + dx * pass.Step;
+                            if (tapX < 0 || tapX >= width || (dx == 0 && dy == 0))
+                            {
+                                continue;
+                            }
+
+                            std::size_t j = tapY * pass.Width + tapX;
+                            float tapDepth = pass.Depth[j];
+                            float exponent = std::abs(luminance - Luminance(pass.Input[0][j], pass.Input[1][j], pass.Input[2][j])) * luminanceScale;
+
+                            // Background only blends with background
+                            float geometry;
+                            if (depth < 0 || tapDepth < 0)
+                            {
+                                geometry = depth < 0 && tapDepth < 0 ? 1.0f : 0.0f;
+                            }
+                            else
+                            {
+                                float expected = std::abs(pass.Gradient[0][i] * (dx * pass.Step) + pass.Gradient[1][i] * (dy * pass.Step));
+                                exponent += std::abs(depth - tapDepth) / (pass.DepthSigma * expected + DepthEpsilon * depth);
+                                geometry = NormalWeight(
+                                    pass.Normal[0][i] * pass.Normal[0][j] +
+                                    pass.Normal[1][i] * pass.Normal[1][j] +
+                                    pass.Normal[2][i] * pass.Normal[2][j]);
+                            }
+
+                            float weight = Kernel[dx + 2] * Kernel[dy + 2] * geometry * std::exp(-exponent);
+                            sum[0] += weight * pass.Input[0][j];
+                            sum[1] += weight * pass.Input[1][j];
+                            sum[2] += weight * pass.Input[2][j];
+                            weightSum += weight;
+                            varianceSum += weight * weight * pass.Input[3][j];
+                        }
+                    }
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        pass.Output[c][i] = sum[c] / weightSum;
+                    }
+                    pass.Output[3][i] = varianceSum / (weightSum * weightSum);
+                }
+            }
+        }
+
+        namespace Avx2
+        {
+            // e^x for x <= 0 to about 1e-6 relative, plenty for weights
+            inline __m256 Exp(__m256 x)
+            {
+                x = _mm256_max_ps(x, _mm256_set1_ps(-87.0f));
+                __m256 t = _mm256_mul_ps(x, _mm256_set1_ps(1.44269504f));
+                __m256 n = _mm256_round_ps(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                __m256 f = _mm256_sub_ps(t, n);
+
+                // 2^f on [-0.5, 0.5]
+                __m256 p = _mm256_set1_ps(1.3333558e-3f);
+                p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(9.6181291e-3f));
+                p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(5.5504109e-2f));
+                p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(2.4022651e-1f));
+                p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(6.9314718e-1f));
+                p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+
+                // 2^n built in the exponent bits
+                __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+                return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+            }
+
+            inline __m256 Luminance(__m256 red, __m256 green, __m256 blue)
+            {
+                return _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(red, _mm256_set1_ps(0.2126f)),
+                    _mm256_mul_ps(green, _mm256_set1_ps(0.7152f))),
+                    _mm256_mul_ps(blue, _mm256_set1_ps(0.0722f)));
+            }
+
+            // Filters blocks of eight pixels from xBegin, as long as they fit before
+            // xEnd, and returns where it stopped. Every tap of the pixels in
+            // [xBegin, xEnd) must be within the row.
+            std::size_t FilterRow(const Pass& pass, std::size_t y, std::size_t xBegin, std::size_t xEnd)
+            {
+                const std::ptrdiff_t height = static_cast<std::ptrdiff_t>(pass.Height);
+                const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+                const __m256 zero = _mm256_setzero_ps();
+                const __m256 one = _mm256_set1_ps(1.0f);
+                const __m256 luminanceSigma = _mm256_set1_ps(pass.LuminanceSigma);
+                const __m256 depthSigma = _mm256_set1_ps(pass.DepthSigma);
+
+                std::size_t x = xBegin;
+                for (; x + 8 <= xEnd; x += 8)
+                {
+                    std::size_t i = y * pass.Width + x;
+                    __m256 depth = _mm256_loadu_ps(pass.Depth + i);
+                    __m256 normal[3] = {
+                        _mm256_loadu_ps(pass.Normal[0] + i),
+                        _mm256_loadu_ps(pass.Normal[1] + i),
+                        _mm256_loadu_ps(pass.Normal[2] + i) };
+                    __m256 gradientX = _mm256_loadu_ps(pass.Gradient[0] + i);
+                    __m256 gradientY = _mm256_loadu_ps(pass.Gradient[1] + i);
+                    __m256 input[4] = {
+                        _mm256_loadu_ps(pass.Input[0] + i),
+                        _mm256_loadu_ps(pass.Input[1] + i),
+                        _mm256_loadu_ps(pass.Input[2] + i),
+                        _mm256_loadu_ps(pass.Input[3] + i) };
+
+                    __m256 luminance = Luminance(input[0], input[1], input[2]);
+                    __m256 luminanceScale = _mm256_div_ps(one, _mm256_add_ps(
+                        _mm256_mul_ps(luminanceSigma, _mm256_sqrt_ps(_mm256_max_ps(input[3], zero))),
+                        _mm256_set1_ps(LuminanceEpsilon)));
+                    __m256 depthTolerance = _mm256_mul_ps(depth, _mm256_set1_ps(DepthEpsilon));
+                    __m256 miss = _mm256_cmp_ps(depth, zero, _CMP_LT_OQ);
+
+                    __m256 centerWeight = _mm256_set1_ps(Kernel[2] * Kernel[2]);
+                    __m256 sum[3] = {
+                        _mm256_mul_ps(centerWeight, input[0]),
+                        _mm256_mul_ps(centerWeight, input[1]),
+                        _mm256_mul_ps(centerWeight, input[2]) };
+                    __m256 weightSum = centerWeight;
+                    __m256 varianceSum = _mm256_mul_ps(_mm256_mul_ps(centerWeight, centerWeight), input[3]);
+
+                    for (std::ptrdiff_t dy = -2; dy <= 2; ++dy)
+                    {
+                        std::ptrdiff_t tapY = static_cast<std::ptrdiff_t>(y) + dy * pass.Step;
+                        if (tapY < 0 || tapY >= height)
+                        {
+                            continue;
+                        }
+
+                        for (std::ptrdiff_t dx = -2; dx <= 2; ++dx)
+                        {
+                            if (dx == 0 && dy == 0)
+                            {
+                                continue;
+                            }
+
+                            std::size_t j = tapY * pass.Width + x + dx * pass.Step;
+                            __m256 tapDepth = _mm256_loadu_ps(pass.Depth + j);
+                            __m256 tap[4] = {
+                                _mm256_loadu_ps(pass.Input[0] + j),
+                                _mm256_loadu_ps(pass.Input[1] + j),
+                                _mm256_loadu_ps(pass.Input[2] + j),
+                                _mm256_loadu_ps(pass.Input[3] + j) };
+
+                            __m256 exponent = _mm256_mul_ps(
+                                _mm256_and_ps(_mm256_sub_ps(luminance, Luminance(tap[0], tap[1], tap[2])), absMask),
+                                luminanceScale);
+
+                            __m256 tapMiss = _mm256_cmp_ps(tapDepth, zero, _CMP_LT_OQ);
+                            __m256 anyMiss = _mm256_or_ps(miss, tapMiss);
+                            __m256 bothMiss = _mm256_and_ps(miss, tapMiss);
+
+                            __m256 expected = _mm256_and_ps(_mm256_add_ps(
+                                _mm256_mul_ps(gradientX, _mm256_set1_ps(static_cast<float>(dx * pass.Step))),
+                                _mm256_mul_ps(gradientY, _mm256_set1_ps(static_cast<float>(dy * pass.Step)))), absMask);
+                            // An approximate reciprocal is accurate enough for a weight
+                            __m256 depthTerm = _mm256_mul_ps(
+                                _mm256_and_ps(_mm256_sub_ps(depth, tapDepth), absMask),
+                                _mm256_rcp_ps(_mm256_add_ps(_mm256_mul_ps(depthSigma, expected), depthTolerance)));
+                            // Lanes with a miss have no depth term, whatever it computed to
+                            exponent = _mm256_add_ps(exponent, _mm256_andnot_ps(anyMiss, depthTerm));
+
+                            __m256 cosine = _mm256_add_ps(_mm256_add_ps(
+                                _mm256_mul_ps(normal[0], _mm256_loadu_ps(pass.Normal[0] + j)),
+                                _mm256_mul_ps(normal[1], _mm256_loadu_ps(pass.Normal[1] + j))),
+                                _mm256_mul_ps(normal[2], _mm256_loadu_ps(pass.Normal[2] + j)));
+                            __m256 normalWeight = _mm256_max_ps(cosine, zero);
+                            for (int k = 0; k < 7; ++k)
+                            {
+                                normalWeight = _mm256_mul_ps(normalWeight, normalWeight);
+                            }
+                            __m256 geometry = _mm256_blendv_ps(normalWeight, _mm256_and_ps(bothMiss, one), anyMiss);
+
+                            __m256 weight = _mm256_mul_ps(
+                                _mm256_mul_ps(_mm256_set1_ps(Kernel[dx + 2] * Kernel[dy + 2]), geometry),
+                                Exp(_mm256_sub_ps(zero, exponent)));
+                            for (int c = 0; c < 3; ++c)
+                            {
+                                sum[c] = _mm256_add_ps(sum[c], _mm256_mul_ps(weight, tap[c]));
+                            }
+                            weightSum = _mm256_add_ps(weightSum, weight);
+                            varianceSum = _mm256_add_ps(varianceSum, _mm256_mul_ps(_mm256_mul_ps(weight, weight), tap[3]));
+                        }
+                    }
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        _mm256_storeu_ps(pass.Output[c] + i, _mm256_div_ps(sum[c], weightSum));
+                    }
+                    _mm256_storeu_ps(pass.Output[3] + i, _mm256_div_ps(varianceSum, _mm256_mul_ps(weightSum, weightSum)));
+                }
+
+                return x;
+            }
+        }
+    }
+
+    WaveletDenoiser::WaveletDenoiser(std::size_t width, std::size_t height, DXGI_FORMAT format, ThreadPool& threadPool,
+        DenoiseQuality quality, const WaveletDenoising& settings) :
+        _width(width),
+        _height(height),
+        _format(format),
+        _threadPool(&threadPool),
+        _settings(settings)
+    {
+        if (_format != DXGI_FORMAT_R16G16B16A16_FLOAT && _format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+        {
+            throw std::invalid_argument("Unsupported denoiser image format");
+        }
+
+        if (_settings.Iterations == 0)
+        {
+            switch (quality)
+            {
+            case DenoiseQuality::Fast:
+                _settings.Iterations = 3;
+                break;
+            case DenoiseQuality::Balanced:
+                _settings.Iterations = 4;
+                break;
+            case DenoiseQuality::High:
+            default:
+                _settings.Iterations = 5;
+                break;
+            }
+        }
+
+        std::size_t pixelCount = _width * _height;
+        _illumination[0].resize(4 * pixelCount);
+        _illumination[1].resize(4 * pixelCount);
+        _albedo.resize(3 * pixelCount);
+        _guide.resize(6 * pixelCount);
+    }
+
+    void WaveletDenoiser::Denoise(const void* image, const void* albedo, const void* normal, std::size_t inputRowPitch,
+        void* output, std::size_t outputRowPitch)
+    {
+        _Load(image, albedo, normal, inputRowPitch);
+        _EstimateVariance();
+
+        for (uint32_t i = 0; i < _settings.Iterations; ++i)
+        {
+            _Filter(std::size_t(1) << i, _illumination[i % 2], _illumination[(i + 1) % 2]);
+        }
+
+        _Store(_illumination[_settings.Iterations % 2], output, outputRowPitch);
+    }
+
+    void WaveletDenoiser::_Load(const void* image, const void* albedo, const void* normal, std::size_t rowPitch)
+    {
+        std::size_t pixelCount = _width * _height;
+
+        _threadPool->ParallelFor(_height, 16, [&](std::size_t begin, std::size_t end)
+        {
+            std::vector<float> colors(_width * 4);
+            std::vector<float> albedos(_width * 4);
+            std::vector<float> normals(_width * 4);
+
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                LoadPixels(static_cast<const uint8_t*>(image) + y * rowPitch, _format, colors.data(), _width);
+                LoadPixels(static_cast<const uint8_t*>(albedo) + y * rowPitch, _format, albedos.data(), _width);
+                LoadPixels(static_cast<const uint8_t*>(normal) + y * rowPitch, _format, normals.data(), _width);
+
+                for (std::size_t x = 0; x < _width; ++x)
+                {
+                    std::size_t i = y * _width + x;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        float surfaceAlbedo = std::max(albedos[x * 4 + c], MinAlbedo);
+                        _albedo[c * pixelCount + i] = surfaceAlbedo;
+                        _illumination[0][c * pixelCount + i] = colors[x * 4 + c] / surfaceAlbedo;
+                        _guide[c * pixelCount + i] = normals[x * 4 + c];
+                    }
+                    _guide[3 * pixelCount + i] = normals[x * 4 + 3];
+                }
+            }
+        });
+    }
+
+    void WaveletDenoiser::_EstimateVariance()
+    {
+        std::size_t pixelCount = _width * _height;
+        const float* red = &_illumination[0][0];
+        const float* green = &_illumination[0][pixelCount];
+        const float* blue = &_illumination[0][2 * pixelCount];
+        float* variance = &_illumination[0][3 * pixelCount];
+        const float* depth = &_guide[3 * pixelCount];
+        float* gradientX = &_guide[4 * pixelCount];
+        float* gradientY = &_guide[5 * pixelCount];
+
+        // Depth difference per pixel between two hits, 0 when either is a miss
+        auto difference = [depth](std::size_t a, std::size_t b, float distance)
+        {
+            return depth[a] >= 0 && depth[b] >= 0 ? (depth[b] - depth[a]) / distance : 0.0f;
+        };
+
+        _threadPool->ParallelFor(_height, 16, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                std::size_t top = y > 0 ? y - 1 : y;
+                std::size_t bottom = y + 1 < _height ? y + 1 : y;
+
+                for (std::size_t x = 0; x < _width; ++x)
+                {
+                    std::size_t left = x > 0 ? x - 1 : x;
+                    std::size_t right = x + 1 < _width ? x + 1 : x;
+                    std::size_t i = y * _width + x;
+
+                    gradientX[i] = right != left ? difference(y * _width + left, y * _width + right, static_cast<float>(right - left)) : 0.0f;
+                    gradientY[i] = bottom != top ? difference(top * _width + x, bottom * _width + x, static_cast<float>(bottom - top)) : 0.0f;
+
+                    // Luminance moments over the 3x3 neighborhood, the frame
+                    // has no history to estimate them over time
+                    float moment = 0;
+                    float squaredMoment = 0;
+                    for (std::size_t tapY = top; tapY <= bottom; ++tapY)
+                    {
+                        for (std::size_t tapX = left; tapX <= right; ++tapX)
+                        {
+                            std::size_t j = tapY * _width + tapX;
+                            float luminance = Luminance(red[j], green[j], blue[j]);
+                            moment += luminance;
+                            squaredMoment += luminance * luminance;
+                        }
+                    }
+                    float tapCount = static_cast<float>((bottom - top + 1) * (right - left + 1));
+                    moment /= tapCount;
+                    variance[i] = std::max(squaredMoment / tapCount - moment * moment, 0.0f);
+                }
+            }
+        });
+    }
+
+    void WaveletDenoiser::_Filter(std::size_t step, const std::vector<float>& input, std::vector<float>& output)
+    {
+        std::size_t pixelCount = _width * _height;
+        Pass pass;
+        pass.Width = _width;
+        pass.Height = _height;
+        pass.Step = static_cast<std::ptrdiff_t>(step);
+        for (int c = 0; c < 4; ++c)
+        {
+            pass.Input[c] = &input[c * pixelCount];
+            pass.Output[c] = &output[c * pixelCount];
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            pass.Normal[c] = &_guide[c * pixelCount];
+        }
+        pass.Depth = &_guide[3 * pixelCount];
+        pass.Gradient[0] = &_guide[4 * pixelCount];
+        pass.Gradient[1] = &_guide[5 * pixelCount];
+        pass.LuminanceSigma = _settings.LuminanceSigma;
+        pass.DepthSigma = _settings.DepthSigma;
+
+        bool vectorized = _vectorized && GetCpuFeatures().Avx2;
+        // Pixels whose taps all fall within their row
+        std::size_t margin = 2 * step;
+
+        _threadPool->ParallelFor(_height, 8, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                if (vectorized && _width > 2 * margin)
+                {
+                    Scalar::FilterRow(pass, y, 0, margin);
+                    std::size_t done = Avx2::FilterRow(pass, y, margin, _width - margin);
+                    Scalar::FilterRow(pass, y, done, _width);
+                }
+                else
+                {
+                    Scalar::FilterRow(pass, y, 0, _width);
+                }
+            }
+        });
+    }
+
+    void WaveletDenoiser::_Store(const std::vector<float>& illumination, void* output, std::size_t rowPitch)
+    {
+        std::size_t pixelCount = _width * _height;
+
+        _threadPool->ParallelFor(_height, 16, [&](std::size_t begin, std::size_t end)
+        {
+            std::vector<float> colors(_width * 4);
+
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                for (std::size_t x = 0; x < _width; ++x)
+                {
+                    std::size_t i = y * _width + x;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        colors[x * 4 + c] = illumination[c * pixelCount + i] * _albedo[c * pixelCount + i];
+                    }
+                    colors[x * 4 + 3] = 1.0f;
+                }
+
+                uint8_t* row = static_cast<uint8_t*>(output) + y * rowPitch;
+                if (_format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+                {
+                    std::memcpy(row, colors.data(), _width * 4 * sizeof(float));
+                }
+                else
+                {
+                    PixelConversion::Rgba32fToRgba16f(colors.data(), reinterpret_cast<uint16_t*>(row), _width);
+                }
+            }
+        });
+    }
+}
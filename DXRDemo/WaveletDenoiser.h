@@ -0,0 +1,79 @@
+#pragma once
+
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "DenoiseQuality.h"
+#include "ImageDenoiser.h"
+#include "ThreadPool.h"
+
+namespace DXRDemo
+{
+    struct WaveletDenoising
+    {
+        // Filter passes, each one twice as wide as the previous one. 0 picks them
+        // from the quality, 3 for Fast up to 5 for High.
+        uint32_t Iterations = 0;
+        // Luminance differences stop the filter past this many standard deviations
+        // of the noise
+        float LuminanceSigma = 4.0f;
+        // Depth differences stop the filter past this many times the difference
+        // the depth gradient predicts
+        float DepthSigma = 1.0f;
+    };
+
+    // Edge-avoiding à-trous wavelet filter in the spirit of SVGF, a lightweight
+    // alternative to Open Image Denoise that runs in milliseconds on any CPU.
+    //
+    // The radiance is divided by the albedo so that only the noisy illumination is
+    // blurred, then filtered with a 5x5 B3 spline kernel whose taps spread further
+    // apart every pass. Tap weights fall off with the normal and depth difference
+    // to the center pixel and with its luminance difference relative to the noise,
+    // estimated from the local luminance variance and filtered along. The normal
+    // feature carries the hit distance in its alpha, negative where nothing was hit.
+    //
+    // Rows are split across the thread pool, and filtered eight pixels at a time
+    // with AVX2 when the CPU has it.
+    class WaveletDenoiser final : public ImageDenoiser
+    {
+    public:
+        // Images are DXGI_FORMAT_R16G16B16A16_FLOAT or DXGI_FORMAT_R32G32B32A32_FLOAT
+        WaveletDenoiser(std::size_t width, std::size_t height, DXGI_FORMAT format, ThreadPool& threadPool,
+            DenoiseQuality quality = DenoiseQuality::High, const WaveletDenoising& settings = {});
+
+        void Denoise(const void* image, const void* albedo, const void* normal, std::size_t inputRowPitch,
+            void* output, std::size_t outputRowPitch) override;
+
+        // Whether to use the AVX2 kernels when the CPU has them, for comparing them
+        // with the scalar ones
+        inline void SetVectorized(bool vectorized)
+        {
+            _vectorized = vectorized;
+        }
+
+        inline uint32_t GetIterations() const
+        {
+            return _settings.Iterations;
+        }
+
+    private:
+        std::size_t _width;
+        std::size_t _height;
+        DXGI_FORMAT _format;
+        ThreadPool* _threadPool;
+        WaveletDenoising _settings;
+        bool _vectorized = true;
+        // Planes of width * height floats. The illumination holds red, green, blue
+        // and the luminance variance and is ping-ponged between passes. The guide
+        // holds the normal, the depth and the depth gradient along x and y.
+        std::vector<float> _illumination[2];
+        std::vector<float> _albedo;
+        std::vector<float> _guide;
+
+        void _Load(const void* image, const void* albedo, const void* normal, std::size_t rowPitch);
+        void _EstimateVariance();
+        void _Filter(std::size_t step, const std::vector<float>& input, std::vector<float>& output);
+        void _Store(const std::vector<float>& illumination, void* output, std::size_t rowPitch);
+    };
+}
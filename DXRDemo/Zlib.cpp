@@ -0,0 +1,572 @@
+#include "Zlib.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace DXRDemo
+{
+    namespace
+    {
+        constexpr std::size_t WindowSize = 32768;
+        constexpr std::size_t MinMatch = 3;
+        constexpr std::size_t MaxMatch = 258;
+        constexpr int HashBits = 15;
+        // Candidates tried per position, and the match length that ends the search
+        // early, trading compression for speed
+        constexpr int MaxChainLength = 8;
+        constexpr std::size_t NiceMatch = 32;
+        // Longer matches leave the positions inside them out of the hash chains
+        constexpr std::size_t MaxInsertMatch = 16;
+        // Tokens per block before its Huffman codes are rebuilt
+        constexpr std::size_t BlockTokens = 1 << 15;
+        constexpr std::size_t MaxStoredBlockSize = 65535;
+
+        constexpr int LiteralLengthSymbols = 286;
+        constexpr int DistanceSymbols = 30;
+        constexpr int CodeLengthSymbols = 19;
+        constexpr int EndOfBlock = 256;
+
+        constexpr uint16_t LengthBase[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        constexpr uint8_t LengthExtraBits[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        constexpr uint16_t DistanceBase[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        constexpr uint8_t DistanceExtraBits[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        // Order the code length code lengths are sent in
+        constexpr uint8_t CodeLengthOrder[CodeLengthSymbols] = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        // Writes bits least significant first, as deflate packs them
+        class BitWriter final
+        {
+        public:
+            explicit BitWriter(std::vector<uint8_t>& output) :
+                _output(&output)
+            {
+            }
+
+            void Write(uint32_t bits, int count)
+            {
+                _buffer |= static_cast<uint64_t>(bits) << _count;
+                _count += count;
+                while (_count >= 8)
+                {
+                    _output->push_back(static_cast<uint8_t>(_buffer));
+                    _buffer >>= 8;
+                    _count -= 8;
+                }
+            }
+
+            void AlignToByte()
+            {
+                if (_count > 0)
+                {
+                    _output->push_back(static_cast<uint8_t>(_buffer));
+                    _buffer = 0;
+                    _count = 0;
+                }
+            }
+
+        private:
+            std::vector<uint8_t>* _output;
+            uint64_t _buffer = 0;
+            int _count = 0;
+        };
+
+        // A literal byte, or a match when the distance is not 0
+        struct Token
+        {
+            uint16_t LiteralOrLength;
+            uint16_t Distance;
+        };
+
+        int LengthSymbol(std::size_t length)
+        {
+            return static_cast<int>(std::upper_bound(std::begin(LengthBase), std::end(LengthBase), length) - std::begin(LengthBase)) - 1;
+        }
+
+        int DistanceSymbol(std::size_t distance)
+        {
+            return static_cast<int>(std::upper_bound(std::begin(DistanceBase), std::end(DistanceBase), distance) - std::begin(DistanceBase)) - 1;
+        }
+
+        // Huffman code lengths of at most maxLength bits for the frequencies. When the
+        // tree gets too deep the frequencies are flattened until it fits. At least two
+        // symbols get a code, as a decoder needs a complete code.
+        std::vector<uint8_t> BuildLengths(std::vector<uint32_t> frequencies, int maxLength)
+        {
+            int used = static_cast<int>(std::count_if(frequencies.begin(), frequencies.end(), [](uint32_t frequency) { return frequency > 0; }));
+            for (std::size_t symbol = 0; used < 2; ++symbol)
+            {
+                if (frequencies[symbol] == 0)
+                {
+                    frequencies[symbol] = 1;
+                    ++used;
+                }
+            }
+
+            std::vector<uint8_t> lengths(frequencies.size(), 0);
+            while (true)
+            {
+                using Node = std::pair<uint64_t, int>;
+                std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+                std::vector<int> parents;
+                for (std::size_t symbol = 0; symbol < frequencies.size(); ++symbol)
+                {
+                    if (frequencies[symbol] > 0)
+                    {
+                        queue.push({ frequencies[symbol], static_cast<int>(parents.size()) });
+                        parents.push_back(-1);
+                    }
+                }
+                while (queue.size() > 1)
+                {
+                    Node first = queue.top();
+                    queue.pop();
+                    Node second = queue.top();
+                    queue.pop();
+                    int parent = static_cast<int>(parents.size());
+                    parents.push_back(-1);
+                    parents[first.second] = parent;
+                    parents[second.second] = parent;
+                    queue.push({ first.first + second.first, parent });
+                }
+
+                int leaf = 0;
+                int deepest = 0;
+                for (std::size_t symbol = 0; symbol < frequencies.size(); ++symbol)
+                {
+                    if (frequencies[symbol] == 0)
+                    {
+                        continue;
+                    }
+                    int depth = 0;
+                    for (int node = leaf; parents[node] >= 0; node = parents[node])
+                    {
+                        ++depth;
+                    }
+                    lengths[symbol] = static_cast<uint8_t>(depth);
+                    deepest = std::max(deepest, depth);
+                    ++leaf;
+                }
+
+                if (deepest <= maxLength)
+                {
+                    return lengths;
+                }
+                for (uint32_t& frequency : frequencies)
+                {
+                    if (frequency > 0)
+                    {
+                        frequency = (frequency + 1) / 2;
+                    }
+                }
+            }
+        }
+
+        // Canonical codes for the lengths, bit reversed since deflate sends Huffman
+        // codes most significant bit first
+        std::vector<uint16_t> BuildCodes(const std::vector<uint8_t>& lengths)
+        {
+            std::array<uint16_t, 16> lengthCounts = {};
+            for (uint8_t length : lengths)
+            {
+                ++lengthCounts[length];
+            }
+            lengthCounts[0] = 0;
+
+            std::array<uint16_t, 16> nextCodes = {};
+            uint16_t code = 0;
+            for (int length = 1; length < 16; ++length)
+            {
+                code = static_cast<uint16_t>((code + lengthCounts[length - 1]) << 1);
+                nextCodes[length] = code;
+            }
+
+            std::vector<uint16_t> codes(lengths.size(), 0);
+            for (std::size_t symbol = 0; symbol < lengths.size(); ++symbol)
+            {
+                int length = lengths[symbol];
+                if (length == 0)
+                {
+                    continue;
+                }
+                uint16_t canonical = nextCodes[length]++;
+                uint16_t reversed = 0;
+                for (int bit = 0; bit < length; ++bit)
+                {
+                    reversed = static_cast<uint16_t>((reversed << 1) | ((canonical >> bit) & 1));
+                }
+                codes[symbol] = reversed;
+            }
+            return codes;
+        }
+
+        void WriteStoredBlocks(BitWriter& writer, const uint8_t* data, std::size_t size, bool final)
+        {
+            std::size_t offset = 0;
+            do
+            {
+                std::size_t blockSize = std::min(size - offset, MaxStoredBlockSize);
+                bool last = final && offset + blockSize == size;
+                writer.Write(last ? 1 : 0, 1);
+                writer.Write(0, 2);
+                writer.AlignToByte();
+                writer.Write(static_cast<uint32_t>(blockSize), 16);
+                writer.Write(static_cast<uint32_t>(~blockSize & 0xFFFF), 16);
+                for (std::size_t i = 0; i < blockSize; ++i)
+                {
+                    writer.Write(data[offset + i], 8);
+                }
+                offset += blockSize;
+            } while (offset < size);
+        }
+
+        // Writes the tokens as a block with dynamic Huffman codes, or the data they
+        // encode as stored blocks if that is smaller
+        void WriteBlock(BitWriter& writer, const std::vector<Token>& tokens, const uint8_t* data, std::size_t size, bool final)
+        {
+            std::vector<uint32_t> literalFrequencies(LiteralLengthSymbols, 0);
+            std::vector<uint32_t> distanceFrequencies(DistanceSymbols, 0);
+            for (const Token& token : tokens)
+            {
+                if (token.Distance == 0)
+                {
+                    ++literalFrequencies[token.LiteralOrLength];
+                }
+                else
+                {
+                    ++literalFrequencies[257 + LengthSymbol(token.LiteralOrLength)];
+                    ++distanceFrequencies[DistanceSymbol(token.Distance)];
+                }
+            }
+            literalFrequencies[EndOfBlock] = 1;
+
+            std::vector<uint8_t> literalLengths = BuildLengths(literalFrequencies, 15);
+            std::vector<uint8_t> distanceLengths = BuildLengths(distanceFrequencies, 15);
+
+            int literalCount = LiteralLengthSymbols;
+            while (literalCount > 257 && literalLengths[literalCount - 1] == 0)
+            {
+                --literalCount;
+            }
+            int distanceCount = DistanceSymbols;
+            while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0)
+            {
+                --distanceCount;
+            }
+
+            // Both code length lists, run length coded with symbols 16 to 18
+            std::vector<uint8_t> lengths(literalLengths.begin(), literalLengths.begin() + literalCount);
+            lengths.insert(lengths.end(), distanceLengths.begin(), distanceLengths.begin() + distanceCount);
+            std::vector<std::pair<uint8_t, uint8_t>> runs;
+            for (std::size_t i = 0; i < lengths.size();)
+            {
+                uint8_t length = lengths[i];
+                std::size_t run = 1;
+                while (i + run < lengths.size() && lengths[i + run] == length)
+                {
+                    ++run;
+                }
+                i += run;
+
+                if (length == 0)
+                {
+                    while (run >= 11)
+                    {
+                        std::size_t count = std::min<std::size_t>(run, 138);
+                        runs.push_back({ 18, static_cast<uint8_t>(count - 11) });
+                        run -= count;
+                    }
+                    if (run >= 3)
+                    {
+                        runs.push_back({ 17, static_cast<uint8_t>(run - 3) });
+                        run = 0;
+                    }
+                }
+                else
+                {
+                    runs.push_back({ length, 0 });
+                    --run;
+                    while (run >= 3)
+                    {
+                        std::size_t count = std::min<std::size_t>(run, 6);
+                        runs.push_back({ 16, static_cast<uint8_t>(count - 3) });
+                        run -= count;
+                    }
+                }
+                for (; run > 0; --run)
+                {
+                    runs.push_back({ length, 0 });
+                }
+            }
+
+            std::vector<uint32_t> codeLengthFrequencies(CodeLengthSymbols, 0);
+            for (const auto& [symbol, extra] : runs)
+            {
+                ++codeLengthFrequencies[symbol];
+            }
+            std::vector<uint8_t> codeLengthLengths = BuildLengths(codeLengthFrequencies, 7);
+            int codeLengthCount = CodeLengthSymbols;
+            while (codeLengthCount > 4 && codeLengthLengths[CodeLengthOrder[codeLengthCount - 1]] == 0)
+            {
+                --codeLengthCount;
+            }
+
+            auto runExtraBits = [](uint8_t symbol)
+            {
+                return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+            };
+
+            // Compare the sizes before writing anything
+            uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * codeLengthCount;
+            for (const auto& [symbol, extra] : runs)
+            {
+                dynamicBits += codeLengthLengths[symbol] + runExtraBits(symbol);
+            }
+            for (const Token& token : tokens)
+            {
+                if (token.Distance == 0)
+                {
+                    dynamicBits += literalLengths[token.LiteralOrLength];
+                }
+                else
+                {
+                    int lengthSymbol = LengthSymbol(token.LiteralOrLength);
+                    int distanceSymbol = DistanceSymbol(token.Distance);
+                    dynamicBits += literalLengths[257 + lengthSymbol] + LengthExtraBits[lengthSymbol] +
+                        distanceLengths[distanceSymbol] + DistanceExtraBits[distanceSymbol];
+                }
+            }
+            dynamicBits += literalLengths[EndOfBlock];
+
+            uint64_t storedBlocks = std::max<uint64_t>(1, (size + MaxStoredBlockSize - 1) / MaxStoredBlockSize);
+            uint64_t storedBits = storedBlocks * (3 + 7 + 32) + 8ull * size;
+            if (storedBits <= dynamicBits)
+            {
+                WriteStoredBlocks(writer, data, size, final);
+                return;
+            }
+
+            std::vector<uint16_t> literalCodes = BuildCodes(literalLengths);
+            std::vector<uint16_t> distanceCodes = BuildCodes(distanceLengths);
+            std::vector<uint16_t> codeLengthCodes = BuildCodes(codeLengthLengths);
+
+            writer.Write(final ? 1 : 0, 1);
+            writer.Write(2, 2);
+            writer.Write(literalCount - 257, 5);
+            writer.Write(distanceCount - 1, 5);
+            writer.Write(codeLengthCount - 4, 4);
+            for (int i = 0; i < codeLengthCount; ++i)
+            {
+                writer.Write(codeLengthLengths[CodeLengthOrder[i]], 3);
+            }
+            for (const auto& [symbol, extra] : runs)
+            {
+                writer.Write(codeLengthCodes[symbol], codeLengthLengths[symbol]);
+                writer.Write(extra, runExtraBits(symbol));
+            }
+
+            for (const Token& token : tokens)
+            {
+                if (token.Distance == 0)
+                {
+                    writer.Write(literalCodes[token.LiteralOrLength], literalLengths[token.LiteralOrLength]);
+                    continue;
+                }
+
+                int lengthSymbol = LengthSymbol(token.LiteralOrLength);
+                writer.Write(literalCodes[257 + lengthSymbol], literalLengths[257 + lengthSymbol]);
+                writer.Write(token.LiteralOrLength - LengthBase[lengthSymbol], LengthExtraBits[lengthSymbol]);
+
+                int distanceSymbol = DistanceSymbol(token.Distance);
+                writer.Write(distanceCodes[distanceSymbol], distanceLengths[distanceSymbol]);
+                writer.Write(token.Distance - DistanceBase[distanceSymbol], DistanceExtraBits[distanceSymbol]);
+            }
+            writer.Write(literalCodes[EndOfBlock], literalLengths[EndOfBlock]);
+        }
+
+        uint32_t Hash(const uint8_t* data)
+        {
+            uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+            return (value * 2654435761u) >> (32 - HashBits);
+        }
+
+        void Deflate(const uint8_t* data, std::size_t size, std::vector<uint8_t>& output)
+        {
+            BitWriter writer(output);
+            if (size == 0)
+            {
+                WriteStoredBlocks(writer, data, 0, true);
+                writer.AlignToByte();
+                return;
+            }
+
+            // Most recent position of each hash, and the one before it with the same
+            // hash for each position in the window
+            std::vector<int64_t> head(std::size_t(1) << HashBits, -1);
+            std::vector<int64_t> previous(WindowSize, -1);
+            auto insert = [&](std::size_t position)
+            {
+                uint32_t hash = Hash(data + position);
+                previous[position & (WindowSize - 1)] = head[hash];
+                head[hash] = static_cast<int64_t>(position);
+            };
+
+            std::vector<Token> tokens;
+            tokens.reserve(BlockTokens);
+            std::size_t blockStart = 0;
+            std::size_t position = 0;
+
+            while (position < size)
+            {
+                std::size_t bestLength = 0;
+                std::size_t bestDistance = 0;
+
+                if (position + MinMatch <= size)
+                {
+                    std::size_t maxLength = std::min(MaxMatch, size - position);
+                    int64_t candidate = head[Hash(data + position)];
+                    for (int chain = 0; chain < MaxChainLength && candidate >= 0; ++chain)
+                    {
+                        std::size_t distance = position - static_cast<std::size_t>(candidate);
+                        if (distance > WindowSize)
+                        {
+                            break;
+                        }
+
+                        const uint8_t* match = data + candidate;
+                        if (match[bestLength] == data[position + bestLength])
+                        {
+                            std::size_t length = 0;
+                            while (length < maxLength && match[length] == data[position + length])
+                            {
+                                ++length;
+                            }
+                            if (length > bestLength)
+                            {
+                                bestLength = length;
+                                bestDistance = distance;
+                                if (length >= std::min(maxLength, NiceMatch))
+                                {
+                                    break;
+                                }
+                            }
+                        }
+
+                        int64_t next = previous[static_cast<std::size_t>(candidate) & (WindowSize - 1)];
+                        // The slot was reused by a newer position
+                        if (next >= candidate)
+                        {
+                            break;
+                        }
+                        candidate = next;
+                    }
+                    insert(position);
+                }
+
+                if (bestLength >= MinMatch)
+                {
+                    tokens.push_back({ static_cast<uint16_t>(bestLength), static_cast<uint16_t>(bestDistance) });
+                    if (bestLength <= MaxInsertMatch)
+                    {
+                        for (std::size_t i = 1; i < bestLength; ++i)
+                        {
+                            if (position + i + MinMatch <= size)
+                            {
+                                insert(position + i);
+                            }
+                        }
+                    }
+                    position += bestLength;
+                }
+                else
+                {
+                    tokens.push_back({ data[position], 0 });
+                    ++position;
+                }
+
+                if (tokens.size() >= BlockTokens || position == size)
+                {
+                    WriteBlock(writer, tokens, data + blockStart, position - blockStart, position == size);
+                    tokens.clear();
+                    blockStart = position;
+                }
+            }
+            writer.AlignToByte();
+        }
+    }
+
+    namespace Zlib
+    {
+        std::vector<uint8_t> Compress(const uint8_t* data, std::size_t size)
+        {
+            // Deflate with a 32 KiB window at the default level
+            std::vector<uint8_t> output = { 0x78, 0x9C };
+            output.reserve(size / 2 + 64);
+            Deflate(data, size, output);
+
+            uint32_t adler = Adler32(data, size);
+            for (int shift = 24; shift >= 0; shift -= 8)
+            {
+                output.push_back(static_cast<uint8_t>(adler >> shift));
+            }
+            return output;
+        }
+
+        uint32_t Adler32(const uint8_t* data, std::size_t size, uint32_t adler)
+        {
+            // Largest run of bytes before the sums need reducing
+            const std::size_t maxRun = 5552;
+            uint32_t a = adler & 0xFFFF;
+            uint32_t b = adler >> 16;
+            while (size > 0)
+            {
+                std::size_t run = std::min(size, maxRun);
+                size -= run;
+                for (std::size_t i = 0; i < run; ++i)
+                {
+                    a += *data++;
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+            }
+            return (b << 16) | a;
+        }
+
+        uint32_t Crc32(const uint8_t* data, std::size_t size, uint32_t crc)
+        {
+            static const std::array<uint32_t, 256> table = []()
+            {
+                std::array<uint32_t, 256> values;
+                for (uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t value = i;
+                    for (int bit = 0; bit < 8; ++bit)
+                    {
+                        value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                    }
+                    values[i] = value;
+                }
+                return values;
+            }();
+
+            crc = ~crc;
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+    }
+}
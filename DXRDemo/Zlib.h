@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DXRDemo
+{
+    // The parts of zlib the image encoders need, so they need no library.
+    //
+    // Compression finds repeated strings with a hash chain over the 32 KiB
+    // window, greedily taking the longest match, and codes each block of tokens
+    // with Huffman codes built for it. Blocks that would not shrink are stored.
+    namespace Zlib
+    {
+        // A zlib stream (RFC 1950) of the data compressed with deflate (RFC 1951)
+        std::vector<uint8_t> Compress(const uint8_t* data, std::size_t size);
+
+        // Checksums, continued from the value of the data before when given
+        uint32_t Adler32(const uint8_t* data, std::size_t size, uint32_t adler = 1);
+        uint32_t Crc32(const uint8_t* data, std::size_t size, uint32_t crc = 0);
+    }
+}